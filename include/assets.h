@@ -0,0 +1,23 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+#include <stdint.h>
+#include "lcd.h"
+
+// Pictures made at compile time, next to the raw arrays they describe
+// (images.h, combo.h): a const Picture is the handle the blits take, so
+// drawing an asset touches no heap. A raw asset is an 8-byte header
+// (width, height, 32 bits each) and then RGB565 pixels; its descriptor
+// points past the header. ASSET_CHECK() stops the build if an array's
+// size does not match the dimensions written with it, or the picture is
+// bigger than the screen. include/assets.hpp is the C++ form.
+
+#define ASSET_HEADER 8
+#define ASSET_BYTES(w, h) (ASSET_HEADER + (w) * (h) * 2)
+
+#define ASSET_CHECK(raw, w, h)                                                   \
+    _Static_assert(sizeof(raw) == ASSET_BYTES(w, h), #raw " is not " #w "x" #h); \
+    _Static_assert((w) <= LCD_W && (h) <= LCD_H, #raw " is bigger than the screen")
+
+// Initialiser of the const Picture for raw, which is w x h
+#define ASSET_PICTURE(raw, w, h) { (w), (h), 2, (unsigned char *)(raw) + ASSET_HEADER }
+#endif
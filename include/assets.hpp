@@ -0,0 +1,30 @@
+#ifndef ASSETS_HPP
+#define ASSETS_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "assets.h"
+}
+
+// C++ form of assets.h: a raw array's dimensions are template arguments,
+// checked against its size and the screen when the descriptor is made,
+// and a table of them is a constexpr std::array:
+//
+//     constexpr auto frames = asset_table(asset_picture<240, 200>(frame_0_raw),
+//                                         asset_picture<240, 200>(frame_1_raw));
+//     LCD_DrawPictureStart(0, 0, &frames[i]);
+
+template <unsigned W, unsigned H, std::size_t N>
+constexpr Picture asset_picture(const uint8_t (&raw)[N]) {
+    static_assert(N == ASSET_BYTES(W, H), "asset size does not match its dimensions");
+    static_assert(W <= LCD_W && H <= LCD_H, "asset is bigger than the screen");
+    return Picture{ W, H, 2, const_cast<unsigned char *>(raw + ASSET_HEADER) };
+}
+
+template <typename... P>
+constexpr std::array<Picture, sizeof...(P)> asset_table(P... pics) {
+    return { { pics... } };
+}
+#endif
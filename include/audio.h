@@ -0,0 +1,21 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Song playback on the PWM/DMA set up once by init_pwm_dma(). core0 runs
+// audio_service() in its loop; the game's tasks, on the same core, ask over
+// a channel for the song to start over or stop, for a click track instead
+// (calibration) or for a volume, and the request is handled before the call
+// returns. The DMA channel, IRQ and buffers are kept between rounds.
+
+void audio_init(const uint8_t *pcm, uint32_t samples);
+void audio_service(void);
+void audio_play(void);
+uint32_t audio_click(uint32_t period_ms, bool audible);
+void audio_stop(void);
+void audio_set_volume(uint16_t permille);
+bool audio_playing(void);
+bool audio_idle(void);
+uint32_t audio_sample_rate(void);
+#endif
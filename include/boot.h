@@ -0,0 +1,51 @@
+#ifndef BOOT_H
+#define BOOT_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot as a graph of init steps. Both cores run boot_run(); each takes the
+// next step whose dependencies are done and that may run on it, so
+// independent subsystems come up side by side. A step that has to wait
+// (reset pulse, settle time) returns when it wants to be called again
+// instead of sleeping, and its core runs other steps meanwhile.
+
+#define BOOT_MAX_STEPS 16
+
+// Cores a step may run on
+#define BOOT_CORE0 0x01
+#define BOOT_CORE1 0x02
+#define BOOT_ANY (BOOT_CORE0 | BOOT_CORE1)
+
+// Dependency mask bit of step i
+#define BOOT_DEP(i) (1u << (i))
+
+// Longest wait for the other core to finish a step before looking again
+#define BOOT_POLL_US 1000
+
+// Returns 0 when done, else the time (us since boot) to be called again
+typedef uint64_t (*boot_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    boot_fn_t fn;
+    uint8_t cores;              ///< BOOT_CORE0 and/or BOOT_CORE1
+    uint32_t deps;              ///< BOOT_DEP() of every step that must finish first
+} boot_step_t;
+
+typedef struct {
+    uint64_t start_us;          ///< first call
+    uint64_t end_us;            ///< returned 0
+    uint32_t busy_us;           ///< time spent in the calls
+    uint16_t calls;
+    uint8_t core;               ///< core that ran it
+} boot_record_t;
+
+void boot_init(const boot_step_t *steps, uint8_t count);
+void boot_run(uint8_t core);
+bool boot_done(void);
+uint64_t boot_done_us(void);
+const boot_record_t *boot_record(uint8_t step);
+void boot_print(void);
+void boot_first_beat(void);
+uint64_t boot_first_beat_us(void);
+#endif
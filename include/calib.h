@@ -0,0 +1,55 @@
+#ifndef CALIB_H
+#define CALIB_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "neotrellis.h"
+
+// Latency calibration: the player taps along to a click track (audio
+// offset), then to LED flashes with the speaker silent (visual offset).
+// The offsets are kept in the settings store (KV_KEY_CALIB) and handed to
+// the song clock.
+
+#define CALIB_PERIOD_MS 500
+// Clicks to find the beat before taps count, then clicks that count
+#define CALIB_LEADIN 4
+#define CALIB_BEATS 16
+// Taps left after outlier rejection for a phase to count
+#define CALIB_MIN_TAPS 8
+// Taps further than this many spreads (1.4826 * MAD) from the median are
+// dropped, but never closer than CALIB_OUTLIER_MIN_US
+#define CALIB_OUTLIER_K 3
+#define CALIB_OUTLIER_MIN_US 15000
+// LED flash length in the visual phase
+#define CALIB_FLASH_MS 80
+#define CALIB_INPUT_PERIOD_US 1000
+
+typedef enum {
+    CALIB_IDLE = 0,
+    CALIB_AUDIO,                ///< tapping to clicks
+    CALIB_VISUAL,               ///< tapping to LED flashes
+    CALIB_DONE,                 ///< offsets applied and saved
+    CALIB_FAILED,               ///< too few usable taps, old offsets kept
+} calib_phase_t;
+
+typedef struct {
+    uint32_t taps;              ///< taps matched to a counted beat
+    uint32_t kept;              ///< after outlier rejection
+    int32_t offset_us;          ///< mean lateness of the kept taps
+    uint32_t spread_us;         ///< 1.4826 * median absolute deviation
+} calib_result_t;
+
+// Value of KV_KEY_CALIB
+typedef struct {
+    int32_t audio_us;
+    int32_t visual_us;
+} calib_record_t;
+
+void calib_start(void);
+void calib_cancel(void);
+calib_phase_t calib_phase(void);
+void calib_key(keyEvent evt);
+bool calib_get_result(bool visual, calib_result_t *out);
+bool calib_offset(const int32_t *err_us, uint32_t n, calib_result_t *out);
+bool calib_load(void);
+bool calib_save(int32_t audio_us, int32_t visual_us);
+#endif
@@ -0,0 +1,45 @@
+#ifndef CHAN_H
+#define CHAN_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single-producer/single-consumer message ring in shared SRAM. One side
+// (a core, or an IRQ handler with the thread side of that core not
+// pushing) calls chan_push(), the other chan_pop(). Messages are copied in
+// and out by value; the indices are published with release stores and read
+// with acquire loads, so a message is whole before the other core sees it.
+//
+// Typed channels: CHAN_DEFINE(name, type, depth, flags) defines a channel
+// ready to use, with name_push()/name_pop() taking the message type. They
+// are forced inline, so a push from SRAM stays in SRAM at -O0 (hotpath.h).
+
+// Ring the other core's event (SEV) after each push, waking it from WFE.
+// The SIO FIFO is not used: core0 is the flash lockout victim and its FIFO
+// IRQ eats every word that is not a lockout request.
+#define CHAN_DOORBELL 1u
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;              ///< bytes per message
+    uint32_t mask;              ///< depth - 1, depth a power of two
+    uint32_t flags;
+    uint32_t head;              ///< messages pushed; producer writes
+    uint32_t tail;              ///< messages popped; consumer writes
+    uint32_t dropped;           ///< pushes refused because full; producer writes
+    uint32_t high_water;        ///< most messages waiting; producer writes
+} chan_t;
+
+void chan_init(chan_t *c, void *storage, uint32_t size, uint32_t depth, uint32_t flags);
+void chan_reset(chan_t *c);
+bool chan_push(chan_t *c, const void *msg);
+bool chan_pop(chan_t *c, void *msg);
+bool chan_peek(const chan_t *c, void *msg);
+uint32_t chan_count(const chan_t *c);
+uint32_t chan_free(const chan_t *c);
+
+#define CHAN_DEFINE(name, type, depth, flags)                                   \
+    static type name##_storage[depth];                                          \
+    static chan_t name = { (uint8_t *)name##_storage, sizeof(type), (depth) - 1, (flags), 0, 0, 0, 0 }; \
+    static inline __attribute__((always_inline)) bool name##_push(const type *msg) { return chan_push(&name, msg); } \
+    static inline __attribute__((always_inline)) bool name##_pop(type *msg) { return chan_pop(&name, msg); }
+#endif
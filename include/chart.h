@@ -0,0 +1,79 @@
+#ifndef CHART_H
+#define CHART_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary chart (beatmap), little endian:
+//   chart_header_t, then note_count chart_note_t sorted by time.
+// Times are in song samples, i.e. the audio sample index the DMA is playing,
+// so notes stay locked to the music. sample_rate is only used to turn
+// millisecond windows into samples.
+
+#define CHART_MAGIC 0x48434B4Du     // "MKCH"
+#define CHART_VERSION 1
+#define CHART_MAX_LANES 64
+
+// Playback rate of pwm.c: 150 MHz / (1.22 * (PWM_TOP + 1)), one sample per wrap
+#define CHART_SAMPLE_RATE 31478
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t lanes;             ///< keys the chart is written for
+    uint32_t sample_rate;
+    uint32_t note_count;
+    uint32_t crc32;             ///< over the note table
+    uint32_t reserved;          ///< 0; keeps the note table 8-byte aligned
+} chart_header_t;
+
+typedef struct {
+    uint32_t time;              ///< song sample the note is on
+    uint32_t hold;              ///< hold length in samples, 0 = tap
+    uint64_t lanes;             ///< key bitmask, more than one bit = chord
+} chart_note_t;
+
+typedef enum {
+    CHART_OK = 0,
+    CHART_ERR_SIZE = -1,
+    CHART_ERR_MAGIC = -2,
+    CHART_ERR_VERSION = -3,
+    CHART_ERR_ALIGN = -4,
+    CHART_ERR_CRC = -5,
+    CHART_ERR_ORDER = -6,
+    CHART_ERR_LANES = -7,
+    CHART_ERR_IO = -8,
+} chart_err_t;
+
+typedef struct {
+    const chart_header_t *hdr;
+    const chart_note_t *notes;  ///< points into the image, no copy
+    uint32_t count;
+    uint32_t rate;
+    uint16_t lanes;
+    void *owned;                ///< heap image from chart_load_file, else NULL
+} chart_t;
+
+// Streaming cursor over the notes whose time + offset has been reached.
+// Time only moves forward, so each note is passed once: O(1) amortized per
+// tick. A judgement window is the notes between two cursors, e.g. offsets
+// -early and +late.
+typedef struct {
+    const chart_t *chart;
+    uint32_t next;              ///< first note not yet reached
+    int32_t offset;             ///< samples added to the note time
+} chart_cursor_t;
+
+uint32_t chart_crc32(const void *data, uint32_t len);
+chart_err_t chart_open(chart_t *chart, const void *image, uint32_t len);
+chart_err_t chart_load_file(chart_t *chart, const char *path);
+void chart_close(chart_t *chart);
+const char *chart_strerror(chart_err_t err);
+uint32_t chart_ms_to_samples(const chart_t *chart, uint32_t ms);
+uint32_t chart_write(uint8_t *out, uint32_t cap, uint16_t lanes, uint32_t rate,
+                     const chart_note_t *notes, uint32_t count);
+
+void chart_cursor_init(chart_cursor_t *cur, const chart_t *chart, int32_t offset);
+int32_t chart_cursor_take(chart_cursor_t *cur, uint64_t now);
+void chart_cursor_seek(chart_cursor_t *cur, uint64_t now);
+bool chart_cursor_done(const chart_cursor_t *cur);
+#endif
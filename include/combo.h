@@ -3,7 +3,8 @@
 
 #include <stdint.h>
 #include "lcd.h"
-#include "bmp.h"
+#include "assets.h"
+#include "hotpath.h"
 
 /*! \brief helper function for displaying changing text while occupying the least possible runtime.
     \param x x value of first pixel
@@ -11,7 +12,7 @@
     \param pic struct with picture information
     \param chg boolean indicating change in combo value
 */
-void _disp_combo(u16 x, u16 y, const Picture* pic){
+void HOT_FUNC(_disp_combo)(u16 x, u16 y, const Picture* pic){
     // Cast the pixel data pointer to the correct 16-bit type
     u16 *pixel_ptr = (u16 *)pic->pixel_data;
     lcddev.select(1);
@@ -12060,18 +12061,30 @@ const uint8_t combo_raw[48008] = { 0XC8,0X00,0x00,0x00,0X78,0X00,0x00,0x00,
 0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,0XFF,
 };
 
-const uint8_t* combo_txt[] = {
-    combo_raw, 
-    raw_0,
-    raw_1,
-    raw_2,
-    raw_3,
-    raw_4,
-    raw_5,
-    raw_6,
-    raw_7,
-    raw_8,
-    raw_9
+// The combo text, then the digits 0 to 9, as pictures
+ASSET_CHECK(combo_raw, 200, 120);
+ASSET_CHECK(raw_0, 60, 120);
+ASSET_CHECK(raw_1, 60, 120);
+ASSET_CHECK(raw_2, 60, 120);
+ASSET_CHECK(raw_3, 60, 120);
+ASSET_CHECK(raw_4, 60, 120);
+ASSET_CHECK(raw_5, 60, 120);
+ASSET_CHECK(raw_6, 60, 120);
+ASSET_CHECK(raw_7, 60, 120);
+ASSET_CHECK(raw_8, 60, 120);
+ASSET_CHECK(raw_9, 60, 120);
+const Picture combo_txt[] = {
+    ASSET_PICTURE(combo_raw, 200, 120),
+    ASSET_PICTURE(raw_0, 60, 120),
+    ASSET_PICTURE(raw_1, 60, 120),
+    ASSET_PICTURE(raw_2, 60, 120),
+    ASSET_PICTURE(raw_3, 60, 120),
+    ASSET_PICTURE(raw_4, 60, 120),
+    ASSET_PICTURE(raw_5, 60, 120),
+    ASSET_PICTURE(raw_6, 60, 120),
+    ASSET_PICTURE(raw_7, 60, 120),
+    ASSET_PICTURE(raw_8, 60, 120),
+    ASSET_PICTURE(raw_9, 60, 120)
 };
 const uint32_t combo_img_ct = 11;
 /*! \brief helper function to compare combo count and update screen as needed
@@ -12083,32 +12096,26 @@ void _disp_combo_help(int combo, int* ten, int* one, bool* combo_disp){
     if (combo == 0){
         LCD_DrawFillRectangle(14, 200, 230, 305, 0xC71D);
         *combo_disp = false;
+        // Digits are gone too: the next tens digit has to be drawn
+        *ten = 0;
+        *one = 0;
     }
     if (combo > 0){
-        Picture* combo_img = NULL;
         if (!(*combo_disp)){
-            combo_img = load_image(combo_txt[0]);
-            _disp_combo(9, 200, combo_img);
-            free_image(combo_img);
+            _disp_combo(9, 200, &combo_txt[0]);
             *combo_disp = true;
         }
         if(combo<10){
-            combo_img = load_image(combo_txt[combo+1]);
-            _disp_combo(151, 200, combo_img);
-            free_image(combo_img);
+            _disp_combo(151, 200, &combo_txt[combo+1]);
         }
         else{
             int chg10 = (*ten) == combo/10 ? false: true;
             *ten = combo/10;
             *one = combo%10;
             if (chg10){
-                combo_img = load_image(combo_txt[(*ten)+1]);
-                _disp_combo(130, 200, combo_img);
-                free_image(combo_img);
+                _disp_combo(130, 200, &combo_txt[(*ten)+1]);
             }
-            combo_img = load_image(combo_txt[(*one)+1]);
-            _disp_combo(175, 200, combo_img);
-            free_image(combo_img);
+            _disp_combo(175, 200, &combo_txt[(*one)+1]);
         }
     }
 }
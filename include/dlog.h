@@ -0,0 +1,54 @@
+#ifndef DLOG_H
+#define DLOG_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Deferred log: DLOG() stores the format string's address and its
+// arguments as they are, and nothing is formatted on the device. A low
+// priority task on core0 drains the records to stdio as hex lines, and
+// sim dlog decode rebuilds the text from the firmware ELF, where the
+// format strings are. A call takes a channel push, so it can sit next to
+// a beat; a full channel drops the record and counts it.
+//
+// Arguments are 32-bit integers. A 64-bit value goes in with DLOG_U64()
+// and takes %llx / %llu / %lld; a string literal (or other constant string
+// in the image) goes in with DLOG_STR() and takes %s. Tasks on either core
+// may log; IRQs may not.
+
+// Records waiting per core, a power of two
+#define DLOG_DEPTH 128
+#define DLOG_MAX_ARGS 6
+// Drain task period, and records it writes per run at most
+#define DLOG_DRAIN_PERIOD_US 10000
+#define DLOG_DRAIN_MAX 16
+
+typedef struct {
+    uint32_t t_us;              ///< time_us_32() at the call
+    const char *fmt;
+    uint32_t n;                 ///< arguments used
+    uint32_t arg[DLOG_MAX_ARGS];
+} dlog_rec_t;
+
+// Writes the drained text; NULL = putchar()
+typedef void (*dlog_sink_t)(const char *s, uint32_t len);
+
+// Argument count of a DLOG() call, 0 to DLOG_MAX_ARGS
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(_, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+
+#define DLOG(fmt, ...) dlog_put(fmt, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+// A 64-bit value as two arguments, low word first
+#define DLOG_U64(v) (uint32_t)(uint64_t)(v), (uint32_t)((uint64_t)(v) >> 32)
+// A constant string, as its distance from dlog_anchor
+#define DLOG_STR(s) (uint32_t)((uintptr_t)(s) - (uintptr_t)dlog_anchor)
+
+// Its address tells sim dlog decode where the ELF was loaded
+extern const char dlog_anchor[];
+
+void dlog_put(const char *fmt, uint32_t n, ...);
+void dlog_start(void);
+uint32_t dlog_drain(uint32_t max);
+void dlog_set_sink(dlog_sink_t s);
+void dlog_reset(void);
+uint32_t dlog_lost(void);
+#endif
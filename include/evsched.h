@@ -0,0 +1,103 @@
+#ifndef EVSCHED_H
+#define EVSCHED_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Priorities, highest first. Due tasks run highest priority first, and a
+// task is not started if a beat task falls due before it would be done,
+// so beats are not held up by a frame draw.
+typedef enum {
+    EVS_PRIO_BEAT = 0,      ///< note open / beat / close, round end
+    EVS_PRIO_INPUT,         ///< keypad poll and queued LED writes
+    EVS_PRIO_LED,           ///< staging the next note; core1: the HUD
+    EVS_PRIO_FRAME,         ///< LCD frame
+    EVS_PRIOS
+} evsched_prio_t;
+
+// Tasks that can be registered, per core
+#define EVS_MAX_TASKS 16
+// Cores with a scheduler of their own
+#define EVS_CORES 2
+
+typedef struct evsched_task evsched_task_t;
+typedef void (*evsched_fn_t)(evsched_task_t *task, uint64_t now_us);
+
+struct evsched_task {
+    const char *name;
+    evsched_prio_t prio;
+    evsched_fn_t fn;
+    void *arg;
+    uint32_t period_us;     ///< requeued this long after its release; 0 = queues itself
+    uint32_t deadline_us;   ///< must be done this long after its release; 0 = none
+    // Owned by the scheduler
+    uint64_t at_us;         ///< when it is due, if queued
+    uint64_t release_us;    ///< due time of the job in progress
+    uint16_t resume;        ///< EVS_BEGIN() resume point, 0 = job not started
+    uint8_t core;           ///< scheduler it was registered on
+    uint8_t trace_id;       ///< its slices in the event trace
+    int8_t slot;            ///< position in its priority heap, -1 = not queued
+    uint32_t cost_us;       ///< recent worst slice (run until it returns), decays slowly
+    uint32_t runs;          ///< slices
+    uint64_t late_sum_us;   ///< start time - due time
+    uint32_t late_max_us;
+    uint32_t held;          ///< starts put off for a beat task
+    uint32_t jobs;          ///< jobs finished (one run, or slices up to EVS_END())
+    uint32_t job_us;        ///< run time of the job in progress
+    uint64_t run_sum_us;    ///< run time over the finished jobs
+    uint32_t run_max_us;
+    uint32_t misses;        ///< jobs done after their deadline
+    uint32_t over_max_us;   ///< worst finish past the deadline
+};
+
+// Whole-core counters, written by the core that owns the scheduler and
+// readable from the other; they wrap
+typedef struct {
+    uint32_t passes;        ///< evsched_run_once() calls
+    uint32_t idle_us;       ///< time asleep with nothing due
+    uint32_t misses;        ///< jobs done after their deadline, all tasks
+} evsched_load_t;
+
+/* Stackless coroutines (protothreads) for tasks
+    A task body between EVS_BEGIN() and EVS_END() can give the core back in
+    the middle of a job, typically while DMA or I2C finishes, and go on
+    from the same line when it runs again. Each wait requeues the task, so
+    due tasks of any priority run in between. Locals do not survive a wait
+    (keep state in statics or task->arg), and no switch may span one.
+    The job, for the run time and the deadline, is everything from
+    EVS_BEGIN() to EVS_END().
+*/
+#define EVS_BEGIN(t) switch ((t)->resume) { case 0:
+#define EVS_END(t) } (t)->resume = 0
+
+// Give the core back until at_us (absolute), then go on from here
+#define EVS_YIELD_UNTIL(t, at_us)                   \
+    do {                                            \
+        (t)->resume = __LINE__;                     \
+        evsched_at((t), (at_us));                   \
+        return;                                     \
+    case __LINE__:;                                 \
+    } while (0)
+
+// Give the core back until cond holds, looking again every poll_us
+#define EVS_WAIT_UNTIL(t, cond, poll_us)            \
+    do {                                            \
+        (t)->resume = __LINE__;                     \
+    case __LINE__:                                  \
+        if (!(cond)) {                              \
+            evsched_at((t), time_us_64() + (poll_us)); \
+            return;                                 \
+        }                                           \
+    } while (0)
+
+void evsched_init(void);
+void evsched_task(evsched_task_t *task, const char *name, evsched_prio_t prio,
+                  evsched_fn_t fn, void *arg);
+void evsched_timing(evsched_task_t *task, uint32_t period_us, uint32_t deadline_us);
+void evsched_at(evsched_task_t *task, uint64_t at_us);
+void evsched_cancel(evsched_task_t *task);
+bool evsched_queued(const evsched_task_t *task);
+bool evsched_run_once(void);
+void evsched_get_load(uint32_t core, evsched_load_t *out);
+void evsched_reset_stats(void);
+void evsched_print_stats(void);
+#endif
@@ -0,0 +1,43 @@
+#ifndef GAMEFLOW_H
+#define GAMEFLOW_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Round flow on core0: the first round starts at boot; after its results a
+// key press counts down into the next one (or attract after a while). Peripherals, DMA and
+// buffers are set up once at boot and reused by every round.
+
+// Attract chase step
+#define FLOW_ATTRACT_STEP_MS 120
+// Countdown: this many steps before the song starts
+#define FLOW_COUNTDOWN_STEPS 3
+#define FLOW_COUNTDOWN_STEP_MS 500
+// Results stay up this long, then attract
+#define FLOW_RESULTS_MS 8000
+// Keypad poll and LED writes between rounds
+#define FLOW_IDLE_TICK_MS 10
+// Holding a key this long between rounds calibrates instead of starting
+#define FLOW_CALIB_HOLD_MS 2000
+// Longest wait for core0 to have the song running again
+#define FLOW_AUDIO_WAIT_US 50000
+
+typedef enum {
+    FLOW_ATTRACT = 0,
+    FLOW_COUNTDOWN,
+    FLOW_PLAY,
+    FLOW_RESULTS,
+    FLOW_CALIBRATE,
+} flow_state_t;
+
+typedef void (*flow_hook_t)(flow_state_t state);
+
+typedef struct {
+    uint32_t rounds;
+    uint32_t start_last_us;     ///< countdown over to round running (song rewound, chart reset)
+    uint32_t start_max_us;
+} flow_stats_t;
+
+void flow_init(flow_hook_t hook);
+flow_state_t flow_state(void);
+void flow_get_stats(flow_stats_t *out);
+#endif
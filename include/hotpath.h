@@ -0,0 +1,48 @@
+#ifndef HOTPATH_H
+#define HOTPATH_H
+#include "pico/stdlib.h"
+
+// Code and tables on the paths that run every sample buffer, pixel or bus
+// transfer, copied to SRAM at boot so they never wait on the XIP cache,
+// which the frames' blit DMA and the song data keep churning. Mark a
+// function's name with HOT_FUNC() where it is defined, and a table with
+// HOT_DATA. Build with -DHOT_IN_FLASH to leave them all in flash and
+// compare the rounds' XIP stats (xipmon.c).
+//
+// The sources build at -O0, which inlines nothing but forced inlines: an
+// SDK helper that is only static inline is a call into flash even from
+// SRAM, so hot loops touch the hardware registers themselves, and what
+// they call of ours is HOT_FUNC or forced inline too (chan_push(), the
+// typed channel wrappers, i2c_sched_xfer_us(), hot_time_us_64()). What is
+// left in flash is SDK library code (the I2C transfers, a Seesaw settle
+// that has to sleep) and the stress build's SHOW hook.
+
+#ifdef HOT_IN_FLASH
+#define HOT_FUNC(f) f
+#define HOT_DATA
+#else
+#define HOT_FUNC(f) __not_in_flash_func(f)
+#define HOT_DATA __not_in_flash("hot")
+#endif
+
+#ifdef SIM_HOST
+#define hot_time_us_64() time_us_64()
+#else
+#include "hardware/structs/timer.h"
+
+// time_us_64() from the registers: the SDK's is in flash. The high word is
+// read again until it holds still across the low one.
+static inline __attribute__((always_inline)) uint64_t hot_time_us_64(void) {
+    uint32_t hi = timer_hw->timerawh;
+    uint32_t lo;
+    for (;;) {
+        lo = timer_hw->timerawl;
+        uint32_t next_hi = timer_hw->timerawh;
+        if (next_hi == hi)
+            break;
+        hi = next_hi;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+#endif
+#endif
@@ -0,0 +1,67 @@
+#ifndef I2C_SCHED_H
+#define I2C_SCHED_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bus timing at 400 kHz: 9 SCL clocks per byte (8 data + ACK) = 22.5 us
+#define I2C_SCHED_BUS_HZ 400000
+#define I2C_SCHED_BYTE_NS 22500
+// START + STOP + bus free time
+#define I2C_SCHED_XFER_OVERHEAD_NS 5000
+
+// Bus time LED writes may use per tick, after the keypad poll has run
+#define I2C_SCHED_LED_BUDGET_US 2000
+
+// No keypad poll is started this close to an armed beat SHOW
+// (COUNT + FIFO pipeline with events is about 2.2 ms)
+#define I2C_SCHED_BEAT_GUARD_US 2500
+
+// Seesaw I2C buffer is 32 bytes: 2 offset bytes + 10 GRB pixels
+#define I2C_SCHED_MAX_RUN 10
+
+typedef struct {
+    uint32_t ticks;             ///< number of i2c_sched_tick() calls
+    uint64_t bus_us;            ///< modelled time the wires were busy
+    uint64_t window_us;         ///< wall time covered by the ticks
+    uint32_t input_delay_max_us;///< worst gap between two keypad polls
+    uint32_t input_delay_last_us;
+    uint32_t led_writes;        ///< pixel buffer transactions put on the wire
+    uint32_t led_shows;         ///< frames committed (one SHOW per changed board)
+    uint32_t led_coalesced;     ///< pixel updates merged into a pending one
+    uint32_t led_deferred;      ///< ticks that ran out of LED budget
+    uint32_t beat_staged;       ///< beat SHOWs armed
+    uint32_t beat_shows;        ///< beat SHOWs sent
+    uint64_t beat_jitter_sum_us;
+    uint32_t beat_jitter_max_us;///< SHOW done vs. song deadline
+    uint32_t polls_held;        ///< keypad polls pushed past a beat SHOW
+} i2c_sched_stats_t;
+
+// Pixel p is board p / 16, local key p % 16; bit p set = pixel not yet shown
+typedef void (*i2c_sched_show_hook_t)(uint64_t unshown);
+
+/*! \brief Bus time of a single I2C transaction
+    \param bytes bytes on the wire including the address byte
+    \return transaction time in microseconds; forced inline, as the SRAM
+    send paths use it (hotpath.h)
+*/
+static inline __attribute__((always_inline)) uint32_t i2c_sched_xfer_us(uint32_t bytes) {
+    return (bytes * I2C_SCHED_BYTE_NS + I2C_SCHED_XFER_OVERHEAD_NS + 999) / 1000;
+}
+
+void i2c_sched_init(uint32_t led_budget_us);
+void i2c_sched_set_pixel(uint8_t board, uint8_t local, uint8_t g, uint8_t r, uint8_t b);
+void i2c_sched_show(void);
+void i2c_sched_bus_begin(void);
+void i2c_sched_bus_end(uint32_t wire_bytes);
+void i2c_sched_bus_idle(void);
+int i2c_sched_stage_show(uint64_t song_us);
+void i2c_sched_cancel_beat(void);
+void i2c_sched_poll_begin(void);
+void i2c_sched_tick(void);
+void i2c_sched_flush(void);
+bool i2c_sched_idle(void);
+i2c_sched_show_hook_t i2c_sched_set_show_hook(i2c_sched_show_hook_t hook);
+void i2c_sched_get_stats(i2c_sched_stats_t *out);
+void i2c_sched_reset_stats(void);
+void i2c_sched_print_stats(void);
+#endif
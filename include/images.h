@@ -2,6 +2,7 @@
 #define IMAGES_H
 
 #include <stdint.h>
+#include "assets.h"
 const uint8_t frame_0_raw[] = { 0XF0, 0x00, 0x00, 0x00, 0XC8, 0x00, 0x00, 0x00,
 0X1D,0XC7,0X3D,0XCF,0X3E,0XCF,0X1D,0XC7,0X3E,0XCF,0X3D,0XCF,0X3E,0XCF,0X1D,0XC7,
 0X3D,0XCF,0X3E,0XC7,0X3D,0XCF,0X3E,0XCF,0X3D,0XCF,0X3D,0XCF,0X3E,0XCF,0X1D,0XC7,
@@ -36016,14 +36017,21 @@ const uint8_t frame_5_raw[96008] = { 0XF0, 0x00, 0x00, 0x00, 0XC8, 0x00, 0x00, 0
 0X3D,0XCF,0X1D,0XC7,0X3E,0XCF,0X1D,0XC7,0X3E,0XCF,0X1D,0XC7,0X3E,0XCF,0X3D,0XCF,
 };
 
-// Array of pointers to all animation frames
-const uint8_t* mystery_frames[] = {
-    frame_0_raw,
-    frame_1_raw,
-    frame_2_raw,
-    frame_3_raw,
-    frame_4_raw,
-    frame_5_raw
+// The animation frames as pictures, made with them: blitted straight
+// from flash, nothing loaded at run time
+ASSET_CHECK(frame_0_raw, 240, 200);
+ASSET_CHECK(frame_1_raw, 240, 200);
+ASSET_CHECK(frame_2_raw, 240, 200);
+ASSET_CHECK(frame_3_raw, 240, 200);
+ASSET_CHECK(frame_4_raw, 240, 200);
+ASSET_CHECK(frame_5_raw, 240, 200);
+const Picture mystery_frames[] = {
+    ASSET_PICTURE(frame_0_raw, 240, 200),
+    ASSET_PICTURE(frame_1_raw, 240, 200),
+    ASSET_PICTURE(frame_2_raw, 240, 200),
+    ASSET_PICTURE(frame_3_raw, 240, 200),
+    ASSET_PICTURE(frame_4_raw, 240, 200),
+    ASSET_PICTURE(frame_5_raw, 240, 200)
 };
 
 const uint32_t mystery_frame_count = 6;
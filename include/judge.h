@@ -0,0 +1,67 @@
+#ifndef JUDGE_H
+#define JUDGE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "chart.h"
+
+// Notes of a lane that can wait for a press at the same time
+#define JUDGE_LANE_DEPTH 4
+// Notes inside the good window at once, across all lanes
+#define JUDGE_WINDOW 32
+
+typedef enum {
+    JUDGE_PERFECT = 0,
+    JUDGE_GREAT,
+    JUDGE_GOOD,
+    JUDGE_MISS,
+    JUDGE_GRADES
+} judge_grade_t;
+
+typedef enum {
+    JUDGE_EV_HIT,           ///< press matched a note, grade and offset set
+    JUDGE_EV_MISS,          ///< lane of a note was never pressed
+    JUDGE_EV_HOLD_OK,       ///< hold kept to its end
+    JUDGE_EV_HOLD_DROP,     ///< hold released early
+    JUDGE_EV_STRAY,         ///< press with no note in reach on that lane
+} judge_ev_kind_t;
+
+typedef struct {
+    judge_ev_kind_t kind;
+    judge_grade_t grade;
+    uint32_t note;          ///< note index (not set for JUDGE_EV_STRAY)
+    uint8_t lane;
+    int32_t offset;         ///< press - note time in samples, + = late
+} judge_event_t;
+
+// Half-widths of the timing windows in milliseconds
+typedef struct {
+    uint16_t perfect_ms;
+    uint16_t great_ms;
+    uint16_t good_ms;       ///< outside this a press does not count
+} judge_windows_t;
+
+#define JUDGE_WINDOWS_DEFAULT { .perfect_ms = 33, .great_ms = 66, .good_ms = 100 }
+
+typedef struct {
+    uint32_t count[JUDGE_GRADES];
+    uint32_t strays;
+    uint32_t holds_ok;
+    uint32_t holds_dropped;
+    uint32_t combo;
+    uint32_t max_combo;
+    int64_t offset_sum;     ///< signed, over hits: early/late bias
+    uint64_t abs_offset_sum;
+} judge_stats_t;
+
+typedef void (*judge_callback_t)(const judge_event_t *ev);
+
+void judge_init(const chart_t *chart, const judge_windows_t *windows, judge_callback_t cb);
+void judge_seek(uint64_t now);
+void judge_update(uint64_t now);
+void judge_press(uint8_t lane, uint64_t at);
+void judge_release(uint8_t lane, uint64_t at);
+uint64_t judge_hit_lanes(uint32_t note);
+void judge_get_stats(judge_stats_t *out);
+uint32_t judge_accuracy_permille(const judge_stats_t *st);
+void judge_print_stats(void);
+#endif
@@ -0,0 +1,74 @@
+#ifndef KVSTORE_H
+#define KVSTORE_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Settings kept in flash: a log of CRC'd key/value records in the last
+// KV_SECTORS sectors. One sector is active; records are appended to it and
+// a full sector is compacted into the least worn other one. kv_set() only
+// stages a value in RAM; kv_commit() writes, and refuses while audio plays.
+
+#define KV_SECTORS 4
+// Largest value, and keys live at once
+#define KV_VALUE_MAX 64
+#define KV_MAX_KEYS 16
+
+#define KV_SECTOR_MAGIC 0x3153564Bu     // "KVS1"
+#define KV_COMMITTED 0x54494D43u        // "CMIT", programmed once a copy is complete
+
+// Keys in use
+#define KV_KEY_CALIB 1                  ///< calib_record_t
+#define KV_KEY_HISCORE 2                ///< kv_hiscore_t
+#define KV_KEY_VOLUME 3                 ///< uint16_t master volume, permille
+
+typedef struct {
+    uint32_t chart_crc;         ///< crc32 field of the chart played
+    uint32_t accuracy;          ///< judge_accuracy_permille()
+    uint32_t max_combo;
+} kv_hiscore_t;
+
+// First bytes of every sector in use
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               ///< compaction count, the highest committed sector is active
+    uint32_t erases[KV_SECTORS];  ///< wear of every sector when this one was written
+    uint32_t crc32;             ///< over the fields above
+    uint32_t committed;         ///< KV_COMMITTED, else the copy never finished
+} kv_sector_hdr_t;
+
+// Record header; the value follows, padded to 4 bytes
+typedef struct {
+    uint16_t key;               ///< 0xFFFF: free space from here on
+    uint16_t len;
+    uint32_t crc32;             ///< over key, len and value
+} kv_rec_t;
+
+typedef enum {
+    KV_OK = 0,
+    KV_ERR_NOT_FOUND = -1,
+    KV_ERR_SIZE = -2,
+    KV_ERR_FULL = -3,           ///< too many keys, or live records fill a sector
+    KV_ERR_BUSY = -4,           ///< audio is playing or the renderer did not stop; try again later
+    KV_ERR_IO = -5,             ///< flash write failed or did not read back
+} kv_err_t;
+
+typedef struct {
+    int32_t active;             ///< sector in use, -1 before the first commit
+    uint32_t seq;
+    uint32_t used;              ///< bytes of the active sector written
+    uint32_t keys;
+    uint32_t pending;           ///< values staged, not yet in flash
+    uint32_t appends;           ///< records written since kv_init()
+    uint32_t compactions;
+    uint32_t torn;              ///< bad records skipped by the last kv_init()
+    uint32_t erases[KV_SECTORS];
+} kv_stats_t;
+
+void kv_init(void);
+int32_t kv_get(uint16_t key, void *buf, uint32_t len);
+kv_err_t kv_set(uint16_t key, const void *value, uint32_t len);
+bool kv_pending(void);
+kv_err_t kv_commit(void);
+void kv_get_stats(kv_stats_t *out);
+const char *kv_strerror(kv_err_t err);
+#endif
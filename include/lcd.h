@@ -6,6 +6,7 @@
 #define __LCD_H
 #include "stdlib.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 // shorthand notation for 8-bit and 16-bit unsigned integers
 typedef uint8_t u8;
@@ -67,7 +68,13 @@ extern lcd_dev_t lcddev;
 #define LGRAYBLUE   0XA651
 #define LBBLUE      0X2B12
 
+// Reset pulse, wait after reset, and wait after leaving sleep (ILI9341)
+#define LCD_RESET_MS 100
+#define LCD_RESET_WAIT_MS 50
+#define LCD_SLEEP_OUT_MS 120
+
 void LCD_Setup(void);
+uint64_t LCD_SetupStep(void);
 void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int));
 void LCD_Clear(u16 Color);
 void LCD_DrawPoint(u16 x,u16 y,u16 c);
@@ -95,5 +102,10 @@ typedef struct {
 } Picture;
 
 void LCD_DrawPicture(u16 x0, u16 y0, const Picture *pic);
+// Same picture by DMA: start it, then poll until it is out. pic must stay
+// valid and nothing else may draw until LCD_DrawPictureBusy() is false.
+void LCD_DrawPictureStart(u16 x0, u16 y0, const Picture *pic);
+bool LCD_DrawPictureBusy(void);
+uint32_t LCD_DrawPictureUs(const Picture *pic);
 
 #endif
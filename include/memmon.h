@@ -0,0 +1,40 @@
+#ifndef MEMMON_H
+#define MEMMON_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Stack and heap high-water marks. Both cores' stacks are painted with a
+// known word before they are used: the lowest word that no longer holds
+// it is as deep as that stack has gone. core1 runs on a stack of its own
+// here, sized by MEMMON_CORE1_STACK_BYTES, not the SDK's default. The
+// firmware's allocations go through mem_alloc()/mem_free(), which count
+// the bytes in use, their peak and the allocations each core made, so a
+// path that allocates on every frame shows up in the stats (perfmon.c).
+// On the host the stacks are not known (size 0).
+
+#define MEMMON_PAINT 0x57AC57ACu
+// core1's stack, launched with multicore_launch_core1_with_stack()
+#define MEMMON_CORE1_STACK_BYTES 4096
+// Left as it is just below core0's stack pointer when painting
+#define MEMMON_PAINT_MARGIN 64
+
+typedef struct {
+    uint32_t size;              ///< bytes; 0 = not known
+    uint32_t used_max;          ///< deepest use since the paint
+} memmon_stack_t;
+
+typedef struct {
+    uint32_t in_use;            ///< bytes the callers asked for, still held
+    uint32_t peak;
+    uint32_t allocs[2];         ///< by the core that made them
+    uint32_t frees;
+    uint32_t failed;            ///< allocations the heap could not give
+} memmon_heap_t;
+
+void memmon_init(void);
+uint32_t *memmon_core1_stack(void);
+void memmon_stack(uint32_t core, memmon_stack_t *out);
+void memmon_heap(memmon_heap_t *out);
+void *mem_alloc(size_t n);
+void mem_free(void *p);
+#endif
@@ -4,9 +4,14 @@
 
 #include <stdint.h>
 #include "neotrellis.h"   // for keyEvent, TrellisCallback, etc.
+#include "judge.h"
+#include "replay.h"
 
 // Initialize game state, keypad callback, timers, etc.
 void game_init(void);
+// game_init() in two parts: once at boot, then once per round
+void game_setup(void);
+void game_start(void);
 
 // Run one "step" of the game (called repeatedly from main loop)
 void game_step(void);
@@ -14,6 +19,25 @@ void game_step(void);
 // Optional: expose score if you want to print it from main later
 int game_get_combo(void);
 
-bool get_chg(void);
+// The round as the renderer sees it, one consistent copy (game_snapshot())
+typedef struct {
+    uint32_t version;       ///< bumps when the combo, score or counts change
+    int32_t combo;
+    uint32_t max_combo;
+    uint32_t accuracy;      ///< permille, the score shown on the results screen
+    uint32_t count[JUDGE_GRADES];
+    uint32_t running;       ///< round in play
+    uint64_t song_pos;      ///< chart samples at the last input tick
+} game_snapshot_t;
+
+void game_snapshot(game_snapshot_t *out);
+
+bool game_finished(void);
+void game_set_chart(const uint8_t *image, uint32_t len);
+const chart_t *game_chart(void);
+void game_set_observer(judge_callback_t cb);
+void game_set_replay(replay_t *r);
+void game_set_seed(uint32_t seed);
+void game_set_idle_keys(void (*cb)(keyEvent evt));
 
 #endif
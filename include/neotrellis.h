@@ -2,8 +2,12 @@
 // NeoTrellis I2C address (default)
 #define NEOTRELLIS_H
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #define NEOTRELLIS_ADDR 0x2E
+// Tiled boards answer at consecutive addresses (0x2E-0x31), strap A0/A1
+#define NEO_TRELLIS_MAX_BOARDS 4
 
 // I2C pins
 #define I2C_SDA_PIN 28
@@ -39,8 +43,32 @@ enum {
 };
 
 // NeoTrellis constants
-#define NEO_TRELLIS_NUM_KEYS 16
-static int button_num[NEO_TRELLIS_NUM_KEYS] = { 0, 1, 2, 3, 
+#ifndef NEO_TRELLIS_NUM_BOARDS
+#define NEO_TRELLIS_NUM_BOARDS 1
+#endif
+// Boards per row of the play field (2x2 tiling for 4 boards)
+#ifndef NEO_TRELLIS_BOARD_COLS
+#define NEO_TRELLIS_BOARD_COLS (NEO_TRELLIS_NUM_BOARDS > 1 ? 2 : 1)
+#endif
+#define NEO_TRELLIS_KEYS_PER_BOARD 16
+#define NEO_TRELLIS_NUM_KEYS (NEO_TRELLIS_KEYS_PER_BOARD * NEO_TRELLIS_NUM_BOARDS)
+#define NEO_TRELLIS_MAX_KEYS (NEO_TRELLIS_KEYS_PER_BOARD * NEO_TRELLIS_MAX_BOARDS)
+// Most events taken from one board's FIFO per poll
+#define NEO_TRELLIS_FIFO_MAX 30
+// Synthetic events that can wait per board for a poll (neo_inject)
+#define NEO_INJECT_DEPTH 64
+// Seesaw firmware start-up: nothing is sent before this long after reset
+#ifndef NEO_TRELLIS_BOOT_MS
+#define NEO_TRELLIS_BOOT_MS 100
+#endif
+// Configuration writes: settle time before the next one to the same board,
+// writes that can be queued per board (setup is 36), payload bytes
+#define NEO_CONFIG_SETTLE_US 5000
+#define NEO_CONFIG_DEPTH 40
+#define NEO_CONFIG_DATA_MAX 4
+
+// Seesaw key number of each key on a board
+static int button_num[NEO_TRELLIS_KEYS_PER_BOARD] = { 0, 1, 2, 3, 
                                                 8, 9, 10, 11,
                                                 16, 17, 18, 19,
                                                 24, 25, 26, 27};
@@ -59,12 +87,42 @@ union keyState {
     uint8_t reg;
 };
 
+// Split-phase Seesaw read in flight
+typedef struct {
+    uint8_t board;
+    bool ok;            ///< address phase was acknowledged
+    uint32_t ready_us;  ///< data phase may run from here on
+} seesaw_read_t;
+
 typedef void (*TrellisCallback)(keyEvent evt);
-TrellisCallback (*_callbacks[NEO_TRELLIS_NUM_KEYS])(keyEvent);
+extern TrellisCallback (*_callbacks[NEO_TRELLIS_MAX_KEYS])(keyEvent);
 
 //TrellisCallback printKey(keyEvent evt);
 void init_i2c();
+int neotrellis_set_layout(uint8_t boards, uint8_t cols);
+uint8_t neotrellis_num_boards(void);
+uint8_t neotrellis_num_keys(void);
+uint8_t neotrellis_key_index(uint8_t board, uint8_t local);
+uint8_t neotrellis_key_board(uint8_t key);
+uint8_t neotrellis_key_local(uint8_t key);
 void neo_read();
+void neo_read_begin();
+bool neo_read_poll();
+void neo_read_finish();
+bool neo_read_busy();
+uint64_t neo_read_began_us();
+void neo_dispatch(keyEvent evt);
+bool neo_inject(uint8_t key, uint8_t edge);
+uint32_t neo_inject_dropped();
+bool seesaw_read_begin(seesaw_read_t *rd, uint8_t board, uint8_t regHigh, uint8_t regLow, uint16_t delay);
+bool seesaw_read_ready(const seesaw_read_t *rd);
+bool seesaw_read_finish(seesaw_read_t *rd, uint8_t *buf, uint8_t len);
+int seesaw_write_raw(uint8_t board, uint8_t regHigh, uint8_t regLow, const uint8_t *data, uint8_t len);
+void neotrellis_config_reset(void);
+uint64_t neotrellis_config_step(void);
+int neotrellis_config_flush(void);
+void neotrellis_config_defer(bool defer);
+uint32_t neotrellis_config_failed(void);
 int init_neopixels();
 int set_pixel_color(uint8_t pixel, uint8_t r, uint8_t g, uint8_t b);
 int show_pixels();
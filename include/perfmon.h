@@ -0,0 +1,84 @@
+#ifndef PERFMON_H
+#define PERFMON_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Live performance view, no debugger needed. A core0 task closes a window
+// a few times a second: frame rate and worst frame (render.c reports),
+// least audio buffer slack (the refill vs. the DMA running dry), I2C bus
+// use, keypad-to-LED latency of hits, each core's idle time and deadline
+// misses (evsched), and the stacks' depth, heap use and allocations per
+// core (memmon.c). A window past a threshold latches a warning
+// that stays until staff close the overlay. The view is published for
+// core1, which draws it as a text overlay on the LCD, or only a warning
+// mark while the overlay is off.
+
+// Window length
+#define PERFMON_WINDOW_US 250000
+// Warning thresholds: a frame longer than the 60 fps budget, fewer frames
+// than 30 a second (or none once core1 has drawn), audio slack under 1 ms,
+// the bus more than 90% busy, a hit later than 20 ms on its LED, a core
+// less than 5% idle, any deadline miss, and a stack 90% deep
+#define PERFMON_FRAME_WARN_US 16667
+#define PERFMON_FPS_WARN_X10 300
+#define PERFMON_AUDIO_WARN_US 1000
+#define PERFMON_I2C_WARN_PERMILLE 900
+#define PERFMON_LED_WARN_US 20000
+#define PERFMON_IDLE_WARN_PERMILLE 50
+#define PERFMON_STACK_WARN_PERMILLE 900
+
+// Overlay text: 40 columns of the 12 px font fill the LCD's width
+#define PERFMON_LINES 4
+#define PERFMON_COLS 40
+
+typedef enum {
+    PERFMON_WARN_FRAME = 0,
+    PERFMON_WARN_AUDIO,
+    PERFMON_WARN_I2C,
+    PERFMON_WARN_LED,
+    PERFMON_WARN_IDLE0,
+    PERFMON_WARN_IDLE1,
+    PERFMON_WARN_DEADLINE0,
+    PERFMON_WARN_DEADLINE1,
+    PERFMON_WARN_STACK0,
+    PERFMON_WARN_STACK1,
+    PERFMON_WARNS
+} perfmon_warn_t;
+
+// One window, as published
+typedef struct {
+    uint32_t version;           ///< windows closed
+    uint32_t window_us;
+    uint32_t frames;
+    uint32_t fps_x10;
+    uint32_t frame_worst_us;
+    int32_t audio_slack_us;     ///< least over the window's refills
+    uint32_t refills;           ///< 0 = no audio, slack not set
+    uint32_t i2c_permille;      ///< modelled bus time over wall time
+    uint32_t led_samples;       ///< hits whose LED went out
+    uint32_t led_avg_us;
+    uint32_t led_max_us;
+    uint32_t idle_permille[2];
+    uint32_t misses[2];         ///< deadline misses per core
+    uint32_t sched_on;          ///< bit per core whose scheduler ran
+    uint32_t stack_used[2];     ///< deepest since boot
+    uint32_t stack_size[2];     ///< 0 = not known
+    uint32_t heap_in_use;       ///< mem_alloc() bytes
+    uint32_t heap_peak;
+    uint32_t allocs[2];         ///< mem_alloc() calls per core, this window
+    uint32_t warn_now;          ///< bit per perfmon_warn_t, this window
+    uint32_t warn;              ///< latched since the overlay was last closed
+    uint32_t overlay;           ///< 1 = core1 draws the text
+} perfmon_view_t;
+
+void perfmon_start(void);
+void perfmon_frame(uint32_t took_us);
+void perfmon_audio(int32_t slack_us);
+void perfmon_led_wait(uint8_t pixel, uint64_t since_us);
+void perfmon_window(void);
+uint32_t perfmon_read(perfmon_view_t *out);
+void perfmon_overlay_toggle(void);
+void perfmon_clear_warnings(void);
+const char *perfmon_warn_name(perfmon_warn_t w);
+void perfmon_format(const perfmon_view_t *v, char line[PERFMON_LINES][PERFMON_COLS + 1]);
+#endif
@@ -0,0 +1,42 @@
+#ifndef RENDER_H
+#define RENDER_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// core1 only renders; core0 runs audio, input and the game. The renderer
+// takes the game state from game_snapshot() at the start of each frame and
+// reports every frame back to core0 over a channel, where the frame rate
+// and worst frame are kept for the round. Before flash work core0 holds
+// the renderer between two frames (render_hold()), as the frame blit's DMA
+// reads flash.
+
+// Frame reports that can wait for core0; more are dropped and counted
+#define RENDER_REPORT_DEPTH 32
+
+typedef struct {
+    uint32_t start_us;          ///< time_us_32() when the frame began
+    uint32_t took_us;
+    uint8_t redrawn;            ///< drew a new game state (snapshot version)
+} render_report_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t redraws;           ///< frames that drew a new game state
+    uint32_t lost;              ///< reports dropped, channel full
+    uint32_t worst_us;          ///< longest frame
+    uint32_t first_us;          ///< start of the first frame counted
+    uint32_t last_us;           ///< end of the last frame counted
+    uint64_t busy_us;           ///< time spent in frames
+} render_stats_t;
+
+void render_report(uint64_t start_us, uint64_t end_us, bool redrawn);
+void render_attach(void);
+bool render_hold(uint32_t timeout_us);
+void render_release(void);
+bool render_held(void);
+void render_service(void);
+void render_get_stats(render_stats_t *out);
+uint32_t render_fps_x10(const render_stats_t *st);
+void render_reset_stats(void);
+void render_print_stats(void);
+#endif
@@ -0,0 +1,75 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Input replay log, little endian:
+//   replay_header_t, then one varint (LEB128) per key event:
+//   (samples since the previous event << 7) | (press << 6) | key.
+// Times are song samples, the same as the chart, so playback against the
+// song clock hands the judge exactly the positions it saw live.
+
+#define REPLAY_MAGIC 0x594C504Du    // "MPLY"
+#define REPLAY_VERSION 1
+
+// RAM kept for the log while recording; ~3 bytes per event, so a round
+// of a few hundred presses and releases fits many times over
+#define REPLAY_LOG_BYTES 4096
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t chart_crc;         ///< crc32 field of the chart played
+    uint32_t seed;              ///< player / shuffle seed, 0 if none
+    uint32_t sample_rate;
+    uint32_t events;
+    uint32_t bytes;             ///< encoded events after the header
+    uint32_t crc32;             ///< over the encoded events
+    int32_t score;              ///< final combo of the recorded round
+    uint32_t max_combo;
+    uint32_t accuracy;          ///< judge_accuracy_permille() of the round
+} replay_header_t;
+
+typedef enum {
+    REPLAY_OK = 0,
+    REPLAY_ERR_SIZE = -1,
+    REPLAY_ERR_MAGIC = -2,
+    REPLAY_ERR_VERSION = -3,
+    REPLAY_ERR_CRC = -4,
+    REPLAY_ERR_FULL = -5,
+    REPLAY_ERR_IO = -6,
+} replay_err_t;
+
+typedef struct {
+    uint64_t at;                ///< song position in samples
+    uint8_t key;
+    bool press;                 ///< rising edge, else released
+} replay_event_t;
+
+// Playback cursor over a log image
+typedef struct {
+    const replay_header_t *hdr;
+    const uint8_t *data;        ///< points into the image, no copy
+    uint32_t pos;               ///< next byte to decode
+    uint32_t left;              ///< events not yet taken
+    uint64_t at;                ///< time of the last event taken
+    void *owned;                ///< heap image from replay_load_file, else NULL
+} replay_t;
+
+void replay_record_start(uint32_t chart_crc, uint32_t sample_rate, uint32_t seed);
+void replay_record(uint8_t key, bool press, uint64_t at);
+bool replay_recording(void);
+const uint8_t *replay_record_finish(int32_t score, uint32_t max_combo, uint32_t accuracy,
+                                    uint32_t *len);
+const uint8_t *replay_log(uint32_t *len);
+replay_err_t replay_save_file(const char *path);
+
+replay_err_t replay_open(replay_t *r, const void *image, uint32_t len);
+replay_err_t replay_load_file(replay_t *r, const char *path);
+void replay_close(replay_t *r);
+void replay_rewind(replay_t *r);
+bool replay_peek(const replay_t *r, replay_event_t *ev);
+bool replay_next(replay_t *r, replay_event_t *ev);
+const char *replay_strerror(replay_err_t err);
+#endif
@@ -0,0 +1,34 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single-writer sequence lock over a block of shared SRAM. The writer never
+// waits: it makes the sequence odd, writes the block and makes it even
+// again. Readers copy the block out and go again if the sequence was odd or
+// moved while they copied, so they never see half a write and never hold
+// up the writer. Any number of readers, on either core.
+//
+// The block is copied a word at a time: its size must be a multiple of 4.
+//
+// Typed blocks: SEQLOCK_DEFINE(name, type) defines one ready to use, with
+// name_write()/name_read() taking the type.
+
+typedef struct {
+    uint32_t *data;
+    uint32_t words;
+    uint32_t seq;               ///< writes started and finished; odd during one
+    uint32_t retries;           ///< reads that had to go again
+} seqlock_t;
+
+void seqlock_init(seqlock_t *s, void *storage, uint32_t size);
+void seqlock_write(seqlock_t *s, const void *src);
+uint32_t seqlock_read(seqlock_t *s, void *dst);
+
+#define SEQLOCK_DEFINE(name, type)                                              \
+    _Static_assert(sizeof(type) % 4 == 0, #type " is not a whole number of words"); \
+    static type name##_storage;                                                 \
+    static seqlock_t name = { (uint32_t *)&name##_storage, sizeof(type) / 4, 0, 0 }; \
+    static inline void name##_write(const type *v) { seqlock_write(&name, v); } \
+    static inline uint32_t name##_read(type *v) { return seqlock_read(&name, v); }
+#endif
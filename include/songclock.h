@@ -0,0 +1,27 @@
+#ifndef SONGCLOCK_H
+#define SONGCLOCK_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/time.h"
+
+// Song position derived from the audio DMA. The DMA IRQ reports every
+// finished buffer; between buffers the position is extrapolated from the
+// timer, which runs off the same crystal as the PWM. Positions are as
+// heard: the calibrated audio offset is taken off the DMA position.
+// core0 starts, stops and moves the clock; its changes reach the reading
+// side over a channel (see songclock.c).
+
+void song_clock_start(uint32_t sample_rate);
+void song_clock_stop(void);
+void song_clock_buffer_done(uint32_t samples);
+void song_clock_service(void);
+bool song_clock_running(void);
+uint64_t song_clock_samples(void);
+uint64_t song_clock_us(void);
+uint64_t song_clock_raw_us(void);
+uint32_t song_clock_ms(void);
+absolute_time_t song_clock_to_abs(uint64_t song_us);
+absolute_time_t song_clock_visual_to_abs(uint64_t song_us);
+void song_clock_set_offsets(int32_t audio_us, int32_t visual_us);
+void song_clock_get_offsets(int32_t *audio_us, int32_t *visual_us);
+#endif
@@ -0,0 +1,46 @@
+#ifndef STRESS_H
+#define STRESS_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "judge.h"
+
+// Synthetic input load (build with -DGAME_STRESS=<mode> on the device).
+// Modes can be combined.
+typedef enum {
+    STRESS_AUTOPLAY = 1,    ///< every lane of every note pressed on time, holds kept
+    STRESS_STORM = 2,       ///< bursts of 1..NEO_TRELLIS_FIFO_MAX random edges
+} stress_mode_t;
+
+// Latency samples kept per measurement
+#define STRESS_MAX_SAMPLES 4096
+// Presses per key that can wait for their judgement
+#define STRESS_KEY_DEPTH 8
+// Storm bursts start every 2..STRESS_STORM_GAP_MS ms
+#define STRESS_STORM_GAP_MS 20
+// Autoplay taps are held this long
+#define STRESS_TAP_MS 50
+// Storms keep off the lanes of notes due within this: the good window
+// (100 ms) and a poll or two, so no storm press is judged as a hit
+#define STRESS_STORM_GUARD_MS 120
+
+// Where events go in: neo_inject() on the device, the simulated Seesaw on
+// the host. key is a key index.
+typedef void (*stress_sink_t)(uint8_t key, bool press);
+
+typedef struct {
+    uint32_t injected;          ///< edges handed to the sink
+    uint32_t presses;
+    uint32_t judged;            ///< presses matched to their judgement
+    uint32_t shown;             ///< hits whose colour reached the LEDs
+    uint32_t unmatched;         ///< judgements with no press waiting (lost edge)
+    uint32_t bursts;
+    uint32_t burst_max;
+} stress_stats_t;
+
+void stress_start(uint8_t mode, uint32_t seed, stress_sink_t sink);
+void stress_stop(void);
+void stress_on_judge(const judge_event_t *ev);
+void stress_get_stats(stress_stats_t *out);
+uint32_t stress_percentile(bool led, uint32_t permille);
+void stress_print_stats(void);
+#endif
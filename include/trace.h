@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Event tracing, built with -DTRACE only. Every core records begin / end
+// / instant events, and async begin / end for spans that outlast the task
+// that started them (a DMA blit, a keypad read), with a microsecond
+// timestamp and a 16-bit argument into a ring of its own; the newest
+// TRACE_DEPTH events per core are kept. The rings are printed with
+// trace_dump() (USB: send 't'), and sim trace json turns the dump into
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Without -DTRACE
+// the TRACE_* macros are empty and their arguments are not evaluated.
+
+// Events kept per core, a power of two
+#define TRACE_DEPTH 2048
+#define TRACE_CORES 2
+// Event names in all: the fixed ones below and the scheduler's tasks
+#define TRACE_MAX_NAMES 64
+
+typedef enum {
+    TRACE_AUDIO_IRQ = 0,    ///< DMA buffer done (instant, buffer)
+    TRACE_AUDIO_REFILL,     ///< one buffer filled (buffer)
+    TRACE_AUDIO_CMD,        ///< request handled (instant, op)
+    TRACE_I2C,              ///< one transaction (end: bytes on the wire)
+    TRACE_KEY_POLL,         ///< keypad read, COUNT address to last FIFO byte (async)
+    TRACE_I2C_TICK,         ///< keypad read finished and LED writes
+    TRACE_LED_SHOW,         ///< SHOW sent (instant, boards)
+    TRACE_BEAT_SHOW,        ///< armed beat SHOW (end: us late)
+    TRACE_JUDGE,            ///< judgement (instant, grade << 8 | lane)
+    TRACE_SNAPSHOT,         ///< game snapshot with a new version (instant, version)
+    TRACE_FLOW,             ///< round flow state (instant, state)
+    TRACE_FLASH,            ///< flash erase / program (kB)
+    TRACE_BOOT,             ///< boot step (step)
+    TRACE_FRAME,            ///< LCD frame, waits included (core1, async)
+    TRACE_BLIT,             ///< picture out by DMA (core1, async)
+    TRACE_HUD,              ///< combo redraw (core1, combo)
+    TRACE_TASK,             ///< scheduler task once the names ran out
+    TRACE_IDS               ///< first name from trace_name()
+} trace_id_t;
+
+typedef struct {
+    uint32_t t_us;          ///< time_us_32()
+    uint8_t id;             ///< trace_id_t or trace_name()
+    uint8_t ph;             ///< 'B', 'E', 'i', 'b' or 'e', as in the Chrome format
+    uint16_t arg;
+} trace_event_t;
+
+typedef struct {
+    uint32_t head;          ///< events written; the slot is head % TRACE_DEPTH
+    trace_event_t ev[TRACE_DEPTH];
+} trace_ring_t;
+
+#ifdef TRACE
+#include "pico/stdlib.h"
+
+extern trace_ring_t trace_rings[TRACE_CORES];
+extern uint32_t trace_on;
+
+/*! \brief Record an event on the calling core (tasks and IRQs)
+    The slot is taken with an atomic add, so an IRQ on the same core that
+    records in between gets a slot of its own. No other core writes here.
+*/
+static inline void trace_put(uint8_t id, uint8_t ph, uint16_t arg) {
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED))
+        return;
+    trace_ring_t *r = &trace_rings[get_core_num()];
+    uint32_t i = __atomic_fetch_add(&r->head, 1, __ATOMIC_RELAXED) & (TRACE_DEPTH - 1);
+    trace_event_t *e = &r->ev[i];
+    e->t_us = time_us_32();
+    e->id = id;
+    e->ph = ph;
+    e->arg = arg;
+}
+
+#define TRACE_BEGIN(id, arg) trace_put((id), 'B', (uint16_t)(arg))
+#define TRACE_END(id, arg) trace_put((id), 'E', (uint16_t)(arg))
+#define TRACE_INSTANT(id, arg) trace_put((id), 'i', (uint16_t)(arg))
+#define TRACE_ASYNC_BEGIN(id, arg) trace_put((id), 'b', (uint16_t)(arg))
+#define TRACE_ASYNC_END(id, arg) trace_put((id), 'e', (uint16_t)(arg))
+#define TRACE_NAME(name) trace_name(name)
+
+void trace_init(void);
+uint8_t trace_name(const char *name);
+void trace_dump(void);
+#else
+#define TRACE_BEGIN(id, arg) ((void)0)
+#define TRACE_END(id, arg) ((void)0)
+#define TRACE_INSTANT(id, arg) ((void)0)
+#define TRACE_ASYNC_BEGIN(id, arg) ((void)0)
+#define TRACE_ASYNC_END(id, arg) ((void)0)
+#define TRACE_NAME(name) ((uint8_t)TRACE_TASK)
+#endif
+#endif
@@ -0,0 +1,48 @@
+#ifndef XIPMON_H
+#define XIPMON_H
+#include <stdint.h>
+
+// XIP cache hits and accesses around the render (core1's frame blit) and
+// the audio refill (core0). The counters are the cache's own, so a span
+// counts every cached flash access made while it ran: both cores' code and
+// data, and the blit DMA reading its frame. Misses in the refill with a
+// frame streaming are the thrash the hot paths are kept out of
+// (hotpath.h). Printed after each round, next to the frame rate.
+//
+// xipmon_bench() runs the refill's loop from flash and from SRAM, with the
+// cache as it is and just invalidated, and prints the time and misses of
+// each; 'x' over USB between rounds, in builds with -DXIP_BENCH.
+
+// Refill loops per bench case
+#define XIPMON_BENCH_RUNS 64
+
+typedef enum {
+    XIPMON_RENDER = 0,
+    XIPMON_REFILL,
+    XIPMON_SPANS
+} xipmon_span_t;
+
+// Where a span started
+typedef struct {
+    uint64_t accesses;
+    uint64_t hits;
+    uint32_t us;
+} xipmon_mark_t;
+
+typedef struct {
+    uint32_t spans;
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t us;
+    uint32_t worst_us;
+    uint32_t worst_misses;      ///< most misses in one span
+} xipmon_stats_t;
+
+void xipmon_init(void);
+void xipmon_begin(xipmon_mark_t *m);
+void xipmon_end(xipmon_span_t span, const xipmon_mark_t *m);
+void xipmon_get_stats(xipmon_span_t span, xipmon_stats_t *out);
+void xipmon_reset_stats(void);
+void xipmon_print_stats(void);
+void xipmon_bench(const uint8_t *pcm, uint32_t samples);
+#endif
@@ -0,0 +1,54 @@
+/* sim beat: beat SHOW timing
+    Runs the minigame on core0's scheduler against the song clock, with
+    core1 rendering frames of a given length, and reports how far each beat's SHOW
+    landed from its song deadline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "chart.h"
+#include "evsched.h"
+#include "seesaw_sim.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+static uint32_t render_us;
+
+int cmd_beat(int argc, char *argv[]) {
+    render_us = argc > 1 ? (uint32_t)atoi(argv[1]) : 3000;
+    uint32_t secs = argc > 2 ? (uint32_t)atoi(argv[2]) : 10;
+    if (secs > 30) secs = 30; // the round ends at 33 s
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    game_init();
+    sim_render_start(render_us);
+    i2c_sched_reset_stats();
+    sim_seesaw_reset_bus_stats();
+
+    uint64_t t0 = sim_clock_now_us();
+    while (sim_clock_now_us() - t0 < (uint64_t)secs * 1000000)
+        game_step();
+
+    i2c_sched_stats_t st;
+    i2c_sched_get_stats(&st);
+    printf("%u s, %u us frame: %u beats staged, %u sent, SHOW after deadline avg %u max %u us, "
+           "%u polls held\n",
+           (unsigned)secs, (unsigned)render_us, (unsigned)st.beat_staged,
+           (unsigned)st.beat_shows,
+           (unsigned)(st.beat_shows ? st.beat_jitter_sum_us / st.beat_shows : 0),
+           (unsigned)st.beat_jitter_max_us, (unsigned)st.polls_held);
+    evsched_print_stats();
+    sim_render_stop();
+    song_clock_stop();
+    return st.beat_shows ? 0 : 1;
+}
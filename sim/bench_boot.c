@@ -0,0 +1,108 @@
+/* sim boot: the firmware's boot graph on the virtual clock
+    Runs the same steps as main.c (the LCD is a stand-in with the panel's
+    reset and sleep-out waits and the time of a full-screen clear) with one
+    thread standing for both cores, so every wait is filled by other steps.
+    Then plays until the first beat and prints boot-to-first-beat, next to
+    the old serial boot with fixed sleeps.
+
+    boot
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "gameflow.h"
+#include "boot.h"
+#include "lcd.h"
+#include "seesaw_sim.h"
+#include "sim_clock.h"
+#include "sim_cmds.h"
+
+// Full-screen clear: 320x240 RGB565 over SPI at ~75 MHz
+#define SIM_LCD_CLEAR_US 16400
+// The old core1 boot slept this long after setting up I2C
+#define OLD_BOOT_SLEEP_MS 500
+
+enum { STEP_I2C, STEP_SEESAW, STEP_LCD, STEP_GAME, STEP_COUNT };
+
+static uint64_t boot_i2c(void) {
+    init_i2c();
+    return 0;
+}
+
+static uint64_t boot_seesaw(void) {
+    static bool queued = false;
+    if (!queued) {
+        neotrellis_config_defer(true);
+        init_neopixels();
+        game_setup();
+        neotrellis_config_defer(false);
+        queued = true;
+    }
+    uint64_t at = neotrellis_config_step();
+    if (!at)
+        queued = false;
+    return at;
+}
+
+static uint64_t boot_lcd(void) {
+    static int stage = 0;
+    uint64_t now = time_us_64();
+    switch (stage++) {
+    case 0:
+        return now + LCD_RESET_MS * 1000;
+    case 1:
+        return now + LCD_RESET_WAIT_MS * 1000;
+    case 2:
+        return now + LCD_SLEEP_OUT_MS * 1000;
+    default:
+        sleep_us(SIM_LCD_CLEAR_US);
+        stage = 0;
+        return 0;
+    }
+}
+
+static uint64_t boot_game(void) {
+    evsched_init();
+    flow_init(NULL);
+    return 0;
+}
+
+static const boot_step_t steps[STEP_COUNT] = {
+    [STEP_I2C] = { "i2c", boot_i2c, BOOT_ANY, 0 },
+    [STEP_SEESAW] = { "seesaw", boot_seesaw, BOOT_CORE0, BOOT_DEP(STEP_I2C) },
+    [STEP_LCD] = { "lcd", boot_lcd, BOOT_CORE1, 0 },
+    [STEP_GAME] = { "game", boot_game, BOOT_CORE0, BOOT_DEP(STEP_SEESAW) },
+};
+
+int cmd_boot(int argc, char *argv[]) {
+    // Old boot: everything in a row on core1, fixed sleeps
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    sleep_ms(OLD_BOOT_SLEEP_MS);
+    sleep_ms(LCD_RESET_MS + LCD_RESET_WAIT_MS + LCD_SLEEP_OUT_MS);
+    sleep_us(SIM_LCD_CLEAR_US);
+    init_neopixels();
+    game_setup();
+    uint64_t old_ready = time_us_64();
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    boot_init(steps, STEP_COUNT);
+    boot_run(BOOT_ANY);
+    boot_print();
+    uint64_t limit = time_us_64() + 10000000;
+    while (!boot_first_beat_us() && time_us_64() < limit)
+        evsched_run_once();
+    evsched_print_stats();
+    while (!game_finished())
+        evsched_run_once();
+
+    printf("\nold serial boot ready at %.1f ms; now ready at %.1f ms, first beat at %.1f ms\n",
+           old_ready / 1000.0, boot_done_us() / 1000.0, boot_first_beat_us() / 1000.0);
+    return !boot_done() || !boot_first_beat_us();
+}
@@ -0,0 +1,75 @@
+/* sim bus: I2C scheduler under a synthetic worst-case LED workload
+    Every tick repaints all 16 pixels and asks for a SHOW while a key is
+    tapped every 37 ms. The same workload runs once with the LED writes
+    flushed straight away (the old behaviour) and once through the budgeted
+    scheduler, and the keypad latency and bus numbers are compared.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+#define BENCH_US 2000000
+#define TAP_EVERY_US 37000
+
+static int presses = 0;
+
+static TrellisCallback on_key(keyEvent evt) {
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING)
+        presses++;
+    return 0;
+}
+
+static void run(const char *name, bool scheduled, uint32_t render_us, uint32_t budget_us) {
+    sim_clock_reset();
+    sim_seesaw_reset(1);
+    init_i2c();
+    init_neopixels();
+    init_keypad(on_key);
+    i2c_sched_init(budget_us);
+    presses = 0;
+
+    uint64_t t0 = sim_clock_now_us();
+    uint32_t seed = 1;
+    int taps = 0;
+    for (uint64_t t = t0 + 5000; t < t0 + BENCH_US; t += TAP_EVERY_US) {
+        seed = seed * 1103515245 + 12345;
+        sim_seesaw_script_tap(0, t, (seed >> 16) % NEO_TRELLIS_NUM_KEYS, 15000);
+        taps++;
+    }
+    sim_seesaw_reset_bus_stats();
+    i2c_sched_reset_stats();
+
+    uint32_t frame = 0;
+    while (sim_clock_now_us() - t0 < BENCH_US) {
+        for (int i = 0; i < NEO_TRELLIS_NUM_KEYS; i++)
+            set_pixel_color(i, (frame * 7 + i) & 0xFF, (frame * 3) & 0xFF, i * 16);
+        show_pixels();
+        if (!scheduled)
+            i2c_sched_flush();
+        i2c_sched_tick();
+        sleep_us(render_us); // the rest of the core1 loop
+        frame++;
+    }
+
+    uint64_t elapsed = sim_clock_now_us() - t0;
+    printf("%s: %u ticks, %d/%d taps seen, %u LED frames shown (%.1f fps)\n", name,
+           (unsigned)frame, presses, taps, (unsigned)sim_seesaw_shows(0),
+           sim_seesaw_shows(0) * 1e6 / elapsed);
+    sim_seesaw_print_bus_stats(elapsed);
+    i2c_sched_print_stats();
+}
+
+int cmd_bus(int argc, char *argv[]) {
+    uint32_t render_us = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+    uint32_t budget_us = argc > 2 ? (uint32_t)atoi(argv[2]) : 1000;
+    printf("worst-case LED load, %u us of other work per tick, %u us LED budget\n",
+           (unsigned)render_us, (unsigned)budget_us);
+    run("unbudgeted", false, render_us, budget_us);
+    run("scheduled", true, render_us, budget_us);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/* sim calib: latency calibration against a scripted player
+    Boots the round flow, lets the first round run out, then holds a key
+    to start calibrating. The player taps each click audio_ms late and each
+    flash visual_ms late, with normal jitter, a skipped beat now and then,
+    a double tap and two wild taps that outlier rejection has to drop.
+    Checks the measured offsets against the player's, lets the round flow
+    write them to flash, then "reboots" (song clock offsets cleared, store
+    remounted) and checks they come back.
+
+    calib [audio_ms] [visual_ms] [jitter_ms] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "gameflow.h"
+#include "calib.h"
+#include "kvstore.h"
+#include "seesaw_sim.h"
+#include "sim_flash.h"
+#include "sim_clock.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+// Poll period, turnaround and a frame: taps reach calib.c up to this much late
+#define SIM_CALIB_POLL_US 4000
+#define SIM_CALIB_TAP_US 40000
+
+static uint32_t rng;
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Roughly normal, mean 0, sd 1 (sum of 4 uniforms)
+static double rng_norm(void) {
+    double s = 0;
+    for (int i = 0; i < 4; i++)
+        s += (rng_next() & 0xFFFF) / 65536.0;
+    return (s - 2.0) * 1.732;
+}
+
+static bool run_until(bool (*cond)(void), uint64_t limit_us) {
+    uint64_t limit = time_us_64() + limit_us;
+    while (!cond() && time_us_64() < limit)
+        evsched_run_once();
+    return cond();
+}
+
+static bool in_results(void) { return flow_state() == FLOW_RESULTS; }
+static bool in_audio(void) { return calib_phase() == CALIB_AUDIO; }
+static bool in_visual(void) { return calib_phase() == CALIB_VISUAL; }
+static bool calib_over(void) { return calib_phase() == CALIB_DONE || calib_phase() == CALIB_FAILED; }
+static bool saved(void) { return !kv_pending(); }
+
+// Script one phase of taps: lateness late_us, sd jitter_us
+static void script_phase(int64_t late_us, double jitter_us) {
+    uint64_t start = time_us_64() - song_clock_raw_us();
+    uint64_t period = CALIB_PERIOD_MS * 1000ull;
+    uint32_t beats = CALIB_LEADIN + CALIB_BEATS;
+    for (uint32_t k = 0; k < beats; k++) {
+        uint8_t key = rng_next() % neotrellis_num_keys();
+        int64_t at = (int64_t)(start + k * period) + late_us + (int64_t)(rng_norm() * jitter_us);
+        if (k == CALIB_LEADIN + 3 || k == CALIB_LEADIN + 11)
+            continue;                                   // missed beats
+        if (k == CALIB_LEADIN + 5)
+            at += 150000;                               // wild, late
+        if (k == CALIB_LEADIN + 8)
+            at -= 120000;                               // wild, early
+        if (at < (int64_t)time_us_64()) continue;
+        sim_seesaw_script_tap(0, (uint64_t)at, key, SIM_CALIB_TAP_US);
+        if (k == CALIB_LEADIN + 6)                      // double tap, 60 ms on
+            sim_seesaw_script_tap(0, (uint64_t)at + 60000, (key + 1) % 16, SIM_CALIB_TAP_US);
+    }
+}
+
+int cmd_calib(int argc, char *argv[]) {
+    int32_t audio_ms = argc > 1 ? atoi(argv[1]) : 45;
+    int32_t visual_ms = argc > 2 ? atoi(argv[2]) : 30;
+    double jitter_ms = argc > 3 ? atof(argv[3]) : 8;
+    rng = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1;
+    if (!rng) rng = 1;
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    sim_flash_reset();
+    kv_init();
+    song_clock_set_offsets(0, 0);
+    init_i2c();
+    init_neopixels();
+    evsched_init();
+    game_setup();
+    flow_init(NULL);
+    sim_render_start(3000);
+
+    // First round runs out untouched, then a 2.5 s hold on the results screen
+    if (!run_until(in_results, 60000000)) {
+        printf("calib: round did not end\n");
+        return 1;
+    }
+    sim_seesaw_script_tap(0, time_us_64() + 100000, 0, (FLOW_CALIB_HOLD_MS + 500) * 1000);
+    if (!run_until(in_audio, 10000000)) {
+        printf("calib: hold did not start calibration\n");
+        return 1;
+    }
+    script_phase(audio_ms * 1000, jitter_ms * 1000);
+    if (!run_until(in_visual, 30000000)) {
+        printf("calib: audio phase did not end\n");
+        return 1;
+    }
+    script_phase(visual_ms * 1000, jitter_ms * 1000);
+    run_until(calib_over, 30000000);
+
+    calib_result_t res[2];
+    bool ok[2];
+    int bad = calib_phase() != CALIB_DONE;
+    for (int i = 0; i < 2; i++) {
+        ok[i] = calib_get_result(i, &res[i]);
+        int32_t want = (i ? visual_ms : audio_ms) * 1000;
+        int32_t err = res[i].offset_us - want;
+        // The mean of the kept taps still carries their jitter: 3 sigma
+        int32_t slack = res[i].kept ? (int32_t)(3 * jitter_ms * 1000 / sqrt(res[i].kept)) : 0;
+        bool close = ok[i] && err >= -slack && err <= SIM_CALIB_POLL_US + slack;
+        if (!close) bad++;
+        printf("%-6s player %+6d us, measured %+6d us (%+d), %u/%u taps kept, spread %u us%s\n",
+               i ? "visual" : "audio", (int)want, (int)res[i].offset_us, (int)err,
+               (unsigned)res[i].kept, (unsigned)res[i].taps, (unsigned)res[i].spread_us,
+               close ? "" : "  OUT OF TOLERANCE");
+    }
+
+    // The flow commits them between rounds; then reboot: offsets gone from
+    // RAM, back from flash
+    run_until(saved, 1000000);
+    int32_t a0, v0, a1, v1;
+    song_clock_get_offsets(&a0, &v0);
+    song_clock_set_offsets(0, 0);
+    kv_init();
+    bool loaded = calib_load();
+    song_clock_get_offsets(&a1, &v1);
+    bool same = loaded && a0 == a1 && v0 == v1;
+    if (!same) bad++;
+    sim_flash_stats_t fs;
+    sim_flash_get_stats(&fs);
+    printf("flash: %u page(s) programmed, offsets after reboot %+d/%+d us %s\n",
+           (unsigned)fs.programs, (int)a1, (int)v1, same ? "(same)" : "DIFFER");
+    printf("calibration %s\n", bad ? "FAILED" : "OK");
+    return bad != 0;
+}
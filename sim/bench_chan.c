@@ -0,0 +1,144 @@
+/* sim chan: inter-core channels under two real threads
+    A producer thread pushes numbered messages as fast as it can while a
+    consumer thread pops them, for each message size. Every message carries
+    its sequence number in every word, so a message read before it was
+    completely written (missing barrier) shows up as a torn word, and one
+    out of order as a sequence gap. The indices start just below the 32-bit
+    wrap so it is crossed during the run.
+
+    Blocking runs retry a full channel and must see every message in order.
+    Lossy runs drop on full, like the song clock ticks, and must see a
+    rising sequence with received + dropped = sent.
+
+    On x86 the hardware keeps stores in order, so this mostly checks that
+    the compiler does; on an ARM host it checks the barriers too.
+
+    chan [messages] [depth]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "chan.h"
+#include "sim_cmds.h"
+
+#define SIM_CHAN_MAX_WORDS 16
+#define SIM_CHAN_MAX_DEPTH 1024
+
+typedef struct {
+    chan_t *c;
+    uint32_t words;             ///< message size in 32-bit words
+    uint32_t count;
+    bool lossy;
+    // Results
+    uint32_t received;
+    uint32_t torn;
+    uint32_t out_of_order;
+    uint32_t full_spins;        ///< producer: pushes retried
+    uint32_t marker_spins;      ///< of those, for the end marker
+} run_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *producer(void *arg) {
+    run_t *r = arg;
+    uint32_t msg[SIM_CHAN_MAX_WORDS];
+    for (uint32_t seq = 1; seq <= r->count; seq++) {
+        for (uint32_t w = 0; w < r->words; w++)
+            msg[w] = seq ^ (w * 0x9E3779B9u);
+        if (r->lossy) {
+            // Dropped: the next one comes a little later (the next tick)
+            if (!chan_push(r->c, msg))
+                sched_yield();
+            continue;
+        }
+        while (!chan_push(r->c, msg)) {
+            r->full_spins++;
+            sched_yield();
+        }
+    }
+    // End marker; never dropped
+    memset(msg, 0, sizeof(msg));
+    while (!chan_push(r->c, msg)) {
+        r->marker_spins++;
+        sched_yield();
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    run_t *r = arg;
+    uint32_t msg[SIM_CHAN_MAX_WORDS];
+    uint32_t last = 0;
+    for (;;) {
+        if (!chan_pop(r->c, msg)) {
+            // Let the producer run on a single-CPU host
+            sched_yield();
+            continue;
+        }
+        uint32_t seq = msg[0];
+        if (!seq)
+            break;
+        for (uint32_t w = 1; w < r->words; w++)
+            if (msg[w] != (seq ^ (w * 0x9E3779B9u))) {
+                r->torn++;
+                break;
+            }
+        if (r->lossy ? seq <= last : seq != last + 1)
+            r->out_of_order++;
+        last = seq;
+        r->received++;
+    }
+    return NULL;
+}
+
+static int run(uint32_t words, uint32_t depth, uint32_t count, bool lossy) {
+    static uint32_t storage[SIM_CHAN_MAX_DEPTH * SIM_CHAN_MAX_WORDS];
+    chan_t c;
+    chan_init(&c, storage, words * 4, depth, 0);
+    // Cross the 32-bit wrap of the indices early in the run
+    c.head = c.tail = 0xFFFFFFFFu - depth * 3;
+    run_t r = { .c = &c, .words = words, .count = count, .lossy = lossy };
+
+    pthread_t tp, tc;
+    double t0 = now_s();
+    pthread_create(&tc, NULL, consumer, &r);
+    pthread_create(&tp, NULL, producer, &r);
+    pthread_join(tp, NULL);
+    pthread_join(tc, NULL);
+    double secs = now_s() - t0;
+
+    // Refused pushes are counted as dropped, retried ones included
+    uint32_t dropped = c.dropped - r.marker_spins - r.full_spins;
+    int bad = r.torn || r.out_of_order ||
+              (lossy ? r.received + dropped != count : r.received != count || dropped);
+    printf("%-8s %3u B  depth %4u  %9u msgs  %6.1f M/s  %9u dropped  %9u full  high water %4u  "
+           "%u torn, %u out of order %s\n",
+           lossy ? "lossy" : "blocking", (unsigned)(words * 4), (unsigned)depth, (unsigned)r.received,
+           r.received / secs / 1e6, (unsigned)dropped, (unsigned)r.full_spins,
+           (unsigned)c.high_water, (unsigned)r.torn, (unsigned)r.out_of_order, bad ? "FAILED" : "ok");
+    return bad;
+}
+
+int cmd_chan(int argc, char *argv[]) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 2000000;
+    uint32_t depth = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 32;
+    if (!count || depth < 2 || depth > SIM_CHAN_MAX_DEPTH || (depth & (depth - 1))) {
+        printf("chan: depth must be a power of two, 2..%u\n", SIM_CHAN_MAX_DEPTH);
+        return 1;
+    }
+    static const uint32_t sizes[] = { 1, 4, 16 };
+    int bad = 0;
+    for (int lossy = 0; lossy < 2; lossy++)
+        for (int i = 0; i < 3; i++)
+            bad += run(sizes[i], depth, count, lossy);
+    printf("chan %s\n", bad ? "FAILED" : "OK");
+    return bad != 0;
+}
@@ -0,0 +1,140 @@
+/* sim cores: the work split between the cores, before and after
+    Plays the same autoplay + storm round twice:
+    one core  the game, keypad polls, LED writes and the LCD frame share
+              core1's scheduler, as before: a frame starts the next keypad
+              read, then blocks the core for the whole blit
+    split     core0 runs the game next to the audio and core1 only renders
+              (sim_render.c), reporting each frame back over a channel
+    and prints event-to-judgement latency and the frame rate for each.
+    Both rows run today's game code, so the one-core row also gets the
+    keypad read the input task now starts early; the old tree measured
+    within a few percent of it.
+
+    cores [render_us] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "stress.h"
+#include "render.h"
+#include "seesaw_sim.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+// 96 KB frame over SPI at ~75 MHz, as the clear in sim boot
+#define SIM_CORES_RENDER_US 10500
+
+typedef struct {
+    uint32_t judge_p50, judge_p99, judge_max;
+    uint32_t led_p50;
+    uint32_t input_gap_max;     ///< worst time between two keypad polls
+    uint32_t frames;
+    uint32_t fps_x10;
+    uint32_t frame_gap_max;     ///< worst time between two frame starts
+} layout_t;
+
+static uint32_t render_us;
+static uint64_t last_frame_us;
+static uint32_t frames, frame_gap_max;
+static uint64_t first_frame_us;
+
+// The old core1 frame task (main.c before the split)
+static void frame_task(evsched_task_t *t, uint64_t now_us) {
+    if (frames) {
+        uint32_t gap = (uint32_t)(now_us - last_frame_us);
+        if (gap > frame_gap_max)
+            frame_gap_max = gap;
+    } else {
+        first_frame_us = now_us;
+    }
+    last_frame_us = now_us;
+    frames++;
+    i2c_sched_poll_begin();
+    sleep_us(render_us);
+    evsched_at(t, time_us_64() + 40);
+}
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static void run(bool split, uint32_t seed, layout_t *out) {
+    evsched_task_t frame;
+    frames = frame_gap_max = 0;
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    game_set_observer(stress_on_judge);
+    game_init();
+    if (split) {
+        sim_render_start(render_us);
+    } else {
+        evsched_task(&frame, "frame", EVS_PRIO_FRAME, frame_task, NULL);
+        evsched_at(&frame, time_us_64());
+    }
+    stress_start(STRESS_AUTOPLAY | STRESS_STORM, seed, sink_seesaw);
+    while (!game_finished()) {
+        game_step();
+        // core0's loop takes the frame reports between tasks
+        if (split)
+            render_service();
+    }
+    stress_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+
+    i2c_sched_stats_t is;
+    i2c_sched_get_stats(&is);
+    out->input_gap_max = is.input_delay_max_us;
+    out->judge_p50 = stress_percentile(false, 500);
+    out->judge_p99 = stress_percentile(false, 990);
+    out->judge_max = stress_percentile(false, 1000);
+    out->led_p50 = stress_percentile(true, 500);
+    if (split) {
+        sim_render_stop();
+        render_stats_t rs;
+        render_get_stats(&rs);
+        out->frames = rs.frames;
+        out->fps_x10 = render_fps_x10(&rs);
+        // Back to back on their own core
+        out->frame_gap_max = rs.worst_us + 40;
+    } else {
+        out->frames = frames;
+        uint64_t span = last_frame_us - first_frame_us;
+        out->fps_x10 = span ? (uint32_t)((uint64_t)(frames - 1) * 10000000 / span) : 0;
+        out->frame_gap_max = frame_gap_max;
+    }
+}
+
+static void print(const char *name, const layout_t *l) {
+    printf("%-9s %7u %7u %7u %7u %9u %7u %4u.%u %9u\n", name, (unsigned)l->judge_p50,
+           (unsigned)l->judge_p99, (unsigned)l->judge_max, (unsigned)l->led_p50,
+           (unsigned)l->input_gap_max, (unsigned)l->frames, (unsigned)(l->fps_x10 / 10),
+           (unsigned)(l->fps_x10 % 10), (unsigned)l->frame_gap_max);
+}
+
+int cmd_cores(int argc, char *argv[]) {
+    render_us = argc > 1 ? (uint32_t)atoi(argv[1]) : SIM_CORES_RENDER_US;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    layout_t one, split;
+    run(false, seed, &one);
+    run(true, seed, &split);
+
+    printf("\n%u us frame, autoplay + storm; latencies in us, event to judgement / LED\n",
+           (unsigned)render_us);
+    printf("layout    judge50 judge99 judgemx   led50 poll gap  frames    fps frame gap\n");
+    print("one core", &one);
+    print("split", &split);
+    // The split must not be slower on input, nor render less
+    return split.judge_p99 > one.judge_p99 || split.fps_x10 < one.fps_x10;
+}
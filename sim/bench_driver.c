@@ -0,0 +1,70 @@
+/* sim driver: round trip through src/neotrellis.c
+    Configures the board the way the firmware does, taps every key once and
+    lights each pressed key, then reports what the simulated Seesaw saw.
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+static int presses[NEO_TRELLIS_NUM_KEYS];
+static int releases[NEO_TRELLIS_NUM_KEYS];
+
+static TrellisCallback on_key(keyEvent evt) {
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING) {
+        presses[evt.NUM]++;
+        set_pixel_color(evt.NUM, 0, 220, 255);
+        show_pixels();
+    } else if (evt.EDGE == SEESAW_KEYPAD_EDGE_FALLING) {
+        releases[evt.NUM]++;
+    }
+    return 0;
+}
+
+int cmd_driver(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    sim_clock_reset();
+    sim_seesaw_reset(1);
+
+    init_i2c();
+    init_neopixels();
+    init_keypad(on_key);
+    i2c_sched_init(0);
+
+    uint64_t t0 = sim_clock_now_us();
+    int armed = 0;
+    for (int k = 0; k < NEO_TRELLIS_NUM_KEYS; k++)
+        armed += sim_seesaw_edge_enabled(0, k, SEESAW_KEYPAD_EDGE_RISING) &&
+                 sim_seesaw_edge_enabled(0, k, SEESAW_KEYPAD_EDGE_FALLING);
+    printf("init: %llu us, pin %u, speed %u, buf_len %u, %d/%d keys armed\n",
+           (unsigned long long)t0, sim_seesaw_pin(0), sim_seesaw_speed(0),
+           sim_seesaw_buf_length(0), armed, NEO_TRELLIS_NUM_KEYS);
+
+    sim_seesaw_reset_bus_stats();
+    for (int k = 0; k < NEO_TRELLIS_NUM_KEYS; k++)
+        sim_seesaw_script_tap(0, t0 + 10000 + k * 20000, k, 8000);
+
+    while (sim_seesaw_script_pending() || !i2c_sched_idle() ||
+           sim_clock_now_us() - t0 < 400000) {
+        i2c_sched_tick();
+        sleep_us(1000);
+    }
+
+    int ok = armed == NEO_TRELLIS_NUM_KEYS;
+    int lit = 0;
+    const sim_pixel_t *px = sim_seesaw_pixels(0);
+    for (int k = 0; k < NEO_TRELLIS_NUM_KEYS; k++) {
+        if (presses[k] != 1 || releases[k] != 1) ok = 0;
+        if (px[k].r == 0 && px[k].g == 220 && px[k].b == 255) lit++;
+    }
+    if (lit != NEO_TRELLIS_NUM_KEYS) ok = 0;
+
+    printf("keys: %d/%d lit after one tap each\n", lit, NEO_TRELLIS_NUM_KEYS);
+    sim_seesaw_print_bus_stats(sim_clock_now_us() - t0);
+    printf("%s\n", ok ? "driver OK" : "driver MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/* sim flow: rounds back to back through the attract/countdown/play/results
+    flow, with autoplay playing every round. The first round starts at
+    boot and a tap on the results screen starts each next one, so every
+    restart takes the path a player's does. Every round must score the
+    same, and the time from the end of the countdown to the round running
+    is printed next to what the one-time keypad setup costs.
+
+    flow [rounds] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "stress.h"
+#include "gameflow.h"
+#include "seesaw_sim.h"
+#include "sim_clock.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+#define FLOW_MAX_ROUNDS 64
+// Player taps this long after the screen changes
+#define FLOW_TAP_AFTER_US 1000000
+#define FLOW_RENDER_US 3000
+
+typedef struct {
+    int combo;
+    uint32_t max_combo;
+    uint32_t accuracy;
+    uint32_t start_us;
+    uint64_t tap_to_play_us;    ///< restart tap to round running
+} flow_round_t;
+
+static flow_round_t results[FLOW_MAX_ROUNDS];
+static uint32_t rounds_done = 0;
+static uint32_t rounds_wanted = 0;
+static uint32_t seed = 1;
+static uint64_t tap_at = 0;
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static void tap_later(void) {
+    tap_at = time_us_64() + FLOW_TAP_AFTER_US;
+    sim_seesaw_script_tap(0, tap_at, 0, 50000);
+}
+
+static void on_flow(flow_state_t state) {
+    if (state == FLOW_PLAY) {
+        if (rounds_done < FLOW_MAX_ROUNDS)
+            results[rounds_done].tap_to_play_us = time_us_64() - tap_at;
+        stress_start(STRESS_AUTOPLAY, seed, sink_seesaw);
+    } else if (state == FLOW_RESULTS) {
+        stress_stop();
+        judge_stats_t st;
+        judge_get_stats(&st);
+        flow_stats_t fs;
+        flow_get_stats(&fs);
+        if (rounds_done < FLOW_MAX_ROUNDS) {
+            flow_round_t *r = &results[rounds_done];
+            r->combo = game_get_combo();
+            r->max_combo = st.max_combo;
+            r->accuracy = judge_accuracy_permille(&st);
+            r->start_us = fs.start_last_us;
+        }
+        rounds_done++;
+        if (rounds_done < rounds_wanted)
+            tap_later();
+    }
+}
+
+int cmd_flow(int argc, char *argv[]) {
+    rounds_wanted = argc > 1 ? (uint32_t)atoi(argv[1]) : 5;
+    seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (rounds_wanted < 1) rounds_wanted = 1;
+    if (rounds_wanted > FLOW_MAX_ROUNDS) rounds_wanted = FLOW_MAX_ROUNDS;
+    rounds_done = 0;
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    evsched_init();
+    uint64_t t0 = time_us_64();
+    game_setup();
+    uint64_t setup_us = time_us_64() - t0;
+    flow_init(on_flow);
+    sim_render_start(FLOW_RENDER_US);
+    // The first round starts by itself
+    tap_at = time_us_64();
+
+    // A round is ~33 s; give up if the flow stalls
+    uint64_t limit = time_us_64() + (uint64_t)rounds_wanted * 60000000;
+    while (rounds_done < rounds_wanted && time_us_64() < limit)
+        evsched_run_once();
+    sim_render_stop();
+
+    printf("\nround  combo  max  accuracy  start_us  tap_to_play_ms\n");
+    int bad = 0;
+    for (uint32_t i = 0; i < rounds_done; i++) {
+        const flow_round_t *r = &results[i];
+        bool same = r->combo == results[0].combo && r->max_combo == results[0].max_combo &&
+                    r->accuracy == results[0].accuracy;
+        if (!same) bad++;
+        printf("%5u  %5d  %3u  %5u.%u%%  %8u  %14.1f%s\n", (unsigned)i + 1, r->combo,
+               (unsigned)r->max_combo, (unsigned)(r->accuracy / 10), (unsigned)(r->accuracy % 10),
+               (unsigned)r->start_us, r->tap_to_play_us / 1000.0, same ? "" : "  DIFFERS");
+    }
+    flow_stats_t fs;
+    flow_get_stats(&fs);
+    printf("%u/%u rounds, %d differ from the first; start max %u us "
+           "(keypad setup, done once: %.1f ms)\n",
+           (unsigned)rounds_done, (unsigned)rounds_wanted, bad, (unsigned)fs.start_max_us,
+           setup_us / 1000.0);
+    return bad || rounds_done < rounds_wanted;
+}
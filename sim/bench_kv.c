@@ -0,0 +1,215 @@
+/* sim kv: settings store on the RAM flash model
+    basics  values survive a remount, unchanged values are not rewritten,
+            nothing is written while audio plays
+    wear    writes one changing high score over and over and checks the
+            erases are spread over every sector
+    cuts    fills the active sector so that one commit appends a record and
+            then compacts, and cuts the power at every erase and program of
+            that commit, part way and right after; every remount must give
+            each key its old or its new value, and the store must keep
+            working
+
+    kv [writes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "audio.h"
+#include "calib.h"
+#include "kvstore.h"
+#include "sim_flash.h"
+#include "sim_clock.h"
+#include "sim_cmds.h"
+
+static uint8_t snapshot[PICO_FLASH_SIZE_BYTES];
+
+static bool get_calib(calib_record_t *rec) {
+    return kv_get(KV_KEY_CALIB, rec, sizeof(*rec)) == sizeof(*rec);
+}
+
+static bool get_score(kv_hiscore_t *hs) {
+    return kv_get(KV_KEY_HISCORE, hs, sizeof(*hs)) == sizeof(*hs);
+}
+
+static bool get_volume(uint16_t *v) {
+    return kv_get(KV_KEY_VOLUME, v, sizeof(*v)) == sizeof(*v);
+}
+
+static int basics(void) {
+    int bad = 0;
+    sim_flash_reset();
+    kv_init();
+    uint16_t vol = 700;
+    calib_record_t cal = { 41000, 27000 };
+    if (kv_get(KV_KEY_VOLUME, &vol, sizeof(vol)) != KV_ERR_NOT_FOUND) bad++;
+    uint8_t big[KV_VALUE_MAX + 1] = { 0 };
+    if (kv_set(KV_KEY_VOLUME, big, sizeof(big)) != KV_ERR_SIZE) bad++;
+
+    // Nothing reaches flash while the song plays
+    sim_flash_stats_t fs0, fs1;
+    sim_flash_get_stats(&fs0);
+    audio_play();
+    kv_set(KV_KEY_VOLUME, &vol, sizeof(vol));
+    kv_set(KV_KEY_CALIB, &cal, sizeof(cal));
+    kv_err_t busy = kv_commit();
+    sim_flash_get_stats(&fs1);
+    if (busy != KV_ERR_BUSY || fs1.programs != fs0.programs || !kv_pending()) bad++;
+    audio_stop();
+    if (kv_commit() != KV_OK) bad++;
+
+    // Remount
+    kv_init();
+    uint16_t v = 0;
+    calib_record_t c = { 0 };
+    if (!get_volume(&v) || v != vol || !get_calib(&c) || c.audio_us != cal.audio_us ||
+        c.visual_us != cal.visual_us)
+        bad++;
+    // Same value again: staged, but nothing to write
+    kv_set(KV_KEY_VOLUME, &vol, sizeof(vol));
+    sim_flash_get_stats(&fs0);
+    if (kv_pending() || kv_commit() != KV_OK) bad++;
+    sim_flash_get_stats(&fs1);
+    if (fs1.programs != fs0.programs) bad++;
+    printf("basics: remount, unchanged value, write while playing %s\n", bad ? "FAILED" : "ok");
+    return bad;
+}
+
+static int wear(uint32_t writes) {
+    sim_flash_reset();
+    kv_init();
+    uint16_t vol = 800;
+    kv_set(KV_KEY_VOLUME, &vol, sizeof(vol));
+    int bad = 0;
+    for (uint32_t i = 1; i <= writes; i++) {
+        kv_hiscore_t hs = { 0x1234, i % 1001, i };
+        kv_set(KV_KEY_HISCORE, &hs, sizeof(hs));
+        if (kv_commit() != KV_OK) {
+            printf("wear: commit %u failed\n", (unsigned)i);
+            return 1;
+        }
+    }
+    kv_init();
+    kv_hiscore_t hs;
+    uint16_t v;
+    if (!get_score(&hs) || hs.max_combo != writes || !get_volume(&v) || v != vol) bad++;
+
+    kv_stats_t st;
+    sim_flash_stats_t fs;
+    kv_get_stats(&st);
+    sim_flash_get_stats(&fs);
+    uint32_t first = PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE - KV_SECTORS;
+    uint32_t lo = UINT32_MAX, hi = 0, total = 0;
+    printf("wear: %u writes, erases per sector", (unsigned)writes);
+    for (uint32_t s = 0; s < KV_SECTORS; s++) {
+        uint32_t e = fs.erases[first + s];
+        printf(" %u", (unsigned)e);
+        if (e < lo) lo = e;
+        if (e > hi) hi = e;
+        total += e;
+        // The headers carry the same counts
+        if (st.erases[s] != e) bad++;
+    }
+    if (hi - lo > 1 || fs.bad_calls) bad++;
+    printf(" (spread %u), %u writes per erase, %u pages programmed %s\n", (unsigned)(hi - lo),
+           (unsigned)(total ? writes / total : 0), (unsigned)fs.programs, bad ? "FAILED" : "ok");
+    return bad;
+}
+
+// Values staged by the cut commit and the ones before it
+static const calib_record_t cal_old = { 40000, 20000 }, cal_new = { 45000, 31000 };
+static const kv_hiscore_t hs_old = { 0x1234, 812, 60 }, hs_new = { 0x1234, 903, 65 };
+
+static int cuts(void) {
+    // Go round every sector once so the compaction below has to erase
+    sim_flash_reset();
+    kv_init();
+    kv_set(KV_KEY_CALIB, &cal_old, sizeof(cal_old));
+    kv_set(KV_KEY_HISCORE, &hs_old, sizeof(hs_old));
+    kv_stats_t st;
+    uint16_t vol = 0;
+    do {
+        vol++;
+        kv_set(KV_KEY_VOLUME, &vol, sizeof(vol));
+        kv_commit();
+        kv_get_stats(&st);
+    } while (st.compactions < KV_SECTORS + 1 ||
+             st.used + sizeof(kv_rec_t) * 2 + 12 + 8 <= FLASH_SECTOR_SIZE);
+    // The high score (staged last, written first) fits; the calibration does not
+    if (st.used + sizeof(kv_rec_t) + 12 > FLASH_SECTOR_SIZE) {
+        printf("cuts: set-up left %u bytes used\n", (unsigned)st.used);
+        return 1;
+    }
+    memcpy(snapshot, sim_flash_mem, sizeof(snapshot));
+
+    int bad = 0;
+    uint32_t points = 0, got_new = 0;
+    static const uint32_t tears[] = { 0, 500, 1000 };
+    for (uint32_t ops = 0;; ops++) {
+        bool cut = false;
+        for (int t = 0; t < 3; t++) {
+            memcpy(sim_flash_mem, snapshot, sizeof(snapshot));
+            sim_flash_power_on();
+            kv_init();
+            kv_set(KV_KEY_CALIB, &cal_new, sizeof(cal_new));
+            kv_set(KV_KEY_HISCORE, &hs_new, sizeof(hs_new));
+            sim_flash_stats_t fs0, fs1;
+            sim_flash_get_stats(&fs0);
+            sim_flash_cut_after(ops, tears[t]);
+            kv_commit();
+            sim_flash_get_stats(&fs1);
+            sim_flash_power_on();
+            if (fs1.cuts == fs0.cuts)
+                break;
+            cut = true;
+            points++;
+
+            // Power back on
+            kv_init();
+            calib_record_t c;
+            kv_hiscore_t hs;
+            uint16_t v;
+            bool cal_ok = get_calib(&c) &&
+                          (!memcmp(&c, &cal_old, sizeof(c)) || !memcmp(&c, &cal_new, sizeof(c)));
+            bool hs_ok = get_score(&hs) &&
+                         (!memcmp(&hs, &hs_old, sizeof(hs)) || !memcmp(&hs, &hs_new, sizeof(hs)));
+            bool vol_ok = get_volume(&v) && v == vol;
+            if (cal_ok && !memcmp(&c, &cal_new, sizeof(c)))
+                got_new++;
+
+            // And it keeps working
+            calib_record_t again = { ops, t };
+            kv_set(KV_KEY_CALIB, &again, sizeof(again));
+            kv_err_t err = kv_commit();
+            kv_init();
+            bool works = err == KV_OK && get_calib(&c) && !memcmp(&c, &again, sizeof(c)) &&
+                         get_volume(&v) && v == vol && get_score(&hs);
+            if (!cal_ok || !hs_ok || !vol_ok || !works) {
+                bad++;
+                printf("cuts: after op %u (%u permille): calib %s, score %s, volume %s, %s\n",
+                       (unsigned)ops, (unsigned)tears[t], cal_ok ? "ok" : "BAD",
+                       hs_ok ? "ok" : "BAD", vol_ok ? "ok" : "BAD",
+                       works ? "writes again" : "BROKEN");
+            }
+        }
+        if (!cut)
+            break;
+    }
+    printf("cuts: %u power cuts over a commit of %u flash calls, new calibration kept after %u, "
+           "%u bad %s\n", (unsigned)points, (unsigned)(points / 3), (unsigned)got_new,
+           (unsigned)bad, bad ? "FAILED" : "ok");
+    return bad;
+}
+
+int cmd_kv(int argc, char *argv[]) {
+    uint32_t writes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 5000;
+    sim_clock_reset();
+    int bad = basics();
+    bad += wear(writes ? writes : 1);
+    bad += cuts();
+    // Leave the flash blank for other benches
+    sim_flash_reset();
+    printf("kv %s\n", bad ? "FAILED" : "OK");
+    return bad != 0;
+}
@@ -0,0 +1,72 @@
+/* sim overlap: split-phase keypad reads
+    Runs the core1 loop shape (keypad tick, then a frame of other work)
+    with the keypad read fully blocking, and with its address phase sent
+    before the frame work so the Seesaw turnaround overlaps it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+#define BENCH_US 2000000
+
+static int presses = 0;
+
+static TrellisCallback on_key(keyEvent evt) {
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING)
+        presses++;
+    return 0;
+}
+
+static void run(const char *name, bool split, uint32_t render_us) {
+    sim_clock_reset();
+    sim_seesaw_reset(1);
+    init_i2c();
+    init_neopixels();
+    init_keypad(on_key);
+    i2c_sched_init(0);
+    presses = 0;
+
+    uint64_t t0 = sim_clock_now_us();
+    int taps = 0;
+    for (uint64_t t = t0 + 4000; t < t0 + BENCH_US; t += 41000) {
+        sim_seesaw_script_tap(0, t, taps % NEO_TRELLIS_KEYS_PER_BOARD, 15000);
+        taps++;
+    }
+    sim_seesaw_reset_bus_stats();
+
+    uint32_t loops = 0;
+    uint64_t blocked = 0;
+    while (sim_clock_now_us() - t0 < BENCH_US) {
+        if (split)
+            i2c_sched_poll_begin();
+        sleep_us(render_us); // frame blit and game logic
+        uint64_t t = sim_clock_now_us();
+        i2c_sched_tick();
+        blocked += sim_clock_now_us() - t;
+        loops++;
+    }
+
+    sim_bus_stats_t bus;
+    sim_seesaw_get_bus_stats(&bus);
+    uint64_t elapsed = sim_clock_now_us() - t0;
+    uint32_t avg = bus.events_delivered ?
+                   (uint32_t)(bus.event_latency_sum_us / bus.events_delivered) : 0;
+    printf("%-9s loop %5.0f us, keypad blocks %5.0f us/loop, key latency avg %u max %u us, "
+           "%d/%d taps, %u turnaround violations\n",
+           name, (double)elapsed / loops, (double)blocked / loops, (unsigned)avg,
+           (unsigned)bus.event_latency_max_us, presses, taps,
+           (unsigned)bus.turnaround_violations);
+}
+
+int cmd_overlap(int argc, char *argv[]) {
+    uint32_t render_us = argc > 1 ? (uint32_t)atoi(argv[1]) : 3000;
+    printf("%u us of other work per loop\n", (unsigned)render_us);
+    run("blocking", false, render_us);
+    run("split", true, render_us);
+    return 0;
+}
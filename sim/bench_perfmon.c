@@ -0,0 +1,153 @@
+/* sim perfmon: the stats overlay over a round
+    Plays an autoplay + storm round with core1 rendering beside it and the
+    monitor closing its windows as on the device, and prints the overlay
+    text once a second. Then the same round with frames longer than the
+    60 fps budget, which must latch the frame warning, and closes the
+    overlay, which must clear it. The first run must keep to the frame
+    rate sim_render gives it, with no frame warning.
+
+    perfmon [render_us] [slow_us] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "stress.h"
+#include "render.h"
+#include "perfmon.h"
+#include "seesaw_sim.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+#define SIM_PERFMON_RENDER_US 10500
+#define SIM_PERFMON_SLOW_US 20000
+// Windows between two printed overlays
+#define SIM_PERFMON_PRINT_EVERY 4
+
+typedef struct {
+    uint32_t windows;
+    uint32_t fps_min_x10, fps_max_x10;  ///< over the full windows of the round
+    uint32_t led_samples;
+    uint32_t led_max_us;
+    uint32_t i2c_max_permille;
+    uint32_t idle0_min_permille;
+    uint32_t warn;
+} sim_perfmon_run_t;
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static void print_view(const perfmon_view_t *v) {
+    char line[PERFMON_LINES][PERFMON_COLS + 1];
+    perfmon_format(v, line);
+    printf("%5.2f s |%s|\n", v->version * PERFMON_WINDOW_US / 1e6, line[0]);
+    for (int l = 1; l < PERFMON_LINES; l++)
+        printf("        |%s|\n", line[l]);
+}
+
+static void run(uint32_t render_us, uint32_t seed, bool print, sim_perfmon_run_t *out) {
+    *out = (sim_perfmon_run_t){ .fps_min_x10 = UINT32_MAX, .idle0_min_permille = 1000 };
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    perfmon_start();
+    game_set_observer(stress_on_judge);
+    game_init();
+    sim_render_start(render_us);
+    stress_start(STRESS_AUTOPLAY | STRESS_STORM, seed, sink_seesaw);
+    uint32_t seen = 0;
+    perfmon_view_t v;
+    while (!game_finished()) {
+        game_step();
+        render_service();
+        perfmon_read(&v);
+        if (v.version == seen)
+            continue;
+        seen = v.version;
+        // The first window has core1's start in it
+        if (v.version > 1) {
+            out->windows++;
+            if (v.fps_x10 < out->fps_min_x10)
+                out->fps_min_x10 = v.fps_x10;
+            if (v.fps_x10 > out->fps_max_x10)
+                out->fps_max_x10 = v.fps_x10;
+        }
+        out->led_samples += v.led_samples;
+        if (v.led_max_us > out->led_max_us)
+            out->led_max_us = v.led_max_us;
+        if (v.i2c_permille > out->i2c_max_permille)
+            out->i2c_max_permille = v.i2c_permille;
+        if (v.idle_permille[0] < out->idle0_min_permille)
+            out->idle0_min_permille = v.idle_permille[0];
+        if (print && v.version % SIM_PERFMON_PRINT_EVERY == 0)
+            print_view(&v);
+    }
+    stress_stop();
+    sim_render_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+    out->warn = v.warn;
+}
+
+static void print_warn(uint32_t warn) {
+    if (!warn)
+        printf(" none");
+    for (uint32_t w = 0; w < PERFMON_WARNS; w++)
+        if (warn & (1u << w))
+            printf(" %s", perfmon_warn_name(w));
+    printf("\n");
+}
+
+static void summary(const char *name, uint32_t render_us, const sim_perfmon_run_t *r) {
+    printf("%-6s %5u us frames: %u windows, fps %u.%u..%u.%u, %u hits lit (worst %u us), "
+           "bus max %u.%u%%, core0 idle min %u.%u%%, latched:",
+           name, (unsigned)render_us, (unsigned)r->windows, (unsigned)(r->fps_min_x10 / 10),
+           (unsigned)(r->fps_min_x10 % 10), (unsigned)(r->fps_max_x10 / 10),
+           (unsigned)(r->fps_max_x10 % 10), (unsigned)r->led_samples, (unsigned)r->led_max_us,
+           (unsigned)(r->i2c_max_permille / 10), (unsigned)(r->i2c_max_permille % 10),
+           (unsigned)(r->idle0_min_permille / 10), (unsigned)(r->idle0_min_permille % 10));
+    print_warn(r->warn);
+}
+
+int cmd_perfmon(int argc, char *argv[]) {
+    uint32_t render_us = argc > 1 ? (uint32_t)atoi(argv[1]) : SIM_PERFMON_RENDER_US;
+    uint32_t slow_us = argc > 2 ? (uint32_t)atoi(argv[2]) : SIM_PERFMON_SLOW_US;
+    uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+    sim_perfmon_run_t normal, slow;
+
+    run(render_us, seed, true, &normal);
+    run(slow_us, seed, false, &slow);
+    // Staff open the overlay, read it and close it again
+    perfmon_overlay_toggle();
+    perfmon_overlay_toggle();
+    perfmon_view_t v;
+    perfmon_read(&v);
+
+    printf("\n");
+    summary("normal", render_us, &normal);
+    summary("slow", slow_us, &slow);
+    // sim_render: a frame every render_us + its 40 us gap, within a frame
+    // per window either way
+    uint32_t want_x10 = 10000000 / (render_us + 40);
+    uint32_t per_window_x10 = 10000000 / PERFMON_WINDOW_US;
+    bool rate_ok = normal.windows && normal.fps_min_x10 + per_window_x10 >= want_x10 &&
+                   normal.fps_max_x10 <= want_x10 + per_window_x10;
+    bool frame_ok = render_us > PERFMON_FRAME_WARN_US ||
+                    !(normal.warn & (1u << PERFMON_WARN_FRAME));
+    bool slow_ok = (slow.warn & (1u << PERFMON_WARN_FRAME)) != 0;
+    bool lit_ok = normal.led_samples > 0;
+    bool ok = rate_ok && frame_ok && slow_ok && lit_ok && !v.warn;
+    printf("frame rate %s, frame warning %s when slow, hit LEDs %s, closing clears %s: %s\n",
+           rate_ok && frame_ok ? "ok" : "off", slow_ok ? "latched" : "MISSING",
+           lit_ok ? "measured" : "MISSING", v.warn ? "FAILED" : "ok", ok ? "perfmon OK" : "FAILED");
+    return !ok;
+}
@@ -0,0 +1,123 @@
+/* sim sched: core1's renderer on the cooperative scheduler
+    Runs main.c's core1 task set on the virtual clock for a few seconds:
+    frame   blits a frame, then a little CPU; back to back
+    hud     every 10 ms, redraws the combo when it changed (every 50 ms
+            here), which needs the LCD to itself
+    fx      every 5 ms, a short effect step that must be done within 1 ms
+    once with the blit blocking the core, as before, and once by DMA with
+    the frame task waiting in EVS_WAIT_UNTIL(). Prints each task's run
+    time and deadline misses. The waiting frame must leave fx no misses,
+    run less core time per frame than the blocking one, and the HUD must
+    never draw while a blit is out.
+
+    sched [blit_us] [secs]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "evsched.h"
+#include "sim_cmds.h"
+
+// 96 KB frame over SPI at ~75 MHz, as in sim cores
+#define SIM_SCHED_BLIT_US 10500
+#define SIM_SCHED_FRAME_CPU_US 200
+#define SIM_SCHED_HUD_DRAW_US 600
+#define SIM_SCHED_COMBO_US 50000
+#define SIM_SCHED_FX_US 150
+// As in main.c
+#define SIM_SCHED_BUDGET_US 16667
+#define SIM_SCHED_HUD_PERIOD_US 10000
+#define SIM_SCHED_POLL_US 100
+#define SIM_SCHED_HUD_POLL_US 1000
+#define SIM_SCHED_FX_PERIOD_US 5000
+#define SIM_SCHED_FX_DEADLINE_US 1000
+
+static evsched_task_t t_frame, t_hud, t_fx;
+static bool dma;
+static uint32_t blit_us;
+static uint64_t blit_done_at;
+static uint32_t frames, drawn, drawn_busy, drawn_version;
+
+// The LCD's DMA: out once the wire time has passed
+static bool blit_busy(void) {
+    return time_us_64() < blit_done_at;
+}
+
+static void frame_task(evsched_task_t *t, uint64_t now_us) {
+    EVS_BEGIN(t);
+    blit_done_at = time_us_64() + blit_us;
+    if (dma) {
+        EVS_YIELD_UNTIL(t, blit_done_at);
+        EVS_WAIT_UNTIL(t, !blit_busy(), SIM_SCHED_POLL_US);
+        if (t_hud.resume)
+            evsched_at(&t_hud, time_us_64());
+    } else {
+        sleep_us(blit_us);
+    }
+    sleep_us(SIM_SCHED_FRAME_CPU_US);
+    frames++;
+    evsched_at(t, time_us_64() + 40);
+    EVS_END(t);
+}
+
+static void hud_task(evsched_task_t *t, uint64_t now_us) {
+    EVS_BEGIN(t);
+    if (time_us_64() / SIM_SCHED_COMBO_US != drawn_version) {
+        EVS_WAIT_UNTIL(t, !blit_busy(), SIM_SCHED_HUD_POLL_US);
+        drawn_busy += blit_busy();
+        sleep_us(SIM_SCHED_HUD_DRAW_US);
+        drawn_version = (uint32_t)(time_us_64() / SIM_SCHED_COMBO_US);
+        drawn++;
+    }
+    EVS_END(t);
+}
+
+static void fx_task(evsched_task_t *t, uint64_t now_us) {
+    sleep_us(SIM_SCHED_FX_US);
+}
+
+static void run(bool use_dma, uint32_t secs) {
+    dma = use_dma;
+    frames = drawn = drawn_busy = drawn_version = 0;
+    blit_done_at = 0;
+    sim_clock_reset();
+    evsched_init();
+    evsched_task(&t_frame, "frame", EVS_PRIO_FRAME, frame_task, NULL);
+    evsched_task(&t_hud, "hud", EVS_PRIO_LED, hud_task, NULL);
+    evsched_task(&t_fx, "fx", EVS_PRIO_INPUT, fx_task, NULL);
+    evsched_timing(&t_frame, 0, SIM_SCHED_BUDGET_US);
+    evsched_timing(&t_hud, SIM_SCHED_HUD_PERIOD_US, SIM_SCHED_BUDGET_US);
+    evsched_timing(&t_fx, SIM_SCHED_FX_PERIOD_US, SIM_SCHED_FX_DEADLINE_US);
+    uint64_t t0 = time_us_64();
+    evsched_at(&t_frame, t0);
+    evsched_at(&t_hud, t0);
+    evsched_at(&t_fx, t0);
+    uint64_t end = t0 + (uint64_t)secs * 1000000;
+    while (time_us_64() < end)
+        evsched_run_once();
+
+    printf("\n%s blit, %u us: %u frames (%u fps), %u HUD draws, %u during a blit\n",
+           use_dma ? "DMA" : "blocking", (unsigned)blit_us, (unsigned)frames,
+           (unsigned)(frames / secs), (unsigned)drawn, (unsigned)drawn_busy);
+    evsched_print_stats();
+}
+
+int cmd_sched(int argc, char *argv[]) {
+    blit_us = argc > 1 ? (uint32_t)atoi(argv[1]) : SIM_SCHED_BLIT_US;
+    uint32_t secs = argc > 2 ? (uint32_t)atoi(argv[2]) : 5;
+    if (!secs)
+        secs = 1;
+
+    run(false, secs);
+    uint32_t block_misses = t_fx.misses;
+    uint32_t block_run_max = t_frame.run_max_us;
+
+    run(true, secs);
+    int bad = t_fx.misses || drawn_busy || !drawn || t_frame.run_max_us >= block_run_max;
+    printf("\nfx deadline misses %u blocking, %u with DMA waits; frame run max %u -> %u us\n",
+           (unsigned)block_misses, (unsigned)t_fx.misses, (unsigned)block_run_max,
+           (unsigned)t_frame.run_max_us);
+    printf("sched %s\n", bad ? "FAILED" : "OK");
+    return bad;
+}
@@ -0,0 +1,189 @@
+/* sim snapshot: game-state snapshot under a writer and readers
+    threads  a writer thread rewrites a block as fast as it can while a
+             reader thread copies it out. Every word of a write carries the
+             write's number, so a copy that mixes two writes shows up as
+             torn, and one older than the copy before it as going back.
+    round    a full autoplay + storm round with a frame task that reads the
+             snapshot once per frame and redraws the combo only when the
+             version moved. Every frame the snapshot must agree with the
+             game (no update waiting for a later frame), and at the end the
+             drawn combo and counts must be the round's.
+
+    On x86 the hardware keeps stores in order, so the threads mostly check
+    that the compiler does; on an ARM host it checks the fences too.
+
+    snapshot [writes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "judge.h"
+#include "evsched.h"
+#include "stress.h"
+#include "seqlock.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+// Words per block: about the size of game_snapshot_t
+#define SIM_SNAP_WORDS 12
+// LCD frame length in the round, as in the other benches
+#define SIM_SNAP_FRAME_US 3000
+
+typedef struct {
+    seqlock_t lock;
+    uint32_t writes;
+    uint32_t done;
+    // Results
+    uint32_t reads;
+    uint32_t torn;
+    uint32_t backwards;
+} run_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *writer(void *arg) {
+    run_t *r = arg;
+    uint32_t block[SIM_SNAP_WORDS];
+    for (uint32_t n = 1; n <= r->writes; n++) {
+        for (uint32_t w = 0; w < SIM_SNAP_WORDS; w++)
+            block[w] = n ^ (w * 0x9E3779B9u);
+        seqlock_write(&r->lock, block);
+        // Let the reader run on a single-CPU host
+        if (!(n & 63))
+            sched_yield();
+    }
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    run_t *r = arg;
+    uint32_t block[SIM_SNAP_WORDS];
+    uint32_t last = 0;
+    while (!__atomic_load_n(&r->done, __ATOMIC_ACQUIRE)) {
+        // Nothing written yet
+        if (!seqlock_read(&r->lock, block))
+            continue;
+        uint32_t n = block[0];
+        for (uint32_t w = 1; w < SIM_SNAP_WORDS; w++)
+            if (block[w] != (n ^ (w * 0x9E3779B9u))) {
+                r->torn++;
+                break;
+            }
+        if (n < last)
+            r->backwards++;
+        last = n;
+        r->reads++;
+        sched_yield();
+    }
+    return NULL;
+}
+
+static int threads(uint32_t writes) {
+    static uint32_t storage[SIM_SNAP_WORDS];
+    run_t r = { .writes = writes };
+    seqlock_init(&r.lock, storage, sizeof(storage));
+
+    pthread_t tw, tr;
+    double t0 = now_s();
+    pthread_create(&tr, NULL, reader, &r);
+    pthread_create(&tw, NULL, writer, &r);
+    pthread_join(tw, NULL);
+    pthread_join(tr, NULL);
+    double secs = now_s() - t0;
+
+    int bad = r.torn || r.backwards || r.lock.seq != writes * 2;
+    printf("threads: %u writes (%.1f M/s), %u reads, %u retried, %u torn, %u went back %s\n",
+           (unsigned)writes, writes / secs / 1e6, (unsigned)r.reads, (unsigned)r.lock.retries,
+           (unsigned)r.torn, (unsigned)r.backwards, bad ? "FAILED" : "ok");
+    return bad;
+}
+
+// Round: what the frame task saw and drew
+static uint32_t frames, redraws, stale;
+static uint32_t drawn_version;
+static int drawn_combo;
+
+static void frame_task(evsched_task_t *t, uint64_t now_us) {
+    game_snapshot_t snap;
+    game_snapshot(&snap);
+    i2c_sched_poll_begin();
+    frames++;
+    // The game has finished every task before this one runs
+    if (snap.combo != game_get_combo())
+        stale++;
+    if (snap.version != drawn_version) {
+        redraws++;
+        drawn_version = snap.version;
+        drawn_combo = snap.combo;
+    }
+    sleep_us(SIM_SNAP_FRAME_US); // no-op display
+    evsched_at(t, time_us_64());
+}
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static int round_check(void) {
+    evsched_task_t frame;
+    frames = redraws = stale = 0;
+    drawn_version = 0;
+    drawn_combo = 0;
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    game_set_observer(stress_on_judge);
+    game_init();
+    evsched_task(&frame, "frame", EVS_PRIO_FRAME, frame_task, NULL);
+    evsched_at(&frame, time_us_64());
+    stress_start(STRESS_AUTOPLAY | STRESS_STORM, 1, sink_seesaw);
+    while (!game_finished())
+        game_step();
+    stress_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+
+    game_snapshot_t snap;
+    judge_stats_t st;
+    game_snapshot(&snap);
+    judge_get_stats(&st);
+    int bad = stale || snap.running || snap.combo != game_get_combo() ||
+              snap.max_combo != st.max_combo || snap.accuracy != judge_accuracy_permille(&st) ||
+              memcmp(snap.count, st.count, sizeof(snap.count));
+    // The last frame ran before the end; what it drew is what was current then
+    if (drawn_version > snap.version || (drawn_version == snap.version && drawn_combo != snap.combo))
+        bad++;
+    printf("round: %u frames, %u redrawn (%u versions), %u stale, combo %d max %u, "
+           "%u/%u/%u/%u judged %s\n",
+           (unsigned)frames, (unsigned)redraws, (unsigned)snap.version, (unsigned)stale,
+           (int)snap.combo, (unsigned)snap.max_combo, (unsigned)snap.count[JUDGE_PERFECT],
+           (unsigned)snap.count[JUDGE_GREAT], (unsigned)snap.count[JUDGE_GOOD],
+           (unsigned)snap.count[JUDGE_MISS], bad ? "FAILED" : "ok");
+    return bad;
+}
+
+int cmd_snapshot(int argc, char *argv[]) {
+    uint32_t writes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 2000000;
+    int bad = threads(writes ? writes : 1);
+    bad += round_check();
+    printf("snapshot %s\n", bad ? "FAILED" : "OK");
+    return bad != 0;
+}
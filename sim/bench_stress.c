@@ -0,0 +1,67 @@
+/* sim stress: synthetic input load and input latency percentiles
+    Runs the game with stress.c injecting autoplay and/or storm edges, with
+    core1 rendering beside it, and prints event-to-judgement and
+    event-to-LED latency percentiles. Edges go into the simulated Seesaw
+    FIFOs, so they take the whole I2C path (COUNT, FIFO read of count + 2),
+    or with "driver" into neo_inject() as on the device.
+
+    stress [autoplay|storm|both] [render_us] [seed] [driver]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "chart.h"
+#include "evsched.h"
+#include "stress.h"
+#include "seesaw_sim.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+static uint32_t render_us;
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+int cmd_stress(int argc, char *argv[]) {
+    uint8_t mode = STRESS_AUTOPLAY | STRESS_STORM;
+    if (argc > 1 && strcmp(argv[1], "autoplay") == 0) mode = STRESS_AUTOPLAY;
+    else if (argc > 1 && strcmp(argv[1], "storm") == 0) mode = STRESS_STORM;
+    render_us = argc > 2 ? (uint32_t)atoi(argv[2]) : 3000;
+    uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+    bool driver = argc > 4 && strcmp(argv[4], "driver") == 0;
+
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    game_set_observer(stress_on_judge);
+    game_init();
+    sim_render_start(render_us);
+    stress_start(mode, seed, driver ? NULL : sink_seesaw);
+    sim_seesaw_reset_bus_stats();
+    uint64_t t0 = sim_clock_now_us();
+
+    while (!game_finished())
+        game_step();
+    stress_stop();
+    sim_render_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+
+    printf("\n%s%s, %u us frame, edges via %s\n", mode & STRESS_AUTOPLAY ? "autoplay" : "",
+           mode == (STRESS_AUTOPLAY | STRESS_STORM) ? " + storm" :
+           mode == STRESS_STORM ? "storm" : "",
+           (unsigned)render_us, driver ? "neo_inject()" : "the Seesaw FIFO");
+    sim_seesaw_print_bus_stats(sim_clock_now_us() - t0);
+    stress_print_stats();
+    return 0;
+}
@@ -0,0 +1,100 @@
+/* sim tiles: NeoTrellis tiling with 1, 2 and 4 boards
+    Measures an idle keypad poll, a full-field LED commit, and keypad
+    latency / LED frame rate while the whole field is repainted every tick.
+    The "vs 1" columns show how each cost scales with the board count.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+#define LOAD_US 2000000
+#define RENDER_US 2000
+
+static int presses = 0;
+
+static TrellisCallback on_key(keyEvent evt) {
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING)
+        presses++;
+    return 0;
+}
+
+static void setup(int boards) {
+    neotrellis_set_layout(boards, boards > 1 ? 2 : 1);
+    sim_clock_reset();
+    sim_seesaw_reset(boards);
+    init_i2c();
+    init_neopixels();
+    init_keypad(on_key);
+    i2c_sched_init(0);
+    presses = 0;
+}
+
+static void paint(uint32_t frame) {
+    for (int k = 0; k < neotrellis_num_keys(); k++)
+        set_pixel_color(k, (frame + k) & 0xFF, (frame * 5) & 0xFF, k * 4);
+    show_pixels();
+}
+
+int cmd_tiles(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    static const int counts[] = { 1, 2, 4 };
+    double poll1 = 0, commit1 = 0;
+
+    printf("boards keys  poll_us (vs 1)  commit_us (vs 1)  loaded: fps  key_avg_us key_max_us taps\n");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        int n = counts[c];
+        setup(n);
+
+        // Idle keypad poll
+        uint64_t t = sim_clock_now_us();
+        for (int i = 0; i < 100; i++)
+            neo_read();
+        double poll = (sim_clock_now_us() - t) / 100.0;
+
+        // Full-field LED commit
+        t = sim_clock_now_us();
+        for (uint32_t f = 0; f < 100; f++) {
+            paint(f);
+            i2c_sched_flush();
+        }
+        double commit = (sim_clock_now_us() - t) / 100.0;
+
+        // Taps spread over every board while the field is repainted
+        uint64_t t0 = sim_clock_now_us();
+        uint32_t seed = 7;
+        int taps = 0;
+        for (uint64_t at = t0 + 3000; at < t0 + LOAD_US; at += 23000) {
+            seed = seed * 1103515245 + 12345;
+            sim_seesaw_script_tap((seed >> 8) % n, at, (seed >> 16) % NEO_TRELLIS_KEYS_PER_BOARD, 12000);
+            taps++;
+        }
+        sim_seesaw_reset_bus_stats();
+        uint32_t shows0 = sim_seesaw_shows(0);
+        for (uint32_t f = 0; sim_clock_now_us() - t0 < LOAD_US; f++) {
+            paint(f);
+            i2c_sched_tick();
+            sleep_us(RENDER_US);
+        }
+        double fps = (sim_seesaw_shows(0) - shows0) * 1e6 / (sim_clock_now_us() - t0);
+        sim_bus_stats_t bus;
+        sim_seesaw_get_bus_stats(&bus);
+        uint32_t avg = bus.events_delivered ?
+                       (uint32_t)(bus.event_latency_sum_us / bus.events_delivered) : 0;
+
+        if (n == 1) {
+            poll1 = poll;
+            commit1 = commit;
+        }
+        printf("%6d %4d  %7.0f (%.2fx)  %9.0f (%.2fx)  %11.1f  %10u %10u %d/%d\n",
+               n, neotrellis_num_keys(), poll, poll / poll1, commit, commit / commit1,
+               fps, (unsigned)avg, (unsigned)bus.event_latency_max_us, presses, taps);
+    }
+    neotrellis_set_layout(NEO_TRELLIS_NUM_BOARDS, NEO_TRELLIS_BOARD_COLS);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* sim chart: chart generator, validator and loader benchmark
+    gen   writes a chart as a .bin file or as a C header for flash
+    check validates a chart file the way the firmware does on load
+    bench times chart_open() and the streaming cursors against a rescan
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chart.h"
+#include "sim_cmds.h"
+
+#define CHART_EARLY_MS 100
+#define CHART_LATE_MS 100
+
+static double host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Small LCG so generated charts are the same on every host
+static uint32_t lcg = 1;
+static uint32_t lcg_next(void) {
+    lcg = lcg * 1103515245u + 12345u;
+    return (lcg >> 16) & 0x7FFF;
+}
+
+/*! \brief Fill a note table with one note per beat
+    \param chords percent of notes that get a second key
+    \param holds percent of notes held for a beat
+    \return number of notes
+*/
+static uint32_t gen_notes(chart_note_t *notes, uint32_t max, uint16_t lanes, uint32_t bpm,
+                          uint32_t secs, uint32_t seed, int chords, int holds) {
+    lcg = seed;
+    uint64_t beat = (uint64_t)CHART_SAMPLE_RATE * 60 / bpm;
+    uint32_t n = 0;
+    int prev = -1;
+    for (uint64_t t = beat; t < (uint64_t)secs * CHART_SAMPLE_RATE && n < max; t += beat) {
+        // No key twice in a row, really hard to catch when playing
+        int key = lcg_next() % lanes;
+        if (key == prev) key = (key + 1) % lanes;
+        prev = key;
+        notes[n].time = (uint32_t)t;
+        notes[n].lanes = 1ull << key;
+        notes[n].hold = 0;
+        if ((int)(lcg_next() % 100) < chords)
+            notes[n].lanes |= 1ull << ((key + 1 + lcg_next() % (lanes - 1)) % lanes);
+        if ((int)(lcg_next() % 100) < holds)
+            notes[n].hold = (uint32_t)beat / 2;
+        n++;
+    }
+    return n;
+}
+
+static int write_header(const char *path, const char *name, const uint8_t *img, uint32_t len,
+                        const char *cmdline) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    char guard[64];
+    size_t i;
+    for (i = 0; name[i] && i < sizeof(guard) - 1; i++)
+        guard[i] = (name[i] >= 'a' && name[i] <= 'z') ? name[i] - 'a' + 'A' : name[i];
+    guard[i] = 0;
+    fprintf(f, "// Generated by `sim chart gen %s`\n", cmdline);
+    fprintf(f, "#ifndef %s_H\n#define %s_H\n\n#include <stdint.h>\n", guard, guard);
+    fprintf(f, "const uint8_t %s[] __attribute__((aligned(8))) = {", name);
+    for (uint32_t j = 0; j < len; j++)
+        fprintf(f, "%s0x%02x,", j % 16 ? " " : "\n", img[j]);
+    fprintf(f, "\n};\nconst uint32_t %s_len = %u;\n\n#endif\n", name, (unsigned)len);
+    return fclose(f);
+}
+
+static int gen(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: chart gen <out.bin|out.h> [bpm] [secs] [seed] [chord%%] [hold%%]\n");
+        return 1;
+    }
+    const char *out = argv[1];
+    uint32_t bpm = argc > 2 ? (uint32_t)atoi(argv[2]) : 120;
+    uint32_t secs = argc > 3 ? (uint32_t)atoi(argv[3]) : 33;
+    uint32_t seed = argc > 4 ? (uint32_t)atoi(argv[4]) : 250;
+    int chords = argc > 5 ? atoi(argv[5]) : 0;
+    int holds = argc > 6 ? atoi(argv[6]) : 0;
+    if (!bpm) bpm = 120;
+
+    uint32_t max = secs * bpm / 60 + 1;
+    chart_note_t *notes = calloc(max, sizeof(*notes));
+    uint32_t cap = sizeof(chart_header_t) + max * sizeof(chart_note_t);
+    uint8_t *img = aligned_alloc(8, (cap + 7) & ~7u);
+    uint32_t n = gen_notes(notes, max, 16, bpm, secs, seed, chords, holds);
+    uint32_t len = chart_write(img, cap, 16, CHART_SAMPLE_RATE, notes, n);
+
+    int rc;
+    size_t l = strlen(out);
+    if (l > 2 && strcmp(out + l - 2, ".h") == 0) {
+        // chart_default.h -> chart_default
+        char name[64];
+        const char *base = strrchr(out, '/');
+        base = base ? base + 1 : out;
+        snprintf(name, sizeof(name), "%.*s", (int)(strlen(base) - 2), base);
+        char cmdline[256];
+        snprintf(cmdline, sizeof(cmdline), "%s %u %u %u %d %d", base, (unsigned)bpm,
+                 (unsigned)secs, (unsigned)seed, chords, holds);
+        rc = write_header(out, name, img, len, cmdline);
+    } else {
+        FILE *f = fopen(out, "wb");
+        rc = f && fwrite(img, 1, len, f) == len ? 0 : -1;
+        if (f) fclose(f);
+    }
+    printf("%s: %u notes, %u bytes%s\n", out, (unsigned)n, (unsigned)len, rc ? " (write failed)" : "");
+    free(img);
+    free(notes);
+    return rc ? 1 : 0;
+}
+
+static int check(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: chart check <file.bin>...\n");
+        return 1;
+    }
+    int bad = 0;
+    for (int i = 1; i < argc; i++) {
+        chart_t c;
+        chart_err_t err = chart_load_file(&c, argv[i]);
+        if (err != CHART_OK) {
+            printf("%s: %s\n", argv[i], chart_strerror(err));
+            bad++;
+            continue;
+        }
+        uint32_t chords = 0, holds = 0;
+        for (uint32_t j = 0; j < c.count; j++) {
+            if (c.notes[j].lanes & (c.notes[j].lanes - 1)) chords++;
+            if (c.notes[j].hold) holds++;
+        }
+        uint32_t end = c.count ? c.notes[c.count - 1].time + c.notes[c.count - 1].hold : 0;
+        printf("%s: ok, %u lanes, %u Hz, %u notes (%u chords, %u holds), %.2f s\n", argv[i],
+               (unsigned)c.lanes, (unsigned)c.rate, (unsigned)c.count, (unsigned)chords,
+               (unsigned)holds, (double)end / c.rate);
+        chart_close(&c);
+    }
+    return bad ? 1 : 0;
+}
+
+static int bench(int argc, char *argv[]) {
+    uint32_t secs = argc > 1 ? (uint32_t)atoi(argv[1]) : 3600;
+    uint32_t bpm = 240;
+    uint32_t max = secs * bpm / 60 + 1;
+    chart_note_t *notes = calloc(max, sizeof(*notes));
+    uint32_t n = gen_notes(notes, max, 16, bpm, secs, 1, 20, 10);
+    uint32_t cap = sizeof(chart_header_t) + n * sizeof(chart_note_t);
+    uint8_t *img = aligned_alloc(8, (cap + 7) & ~7u);
+    uint32_t len = chart_write(img, cap, 16, CHART_SAMPLE_RATE, notes, n);
+    free(notes);
+
+    chart_t c;
+    const int reps = 20;
+    double t0 = host_ns();
+    for (int i = 0; i < reps; i++) {
+        if (chart_open(&c, img, len) != CHART_OK) {
+            printf("chart_open failed\n");
+            return 1;
+        }
+    }
+    double open_ns = (host_ns() - t0) / reps;
+    printf("%u notes, %u bytes: chart_open %.0f us (%.1f ns/note)\n", (unsigned)n, (unsigned)len,
+           open_ns / 1000, open_ns / n);
+
+    // One tick per millisecond over the whole song, as game_step() does
+    int32_t early = (int32_t)chart_ms_to_samples(&c, CHART_EARLY_MS);
+    int32_t late = (int32_t)chart_ms_to_samples(&c, CHART_LATE_MS);
+    uint64_t step = c.rate / 1000;
+    uint64_t end = (uint64_t)secs * c.rate;
+    uint64_t ticks = end / step;
+
+    chart_cursor_t open, close;
+    chart_cursor_init(&open, &c, -early);
+    chart_cursor_init(&close, &c, late);
+    uint64_t active_sum = 0, opened = 0;
+    t0 = host_ns();
+    for (uint64_t now = 0; now < end; now += step) {
+        while (chart_cursor_take(&open, now) >= 0) opened++;
+        while (chart_cursor_take(&close, now) >= 0) {}
+        active_sum += open.next - close.next;
+    }
+    double cur_ns = (host_ns() - t0) / ticks;
+
+    // Same window found by searching from the start of the chart every tick
+    uint64_t scan_ticks = ticks < 20000 ? ticks : 20000;
+    uint64_t check_sum = 0;
+    t0 = host_ns();
+    for (uint64_t k = 0; k < scan_ticks; k++) {
+        uint64_t now = k * step * (ticks / scan_ticks);
+        uint32_t lo = 0, hi = 0;
+        while (lo < c.count && (int64_t)c.notes[lo].time + late <= (int64_t)now) lo++;
+        hi = lo;
+        while (hi < c.count && (int64_t)c.notes[hi].time - early <= (int64_t)now) hi++;
+        check_sum += hi - lo;
+    }
+    double scan_ns = (host_ns() - t0) / scan_ticks;
+
+    printf("cursor: %.1f ns/tick over %llu ticks, %llu notes opened, %.2f notes in window avg\n",
+           cur_ns, (unsigned long long)ticks, (unsigned long long)opened,
+           (double)active_sum / ticks);
+    printf("rescan: %.1f ns/tick (%.0fx), window check %llu\n", scan_ns, scan_ns / cur_ns,
+           (unsigned long long)check_sum);
+    free(img);
+    return opened == n ? 0 : 1;
+}
+
+int cmd_chart(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "gen") == 0) return gen(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "check") == 0) return check(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) return bench(argc - 1, argv + 1);
+    printf("usage: chart gen|check|bench ...\n");
+    return 1;
+}
@@ -0,0 +1,472 @@
+/* sim dlog: deferred log decoder and check
+    decode  turns "dlog:" lines (a serial log with them in it) back into
+            text. Format strings and DLOG_STR() strings are read from the
+            firmware ELF at the addresses in the lines; the "dlog: @" line
+            gives where dlog_anchor was, so a relocated image (the host's,
+            built as PIE) decodes too. Output is one line per record:
+            <core> <seconds> <text>.
+    check   times DLOG() on the host, round-trips known messages through
+            the hex lines and this decoder against the simulator's own
+            binary (each must match snprintf()), then plays ms of an
+            autoplay round with the drain task running and decodes what it
+            wrote.
+
+    dlog decode <elf> <log> [out]
+    dlog check [ms] [seed]
+*/
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "stress.h"
+#include "dlog.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+#define SIM_DLOG_LINE 512
+#define SIM_DLOG_CASES 16
+
+// The parts of an ELF the decoder reads: loaded sections and one symbol
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    uint64_t anchor;            ///< dlog_anchor's address in the file
+} sim_elf_t;
+
+static bool in_file(const sim_elf_t *e, uint64_t off, uint64_t len) {
+    return off <= e->len && len <= e->len - off;
+}
+
+/*! \brief Section header i as 64-bit fields, from either ELF class
+*/
+static bool section(const sim_elf_t *e, uint32_t i, Elf64_Shdr *sh) {
+    if (e->data[EI_CLASS] == ELFCLASS64) {
+        const Elf64_Ehdr *h = (const Elf64_Ehdr *)e->data;
+        uint64_t off = h->e_shoff + (uint64_t)i * h->e_shentsize;
+        if (i >= h->e_shnum || !in_file(e, off, sizeof(*sh)))
+            return false;
+        memcpy(sh, e->data + off, sizeof(*sh));
+        return true;
+    }
+    const Elf32_Ehdr *h = (const Elf32_Ehdr *)e->data;
+    uint64_t off = h->e_shoff + (uint64_t)i * h->e_shentsize;
+    Elf32_Shdr s;
+    if (i >= h->e_shnum || !in_file(e, off, sizeof(s)))
+        return false;
+    memcpy(&s, e->data + off, sizeof(s));
+    *sh = (Elf64_Shdr){ s.sh_name, s.sh_type, s.sh_flags, s.sh_addr, s.sh_offset, s.sh_size,
+                        s.sh_link, s.sh_info, s.sh_addralign, s.sh_entsize };
+    return true;
+}
+
+static uint32_t sections(const sim_elf_t *e) {
+    if (e->data[EI_CLASS] == ELFCLASS64)
+        return ((const Elf64_Ehdr *)e->data)->e_shnum;
+    return ((const Elf32_Ehdr *)e->data)->e_shnum;
+}
+
+/*! \brief Address of a symbol in the symbol table
+    \return false if there is none, or the file is stripped
+*/
+static bool symbol(const sim_elf_t *e, const char *name, uint64_t *addr) {
+    bool is64 = e->data[EI_CLASS] == ELFCLASS64;
+    Elf64_Shdr sh, str;
+    for (uint32_t i = 0; section(e, i, &sh); i++) {
+        if (sh.sh_type != SHT_SYMTAB || !section(e, sh.sh_link, &str) ||
+            !in_file(e, sh.sh_offset, sh.sh_size) || !in_file(e, str.sh_offset, str.sh_size))
+            continue;
+        uint64_t ent = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+        for (uint64_t off = 0; off + ent <= sh.sh_size; off += ent) {
+            const uint8_t *p = e->data + sh.sh_offset + off;
+            uint32_t n;
+            uint64_t v;
+            if (is64) {
+                n = ((const Elf64_Sym *)p)->st_name;
+                v = ((const Elf64_Sym *)p)->st_value;
+            } else {
+                n = ((const Elf32_Sym *)p)->st_name;
+                v = ((const Elf32_Sym *)p)->st_value;
+            }
+            if (n < str.sh_size && strncmp((const char *)e->data + str.sh_offset + n, name,
+                                           str.sh_size - n) == 0) {
+                *addr = v;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*! \brief The string at an address of the image, as the ELF has it
+    \return NULL if no loaded section holds a whole string there
+*/
+static const char *string_at(const sim_elf_t *e, uint64_t addr) {
+    Elf64_Shdr sh;
+    for (uint32_t i = 0; section(e, i, &sh); i++) {
+        if (!(sh.sh_flags & SHF_ALLOC) || sh.sh_type == SHT_NOBITS || addr < sh.sh_addr ||
+            addr - sh.sh_addr >= sh.sh_size || !in_file(e, sh.sh_offset, sh.sh_size))
+            continue;
+        const char *s = (const char *)e->data + sh.sh_offset + (addr - sh.sh_addr);
+        const char *end = (const char *)e->data + sh.sh_offset + sh.sh_size;
+        return memchr(s, 0, end - s) ? s : NULL;
+    }
+    return NULL;
+}
+
+static bool elf_load(sim_elf_t *e, const char *path) {
+    memset(e, 0, sizeof(*e));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    rewind(f);
+    e->data = malloc(len > 0 ? len : 1);
+    e->len = e->data && len > 0 ? fread(e->data, 1, len, f) : 0;
+    fclose(f);
+    if (e->len < sizeof(Elf64_Ehdr) || memcmp(e->data, ELFMAG, SELFMAG) != 0 ||
+        (e->data[EI_CLASS] != ELFCLASS32 && e->data[EI_CLASS] != ELFCLASS64) ||
+        e->data[EI_DATA] != ELFDATA2LSB || !sections(e)) {
+        fprintf(stderr, "%s: not a little-endian ELF with sections\n", path);
+        free(e->data);
+        return false;
+    }
+    if (!symbol(e, "dlog_anchor", &e->anchor)) {
+        fprintf(stderr, "%s: no dlog_anchor symbol (stripped, or built without dlog.c?)\n", path);
+        free(e->data);
+        return false;
+    }
+    return true;
+}
+
+/*! \brief printf() one record's format with its raw words, as the device would
+    Arguments are 32 bits, as on the RP2350: l and z take one word, ll
+    takes two (low first), %s a DLOG_STR() distance from dlog_anchor.
+    \return false if a string was not in the ELF or arguments ran short
+*/
+static bool format(FILE *out, const sim_elf_t *e, const char *fmt, const uint32_t *arg,
+                   uint32_t n) {
+    bool ok = true;
+    uint32_t a = 0;
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            fputc(*p, out);
+            continue;
+        }
+        // Flags, width and precision go to fprintf() as they are
+        char spec[32] = "%";
+        size_t len = 1;
+        p++;
+        while (*p && strchr("-+ #0123456789.", *p) && len < sizeof(spec) - 4)
+            spec[len++] = *p++;
+        uint32_t longs = 0;
+        while (*p && strchr("hlzjt", *p)) {
+            if (*p == 'h' && len < sizeof(spec) - 4)
+                spec[len++] = 'h';
+            longs += *p == 'l';
+            p++;
+        }
+        char conv = *p;
+        if (!conv)
+            break;
+        if (conv == '%') {
+            fputc('%', out);
+            continue;
+        }
+        uint32_t words = longs >= 2 && strchr("diuxXo", conv) ? 2 : 1;
+        if (a + words > n) {
+            fprintf(out, "<?>");
+            ok = false;
+            continue;
+        }
+        uint64_t v = arg[a];
+        if (words == 2)
+            v |= (uint64_t)arg[a + 1] << 32;
+        a += words;
+        if (words == 2) {
+            spec[len++] = 'l';
+            spec[len++] = 'l';
+        }
+        spec[len++] = conv == 'p' ? 'x' : conv;
+        spec[len] = 0;
+        switch (conv) {
+        case 'd':
+        case 'i':
+            if (words == 2)
+                fprintf(out, spec, (long long)v);
+            else
+                fprintf(out, spec, (int32_t)v);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            if (words == 2)
+                fprintf(out, spec, (unsigned long long)v);
+            else
+                fprintf(out, spec, (uint32_t)v);
+            break;
+        case 'c':
+            fprintf(out, spec, (int)v);
+            break;
+        case 'p':
+            fputs("0x", out);
+            fprintf(out, spec, (uint32_t)v);
+            break;
+        case 's': {
+            const char *s = string_at(e, e->anchor + (int64_t)(int32_t)v);
+            if (!s)
+                ok = false;
+            fprintf(out, spec, s ? s : "<?>");
+            break;
+        }
+        default:
+            // Floats and the like are not loggable
+            fprintf(out, "<%%%c?>", conv);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+typedef struct {
+    uint32_t records;
+    uint32_t lost;
+    uint32_t bad;               ///< records whose strings were not in the ELF
+} sim_dlog_stats_t;
+
+/*! \brief Decode every "dlog:" line of a log
+    \param stamps prefix each record with its core and time
+*/
+static sim_dlog_stats_t decode(FILE *in, FILE *out, const sim_elf_t *e, bool stamps) {
+    sim_dlog_stats_t st = { 0 };
+    // Runtime address of dlog_anchor minus its ELF address; 0 until a "@"
+    uint64_t bias = 0;
+    bool have_bias = false;
+    char line[SIM_DLOG_LINE];
+    while (fgets(line, sizeof(line), in)) {
+        char *p = strstr(line, "dlog: ");
+        if (!p)
+            continue;
+        p += 6;
+        char *end;
+        if (*p == '@') {
+            bias = strtoull(p + 1, NULL, 16) - e->anchor;
+            have_bias = true;
+            continue;
+        }
+        if (strncmp(p, "lost", 4) == 0) {
+            uint32_t lost = (uint32_t)strtoul(p + 4, NULL, 16);
+            st.lost += lost;
+            fprintf(out, "%s(%u records lost)\n", stamps ? "- - " : "", (unsigned)lost);
+            continue;
+        }
+        unsigned core = (unsigned)strtoul(p, &end, 16);
+        uint64_t w[2 + DLOG_MAX_ARGS];
+        uint32_t words = 0;
+        for (p = end; words < 2 + DLOG_MAX_ARGS; words++) {
+            w[words] = strtoull(p, &end, 16);
+            if (end == p)
+                break;
+            p = end;
+        }
+        if (end == line + 6 || words < 2)
+            continue;
+        uint32_t arg[DLOG_MAX_ARGS];
+        for (uint32_t i = 2; i < words; i++)
+            arg[i - 2] = (uint32_t)w[i];
+        st.records++;
+        if (stamps)
+            fprintf(out, "%u %u.%06u ", core, (unsigned)(w[0] / 1000000),
+                    (unsigned)(w[0] % 1000000));
+        const char *fmt = have_bias ? string_at(e, w[1] - bias) : NULL;
+        if (!fmt) {
+            fprintf(out, "<format %llx not in the ELF>\n", (unsigned long long)w[1]);
+            st.bad++;
+            continue;
+        }
+        if (!format(out, e, fmt, arg, words - 2))
+            st.bad++;
+        size_t fl = strlen(fmt);
+        if (!fl || fmt[fl - 1] != '\n')
+            fputc('\n', out);
+    }
+    return st;
+}
+
+static int decode_cmd(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: dlog decode <elf> <log> [out]\n");
+        return 1;
+    }
+    sim_elf_t e;
+    if (!elf_load(&e, argv[1]))
+        return 1;
+    FILE *in = fopen(argv[2], "r");
+    FILE *out = argc > 3 ? fopen(argv[3], "w") : stdout;
+    if (!in || !out) {
+        perror(in ? argv[3] : argv[2]);
+        if (in)
+            fclose(in);
+        free(e.data);
+        return 1;
+    }
+    sim_dlog_stats_t st = decode(in, out, &e, true);
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+    free(e.data);
+    fprintf(stderr, "dlog decode: %u records, %u lost, %u not decoded\n", (unsigned)st.records,
+            (unsigned)st.lost, (unsigned)st.bad);
+    return st.bad != 0;
+}
+
+// The drain task's output, captured
+static FILE *captured;
+
+static void sink_capture(const char *s, uint32_t len) {
+    fwrite(s, 1, len, captured);
+}
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static double host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*! \brief Decode what was captured so far, and forget it
+    \param text decoded lines without stamps, caller frees
+*/
+static sim_dlog_stats_t decode_captured(const sim_elf_t *e, char **raw, size_t *raw_len,
+                                        char **text) {
+    fflush(captured);
+    FILE *in = fmemopen(*raw, *raw_len ? *raw_len : 1, "r");
+    size_t text_len;
+    FILE *out = open_memstream(text, &text_len);
+    sim_dlog_stats_t st = decode(in, out, e, false);
+    fclose(in);
+    fclose(out);
+    rewind(captured);
+    return st;
+}
+
+static int check(int argc, char *argv[]) {
+    uint32_t ms = argc > 1 ? (uint32_t)atoi(argv[1]) : 3000;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    sim_elf_t e;
+    if (!elf_load(&e, "/proc/self/exe"))
+        return 1;
+    char *raw = NULL;
+    size_t raw_len = 0;
+    captured = open_memstream(&raw, &raw_len);
+    dlog_set_sink(sink_capture);
+    sim_clock_reset();
+    dlog_reset();
+
+    // Cost of a call on the host; the channel is emptied before it fills
+    const uint32_t calls = 1u << 22;
+    double t0 = host_ns();
+    for (uint32_t i = 0; i < calls; i++) {
+        DLOG("Note %u lane %u grade %d offset %d\n", i, i & 15, 1, -3);
+        if ((i & (DLOG_DEPTH / 2 - 1)) == DLOG_DEPTH / 2 - 1)
+            dlog_reset();
+    }
+    double ns = (host_ns() - t0) / calls;
+    dlog_reset();
+
+    // Known messages: decoded text against snprintf()
+    static char want[SIM_DLOG_CASES][128];
+    uint32_t cases = 0;
+#define SIM_DLOG_CASE(...)                                                      \
+    do {                                                                        \
+        DLOG(__VA_ARGS__);                                                      \
+        snprintf(want[cases++], sizeof(want[0]), __VA_ARGS__);                  \
+    } while (0)
+    SIM_DLOG_CASE("plain\n");
+    SIM_DLOG_CASE("%u %d %x %X %o\n", 7u, -5, 0xbeefu, 0xc0deu, 8u);
+    SIM_DLOG_CASE("%08x|%-4d|%+d|%5u|%c\n", 0x1234u, 12, 3, 42u, 'k');
+    SIM_DLOG_CASE("100%% %u %u %u %u %u %u\n", 1u, 2u, 3u, 4u, 5u, 6u);
+    SIM_DLOG_CASE("no newline %u", 9u);
+#undef SIM_DLOG_CASE
+    uint64_t big = 0x0123456789abcdefull;
+    int64_t neg = -1234567890123ll;
+    DLOG("%llx %llu\n", DLOG_U64(big), DLOG_U64(big));
+    snprintf(want[cases++], sizeof(want[0]), "%llx %llu\n", (unsigned long long)big,
+             (unsigned long long)big);
+    DLOG("%lld %u\n", DLOG_U64(neg), 5u);
+    snprintf(want[cases++], sizeof(want[0]), "%lld %u\n", (long long)neg, 5u);
+    DLOG("%s=%-6s|\n", DLOG_STR("lane"), DLOG_STR("hold"));
+    snprintf(want[cases++], sizeof(want[0]), "%s=%-6s|\n", "lane", "hold");
+    dlog_drain(DLOG_DEPTH);
+    char *text = NULL;
+    sim_dlog_stats_t st = decode_captured(&e, &raw, &raw_len, &text);
+    uint32_t wrong = st.records == cases ? 0 : cases;
+    const char *p = text;
+    for (uint32_t i = 0; i < cases && !wrong; i++) {
+        size_t wl = strlen(want[i]);
+        bool nl = wl && want[i][wl - 1] == '\n';
+        if (strncmp(p, want[i], wl) != 0 || (!nl && p[wl] != '\n')) {
+            fprintf(stderr, "dlog: case %u decoded as \"%.*s\", want \"%s\"\n", (unsigned)i,
+                    (int)strcspn(p, "\n"), p, want[i]);
+            wrong++;
+        }
+        p = strchr(p, '\n');
+        p = p ? p + 1 : "";
+    }
+    free(text);
+
+    // A round with the drain task writing as on the device
+    sim_clock_reset();
+    dlog_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    dlog_start();
+    game_set_observer(stress_on_judge);
+    game_init();
+    stress_start(STRESS_AUTOPLAY, seed, sink_seesaw);
+    uint64_t stop = time_us_64() + (uint64_t)ms * 1000;
+    while (!game_finished() && time_us_64() < stop)
+        game_step();
+    stress_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+    dlog_drain(2 * DLOG_DEPTH);
+    dlog_set_sink(NULL);
+    fclose(captured);
+    FILE *in = fmemopen(raw, raw_len ? raw_len : 1, "r");
+    sim_dlog_stats_t round = decode(in, stdout, &e, true);
+    fclose(in);
+    free(raw);
+    free(e.data);
+
+    bool ok = !wrong && !st.bad && round.records && !round.bad && !round.lost;
+    fprintf(stderr, "dlog: %.1f ns host per call, %u/%u messages decoded as snprintf, "
+                    "round %u records %u lost %u not decoded %s\n",
+            ns, (unsigned)(cases - wrong), (unsigned)cases, (unsigned)round.records,
+            (unsigned)round.lost, (unsigned)round.bad, ok ? "OK" : "FAILED");
+    return !ok;
+}
+
+int cmd_dlog(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "decode") == 0) return decode_cmd(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "check") == 0) return check(argc - 1, argv + 1);
+    fprintf(stderr, "usage: dlog decode <elf> <log> [out] | check [ms] [seed]\n");
+    return 1;
+}
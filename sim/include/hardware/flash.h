@@ -0,0 +1,18 @@
+// Host stand-in for hardware/flash.h: a RAM flash model (sim/sim_flash.c)
+// with NOR semantics, erase to 0xFF and programming that only clears bits
+#ifndef SIM_HARDWARE_FLASH_H
+#define SIM_HARDWARE_FLASH_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_PAGE_SIZE 256u
+#define FLASH_SECTOR_SIZE 4096u
+#define PICO_FLASH_SIZE_BYTES (256u * 1024u)
+
+// Reads go through the XIP window, here the model's memory
+extern uint8_t sim_flash_mem[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)sim_flash_mem)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+#endif
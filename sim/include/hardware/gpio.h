@@ -0,0 +1,16 @@
+// Host stand-in for hardware/gpio.h; pin setup is a no-op in the simulator
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+#include <stdint.h>
+#include <stdbool.h>
+
+enum { GPIO_FUNC_SPI = 1, GPIO_FUNC_I2C = 3, GPIO_FUNC_PWM = 4, GPIO_FUNC_SIO = 5 };
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+static inline void gpio_set_function(unsigned int gpio, int fn) { (void)gpio; (void)fn; }
+static inline void gpio_pull_up(unsigned int gpio) { (void)gpio; }
+static inline void gpio_init(unsigned int gpio) { (void)gpio; }
+static inline void gpio_set_dir(unsigned int gpio, bool out) { (void)gpio; (void)out; }
+static inline void gpio_put(unsigned int gpio, bool value) { (void)gpio; (void)value; }
+#endif
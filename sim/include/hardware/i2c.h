@@ -0,0 +1,15 @@
+// Host stand-in for hardware/i2c.h; transactions go to the simulated Seesaw
+#ifndef SIM_HARDWARE_I2C_H
+#define SIM_HARDWARE_I2C_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t *const sim_i2c0;
+#define i2c0 sim_i2c0
+
+unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+#endif
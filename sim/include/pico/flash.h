@@ -0,0 +1,17 @@
+// Host stand-in for pico/flash.h; there is no other core to lock out
+#ifndef SIM_PICO_FLASH_H
+#define SIM_PICO_FLASH_H
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef PICO_OK
+#define PICO_OK 0
+#endif
+
+static inline int flash_safe_execute(void (*func)(void *), void *param, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    func(param);
+    return PICO_OK;
+}
+static inline bool flash_safe_execute_core_init(void) { return true; }
+#endif
@@ -0,0 +1,31 @@
+// Host stand-in for the Pico SDK's pico/stdlib.h (native build only)
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+typedef unsigned int uint;
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// Everything runs from RAM on the host
+#define __not_in_flash_func(f) f
+#define __no_inline_not_in_flash_func(f) f
+#define __not_in_flash(group)
+
+// The game and its scheduler run on core0; sim_render.c stands in for
+// core1 and switches this over while its alarm runs
+extern uint sim_core_num;
+static inline uint get_core_num(void) { return sim_core_num; }
+
+static inline void tight_loop_contents(void) {}
+static inline bool stdio_init_all(void) { return true; }
+#endif
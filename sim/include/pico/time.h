@@ -0,0 +1,35 @@
+// Host stand-in for pico/time.h, backed by the simulator's virtual clock
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_clock.h"
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+typedef struct sim_alarm_pool alarm_pool_t;
+
+static inline absolute_time_t get_absolute_time(void) { return sim_clock_now_us(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline uint64_t time_us_64(void) { return sim_clock_now_us(); }
+static inline uint32_t time_us_32(void) { return (uint32_t)sim_clock_now_us(); }
+static inline void sleep_us(uint64_t us) { sim_clock_advance_us(us); }
+static inline void sleep_ms(uint32_t ms) { sim_clock_advance_us((uint64_t)ms * 1000); }
+static inline void busy_wait_us(uint64_t us) { sim_clock_advance_us(us); }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+// Nothing else runs on the virtual clock, so the wait always lasts to t
+static inline bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    if (t > sim_clock_now_us()) sim_clock_advance_us(t - sim_clock_now_us());
+    return true;
+}
+
+// Alarms fire from sim_clock_advance_us() once the virtual clock reaches them
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(unsigned max_timers);
+alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time,
+                                   alarm_callback_t callback, void *user_data,
+                                   bool fire_if_past);
+bool alarm_pool_cancel_alarm(alarm_pool_t *pool, alarm_id_t alarm_id);
+#endif
@@ -0,0 +1,152 @@
+/* sim judge: scripted judgement cases
+    Each case builds a small chart, plays presses and releases at exact
+    offsets from the notes straight into judge.c, and checks the grades,
+    misses and stats that come out. Exit status is the number of failures.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "chart.h"
+#include "judge.h"
+#include "sim_cmds.h"
+
+#define RATE 48000
+#define MS(x) ((int64_t)(x) * RATE / 1000)
+#define NOTE(t_ms, lanes_, hold_ms) { (uint32_t)MS(t_ms), (uint32_t)MS(hold_ms), (lanes_) }
+
+typedef enum { PRESS, RELEASE, UPDATE } step_kind_t;
+
+typedef struct {
+    step_kind_t kind;
+    uint8_t lane;
+    int64_t at_ms;
+} step_t;
+
+typedef struct {
+    const char *name;
+    chart_note_t notes[8];
+    uint32_t n_notes;
+    step_t steps[12];
+    uint32_t n_steps;
+    const char *expect;     // one letter per event: P G O(good) M(iss) S(tray) K(ept) D(ropped)
+    uint32_t max_combo;
+} judge_case_t;
+
+static char got[64];
+static int n_got;
+
+static void on_event(const judge_event_t *ev) {
+    static const char grade_ch[JUDGE_GRADES] = { 'P', 'G', 'O', 'M' };
+    char c = '?';
+    switch (ev->kind) {
+    case JUDGE_EV_HIT: c = grade_ch[ev->grade]; break;
+    case JUDGE_EV_MISS: c = 'M'; break;
+    case JUDGE_EV_HOLD_OK: c = 'K'; break;
+    case JUDGE_EV_HOLD_DROP: c = 'D'; break;
+    case JUDGE_EV_STRAY: c = 'S'; break;
+    }
+    if (n_got < (int)sizeof(got) - 1)
+        got[n_got++] = c;
+}
+
+// Default windows: perfect 33 ms, great 66 ms, good 100 ms
+static const judge_case_t cases[] = {
+    { "on time", { NOTE(1000, 1, 0) }, 1, { { PRESS, 0, 1000 } }, 1, "P", 1 },
+    { "perfect edge", { NOTE(1000, 1, 0), NOTE(2000, 1, 0) }, 2,
+      { { PRESS, 0, 1000 - 33 }, { PRESS, 0, 2000 + 33 } }, 2, "PP", 2 },
+    { "great late", { NOTE(1000, 1, 0) }, 1, { { PRESS, 0, 1045 } }, 1, "G", 1 },
+    { "good early", { NOTE(1000, 1, 0) }, 1, { { PRESS, 0, 920 } }, 1, "O", 1 },
+    { "too early", { NOTE(1000, 1, 0) }, 1,
+      { { PRESS, 0, 850 }, { UPDATE, 0, 1200 } }, 2, "SM", 0 },
+    { "too late", { NOTE(1000, 1, 0) }, 1, { { PRESS, 0, 1101 } }, 1, "MS", 0 },
+    { "good edge", { NOTE(1000, 1, 0) }, 1, { { PRESS, 0, 1100 } }, 1, "O", 1 },
+    { "no press", { NOTE(1000, 1, 0), NOTE(1500, 2, 0) }, 2,
+      { { UPDATE, 0, 2000 } }, 1, "MM", 0 },
+    { "wrong lane", { NOTE(1000, 1, 0) }, 1,
+      { { PRESS, 1, 1000 }, { UPDATE, 0, 1200 } }, 2, "SM", 0 },
+    { "chord", { NOTE(1000, 0x9, 0) }, 1,
+      { { PRESS, 0, 1000 }, { PRESS, 3, 1050 } }, 2, "PG", 2 },
+    { "half chord", { NOTE(1000, 0x9, 0) }, 1,
+      { { PRESS, 3, 1000 }, { UPDATE, 0, 1200 } }, 2, "PM", 1 },
+    { "nearest note", { NOTE(1000, 1, 0), NOTE(1120, 1, 0) }, 2,
+      { { PRESS, 0, 1090 }, { UPDATE, 0, 1300 } }, 2, "PM", 1 },
+    { "oldest first", { NOTE(1000, 1, 0), NOTE(1120, 1, 0) }, 2,
+      { { PRESS, 0, 1050 }, { PRESS, 0, 1120 } }, 2, "GP", 2 },
+    { "combo break", { NOTE(1000, 1, 0), NOTE(1500, 1, 0), NOTE(2000, 1, 0), NOTE(2500, 1, 0) }, 4,
+      { { PRESS, 0, 1000 }, { PRESS, 0, 1500 }, { PRESS, 0, 2500 } }, 3, "PPMP", 2 },
+    { "hold kept", { NOTE(1000, 1, 500) }, 1,
+      { { PRESS, 0, 1010 }, { RELEASE, 0, 1450 } }, 2, "PK", 1 },
+    { "hold to end", { NOTE(1000, 1, 500) }, 1,
+      { { PRESS, 0, 1000 }, { UPDATE, 0, 1500 }, { RELEASE, 0, 1600 } }, 3, "PK", 1 },
+    { "hold dropped", { NOTE(1000, 1, 500), NOTE(2000, 1, 0) }, 2,
+      { { PRESS, 0, 1000 }, { RELEASE, 0, 1200 }, { PRESS, 0, 2000 } }, 3, "PDP", 1 },
+};
+
+static int run_case(const judge_case_t *c) {
+    static uint8_t img[sizeof(chart_header_t) + 8 * sizeof(chart_note_t)] __attribute__((aligned(8)));
+    uint32_t len = chart_write(img, sizeof(img), 16, RATE, c->notes, c->n_notes);
+    chart_t chart;
+    if (chart_open(&chart, img, len) != CHART_OK) {
+        printf("FAIL %-14s chart rejected\n", c->name);
+        return 1;
+    }
+    n_got = 0;
+    judge_init(&chart, NULL, on_event);
+    for (uint32_t i = 0; i < c->n_steps; i++) {
+        uint64_t at = (uint64_t)MS(c->steps[i].at_ms);
+        if (c->steps[i].kind == PRESS) judge_press(c->steps[i].lane, at);
+        else if (c->steps[i].kind == RELEASE) judge_release(c->steps[i].lane, at);
+        else judge_update(at);
+    }
+    // Let every window close
+    judge_update((uint64_t)MS(60000));
+    got[n_got] = 0;
+
+    judge_stats_t st;
+    judge_get_stats(&st);
+    bool ok = strcmp(got, c->expect) == 0 && st.max_combo == c->max_combo;
+    printf("%s %-14s events %-6s (want %-6s) max combo %u (want %u)\n", ok ? "ok  " : "FAIL",
+           c->name, got, c->expect, (unsigned)st.max_combo, (unsigned)c->max_combo);
+    return ok ? 0 : 1;
+}
+
+// Offsets and accuracy over a whole chart
+static int run_stats(void) {
+    static chart_note_t notes[100];
+    static uint8_t img[sizeof(chart_header_t) + sizeof(notes)] __attribute__((aligned(8)));
+    for (int i = 0; i < 100; i++) {
+        notes[i].time = (uint32_t)MS(1000 + i * 250);
+        notes[i].lanes = 1ull << (i % 16);
+        notes[i].hold = 0;
+    }
+    uint32_t len = chart_write(img, sizeof(img), 16, RATE, notes, 100);
+    chart_t chart;
+    chart_open(&chart, img, len);
+    judge_init(&chart, NULL, NULL);
+    // 50 perfect at +10 ms, 30 great at -50 ms, 10 good at +90 ms, 10 missed
+    for (int i = 0; i < 90; i++) {
+        int off = i < 50 ? 10 : i < 80 ? -50 : 90;
+        judge_press(i % 16, notes[i].time + MS(off));
+    }
+    judge_update((uint64_t)MS(60000));
+    judge_stats_t st;
+    judge_get_stats(&st);
+    int64_t bias_us = st.offset_sum * 1000000 / 90 / RATE;
+    uint32_t acc = judge_accuracy_permille(&st);
+    // (50*1000 + 30*700 + 10*400) / 100 = 750
+    bool ok = st.count[JUDGE_PERFECT] == 50 && st.count[JUDGE_GREAT] == 30 &&
+              st.count[JUDGE_GOOD] == 10 && st.count[JUDGE_MISS] == 10 && acc == 750 &&
+              bias_us > -1200 && bias_us < -1000;
+    printf("%s %-14s accuracy %u permille (want 750), bias %+d us (want ~-1111)\n",
+           ok ? "ok  " : "FAIL", "accuracy", (unsigned)acc, (int)bias_us);
+    return ok ? 0 : 1;
+}
+
+int cmd_judge(int argc, char *argv[]) {
+    int fails = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        fails += run_case(&cases[i]);
+    fails += run_stats();
+    printf("%d failed\n", fails);
+    return fails;
+}
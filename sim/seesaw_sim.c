@@ -0,0 +1,332 @@
+/* Host-side Seesaw/NeoTrellis simulator
+    Models the register map the driver in src/neotrellis.c talks to: keypad
+    event config, COUNT/FIFO fed from a script of timed key edges, and the
+    NeoPixel PIN/SPEED/BUF_LENGTH/BUF/SHOW registers with a 16 pixel output.
+    Every transaction moves the virtual clock forward by its time on a
+    400 kHz bus, so drivers can be compared by bytes and microseconds.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "neotrellis.h"
+#include "seesaw_sim.h"
+
+#define PICO_ERROR_GENERIC (-2)
+
+struct i2c_inst { int unused; };
+static struct i2c_inst i2c0_inst;
+i2c_inst_t *const sim_i2c0 = &i2c0_inst;
+
+typedef struct {
+    uint8_t ptr_base;
+    uint8_t ptr_reg;
+    uint64_t ptr_us;            // when the address phase finished
+    uint8_t key_edges[64];      // raw key number -> enabled edge mask
+    uint8_t intenset;
+
+    uint8_t fifo[SIM_SEESAW_FIFO_LEN];
+    uint64_t fifo_us[SIM_SEESAW_FIFO_LEN];
+    uint8_t fifo_head;
+    uint8_t fifo_count;
+
+    uint8_t pin;
+    uint8_t speed;
+    uint16_t buf_len;
+    uint8_t buf[SIM_SEESAW_PIXEL_BYTES];
+    sim_pixel_t out[SIM_SEESAW_NUM_KEYS];
+    uint32_t shows;
+    uint64_t last_show_us;
+} board_t;
+
+typedef struct {
+    uint64_t at_us;
+    uint8_t board;
+    uint8_t key;
+    bool press;
+} script_ev_t;
+
+static board_t boards[SIM_SEESAW_MAX_BOARDS];
+static int num_boards = 1;
+
+static script_ev_t script[SIM_SEESAW_MAX_SCRIPT];
+static int script_len = 0;
+static int script_pos = 0;
+
+static sim_bus_stats_t bus;
+
+// Logical key (row major 4x4) to the Seesaw's 8-wide key numbering
+static inline uint8_t raw_key(uint8_t key) {
+    return (key / 4) * 8 + (key % 4);
+}
+
+static board_t *board_at(uint8_t addr) {
+    int i = addr - NEOTRELLIS_ADDR;
+    if (i < 0 || i >= num_boards) return NULL;
+    return &boards[i];
+}
+
+static void bus_time(size_t bytes) {
+    uint64_t ns = bytes * SIM_I2C_BYTE_NS + SIM_I2C_XFER_OVERHEAD_NS;
+    uint64_t us = (ns + 999) / 1000;
+    bus.wire_bytes += bytes;
+    bus.bus_us += us;
+    sim_clock_advance_us(us);
+}
+
+static void fifo_push(board_t *b, uint8_t key, uint8_t edge, uint64_t at_us) {
+    uint8_t raw = raw_key(key);
+    if (!(b->key_edges[raw] & (1 << edge)))
+        return;
+    if (b->fifo_count == SIM_SEESAW_FIFO_LEN) {
+        bus.events_dropped++;
+        return;
+    }
+    int i = (b->fifo_head + b->fifo_count) % SIM_SEESAW_FIFO_LEN;
+    keyEvent e = { edge, raw };
+    memcpy(&b->fifo[i], &e, 1);
+    b->fifo_us[i] = at_us;
+    b->fifo_count++;
+}
+
+// Move every scripted edge that is due into the board FIFOs
+static void pump_script(void) {
+    uint64_t now = sim_clock_now_us();
+    while (script_pos < script_len && script[script_pos].at_us <= now) {
+        script_ev_t *ev = &script[script_pos++];
+        fifo_push(&boards[ev->board], ev->key,
+                  ev->press ? SEESAW_KEYPAD_EDGE_RISING : SEESAW_KEYPAD_EDGE_FALLING,
+                  ev->at_us);
+    }
+}
+
+/*! \brief Reset every board and the script
+    \param n number of boards, answering at NEOTRELLIS_ADDR onwards
+*/
+void sim_seesaw_reset(int n) {
+    memset(boards, 0, sizeof(boards));
+    num_boards = n < 1 ? 1 : (n > SIM_SEESAW_MAX_BOARDS ? SIM_SEESAW_MAX_BOARDS : n);
+    script_len = 0;
+    script_pos = 0;
+    sim_seesaw_reset_bus_stats();
+}
+
+/*! \brief Schedule a key edge
+    \param board board index
+    \param at_us virtual time of the edge
+    \param key logical key 0-15 on that board
+    \param press true for a press (rising), false for a release (falling)
+    \return 0 on success, -1 if the script is full
+*/
+int sim_seesaw_script_key(int board, uint64_t at_us, uint8_t key, bool press) {
+    if (script_len == SIM_SEESAW_MAX_SCRIPT || board >= SIM_SEESAW_MAX_BOARDS ||
+        key >= SIM_SEESAW_NUM_KEYS)
+        return -1;
+
+    // Keep the script sorted; callers mostly append in order
+    int i = script_len++;
+    while (i > script_pos && script[i - 1].at_us > at_us) {
+        script[i] = script[i - 1];
+        i--;
+    }
+    script[i] = (script_ev_t){ at_us, (uint8_t)board, key, press };
+    return 0;
+}
+
+/*! \brief Schedule a press and its release
+*/
+int sim_seesaw_script_tap(int board, uint64_t at_us, uint8_t key, uint32_t hold_us) {
+    if (sim_seesaw_script_key(board, at_us, key, true) < 0) return -1;
+    return sim_seesaw_script_key(board, at_us + hold_us, key, false);
+}
+
+/*! \brief Number of scripted edges not yet delivered
+*/
+int sim_seesaw_script_pending(void) {
+    return script_len - script_pos;
+}
+
+/*! \brief Put a key edge in a FIFO right now
+*/
+void sim_seesaw_inject(int board, uint8_t key, bool press) {
+    if (board >= num_boards || key >= SIM_SEESAW_NUM_KEYS) return;
+    pump_script();
+    fifo_push(&boards[board], key,
+              press ? SEESAW_KEYPAD_EDGE_RISING : SEESAW_KEYPAD_EDGE_FALLING,
+              sim_clock_now_us());
+}
+
+static void reg_write(board_t *b, uint8_t base, uint8_t reg, const uint8_t *d, size_t n) {
+    if (base == SEESAW_KEYPAD_BASE) {
+        if (reg == SEESAW_KEYPAD_EVENT && n >= 2) {
+            union keyState ks;
+            ks.reg = d[1];
+            if (d[0] < 64) {
+                if (ks.bit.STATE)
+                    b->key_edges[d[0]] |= ks.bit.ACTIVE;
+                else
+                    b->key_edges[d[0]] &= ~ks.bit.ACTIVE;
+            }
+        } else if (reg == SEESAW_KEYPAD_INTENSET && n >= 1) {
+            b->intenset |= d[0];
+        } else if (reg == SEESAW_KEYPAD_INTENCLR && n >= 1) {
+            b->intenset &= ~d[0];
+        }
+    } else if (base == SEESAW_NEOPIXEL_BASE) {
+        switch (reg) {
+        case SEESAW_NEOPIXEL_PIN:
+            if (n >= 1) b->pin = d[0];
+            break;
+        case SEESAW_NEOPIXEL_SPEED:
+            if (n >= 1) b->speed = d[0];
+            break;
+        case SEESAW_NEOPIXEL_BUF_LENGTH:
+            if (n >= 2) b->buf_len = (d[0] << 8) | d[1];
+            break;
+        case SEESAW_NEOPIXEL_BUF:
+            if (n >= 2) {
+                uint16_t off = (d[0] << 8) | d[1];
+                for (size_t i = 2; i < n && off < sizeof(b->buf) && off < b->buf_len; i++)
+                    b->buf[off++] = d[i];
+                bus.buf_writes++;
+            }
+            break;
+        case SEESAW_NEOPIXEL_SHOW:
+            for (int i = 0; i < SIM_SEESAW_NUM_KEYS; i++) {
+                b->out[i].g = b->buf[i * 3];
+                b->out[i].r = b->buf[i * 3 + 1];
+                b->out[i].b = b->buf[i * 3 + 2];
+            }
+            b->shows++;
+            b->last_show_us = sim_clock_now_us();
+            bus.shows++;
+            break;
+        }
+    }
+}
+
+unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate) {
+    (void)i2c;
+    return baudrate;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    (void)i2c;
+    (void)nostop;
+    bus.writes++;
+    board_t *b = board_at(addr);
+    if (!b) {
+        bus_time(1);
+        bus.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    bus_time(len + 1);
+    pump_script();
+
+    if (len >= 2) {
+        b->ptr_base = src[0];
+        b->ptr_reg = src[1];
+        b->ptr_us = sim_clock_now_us();
+        reg_write(b, src[0], src[1], src + 2, len - 2);
+    }
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    (void)i2c;
+    (void)nostop;
+    bus.reads++;
+    board_t *b = board_at(addr);
+    uint64_t now = sim_clock_now_us();
+    if (!b) {
+        bus_time(1);
+        bus.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    if (b->ptr_base == SEESAW_KEYPAD_BASE &&
+        now - b->ptr_us < SIM_SEESAW_KEYPAD_TURNAROUND_US) {
+        bus_time(1);
+        bus.nacks++;
+        bus.turnaround_violations++;
+        return PICO_ERROR_GENERIC;
+    }
+    bus_time(len + 1);
+    pump_script();
+    now = sim_clock_now_us();
+
+    memset(dst, 0xFF, len);
+    if (b->ptr_base == SEESAW_KEYPAD_BASE && b->ptr_reg == SEESAW_KEYPAD_COUNT) {
+        if (len) dst[0] = b->fifo_count;
+    } else if (b->ptr_base == SEESAW_KEYPAD_BASE && b->ptr_reg == SEESAW_KEYPAD_FIFO) {
+        for (size_t i = 0; i < len && b->fifo_count; i++) {
+            dst[i] = b->fifo[b->fifo_head];
+            uint32_t lat = (uint32_t)(now - b->fifo_us[b->fifo_head]);
+            bus.events_delivered++;
+            bus.event_latency_sum_us += lat;
+            if (lat > bus.event_latency_max_us)
+                bus.event_latency_max_us = lat;
+            b->fifo_head = (b->fifo_head + 1) % SIM_SEESAW_FIFO_LEN;
+            b->fifo_count--;
+        }
+    } else if (b->ptr_base == SEESAW_NEOPIXEL_BASE && b->ptr_reg == SEESAW_NEOPIXEL_BUF_LENGTH) {
+        if (len >= 2) {
+            dst[0] = b->buf_len >> 8;
+            dst[1] = b->buf_len & 0xFF;
+        }
+    }
+    return (int)len;
+}
+
+const sim_pixel_t *sim_seesaw_pixels(int board) {
+    return boards[board].out;
+}
+
+uint8_t sim_seesaw_pin(int board) {
+    return boards[board].pin;
+}
+
+uint8_t sim_seesaw_speed(int board) {
+    return boards[board].speed;
+}
+
+uint16_t sim_seesaw_buf_length(int board) {
+    return boards[board].buf_len;
+}
+
+bool sim_seesaw_edge_enabled(int board, uint8_t key, uint8_t edge) {
+    return boards[board].key_edges[raw_key(key)] & (1 << edge);
+}
+
+uint32_t sim_seesaw_shows(int board) {
+    return boards[board].shows;
+}
+
+uint64_t sim_seesaw_last_show_us(int board) {
+    return boards[board].last_show_us;
+}
+
+void sim_seesaw_get_bus_stats(sim_bus_stats_t *out) {
+    *out = bus;
+}
+
+void sim_seesaw_reset_bus_stats(void) {
+    memset(&bus, 0, sizeof(bus));
+}
+
+/*! \brief Print bus traffic and key event latency
+    \param elapsed_us virtual time the numbers cover, for utilization
+*/
+void sim_seesaw_print_bus_stats(uint64_t elapsed_us) {
+    uint32_t util_pm = elapsed_us ? (uint32_t)(bus.bus_us * 1000 / elapsed_us) : 0;
+    uint32_t avg = bus.events_delivered ?
+                   (uint32_t)(bus.event_latency_sum_us / bus.events_delivered) : 0;
+    printf("  bus: %u writes, %u reads, %llu bytes, %llu us busy (%u.%u%%), %u nacks\n",
+           (unsigned)bus.writes, (unsigned)bus.reads,
+           (unsigned long long)bus.wire_bytes, (unsigned long long)bus.bus_us,
+           (unsigned)(util_pm / 10), (unsigned)(util_pm % 10), (unsigned)bus.nacks);
+    printf("  leds: %u buf writes, %u shows\n", (unsigned)bus.buf_writes, (unsigned)bus.shows);
+    printf("  keys: %u delivered, %u dropped, latency avg %u us max %u us\n",
+           (unsigned)bus.events_delivered, (unsigned)bus.events_dropped,
+           (unsigned)avg, (unsigned)bus.event_latency_max_us);
+}
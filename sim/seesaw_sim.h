@@ -0,0 +1,59 @@
+#ifndef SEESAW_SIM_H
+#define SEESAW_SIM_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulated Seesaw/NeoTrellis boards behind the host i2c_*_blocking() calls.
+// Boards answer at consecutive addresses starting at NEOTRELLIS_ADDR.
+
+#define SIM_SEESAW_MAX_BOARDS 4
+#define SIM_SEESAW_NUM_KEYS 16
+#define SIM_SEESAW_FIFO_LEN 32
+#define SIM_SEESAW_MAX_SCRIPT 4096
+#define SIM_SEESAW_PIXEL_BYTES (SIM_SEESAW_NUM_KEYS * 3)
+
+// Bus model: 400 kHz, 9 clocks per byte, plus START/STOP
+#define SIM_I2C_BYTE_NS 22500
+#define SIM_I2C_XFER_OVERHEAD_NS 5000
+
+// Minimum time between the register address phase and the read for the
+// keypad module; a read issued sooner is NACKed like the real firmware does
+#define SIM_SEESAW_KEYPAD_TURNAROUND_US 250
+
+typedef struct {
+    uint8_t r, g, b;
+} sim_pixel_t;
+
+typedef struct {
+    uint32_t writes;
+    uint32_t reads;
+    uint64_t wire_bytes;        ///< bytes on the wire including address bytes
+    uint64_t bus_us;            ///< time the bus was driven
+    uint32_t nacks;             ///< unknown address or read too early
+    uint32_t turnaround_violations;
+    uint32_t buf_writes;
+    uint32_t shows;
+    uint32_t events_delivered;
+    uint32_t events_dropped;    ///< keypad FIFO overflowed
+    uint64_t event_latency_sum_us;
+    uint32_t event_latency_max_us; ///< key edge to FIFO read
+} sim_bus_stats_t;
+
+void sim_seesaw_reset(int boards);
+int sim_seesaw_script_key(int board, uint64_t at_us, uint8_t key, bool press);
+int sim_seesaw_script_tap(int board, uint64_t at_us, uint8_t key, uint32_t hold_us);
+int sim_seesaw_script_pending(void);
+void sim_seesaw_inject(int board, uint8_t key, bool press);
+
+const sim_pixel_t *sim_seesaw_pixels(int board);
+uint8_t sim_seesaw_pin(int board);
+uint8_t sim_seesaw_speed(int board);
+uint16_t sim_seesaw_buf_length(int board);
+bool sim_seesaw_edge_enabled(int board, uint8_t key, uint8_t edge);
+uint32_t sim_seesaw_shows(int board);
+uint64_t sim_seesaw_last_show_us(int board);
+
+void sim_seesaw_get_bus_stats(sim_bus_stats_t *out);
+void sim_seesaw_reset_bus_stats(void);
+void sim_seesaw_print_bus_stats(uint64_t elapsed_us);
+#endif
@@ -0,0 +1,430 @@
+/* sim session: headless game sessions on the virtual clock
+    Runs core0's game loop (minigame, I2C scheduler, Seesaw) against a
+    scripted player, as fast as the host allows. Core1's frames are left
+    out: they read the game's snapshot and change no judgement, and their
+    alarms would cost the batch most of its speed ('sim cores' has them).
+    A player is a seed: per note it presses each key with some timing
+    error, misses now and then, lets go of holds early now and then, and
+    adds stray presses.
+
+    Every round is recorded (replay.c); a batch plays every 100th log back
+    and checks the judgement comes out the same.
+
+    session <count> [seed] [jobs]   batch; prints the score spread and host cost
+    session trace [seed]            one session with its judgement/score trace
+    session record <seed> <file>    one session, replay log written to file
+    replay <file> [times]           play a replay log back headless
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "chart.h"
+#include "judge.h"
+#include "evsched.h"
+#include "replay.h"
+#include "seesaw_sim.h"
+#include "sim_cmds.h"
+
+// Song starts this long after boot, as in main()
+#define SESSION_SONG_START_US 500000
+
+typedef struct {
+    uint32_t seed;
+    int score;
+    judge_stats_t judge;
+    uint64_t trace_hash;
+    uint32_t steps;
+    double step_ns;         ///< host time spent in game_step(), from a sample
+} session_result_t;
+
+static bool tracing = false;
+static uint64_t trace_hash;
+
+static uint32_t rng;
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Roughly normal, mean 0, sd 1 (sum of 4 uniforms)
+static double rng_norm(void) {
+    double s = 0;
+    for (int i = 0; i < 4; i++)
+        s += (rng_next() & 0xFFFF) / 65536.0;
+    return (s - 2.0) * 1.732;
+}
+
+static double host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void hash_mix(uint64_t v) {
+    // FNV-1a over the bytes of v
+    for (int i = 0; i < 8; i++) {
+        trace_hash ^= (v >> (i * 8)) & 0xFF;
+        trace_hash *= 0x100000001B3ull;
+    }
+}
+
+static void on_judge(const judge_event_t *ev) {
+    static const char *kind[] = { "hit", "miss", "hold ok", "hold drop", "stray" };
+    static const char *grade[] = { "perfect", "great", "good", "miss" };
+    uint64_t now = sim_clock_now_us();
+    hash_mix(now);
+    hash_mix(((uint64_t)ev->kind << 56) | ((uint64_t)ev->grade << 48) |
+             ((uint64_t)ev->lane << 40) | ev->note);
+    hash_mix((uint64_t)(int64_t)ev->offset);
+    hash_mix((uint64_t)game_get_combo());
+    if (tracing) {
+        printf("%9.3f ms  note %3u lane %2u  %-9s %-7s %+7d us  combo %d\n",
+               (double)song_clock_us() / 1000, (unsigned)ev->note, ev->lane, kind[ev->kind],
+               ev->kind == JUDGE_EV_HIT ? grade[ev->grade] : "",
+               (int)((int64_t)ev->offset * 1000000 / CHART_SAMPLE_RATE), game_get_combo());
+    }
+}
+
+static void tap(uint64_t at_us, int key, uint32_t hold_us) {
+    sim_seesaw_script_tap(key / NEO_TRELLIS_KEYS_PER_BOARD, at_us,
+                          key % NEO_TRELLIS_KEYS_PER_BOARD, hold_us);
+}
+
+// Script one player for the whole chart
+static void script_player(const chart_t *chart, uint64_t song0_us) {
+    // Player skill for this seed: timing spread 15..55 ms, bias -20..+20 ms
+    double sd_ms = 15 + rng_next() % 41;
+    double bias_ms = (int)(rng_next() % 41) - 20;
+    uint32_t miss_pct = rng_next() % 15;
+    for (uint32_t i = 0; i < chart->count; i++) {
+        const chart_note_t *n = &chart->notes[i];
+        uint64_t at = song0_us + (uint64_t)n->time * 1000000 / chart->rate;
+        uint32_t hold_us = n->hold ? (uint32_t)((uint64_t)n->hold * 1000000 / chart->rate) : 0;
+        uint64_t lanes = n->lanes;
+        while (lanes) {
+            int key = __builtin_ctzll(lanes);
+            lanes &= lanes - 1;
+            if (rng_next() % 100 < miss_pct) continue;
+            int64_t off = (int64_t)((bias_ms + rng_norm() * sd_ms) * 1000);
+            uint32_t held = hold_us ? hold_us : 60000 + rng_next() % 60000;
+            if (hold_us && rng_next() % 10 == 0)
+                held = hold_us / 3; // lets go early
+            tap((uint64_t)((int64_t)at + off), key, held);
+        }
+        if (rng_next() % 50 == 0)
+            tap(at + 200000, rng_next() % chart->lanes, 50000);
+    }
+}
+
+// Host cost of one host_ns() reading
+static double clock_ns = 0;
+
+static void calibrate_clock(void) {
+    double t0 = host_ns();
+    for (int i = 0; i < 1000; i++)
+        host_ns();
+    clock_ns = (host_ns() - t0) / 1001;
+}
+
+// Boot, start the song and the game
+static uint64_t session_start(uint32_t seed, replay_t *replay) {
+    sim_clock_reset();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+
+    sleep_us(SESSION_SONG_START_US);
+    song_clock_start(CHART_SAMPLE_RATE);
+    uint64_t song0 = sim_clock_now_us();
+
+    trace_hash = 0xCBF29CE484222325ull;
+    evsched_init();
+    game_set_observer(on_judge);
+    game_set_seed(seed);
+    game_set_replay(replay);
+    game_init();
+    return song0;
+}
+
+static void run_session(uint32_t seed, session_result_t *res) {
+    rng = seed ? seed : 1;
+    uint64_t song0 = session_start(seed, NULL);
+    script_player(game_chart(), song0);
+
+    uint32_t steps = 0;
+    double step_ns = 0;
+    uint32_t timed = 0;
+    while (!game_finished()) {
+        // Reading the host clock costs about as much as a step; sample 1 in 16
+        // and take off what the reading itself costs
+        if (steps % 16 == 0) {
+            double t = host_ns();
+            game_step();
+            step_ns += host_ns() - t - clock_ns;
+            timed++;
+        } else {
+            game_step();
+        }
+        steps++;
+    }
+    song_clock_stop();
+    game_set_observer(NULL);
+
+    res->seed = seed;
+    res->score = game_get_combo();
+    judge_get_stats(&res->judge);
+    res->trace_hash = trace_hash;
+    res->steps = steps;
+    res->step_ns = timed ? step_ns * steps / timed : 0;
+}
+
+/*! \brief Play a replay log back headless
+    \param r opened replay
+    \param st judgement of the played-back round
+    \return final combo
+*/
+static int run_replay(replay_t *r, judge_stats_t *st) {
+    session_start(r->hdr->seed, r);
+    while (!game_finished())
+        game_step();
+    song_clock_stop();
+    game_set_observer(NULL);
+    game_set_replay(NULL);
+    judge_get_stats(st);
+    return game_get_combo();
+}
+
+// Judgement of a replay matches the round it was recorded from
+static bool replay_matches(const judge_stats_t *a, int score_a, const judge_stats_t *b, int score_b) {
+    return score_a == score_b && memcmp(a, b, sizeof(*a)) == 0;
+}
+
+// Game and driver printf output would swamp a batch
+static int quiet_begin(void) {
+    fflush(stdout);
+    int saved = dup(1);
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+        dup2(null, 1);
+        close(null);
+    }
+    return saved;
+}
+
+static void quiet_end(int saved) {
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, 1);
+        close(saved);
+    }
+}
+
+static int record(uint32_t seed, const char *path) {
+    session_result_t r;
+    int q = quiet_begin();
+    run_session(seed, &r);
+    quiet_end(q);
+    uint32_t len = 0;
+    replay_log(&len);
+    replay_err_t err = replay_save_file(path);
+    if (err != REPLAY_OK) {
+        printf("%s: %s\n", path, replay_strerror(err));
+        return 1;
+    }
+    printf("seed %u: combo %d, max combo %u, %u bytes written to %s\n", (unsigned)seed, r.score,
+           (unsigned)r.judge.max_combo, (unsigned)len, path);
+    return 0;
+}
+
+int cmd_replay(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: replay <file> [times]\n");
+        return 1;
+    }
+    uint32_t times = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+    if (!times) times = 1;
+    replay_t rp;
+    replay_err_t err = replay_load_file(&rp, argv[1]);
+    if (err != REPLAY_OK) {
+        printf("%s: %s\n", argv[1], replay_strerror(err));
+        return 1;
+    }
+    const replay_header_t *h = rp.hdr;
+    printf("%s: seed %u, chart %08x, %u events in %u bytes\n", argv[1], (unsigned)h->seed,
+           (unsigned)h->chart_crc, (unsigned)h->events, (unsigned)h->bytes);
+
+    judge_stats_t st;
+    int score = 0;
+    uint64_t virt_us = 0;
+    int q = quiet_begin();
+    double t0 = host_ns();
+    for (uint32_t i = 0; i < times; i++) {
+        score = run_replay(&rp, &st);
+        virt_us += sim_clock_now_us();
+    }
+    double wall = host_ns() - t0;
+    quiet_end(q);
+
+    uint32_t acc = judge_accuracy_permille(&st);
+    bool same = score == h->score && st.max_combo == h->max_combo && acc == h->accuracy;
+    printf("recorded: combo %d, max combo %u, accuracy %u.%u%%\n", (int)h->score,
+           (unsigned)h->max_combo, (unsigned)(h->accuracy / 10), (unsigned)(h->accuracy % 10));
+    printf("replayed: combo %d, max combo %u, accuracy %u.%u%% -> %s\n", score,
+           (unsigned)st.max_combo, (unsigned)(acc / 10), (unsigned)(acc % 10),
+           same ? "same" : "DIFFERENT");
+    printf("%u replay(s) in %.3f s, %.0fx real time\n", (unsigned)times, wall / 1e9,
+           (double)virt_us * 1000 / wall);
+    replay_close(&rp);
+    return same ? 0 : 1;
+}
+
+static int trace(uint32_t seed) {
+    session_result_t r, again;
+    tracing = true;
+    run_session(seed, &r);
+    tracing = false;
+    int q = quiet_begin();
+    run_session(seed, &again);
+    quiet_end(q);
+    uint32_t acc = judge_accuracy_permille(&r.judge);
+    printf("seed %u: combo %d, max combo %u, accuracy %u.%u%%, trace %016llx, rerun %s\n",
+           (unsigned)seed, r.score, (unsigned)r.judge.max_combo, (unsigned)(acc / 10),
+           (unsigned)(acc % 10), (unsigned long long)r.trace_hash,
+           again.trace_hash == r.trace_hash ? "identical" : "DIFFERENT");
+    return again.trace_hash == r.trace_hash ? 0 : 1;
+}
+
+typedef struct {
+    uint32_t acc_hist[11];
+    uint64_t steps;
+    uint64_t virt_us;
+    double step_ns;
+    uint32_t max_combo;
+    uint32_t nondet;
+    uint32_t replay_bad;    ///< replays that did not reproduce their round
+    uint64_t hash;          ///< XOR of per-session hashes, same for any job count
+} batch_t;
+
+// Sessions first, first + stride, ... below count
+static void run_batch(uint32_t seed, uint32_t count, uint32_t first, uint32_t stride, batch_t *b) {
+    memset(b, 0, sizeof(*b));
+    for (uint32_t i = first; i < count; i += stride) {
+        session_result_t r;
+        run_session(seed + i, &r);
+        b->virt_us += sim_clock_now_us();
+        b->steps += r.steps;
+        b->step_ns += r.step_ns;
+        b->acc_hist[judge_accuracy_permille(&r.judge) / 100]++;
+        if (r.judge.max_combo > b->max_combo) b->max_combo = r.judge.max_combo;
+        b->hash ^= r.trace_hash + i;
+        // Every 100th session is run twice and played back from its
+        // replay log; all three must come out the same
+        if (i % 100 == 0) {
+            session_result_t again;
+            uint32_t len;
+            const uint8_t *log = replay_log(&len);
+            static uint8_t copy[REPLAY_LOG_BYTES] __attribute__((aligned(4)));
+            replay_t rp;
+            judge_stats_t st;
+            if (!log || replay_open(&rp, memcpy(copy, log, len), len) != REPLAY_OK ||
+                !replay_matches(&r.judge, r.score, &st, run_replay(&rp, &st)))
+                b->replay_bad++;
+            run_session(seed + i, &again);
+            if (again.trace_hash != r.trace_hash) b->nondet++;
+        }
+    }
+}
+
+// Sessions share no state across processes, so jobs > 1 forks workers
+static int run_jobs(uint32_t seed, uint32_t count, uint32_t jobs, batch_t *total) {
+    if (jobs <= 1) {
+        run_batch(seed, count, 0, 1, total);
+        return 0;
+    }
+    int fds[64];
+    for (uint32_t j = 0; j < jobs; j++) {
+        int p[2];
+        if (pipe(p) < 0) return -1;
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) return -1;
+        if (pid == 0) {
+            batch_t b;
+            close(p[0]);
+            run_batch(seed, count, j, jobs, &b);
+            ssize_t w = write(p[1], &b, sizeof(b));
+            _exit(w == (ssize_t)sizeof(b) ? 0 : 1);
+        }
+        close(p[1]);
+        fds[j] = p[0];
+    }
+    memset(total, 0, sizeof(*total));
+    int rc = 0;
+    for (uint32_t j = 0; j < jobs; j++) {
+        batch_t b;
+        if (read(fds[j], &b, sizeof(b)) != (ssize_t)sizeof(b)) rc = -1;
+        close(fds[j]);
+        for (int k = 0; k < 11; k++) total->acc_hist[k] += b.acc_hist[k];
+        total->steps += b.steps;
+        total->virt_us += b.virt_us;
+        total->step_ns += b.step_ns;
+        if (b.max_combo > total->max_combo) total->max_combo = b.max_combo;
+        total->nondet += b.nondet;
+        total->replay_bad += b.replay_bad;
+        total->hash ^= b.hash;
+    }
+    while (wait(NULL) > 0) {}
+    return rc;
+}
+
+int cmd_session(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "trace") == 0)
+        return trace(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1);
+    if (argc > 3 && strcmp(argv[1], "record") == 0)
+        return record((uint32_t)strtoul(argv[2], NULL, 0), argv[3]);
+
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    uint32_t jobs = argc > 3 ? (uint32_t)atoi(argv[3]) : 1;
+    if (!count) count = 1;
+    if (jobs > 64) jobs = 64;
+
+    batch_t b;
+    calibrate_clock();
+    int q = quiet_begin();
+    double t0 = host_ns();
+    int rc = run_jobs(seed, count, jobs, &b);
+    double wall = host_ns() - t0;
+    quiet_end(q);
+    if (rc < 0) {
+        printf("worker failed\n");
+        return 1;
+    }
+
+    printf("%u sessions, %u job(s), %.2f s: %.0f sessions/s, %.0fx real time\n", (unsigned)count,
+           (unsigned)(jobs ? jobs : 1), wall / 1e9, count / (wall / 1e9),
+           (double)b.virt_us * 1000 / wall);
+    printf("game_step: %.0f ns host per call, %llu calls, %.1f%% of the CPU time\n",
+           b.step_ns / b.steps, (unsigned long long)b.steps,
+           100.0 * b.step_ns / (wall * (jobs ? jobs : 1)));
+    printf("accuracy:");
+    for (int k = 0; k <= 10; k++)
+        printf(" %d%%:%u", k * 10, (unsigned)b.acc_hist[k]);
+    printf("\nmax combo %u, batch hash %016llx, %u nondeterministic reruns, %u bad replays\n",
+           (unsigned)b.max_combo, (unsigned long long)b.hash, (unsigned)b.nondet,
+           (unsigned)b.replay_bad);
+    return b.nondet || b.replay_bad ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+/* Host stand-in for the PWM/DMA song playback (src/pwm.c)
+    No samples are played; starting the song only restarts the song clock
+    at the chart rate, the way the first DMA buffer does on the device.
+*/
+
+#include "songclock.h"
+#include "chart.h"
+#include "audio.h"
+
+static bool playing = false;
+
+void audio_init(const uint8_t *pcm, uint32_t samples) {
+    (void)pcm;
+    (void)samples;
+}
+
+void audio_service(void) {
+}
+
+void audio_play(void) {
+    song_clock_stop();
+    song_clock_start(CHART_SAMPLE_RATE);
+    playing = true;
+}
+
+uint32_t audio_click(uint32_t period_ms, bool audible) {
+    (void)audible;
+    audio_play();
+    return CHART_SAMPLE_RATE * period_ms / 1000;
+}
+
+void audio_stop(void) {
+    song_clock_stop();
+    playing = false;
+}
+
+void audio_set_volume(uint16_t permille) {
+    (void)permille;
+}
+
+uint32_t audio_sample_rate(void) {
+    return CHART_SAMPLE_RATE;
+}
+
+bool audio_playing(void) {
+    return playing;
+}
+
+bool audio_idle(void) {
+    return !playing;
+}
@@ -0,0 +1,115 @@
+#include <stddef.h>
+#include "pico/time.h"
+#include "sim_clock.h"
+
+#define SIM_MAX_ALARMS 16
+
+typedef struct {
+    alarm_id_t id;          // 0 = free slot
+    uint64_t at_us;
+    alarm_callback_t cb;
+    void *user_data;
+} sim_alarm_t;
+
+struct sim_alarm_pool {
+    int unused;
+};
+
+static uint64_t now_us = 0;
+static sim_alarm_t alarms[SIM_MAX_ALARMS];
+static alarm_id_t next_id = 1;
+static bool in_alarm = false;
+static uint64_t next_alarm_us = UINT64_MAX; // earliest armed alarm
+static struct sim_alarm_pool pool;
+
+uint64_t sim_clock_now_us(void) {
+    return now_us;
+}
+
+static sim_alarm_t *earliest_due(uint64_t until_us) {
+    sim_alarm_t *best = NULL;
+    for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+        if (alarms[i].id && alarms[i].at_us <= until_us &&
+            (!best || alarms[i].at_us < best->at_us))
+            best = &alarms[i];
+    }
+    return best;
+}
+
+static void update_next_alarm(void) {
+    next_alarm_us = UINT64_MAX;
+    for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+        if (alarms[i].id && alarms[i].at_us < next_alarm_us)
+            next_alarm_us = alarms[i].at_us;
+    }
+}
+
+// Like a hardware alarm IRQ: an alarm interrupts whatever the caller was
+// doing at its due time, but never nests inside another alarm callback
+void sim_clock_advance_us(uint64_t us) {
+    uint64_t target = now_us + us;
+    if (!in_alarm && target >= next_alarm_us) {
+        sim_alarm_t *a;
+        while ((a = earliest_due(target)) != NULL) {
+            if (a->at_us > now_us)
+                now_us = a->at_us;
+            alarm_id_t id = a->id;
+            alarm_callback_t cb = a->cb;
+            void *user_data = a->user_data;
+            a->id = 0;
+            update_next_alarm();
+            in_alarm = true;
+            cb(id, user_data); // one-shot: repeat requests are not modelled
+            in_alarm = false;
+        }
+    }
+    if (target > now_us)
+        now_us = target;
+}
+
+void sim_clock_reset(void) {
+    now_us = 0;
+    for (int i = 0; i < SIM_MAX_ALARMS; i++)
+        alarms[i].id = 0;
+    next_alarm_us = UINT64_MAX;
+}
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(unsigned max_timers) {
+    (void)max_timers;
+    return &pool;
+}
+
+alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *p, absolute_time_t time,
+                                   alarm_callback_t callback, void *user_data,
+                                   bool fire_if_past) {
+    (void)p;
+    if (time <= now_us) {
+        if (!fire_if_past) return 0;
+        callback(0, user_data);
+        return 0;
+    }
+    for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+        if (!alarms[i].id) {
+            alarms[i].id = next_id++;
+            if (next_id <= 0) next_id = 1;
+            alarms[i].at_us = time;
+            alarms[i].cb = callback;
+            alarms[i].user_data = user_data;
+            update_next_alarm();
+            return alarms[i].id;
+        }
+    }
+    return -1;
+}
+
+bool alarm_pool_cancel_alarm(alarm_pool_t *p, alarm_id_t alarm_id) {
+    (void)p;
+    for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+        if (alarm_id && alarms[i].id == alarm_id) {
+            alarms[i].id = 0;
+            update_next_alarm();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,10 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+#include <stdint.h>
+
+// Virtual microsecond clock used by the host build. Nothing sleeps for real:
+// sleep_us()/sleep_ms() and simulated bus transactions just move it forward.
+uint64_t sim_clock_now_us(void);
+void sim_clock_advance_us(uint64_t us);
+void sim_clock_reset(void);
+#endif
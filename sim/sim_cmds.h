@@ -0,0 +1,26 @@
+#ifndef SIM_CMDS_H
+#define SIM_CMDS_H
+
+// Host simulator commands, one per bench/tool; see sim_main.c
+int cmd_driver(int argc, char *argv[]);
+int cmd_bus(int argc, char *argv[]);
+int cmd_tiles(int argc, char *argv[]);
+int cmd_overlap(int argc, char *argv[]);
+int cmd_beat(int argc, char *argv[]);
+int cmd_chart(int argc, char *argv[]);
+int cmd_judge(int argc, char *argv[]);
+int cmd_session(int argc, char *argv[]);
+int cmd_replay(int argc, char *argv[]);
+int cmd_stress(int argc, char *argv[]);
+int cmd_flow(int argc, char *argv[]);
+int cmd_boot(int argc, char *argv[]);
+int cmd_calib(int argc, char *argv[]);
+int cmd_kv(int argc, char *argv[]);
+int cmd_chan(int argc, char *argv[]);
+int cmd_snapshot(int argc, char *argv[]);
+int cmd_cores(int argc, char *argv[]);
+int cmd_sched(int argc, char *argv[]);
+int cmd_trace(int argc, char *argv[]);
+int cmd_dlog(int argc, char *argv[]);
+int cmd_perfmon(int argc, char *argv[]);
+#endif
@@ -0,0 +1,102 @@
+/* RAM flash model behind the host hardware/flash.h
+    Erase sets whole sectors to 0xFF, programming ANDs whole pages in (it
+    can only clear bits), misaligned calls are refused like the boot ROM
+    asserts would, and both take typical QSPI flash time on the virtual
+    clock.
+
+    sim_flash_cut_after() pulls the power during a later call: that call
+    gets only part way through its bytes, and every call after it does
+    nothing until sim_flash_power_on().
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+
+// Typical times of a 16 Mbit QSPI part (W25Q16): 4 KB erase, 256 B program
+#define SIM_FLASH_ERASE_US 45000
+#define SIM_FLASH_PROGRAM_US 400
+
+uint8_t sim_flash_mem[PICO_FLASH_SIZE_BYTES];
+static sim_flash_stats_t stats;
+static int32_t ops_left = -1;       // calls before the power cut, -1 = none
+static uint32_t cut_permille = 0;
+static bool dead = false;
+
+// True if this call must not run; a cut call does the first *count bytes
+static bool power_cut(size_t *count) {
+    if (dead)
+        return true;
+    if (ops_left < 0 || ops_left-- > 0)
+        return false;
+    ops_left = -1;
+    dead = true;
+    stats.cuts++;
+    *count = *count * cut_permille / 1000;
+    return false;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        printf("sim flash: bad erase 0x%x+%zu\n", (unsigned)flash_offs, count);
+        stats.bad_calls++;
+        return;
+    }
+    size_t done = count;
+    if (power_cut(&done))
+        return;
+    for (size_t s = 0; s < count; s += FLASH_SECTOR_SIZE) {
+        // A cut erase leaves the sector part erased
+        size_t n = done > s ? MIN(done - s, FLASH_SECTOR_SIZE) : 0;
+        memset(&sim_flash_mem[flash_offs + s], 0xFF, n);
+        stats.erases[(flash_offs + s) / FLASH_SECTOR_SIZE]++;
+        sim_clock_advance_us(SIM_FLASH_ERASE_US);
+    }
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        printf("sim flash: bad program 0x%x+%zu\n", (unsigned)flash_offs, count);
+        stats.bad_calls++;
+        return;
+    }
+    size_t done = count;
+    if (power_cut(&done))
+        return;
+    for (size_t i = 0; i < done; i++)
+        sim_flash_mem[flash_offs + i] &= data[i];
+    stats.programs += count / FLASH_PAGE_SIZE;
+    sim_clock_advance_us(SIM_FLASH_PROGRAM_US * (count / FLASH_PAGE_SIZE));
+}
+
+// Blank flash, as shipped
+void sim_flash_reset(void) {
+    memset(sim_flash_mem, 0xFF, sizeof(sim_flash_mem));
+    memset(&stats, 0, sizeof(stats));
+    sim_flash_power_on();
+}
+
+/*! \brief Cut the power during a later erase or program
+    \param ops calls that still complete; the one after them is cut
+    \param permille how far through its bytes the cut call gets
+*/
+void sim_flash_cut_after(uint32_t ops, uint32_t permille) {
+    ops_left = (int32_t)ops;
+    cut_permille = permille > 1000 ? 1000 : permille;
+    dead = false;
+}
+
+// Power back: calls work again, no cut pending
+void sim_flash_power_on(void) {
+    ops_left = -1;
+    dead = false;
+}
+
+void sim_flash_get_stats(sim_flash_stats_t *out) {
+    *out = stats;
+}
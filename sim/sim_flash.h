@@ -0,0 +1,19 @@
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+#include <stdint.h>
+#include "hardware/flash.h"
+
+#define SIM_FLASH_SECTORS (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t erases[SIM_FLASH_SECTORS];     ///< per sector
+    uint32_t programs;                      ///< pages
+    uint32_t bad_calls;                     ///< misaligned or out of range
+    uint32_t cuts;                          ///< power cuts injected
+} sim_flash_stats_t;
+
+void sim_flash_reset(void);
+void sim_flash_get_stats(sim_flash_stats_t *out);
+void sim_flash_cut_after(uint32_t ops, uint32_t permille);
+void sim_flash_power_on(void);
+#endif
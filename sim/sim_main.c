@@ -0,0 +1,60 @@
+/* Host simulator entry point (pio run -e native)
+    Runs the firmware's driver and game code against the simulated Seesaw
+    and a virtual clock. Each command is a self-contained bench or tool.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "sim_flash.h"
+#include "sim_cmds.h"
+
+typedef struct {
+    const char *name;
+    int (*fn)(int argc, char *argv[]);
+    const char *help;
+} sim_cmd_t;
+
+static const sim_cmd_t cmds[] = {
+    { "driver", cmd_driver, "keypad/NeoPixel round trip through the simulated Seesaw" },
+    { "bus", cmd_bus, "[render_us] [budget_us] I2C scheduler under a worst-case LED workload" },
+    { "tiles", cmd_tiles, "keypad latency and LED frame rate for 1, 2 and 4 boards" },
+    { "overlap", cmd_overlap, "[render_us] split-phase keypad reads vs blocking reads" },
+    { "beat", cmd_beat, "[render_us] [secs] minigame beat SHOW time vs the song clock" },
+    { "chart", cmd_chart, "gen|check|bench chart generator, validator and loader benchmark" },
+    { "judge", cmd_judge, "scripted presses at exact offsets through the judgement engine" },
+    { "session", cmd_session, "[count] [seed] [jobs] | trace [seed] | record <seed> <file> headless game sessions, scripted players" },
+    { "replay", cmd_replay, "<file> [times] play a recorded round back headless, check the score" },
+    { "stress", cmd_stress, "[autoplay|storm|both] [render_us] [seed] [driver] input latency under synthetic load" },
+    { "flow", cmd_flow, "[rounds] [seed] attract/countdown/play/results with instant restarts" },
+    { "boot", cmd_boot, "boot init graph on the virtual clock, boot to first beat" },
+    { "calib", cmd_calib, "[audio_ms] [visual_ms] [jitter_ms] [seed] latency calibration, scripted player" },
+    { "kv", cmd_kv, "[writes] settings store: remount, wear spread, power cuts during a commit" },
+    { "chan", cmd_chan, "[messages] [depth] inter-core channels: two threads, ordering and throughput" },
+    { "snapshot", cmd_snapshot, "[writes] game-state snapshot: torn reads, renderer redraws in a round" },
+    { "cores", cmd_cores, "[render_us] [seed] one core for game and LCD vs game+audio / render split" },
+    { "sched", cmd_sched, "[blit_us] [secs] core1 tasks: blocking blit vs DMA waits, run time and deadline misses" },
+    { "trace", cmd_trace, "round [ms] [seed] [render_us] | json <dump> [out.json] event trace, Chrome trace JSON" },
+    { "dlog", cmd_dlog, "decode <elf> <log> [out] | check [ms] [seed] deferred log lines back to text" },
+    { "perfmon", cmd_perfmon, "[render_us] [slow_us] [seed] stats overlay over a round, frame warning when slow" },
+};
+
+static void usage(const char *prog) {
+    printf("usage: %s <command> [args]\n", prog);
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+        printf("  %-10s %s\n", cmds[i].name, cmds[i].help);
+}
+
+int main(int argc, char *argv[]) {
+    // Flash starts blank, as shipped
+    sim_flash_reset();
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+        if (strcmp(argv[1], cmds[i].name) == 0)
+            return cmds[i].fn(argc - 1, argv + 1);
+    }
+    usage(argv[0]);
+    return 1;
+}
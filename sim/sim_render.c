@@ -0,0 +1,69 @@
+/* Host stand-in for the core1 render loop (render_frame() in main.c)
+    Every frame_us the frame on screen is reported and the next one starts
+    from a fresh game snapshot, redrawing the combo if its version moved.
+    The alarm counts as core1 (get_core_num()), so its trace events go to
+    core1's ring.
+*/
+
+#include "pico/stdlib.h"
+#include "minigame.h"
+#include "render.h"
+#include "trace.h"
+#include "sim_render.h"
+
+// The render loop's gap between frames
+#define SIM_RENDER_GAP_US 40
+
+uint sim_core_num = 0;
+
+static alarm_pool_t *pool = NULL;
+static alarm_id_t alarm = 0;
+static uint32_t frame_us = 0;
+static uint64_t frame_start = 0;
+static uint32_t drawn_version = 0;
+static bool redrawn = false;
+
+static int64_t frame_done(alarm_id_t id, void *user_data) {
+    uint64_t now = time_us_64();
+    sim_core_num = 1;
+    TRACE_ASYNC_END(TRACE_BLIT, 0);
+    TRACE_ASYNC_END(TRACE_FRAME, redrawn);
+    render_report(frame_start, now, redrawn);
+    // Next frame
+    frame_start = now + SIM_RENDER_GAP_US;
+    game_snapshot_t snap;
+    game_snapshot(&snap);
+    redrawn = snap.version != drawn_version;
+    drawn_version = snap.version;
+    TRACE_ASYNC_BEGIN(TRACE_FRAME, 0);
+    TRACE_ASYNC_BEGIN(TRACE_BLIT, 0);
+    sim_core_num = 0;
+    alarm = alarm_pool_add_alarm_at(pool, from_us_since_boot(frame_start + frame_us), frame_done,
+                                    NULL, true);
+    return 0;
+}
+
+/*! \brief Start rendering; call after sim_clock_reset()
+    \param us length of a frame (the blit)
+*/
+void sim_render_start(uint32_t us) {
+    if (!pool)
+        pool = alarm_pool_create_with_unused_hardware_alarm(1);
+    frame_us = us ? us : 1;
+    frame_start = time_us_64();
+    drawn_version = 0;
+    redrawn = false;
+    render_reset_stats();
+    sim_core_num = 1;
+    TRACE_ASYNC_BEGIN(TRACE_FRAME, 0);
+    TRACE_ASYNC_BEGIN(TRACE_BLIT, 0);
+    sim_core_num = 0;
+    alarm = alarm_pool_add_alarm_at(pool, from_us_since_boot(frame_start + frame_us), frame_done,
+                                    NULL, true);
+}
+
+void sim_render_stop(void) {
+    if (alarm > 0)
+        alarm_pool_cancel_alarm(pool, alarm);
+    alarm = 0;
+}
@@ -0,0 +1,11 @@
+#ifndef SIM_RENDER_H
+#define SIM_RENDER_H
+#include <stdint.h>
+
+// core1 as the firmware runs it: frames back to back, each taking the game
+// snapshot at its start and reporting itself to core0 (render.c) at its
+// end. Frames are alarms on the virtual clock, so they take no time from
+// the game's tasks; only what crosses between the cores is modelled.
+void sim_render_start(uint32_t frame_us);
+void sim_render_stop(void);
+#endif
@@ -0,0 +1,225 @@
+/* sim trace: event trace of a round and the Chrome trace converter
+    round  plays ms of an autoplay + storm round with core1 rendering
+           beside it, prints the trace dump as the device does for 't',
+           and checks that every core's begin / end events nest. Also
+           times trace_put() on the host.
+    json   turns a dump (a serial log with "trace:" lines in it, or the
+           output of round) into Chrome trace JSON for chrome://tracing
+           or ui.perfetto.dev. Times are unwrapped per core (time_us_32()
+           wraps every 71 minutes).
+
+    trace round [ms] [seed] [render_us]
+    trace json <dump> [out.json]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "minigame.h"
+#include "evsched.h"
+#include "stress.h"
+#include "trace.h"
+#include "seesaw_sim.h"
+#include "sim_render.h"
+#include "sim_cmds.h"
+
+// Open begin events per core the nesting check follows
+#define SIM_TRACE_STACK 32
+
+#ifdef TRACE
+
+static void sink_seesaw(uint8_t key, bool press) {
+    sim_seesaw_inject(neotrellis_key_board(key), neotrellis_key_local(key), press);
+}
+
+static double host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*! \brief Check that B/E events nest on every core and time never goes back
+    Events from before the oldest kept one may be missing, so an end with
+    nothing open is taken as cut off; an end that closes something else is
+    an error.
+    \return events that do not fit
+*/
+static uint32_t check_nesting(void) {
+    uint32_t bad = 0;
+    for (int c = 0; c < TRACE_CORES; c++) {
+        const trace_ring_t *r = &trace_rings[c];
+        uint32_t from = r->head > TRACE_DEPTH ? r->head - TRACE_DEPTH : 0;
+        uint8_t stack[SIM_TRACE_STACK];
+        int depth = 0;
+        uint32_t last_t = 0;
+        for (uint32_t i = from; i < r->head; i++) {
+            const trace_event_t *e = &r->ev[i & (TRACE_DEPTH - 1)];
+            if (i > from && (int32_t)(e->t_us - last_t) < 0)
+                bad++;
+            last_t = e->t_us;
+            if (e->ph == 'B') {
+                if (depth == SIM_TRACE_STACK)
+                    bad++;
+                else
+                    stack[depth++] = e->id;
+            } else if (e->ph == 'E' && depth) {
+                if (stack[--depth] != e->id)
+                    bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+static int round_dump(int argc, char *argv[]) {
+    uint32_t ms = argc > 1 ? (uint32_t)atoi(argv[1]) : 3000;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    uint32_t render_us = argc > 3 ? (uint32_t)atoi(argv[3]) : 10500;
+
+    sim_clock_reset();
+    trace_init();
+    sim_seesaw_reset(NEO_TRELLIS_NUM_BOARDS);
+    init_i2c();
+    init_neopixels();
+    song_clock_start(CHART_SAMPLE_RATE);
+    evsched_init();
+    game_set_observer(stress_on_judge);
+    game_init();
+    sim_render_start(render_us);
+    stress_start(STRESS_AUTOPLAY | STRESS_STORM, seed, sink_seesaw);
+    uint64_t stop = time_us_64() + (uint64_t)ms * 1000;
+    while (!game_finished() && time_us_64() < stop)
+        game_step();
+    stress_stop();
+    sim_render_stop();
+    game_set_observer(NULL);
+    song_clock_stop();
+
+    uint32_t bad = check_nesting();
+    uint32_t events[TRACE_CORES];
+    for (int c = 0; c < TRACE_CORES; c++)
+        events[c] = trace_rings[c].head;
+    trace_dump();
+
+    // Recording cost on the host, into a ring nobody reads
+    const uint32_t puts = 1u << 22;
+    trace_init();
+    double t0 = host_ns();
+    for (uint32_t i = 0; i < puts; i++)
+        TRACE_INSTANT(TRACE_TASK, i);
+    double ns = (host_ns() - t0) / puts;
+    trace_init();
+
+    fprintf(stderr, "trace: %u ms, %u events on core0, %u on core1, %u out of order, "
+                    "%.1f ns host per event %s\n",
+            (unsigned)ms, (unsigned)events[0], (unsigned)events[1], (unsigned)bad, ns,
+            bad ? "FAILED" : "OK");
+    return bad != 0;
+}
+#else
+static int round_dump(int argc, char *argv[]) {
+    fprintf(stderr, "trace round: built without -DTRACE\n");
+    return 1;
+}
+#endif
+
+/*! \brief Parse one "trace: ev" line
+    \return true if it is one
+*/
+static bool parse_ev(const char *line, unsigned *core, uint32_t *t, char *ph, unsigned *id,
+                     unsigned *arg) {
+    const char *p = strstr(line, "trace: ev ");
+    unsigned tu;
+    if (!p || sscanf(p + 10, "%u %u %c %u %u", core, &tu, ph, id, arg) != 5 ||
+        *core >= TRACE_CORES || *id > UINT8_MAX)
+        return false;
+    *t = tu;
+    return true;
+}
+
+static int to_json(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: trace json <dump> [out.json]\n");
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "r");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    static char names[UINT8_MAX + 1][32];
+    char line[256], ph;
+    unsigned core, id, arg;
+    uint32_t t;
+
+    // First pass: names, and the earliest event on either core as time 0
+    bool any = false;
+    uint32_t origin = 0;
+    while (fgets(line, sizeof(line), in)) {
+        const char *p = strstr(line, "trace: name ");
+        char name[32];
+        if (p && sscanf(p + 12, "%u %31s", &id, name) == 2 && id <= UINT8_MAX)
+            snprintf(names[id], sizeof(names[id]), "%s", name);
+        else if (parse_ev(line, &core, &t, &ph, &id, &arg) &&
+                 (!any || (int32_t)(t - origin) < 0)) {
+            origin = t;
+            any = true;
+        }
+    }
+
+    // Second pass: the events, each core's time unwrapped from the origin
+    uint64_t ts[TRACE_CORES] = { 0 };
+    uint32_t last[TRACE_CORES];
+    bool seen[TRACE_CORES] = { false };
+    uint32_t events = 0;
+    rewind(in);
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int c = 0; c < TRACE_CORES; c++)
+        fprintf(out, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,"
+                     "\"args\":{\"name\":\"core%d\"}},\n", c, c);
+    while (fgets(line, sizeof(line), in)) {
+        if (!parse_ev(line, &core, &t, &ph, &id, &arg))
+            continue;
+        if (!seen[core]) {
+            seen[core] = true;
+            last[core] = origin;
+        }
+        ts[core] += (uint32_t)(t - last[core]);
+        last[core] = t;
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":0,\"tid\":%u",
+                events ? ",\n" : "", names[id][0] ? names[id] : "?", ph,
+                (unsigned long long)ts[core], core);
+        // Async spans pair up by name; instants are drawn on their core
+        if (ph == 'b' || ph == 'e')
+            fprintf(out, ",\"cat\":\"async\",\"id\":%u", id);
+        else if (ph == 'i')
+            fprintf(out, ",\"s\":\"t\"");
+        fprintf(out, ",\"args\":{\"arg\":%u}}", arg);
+        events++;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "trace json: %u events\n", (unsigned)events);
+    return events == 0;
+}
+
+int cmd_trace(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "round") == 0) return round_dump(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "json") == 0) return to_json(argc - 1, argv + 1);
+    fprintf(stderr, "usage: trace round [ms] [seed] [render_us] | json <dump> [out.json]\n");
+    return 1;
+}
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "lcd.h"
+#include "memmon.h"
 
 // A simple header for our raw files.
 typedef struct {
@@ -19,7 +20,7 @@ typedef struct {
 
 Picture* load_image(const uint8_t* raw_data) {
     // This function takes a pointer to the C array data.
-    MutablePicture* pic_mut = (MutablePicture*)malloc(sizeof(MutablePicture));
+    MutablePicture* pic_mut = (MutablePicture*)mem_alloc(sizeof(MutablePicture));
     if (!pic_mut) return NULL;
 
     // Read width and height from the first 8 bytes of the array.
@@ -41,6 +42,6 @@ Picture* load_image(const uint8_t* raw_data) {
 // Special free function for flash images, since pixel_data is not on the heap
 void free_image(Picture* pic) {
     if (pic) {
-        free((void*)pic);
+        mem_free((void*)pic);
     }
 }
\ No newline at end of file
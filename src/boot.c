@@ -0,0 +1,181 @@
+/* Boot: init steps with dependencies, run on both cores
+    Each core calls boot_run() with the cores it stands for. It keeps
+    picking a step it may run: first one of its own that asked to be
+    called again and is due, else the first unclaimed step in table order
+    whose dependencies are all done (claimed atomically, so each step runs
+    on one core only). With nothing to do it sleeps until its next deadline
+    or until the other core finishes a step.
+
+    Steps return 0 when done or the time they want to be called again, so
+    fixed sleeps become deadlines and the core does other steps meanwhile.
+    The whole timeline is kept for boot_print(), and boot_first_beat()
+    closes it with the time from reset to the first note of the song.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "boot.h"
+#include "dlog.h"
+#include "trace.h"
+
+#ifdef SIM_HOST
+// One thread stands for both cores; nothing to wake
+#define boot_sev() ((void)0)
+#else
+#include "hardware/sync.h"
+#define boot_sev() __sev()
+#endif
+
+static const boot_step_t *steps = NULL;
+static uint8_t num_steps = 0;
+static uint32_t all_mask = 0;
+static volatile uint32_t claimed = 0;
+static volatile uint32_t done = 0;
+static uint64_t resume_at[BOOT_MAX_STEPS];     // owner only; 0 = not waiting
+static boot_record_t records[BOOT_MAX_STEPS];
+static volatile uint64_t done_us = 0;
+static uint64_t first_beat_us = 0;
+
+/*! \brief Set the steps to run; call on core0 before core1 is launched
+    \param s step table, in the order steps should be picked; must stay valid
+    \param count number of steps, at most BOOT_MAX_STEPS
+*/
+void boot_init(const boot_step_t *s, uint8_t count) {
+    if (count > BOOT_MAX_STEPS) count = BOOT_MAX_STEPS;
+    steps = s;
+    num_steps = count;
+    all_mask = (1u << count) - 1;
+    claimed = done = 0;
+    done_us = 0;
+    first_beat_us = 0;
+    memset(resume_at, 0, sizeof(resume_at));
+    memset(records, 0, sizeof(records));
+}
+
+static uint32_t done_mask(void) {
+    return __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+}
+
+// Call a step once; true when it finished
+static bool call(uint8_t i, uint8_t core) {
+    boot_record_t *r = &records[i];
+    uint64_t t0 = time_us_64();
+    if (!r->calls) {
+        r->start_us = t0;
+        r->core = core;
+    }
+    TRACE_BEGIN(TRACE_BOOT, i);
+    uint64_t again = steps[i].fn();
+    TRACE_END(TRACE_BOOT, i);
+    uint64_t t1 = time_us_64();
+    r->busy_us += (uint32_t)(t1 - t0);
+    r->calls++;
+    if (again) {
+        resume_at[i] = again;
+        return false;
+    }
+    resume_at[i] = 0;
+    r->end_us = t1;
+    if ((__atomic_or_fetch(&done, 1u << i, __ATOMIC_ACQ_REL) & all_mask) == all_mask)
+        done_us = t1;
+    boot_sev();
+    return true;
+}
+
+/*! \brief Run steps until every step of the table is done
+    \param cores BOOT_CORE0 on core0, BOOT_CORE1 on core1; both on a single
+    core (or the host simulator) to run the whole graph there
+*/
+void boot_run(uint8_t cores) {
+    uint8_t core = (cores & BOOT_CORE1) && !(cores & BOOT_CORE0) ? 1 : 0;
+    uint32_t mine = 0;     // claimed by this core, not done
+
+    while ((done_mask() & all_mask) != all_mask) {
+        uint64_t now = time_us_64();
+        uint64_t next = 0;
+        int pick = -1;
+
+        // Own waiting steps first, once their deadline has passed
+        for (uint8_t i = 0; i < num_steps; i++) {
+            if (!(mine & (1u << i))) continue;
+            if (resume_at[i] <= now) {
+                pick = i;
+                break;
+            }
+            if (!next || resume_at[i] < next)
+                next = resume_at[i];
+        }
+        // Then the first ready step nobody has taken
+        if (pick < 0) {
+            uint32_t d = done_mask();
+            for (uint8_t i = 0; i < num_steps && pick < 0; i++) {
+                uint32_t bit = 1u << i;
+                if (!(steps[i].cores & cores) || (claimed & bit)) continue;
+                if ((steps[i].deps & d) != steps[i].deps) continue;
+                if (!(__atomic_fetch_or(&claimed, bit, __ATOMIC_ACQ_REL) & bit))
+                    pick = i;
+            }
+        }
+
+        if (pick >= 0) {
+            mine |= 1u << pick;
+            if (call(pick, core))
+                mine &= ~(1u << pick);
+            continue;
+        }
+        if (!next && cores == BOOT_ANY) {
+            // Both cores' steps are ours and none can run: a dependency
+            // that cannot be met
+            printf("ERROR: boot stuck, steps left 0x%x\n", (unsigned)(all_mask & ~done_mask()));
+            return;
+        }
+        // Until the next deadline, or the other core finishing a step
+        if (!next || next > now + BOOT_POLL_US)
+            next = now + BOOT_POLL_US;
+        best_effort_wfe_or_timeout(next);
+    }
+}
+
+bool boot_done(void) {
+    return (done_mask() & all_mask) == all_mask && num_steps;
+}
+
+// When the last step finished, us since boot; 0 before
+uint64_t boot_done_us(void) {
+    return done_us;
+}
+
+const boot_record_t *boot_record(uint8_t step) {
+    return step < num_steps ? &records[step] : NULL;
+}
+
+void boot_print(void) {
+    uint32_t busy[2] = { 0, 0 };
+    printf("boot: step        core  start_ms    end_ms  busy_ms  calls\n");
+    for (uint8_t i = 0; i < num_steps; i++) {
+        const boot_record_t *r = &records[i];
+        printf("boot: %-12s %4u  %8.1f  %8.1f  %7.1f  %5u\n", steps[i].name, (unsigned)r->core,
+               r->start_us / 1000.0, r->end_us / 1000.0, r->busy_us / 1000.0,
+               (unsigned)r->calls);
+        busy[r->core & 1] += r->busy_us;
+    }
+    printf("boot: ready at %.1f ms, core0 busy %.1f ms, core1 busy %.1f ms\n", done_us / 1000.0,
+           busy[0] / 1000.0, busy[1] / 1000.0);
+}
+
+/*! \brief Note the first beat after boot and log boot-to-first-beat;
+    only the first call after boot_run() counts. The beat task calls it,
+    so the line goes through the deferred log, not stdio.
+*/
+void boot_first_beat(void) {
+    if (!done_us || first_beat_us)
+        return;
+    first_beat_us = time_us_64();
+    DLOG("boot: first beat %llu us after reset (ready at %llu us)\n", DLOG_U64(first_beat_us),
+         DLOG_U64(done_us));
+}
+
+uint64_t boot_first_beat_us(void) {
+    return first_beat_us;
+}
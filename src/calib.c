@@ -0,0 +1,250 @@
+/* Latency calibration with a synthesized click track
+    Two phases of CALIB_LEADIN + CALIB_BEATS beats each. In the first the
+    speaker clicks (synthesized by core0 in the refill path) and the LEDs
+    stay dark; in the second the speaker is silent and every key flashes on
+    the beat, sent as a staged SHOW like the game's notes. Each rising edge
+    is timestamped against the raw song clock and matched to the nearest
+    beat; the first tap per beat counts.
+
+    A phase's offset is the mean lateness of its taps once outliers (more
+    than CALIB_OUTLIER_K spreads from the median) are dropped. Both offsets
+    go to the song clock and are staged in the settings store; the round
+    flow commits them to flash once audio has stopped, and calib_load()
+    reads them back at boot.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "evsched.h"
+#include "audio.h"
+#include "kvstore.h"
+#include "calib.h"
+
+// Longest wait for core0 to have the clicks running
+#define CALIB_AUDIO_WAIT_US 50000
+
+static calib_phase_t phase = CALIB_IDLE;
+static evsched_task_t t_input;
+static evsched_task_t t_beat;
+static uint64_t period_us = 0;
+static uint32_t next_beat = 0;          // beat the next flash is staged for
+static int32_t last_tap_beat = -1;
+static int32_t errs[CALIB_BEATS];
+static uint32_t num_errs = 0;
+static calib_result_t results[2];
+static bool result_ok[2];
+static int32_t kept_audio_us = 0;       // offsets in use before calibration
+static int32_t kept_visual_us = 0;
+
+static uint64_t beat_us(uint32_t k) {
+    return k * period_us;
+}
+
+static int cmp_i32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*! \brief Offset from tap errors, with outlier rejection
+    \param err_us lateness of each tap against its beat, at most CALIB_BEATS
+    \param n number of taps
+    \param out filled in
+    \return if enough taps were left to trust the offset
+*/
+bool calib_offset(const int32_t *err_us, uint32_t n, calib_result_t *out) {
+    int32_t v[CALIB_BEATS];
+    int32_t dev[CALIB_BEATS];
+    memset(out, 0, sizeof(*out));
+    if (n > CALIB_BEATS) n = CALIB_BEATS;
+    out->taps = n;
+    if (!n) return false;
+
+    memcpy(v, err_us, n * sizeof(*v));
+    qsort(v, n, sizeof(*v), cmp_i32);
+    int32_t median = n & 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+    for (uint32_t i = 0; i < n; i++)
+        dev[i] = abs(v[i] - median);
+    qsort(dev, n, sizeof(*dev), cmp_i32);
+    int32_t mad = n & 1 ? dev[n / 2] : (dev[n / 2 - 1] + dev[n / 2]) / 2;
+    out->spread_us = (uint32_t)(mad * 14826LL / 10000);
+
+    int32_t limit = (int32_t)out->spread_us * CALIB_OUTLIER_K;
+    if (limit < CALIB_OUTLIER_MIN_US) limit = CALIB_OUTLIER_MIN_US;
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (abs(v[i] - median) > limit) continue;
+        sum += v[i];
+        out->kept++;
+    }
+    if (out->kept)
+        out->offset_us = (int32_t)(sum / (int64_t)out->kept);
+    return out->kept >= CALIB_MIN_TAPS;
+}
+
+// Keypad poll while calibrating (the game's input task is not running)
+static void input_task(evsched_task_t *t, uint64_t now_us) {
+    i2c_sched_tick();
+    evsched_at(t, time_us_64() + CALIB_INPUT_PERIOD_US);
+}
+
+static void fill(uint8_t level) {
+    for (int k = 0; k < neotrellis_num_keys(); k++)
+        set_pixel_color(k, level, level, level);
+}
+
+// Light every key at beat k (visual phase)
+static void stage_flash(uint32_t k) {
+    fill(255);
+    i2c_sched_stage_show(beat_us(k));
+}
+
+static void begin_phase(calib_phase_t p) {
+    phase = p;
+    num_errs = 0;
+    last_tap_beat = -1;
+    uint32_t period = audio_click(CALIB_PERIOD_MS, p == CALIB_AUDIO);
+    period_us = (uint64_t)period * 1000000 / audio_sample_rate();
+    uint64_t t0 = time_us_64();
+    while (!audio_playing() && time_us_64() - t0 < CALIB_AUDIO_WAIT_US)
+        tight_loop_contents();
+
+    fill(0);
+    show_pixels();
+    i2c_sched_flush();
+    next_beat = 0;
+    if (p == CALIB_VISUAL)
+        stage_flash(next_beat);
+    printf("Calibration: tap along to the %s\n", p == CALIB_AUDIO ? "clicks" : "flashes");
+    evsched_at(&t_beat, to_us_since_boot(song_clock_to_abs(beat_us(0) + CALIB_FLASH_MS * 1000)));
+}
+
+static void finish(void) {
+    audio_stop();
+    evsched_cancel(&t_input);
+    evsched_cancel(&t_beat);
+    fill(0);
+    show_pixels();
+    i2c_sched_flush();
+    for (int i = 0; i < 2; i++)
+        printf("Calibration %s: %u taps, %u kept, offset %+d us, spread %u us%s\n",
+               i ? "visual" : "audio", (unsigned)results[i].taps, (unsigned)results[i].kept,
+               (int)results[i].offset_us, (unsigned)results[i].spread_us,
+               result_ok[i] ? "" : " (not enough taps)");
+    if (!result_ok[0] || !result_ok[1]) {
+        song_clock_set_offsets(kept_audio_us, kept_visual_us);
+        phase = CALIB_FAILED;
+        return;
+    }
+    song_clock_set_offsets(results[0].offset_us, results[1].offset_us);
+    if (!calib_save(results[0].offset_us, results[1].offset_us))
+        printf("ERROR: Calibration not saved\n");
+    phase = CALIB_DONE;
+}
+
+// Runs CALIB_FLASH_MS after each beat: flash off, next flash staged, and
+// the phase closed after the last counted beat
+static void beat_task(evsched_task_t *t, uint64_t now_us) {
+    uint32_t last = CALIB_LEADIN + CALIB_BEATS - 1;
+    next_beat++;
+    if (next_beat > last + 1) {
+        // Half a period past the last beat: late taps are in
+        int vis = phase == CALIB_VISUAL;
+        result_ok[vis] = calib_offset(errs, num_errs, &results[vis]);
+        if (phase == CALIB_AUDIO) {
+            // Same clock, silent
+            begin_phase(CALIB_VISUAL);
+        } else {
+            finish();
+        }
+        return;
+    }
+    if (phase == CALIB_VISUAL) {
+        fill(0);
+        show_pixels();
+        i2c_sched_flush();
+        if (next_beat <= last)
+            stage_flash(next_beat);
+    }
+    uint64_t at = next_beat <= last ? beat_us(next_beat) + CALIB_FLASH_MS * 1000
+                                    : beat_us(last) + period_us / 2;
+    evsched_at(t, to_us_since_boot(song_clock_to_abs(at)));
+}
+
+/*! \brief Start calibrating: clicks first, then flashes; the song clock
+    runs without offsets until it is done. Call on core0 between rounds.
+*/
+void calib_start(void) {
+    song_clock_get_offsets(&kept_audio_us, &kept_visual_us);
+    song_clock_set_offsets(0, 0);
+    memset(results, 0, sizeof(results));
+    result_ok[0] = result_ok[1] = false;
+    evsched_task(&t_input, "calib_in", EVS_PRIO_INPUT, input_task, NULL);
+    evsched_task(&t_beat, "calib", EVS_PRIO_BEAT, beat_task, NULL);
+    evsched_at(&t_input, time_us_64());
+    begin_phase(CALIB_AUDIO);
+}
+
+// Stop without changing the offsets
+void calib_cancel(void) {
+    if (phase != CALIB_AUDIO && phase != CALIB_VISUAL)
+        return;
+    audio_stop();
+    evsched_cancel(&t_input);
+    evsched_cancel(&t_beat);
+    i2c_sched_cancel_beat();
+    song_clock_set_offsets(kept_audio_us, kept_visual_us);
+    phase = CALIB_IDLE;
+}
+
+calib_phase_t calib_phase(void) {
+    return phase;
+}
+
+/*! \brief Key event while calibrating: rising edges are taps
+*/
+void calib_key(keyEvent evt) {
+    if (evt.EDGE != SEESAW_KEYPAD_EDGE_RISING || (phase != CALIB_AUDIO && phase != CALIB_VISUAL))
+        return;
+    uint64_t t = song_clock_raw_us();
+    int32_t k = (int32_t)((t + period_us / 2) / period_us);
+    if (k < CALIB_LEADIN || k >= CALIB_LEADIN + CALIB_BEATS || k == last_tap_beat)
+        return;
+    last_tap_beat = k;
+    if (num_errs < CALIB_BEATS)
+        errs[num_errs++] = (int32_t)((int64_t)t - (int64_t)beat_us(k));
+}
+
+/*! \brief Result of the last calibration
+    \param visual visual phase, else audio
+    \return if that phase had enough taps
+*/
+bool calib_get_result(bool visual, calib_result_t *out) {
+    *out = results[visual];
+    return result_ok[visual];
+}
+
+/*! \brief Read the stored offsets and hand them to the song clock; call
+    after kv_init()
+    \return false if none are stored (offsets left as they are)
+*/
+bool calib_load(void) {
+    calib_record_t rec;
+    if (kv_get(KV_KEY_CALIB, &rec, sizeof(rec)) != sizeof(rec))
+        return false;
+    song_clock_set_offsets(rec.audio_us, rec.visual_us);
+    return true;
+}
+
+/*! \brief Stage offsets for the settings store; they reach flash with the
+    next kv_commit()
+    \return if staged
+*/
+bool calib_save(int32_t audio_us, int32_t visual_us) {
+    calib_record_t rec = { audio_us, visual_us };
+    return kv_set(KV_KEY_CALIB, &rec, sizeof(rec)) == KV_OK;
+}
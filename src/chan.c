@@ -0,0 +1,104 @@
+/* Inter-core message channels: single-producer/single-consumer rings
+    The producer owns head, the consumer owns tail; each only reads the
+    other's index. A push copies the message into its slot and then
+    publishes head with a release store, and the consumer loads head with
+    acquire before reading the slot, so it never sees half a message. The
+    consumer publishes tail the same way once it has copied the message
+    out, so the producer never overwrites a slot still being read. No
+    locks, no disabled interrupts, and a full channel refuses the push
+    instead of waiting for the other core.
+*/
+
+#include <string.h>
+#include "chan.h"
+#include "hotpath.h"
+
+#ifdef SIM_HOST
+// Host threads do not sleep in WFE
+#define chan_sev() ((void)0)
+#else
+#include "hardware/sync.h"
+#define chan_sev() __sev()
+#endif
+
+/*! \brief Set up a channel; call before either side uses it
+    \param c channel
+    \param storage depth * size bytes, shared by both cores
+    \param size bytes per message
+    \param depth slots, a power of two
+    \param flags CHAN_DOORBELL or 0
+*/
+void chan_init(chan_t *c, void *storage, uint32_t size, uint32_t depth, uint32_t flags) {
+    c->buf = storage;
+    c->size = size;
+    c->mask = depth - 1;
+    c->flags = flags;
+    chan_reset(c);
+}
+
+// Empty the channel; neither side may be using it
+void chan_reset(chan_t *c) {
+    c->dropped = 0;
+    c->high_water = 0;
+    __atomic_store_n(&c->tail, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->head, 0, __ATOMIC_RELEASE);
+}
+
+/*! \brief Send a message (producer side); in SRAM, as the DMA IRQ pushes
+    the song clock (hotpath.h)
+    \return false if the channel is full; the message is dropped
+*/
+bool HOT_FUNC(chan_push)(chan_t *c, const void *msg) {
+    uint32_t head = __atomic_load_n(&c->head, __ATOMIC_RELAXED);
+    // Acquire: the consumer is done reading every slot it has released
+    uint32_t n = head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    if (n > c->mask) {
+        c->dropped++;
+        return false;
+    }
+    // Copied by hand: memcpy() is in flash
+    uint8_t *slot = c->buf + (head & c->mask) * c->size;
+    const uint8_t *from = msg;
+    for (uint32_t i = 0; i < c->size; i++)
+        slot[i] = from[i];
+    __atomic_store_n(&c->head, head + 1, __ATOMIC_RELEASE);
+    if (n + 1 > c->high_water)
+        c->high_water = n + 1;
+    if (c->flags & CHAN_DOORBELL)
+        chan_sev();
+    return true;
+}
+
+/*! \brief Take the oldest message (consumer side)
+    \return false if there is none
+*/
+bool chan_pop(chan_t *c, void *msg) {
+    uint32_t tail = __atomic_load_n(&c->tail, __ATOMIC_RELAXED);
+    // Acquire: the slot is written before head moved past it
+    if (__atomic_load_n(&c->head, __ATOMIC_ACQUIRE) == tail)
+        return false;
+    memcpy(msg, c->buf + (tail & c->mask) * c->size, c->size);
+    __atomic_store_n(&c->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*! \brief Copy the oldest message without taking it (consumer side)
+    \return false if there is none
+*/
+bool chan_peek(const chan_t *c, void *msg) {
+    uint32_t tail = __atomic_load_n(&c->tail, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&c->head, __ATOMIC_ACQUIRE) == tail)
+        return false;
+    memcpy(msg, c->buf + (tail & c->mask) * c->size, c->size);
+    return true;
+}
+
+// Messages waiting; exact on either side, a snapshot from anywhere else
+uint32_t chan_count(const chan_t *c) {
+    uint32_t tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&c->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+uint32_t chan_free(const chan_t *c) {
+    return c->mask + 1 - chan_count(c);
+}
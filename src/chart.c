@@ -0,0 +1,214 @@
+/* Chart loader and cursor
+    A chart image is used in place, from flash (a const array) or from a
+    heap copy of a file on the SD card. chart_open() checks the whole image
+    once so the game never has to bounds-check a note again.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chart.h"
+#include "memmon.h"
+
+#ifdef SIM_HOST
+#define CHART_FILE_STDIO
+#elif defined(CHART_SD)
+#include "ff.h"
+#endif
+
+// Nibble-wise CRC-32 (IEEE), small enough to keep in flash
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t chart_crc32(const void *data, uint32_t len) {
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xF];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xF];
+    }
+    return ~crc;
+}
+
+/*! \brief Check a chart image and point a chart at it
+    \param chart chart to fill in
+    \param image header followed by the note table, 8-byte aligned
+    \param len image size in bytes
+    \return CHART_OK or the first problem found
+*/
+chart_err_t chart_open(chart_t *chart, const void *image, uint32_t len) {
+    memset(chart, 0, sizeof(*chart));
+    if ((uintptr_t)image & 7) return CHART_ERR_ALIGN;
+    if (len < sizeof(chart_header_t)) return CHART_ERR_SIZE;
+
+    const chart_header_t *hdr = image;
+    if (hdr->magic != CHART_MAGIC) return CHART_ERR_MAGIC;
+    if (hdr->version != CHART_VERSION) return CHART_ERR_VERSION;
+    if (hdr->note_count > (len - sizeof(chart_header_t)) / sizeof(chart_note_t) ||
+        len != sizeof(chart_header_t) + hdr->note_count * sizeof(chart_note_t))
+        return CHART_ERR_SIZE;
+    if (hdr->lanes == 0 || hdr->lanes > CHART_MAX_LANES || hdr->sample_rate == 0)
+        return CHART_ERR_LANES;
+
+    const chart_note_t *notes = (const chart_note_t *)(hdr + 1);
+    if (chart_crc32(notes, hdr->note_count * sizeof(chart_note_t)) != hdr->crc32)
+        return CHART_ERR_CRC;
+
+    uint64_t valid = hdr->lanes == 64 ? ~0ull : (1ull << hdr->lanes) - 1;
+    for (uint32_t i = 0; i < hdr->note_count; i++) {
+        if (!notes[i].lanes || (notes[i].lanes & ~valid)) return CHART_ERR_LANES;
+        // One note per time; simultaneous keys are a chord in one note
+        if (i > 0 && notes[i].time <= notes[i - 1].time) return CHART_ERR_ORDER;
+        if (notes[i].time + notes[i].hold < notes[i].time) return CHART_ERR_ORDER;
+    }
+
+    chart->hdr = hdr;
+    chart->notes = notes;
+    chart->count = hdr->note_count;
+    chart->rate = hdr->sample_rate;
+    chart->lanes = hdr->lanes;
+    return CHART_OK;
+}
+
+/*! \brief Load a chart file into the heap and open it
+    \param chart chart to fill in, release with chart_close()
+    \param path file on the SD card (FatFs, built with -DCHART_SD)
+    \return CHART_OK, CHART_ERR_IO, or a chart_open() error
+*/
+chart_err_t chart_load_file(chart_t *chart, const char *path) {
+    memset(chart, 0, sizeof(*chart));
+    uint8_t *buf = NULL;
+    uint32_t len = 0;
+#if defined(CHART_FILE_STDIO)
+    FILE *f = fopen(path, "rb");
+    if (!f) return CHART_ERR_IO;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long n = ftell(f);
+        if (n > 0 && fseek(f, 0, SEEK_SET) == 0 && (buf = mem_alloc(n)) != NULL) {
+            len = (uint32_t)n;
+            if (fread(buf, 1, len, f) != len) {
+                mem_free(buf);
+                buf = NULL;
+            }
+        }
+    }
+    fclose(f);
+#elif defined(CHART_SD)
+    FIL f;
+    UINT got = 0;
+    if (f_open(&f, path, FA_READ) != FR_OK) return CHART_ERR_IO;
+    len = (uint32_t)f_size(&f);
+    if (len && (buf = mem_alloc(len)) != NULL) {
+        if (f_read(&f, buf, len, &got) != FR_OK || got != len) {
+            mem_free(buf);
+            buf = NULL;
+        }
+    }
+    f_close(&f);
+#else
+    (void)path;
+#endif
+    if (!buf) return CHART_ERR_IO;
+
+    chart_err_t err = chart_open(chart, buf, len);
+    if (err != CHART_OK) {
+        mem_free(buf);
+        return err;
+    }
+    chart->owned = buf;
+    return CHART_OK;
+}
+
+void chart_close(chart_t *chart) {
+    mem_free(chart->owned);
+    memset(chart, 0, sizeof(*chart));
+}
+
+const char *chart_strerror(chart_err_t err) {
+    switch (err) {
+    case CHART_OK: return "ok";
+    case CHART_ERR_SIZE: return "size does not match the note count";
+    case CHART_ERR_MAGIC: return "not a chart";
+    case CHART_ERR_VERSION: return "unsupported version";
+    case CHART_ERR_ALIGN: return "image not 8-byte aligned";
+    case CHART_ERR_CRC: return "note table CRC mismatch";
+    case CHART_ERR_ORDER: return "notes not in time order";
+    case CHART_ERR_LANES: return "lane outside the chart";
+    case CHART_ERR_IO: return "cannot read file";
+    }
+    return "unknown error";
+}
+
+uint32_t chart_ms_to_samples(const chart_t *chart, uint32_t ms) {
+    return (uint32_t)((uint64_t)ms * chart->rate / 1000);
+}
+
+/*! \brief Build a chart image
+    \param out destination, 8-byte aligned
+    \param cap size of out in bytes
+    \param lanes keys the chart is written for
+    \param rate song sample rate
+    \param notes notes sorted by time
+    \param count number of notes
+    \return image size in bytes, 0 if it does not fit
+*/
+uint32_t chart_write(uint8_t *out, uint32_t cap, uint16_t lanes, uint32_t rate,
+                     const chart_note_t *notes, uint32_t count) {
+    uint32_t len = sizeof(chart_header_t) + count * sizeof(chart_note_t);
+    if (len > cap) return 0;
+    chart_header_t hdr = {
+        .magic = CHART_MAGIC,
+        .version = CHART_VERSION,
+        .lanes = lanes,
+        .sample_rate = rate,
+        .note_count = count,
+        .crc32 = chart_crc32(notes, count * sizeof(chart_note_t)),
+        .reserved = 0,
+    };
+    memcpy(out, &hdr, sizeof(hdr));
+    memcpy(out + sizeof(hdr), notes, count * sizeof(chart_note_t));
+    return len;
+}
+
+void chart_cursor_init(chart_cursor_t *cur, const chart_t *chart, int32_t offset) {
+    cur->chart = chart;
+    cur->next = 0;
+    cur->offset = offset;
+}
+
+/*! \brief Take the next note whose time + offset has been reached
+    \param cur cursor
+    \param now song position in samples
+    \return note index, or -1 if the next note is still ahead
+*/
+int32_t chart_cursor_take(chart_cursor_t *cur, uint64_t now) {
+    if (cur->next >= cur->chart->count) return -1;
+    int64_t at = (int64_t)cur->chart->notes[cur->next].time + cur->offset;
+    if (at > (int64_t)now) return -1;
+    return (int32_t)cur->next++;
+}
+
+/*! \brief Jump to a song position without taking the notes in between
+    \param cur cursor
+    \param now song position in samples
+*/
+void chart_cursor_seek(chart_cursor_t *cur, uint64_t now) {
+    uint32_t lo = 0, hi = cur->chart->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((int64_t)cur->chart->notes[mid].time + cur->offset <= (int64_t)now)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    cur->next = lo;
+}
+
+bool chart_cursor_done(const chart_cursor_t *cur) {
+    return cur->next >= cur->chart->count;
+}
@@ -0,0 +1,151 @@
+/* Deferred log: records in, hex lines out
+    Each core logs into a channel of its own (src/chan.c): one producer,
+    the drain task on core0 the consumer. A record is the format string's
+    address, the call's time and up to DLOG_MAX_ARGS raw words.
+
+    The drain task is the lowest priority on core0 and writes a bounded
+    number of records per run, so the scheduler's beat guard keeps it out
+    of the time before a beat like any other task (evsched.c). Lines are
+    written with a small hex writer, no printf:
+        dlog: @ <address of dlog_anchor>
+        dlog: <core> <t_us> <fmt> <arg>...
+        dlog: lost <records dropped since the last line like this>
+    all in hex. The anchor line comes first in every run that writes, so a
+    log cut anywhere can still be decoded.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "chan.h"
+#include "evsched.h"
+#include "dlog.h"
+
+CHAN_DEFINE(log0, dlog_rec_t, DLOG_DEPTH, 0)
+CHAN_DEFINE(log1, dlog_rec_t, DLOG_DEPTH, 0)
+static chan_t *const logs[2] = { &log0, &log1 };
+
+const char dlog_anchor[] = "dlog";
+
+static evsched_task_t t_drain;
+static dlog_sink_t sink = NULL;
+static uint32_t lost_seen = 0;
+
+/*! \brief Log a record (use DLOG())
+    \param fmt printf format, must stay valid: a literal
+    \param n arguments that follow, 32 bits each
+*/
+void dlog_put(const char *fmt, uint32_t n, ...) {
+    dlog_rec_t r;
+    r.t_us = time_us_32();
+    r.fmt = fmt;
+    r.n = n < DLOG_MAX_ARGS ? n : DLOG_MAX_ARGS;
+    va_list ap;
+    va_start(ap, n);
+    for (uint32_t i = 0; i < r.n; i++)
+        r.arg[i] = va_arg(ap, uint32_t);
+    va_end(ap);
+    // Full: dropped, counted in the channel
+    chan_push(logs[get_core_num()], &r);
+}
+
+static void emit(const char *s, uint32_t len) {
+    if (sink) {
+        sink(s, len);
+        return;
+    }
+    for (uint32_t i = 0; i < len; i++)
+        putchar(s[i]);
+}
+
+// " <v>" in hex, no leading zeros
+static uint32_t put_hex(char *p, uintptr_t v) {
+    char tmp[2 * sizeof(v)];
+    uint32_t n = 0;
+    do {
+        tmp[n++] = "0123456789abcdef"[v & 15];
+        v >>= 4;
+    } while (v);
+    p[0] = ' ';
+    for (uint32_t i = 0; i < n; i++)
+        p[1 + i] = tmp[n - 1 - i];
+    return n + 1;
+}
+
+static void emit_line(const char *tag, const uintptr_t *w, uint32_t words) {
+    char line[8 + 10 + (DLOG_MAX_ARGS + 3) * (2 * sizeof(uintptr_t) + 1) + 1];
+    uint32_t len = 0;
+    for (const char *s = "dlog: "; *s; s++)
+        line[len++] = *s;
+    while (*tag)
+        line[len++] = *tag++;
+    for (uint32_t i = 0; i < words; i++)
+        len += put_hex(line + len, w[i]);
+    line[len++] = '\n';
+    emit(line, len);
+}
+
+static uint32_t dropped(void) {
+    uint32_t n = 0;
+    for (int c = 0; c < 2; c++)
+        n += __atomic_load_n(&logs[c]->dropped, __ATOMIC_RELAXED);
+    return n;
+}
+
+/*! \brief Write waiting records, oldest core0 records first
+    \param max records at most
+    \return records written
+*/
+uint32_t dlog_drain(uint32_t max) {
+    uint32_t done = 0;
+    for (int c = 0; c < 2 && done < max; c++) {
+        dlog_rec_t r;
+        while (done < max && chan_pop(logs[c], &r)) {
+            if (!done) {
+                uintptr_t anchor = (uintptr_t)dlog_anchor;
+                emit_line("@", &anchor, 1);
+            }
+            uintptr_t w[2 + DLOG_MAX_ARGS] = { r.t_us, (uintptr_t)r.fmt };
+            for (uint32_t i = 0; i < r.n; i++)
+                w[2 + i] = r.arg[i];
+            // The core is the tag
+            emit_line(c ? "1" : "0", w, 2 + r.n);
+            done++;
+        }
+    }
+    uint32_t d = dropped();
+    if (d != lost_seen) {
+        uintptr_t lost = d - lost_seen;
+        emit_line("lost", &lost, 1);
+        lost_seen = d;
+    }
+    return done;
+}
+
+static void drain_task(evsched_task_t *t, uint64_t now_us) {
+    dlog_drain(DLOG_DRAIN_MAX);
+}
+
+/*! \brief Drain from a core0 task from now on; after evsched_init()
+*/
+void dlog_start(void) {
+    evsched_task(&t_drain, "dlog", EVS_PRIO_FRAME, drain_task, NULL);
+    evsched_timing(&t_drain, DLOG_DRAIN_PERIOD_US, 0);
+    evsched_at(&t_drain, time_us_64());
+}
+
+void dlog_set_sink(dlog_sink_t s) {
+    sink = s;
+}
+
+// Drop everything waiting (no core may be logging)
+void dlog_reset(void) {
+    for (int c = 0; c < 2; c++)
+        chan_reset(logs[c]);
+    lost_seen = 0;
+}
+
+// Records dropped, channel full, since dlog_reset()
+uint32_t dlog_lost(void) {
+    return dropped();
+}
@@ -0,0 +1,295 @@
+/* Timed task scheduler, one per core
+    Game work is a set of tasks, each due at an absolute time. Every
+    priority level has its own min-heap on the due time. evsched_run_once()
+    runs the highest priority task that is due, or sleeps (WFE, with a
+    timer alarm as the timeout) until the earliest task falls due. core0
+    runs the game on it, core1 the renderer; each core only touches its
+    own tasks.
+
+    Scheduling is cooperative: a task runs until it returns, so a long low
+    priority task could hold up a beat. Each task keeps a decaying worst
+    case of its own run time; a task is not started when a beat task falls
+    due before it would finish. The core sleeps until the beat instead.
+    Other priorities only order the due tasks: the keypad poll is due every
+    millisecond and would otherwise never leave room for a frame. A task
+    that waits on I/O gives the core back with EVS_WAIT_UNTIL() instead of
+    spinning (see evsched.h).
+
+    A task may declare a period, to be requeued without doing it itself,
+    and a deadline. Per task the scheduler keeps the run time of each job
+    (the core time it took, waits left out) and counts the jobs that were
+    done after their deadline, so the stats show which task blows a budget.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "evsched.h"
+#include "trace.h"
+
+typedef struct {
+    evsched_task_t *task[EVS_MAX_TASKS];
+    uint8_t len;
+} heap_t;
+
+typedef struct {
+    heap_t heaps[EVS_PRIOS];
+    evsched_task_t *tasks[EVS_MAX_TASKS];
+    uint8_t num_tasks;
+    evsched_load_t load;
+} sched_t;
+
+static sched_t scheds[EVS_CORES];
+
+// The calling core's scheduler
+static inline sched_t *here(void) {
+    return &scheds[get_core_num()];
+}
+
+static void heap_swap(heap_t *h, int a, int b) {
+    evsched_task_t *t = h->task[a];
+    h->task[a] = h->task[b];
+    h->task[b] = t;
+    h->task[a]->slot = a;
+    h->task[b]->slot = b;
+}
+
+static void heap_up(heap_t *h, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (h->task[parent]->at_us <= h->task[i]->at_us) break;
+        heap_swap(h, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_down(heap_t *h, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, min = i;
+        if (l < h->len && h->task[l]->at_us < h->task[min]->at_us) min = l;
+        if (r < h->len && h->task[r]->at_us < h->task[min]->at_us) min = r;
+        if (min == i) break;
+        heap_swap(h, i, min);
+        i = min;
+    }
+}
+
+static void heap_remove(heap_t *h, int i) {
+    h->task[i]->slot = -1;
+    h->len--;
+    if (i == h->len) return;
+    h->task[i] = h->task[h->len];
+    h->task[i]->slot = i;
+    heap_up(h, i);
+    heap_down(h, i);
+}
+
+// Forget this core's tasks
+void evsched_init(void) {
+    sched_t *s = here();
+    memset(s->heaps, 0, sizeof(s->heaps));
+    for (int i = 0; i < s->num_tasks; i++)
+        s->tasks[i]->slot = -1;
+    s->num_tasks = 0;
+}
+
+/*! \brief Register a task on the calling core (not queued until
+    evsched_at()); registering it again resets it
+    \param task task storage, must stay valid
+    \param name name for the stats
+    \param prio priority
+    \param fn run when due; may queue itself again
+    \param arg passed through in task->arg
+*/
+void evsched_task(evsched_task_t *task, const char *name, evsched_prio_t prio,
+                  evsched_fn_t fn, void *arg) {
+    sched_t *s = here();
+    bool known = false;
+    for (int i = 0; i < s->num_tasks; i++)
+        known |= s->tasks[i] == task;
+    if (known)
+        evsched_cancel(task);
+    memset(task, 0, sizeof(*task));
+    task->name = name;
+    task->prio = prio;
+    task->fn = fn;
+    task->arg = arg;
+    task->core = (uint8_t)get_core_num();
+    task->trace_id = TRACE_NAME(name);
+    task->slot = -1;
+    if (!known && s->num_tasks < EVS_MAX_TASKS)
+        s->tasks[s->num_tasks++] = task;
+}
+
+/*! \brief Declare a task's timing
+    \param task registered task
+    \param period_us when a job is done, queue the task again this long
+    after the job was due (if it did not queue itself); 0 = it queues
+    itself
+    \param deadline_us a job done later than this after it was due is a
+    miss; 0 = no deadline
+*/
+void evsched_timing(evsched_task_t *task, uint32_t period_us, uint32_t deadline_us) {
+    task->period_us = period_us;
+    task->deadline_us = deadline_us;
+}
+
+/*! \brief Queue a task, or move it if it is already queued
+    \param task registered task
+    \param at_us absolute time (time_us_64()) it is due
+*/
+void evsched_at(evsched_task_t *task, uint64_t at_us) {
+    heap_t *h = &scheds[task->core].heaps[task->prio];
+    if (task->slot >= 0) {
+        task->at_us = at_us;
+        heap_up(h, task->slot);
+        heap_down(h, task->slot);
+        return;
+    }
+    if (h->len == EVS_MAX_TASKS) return;
+    task->at_us = at_us;
+    task->slot = h->len;
+    h->task[h->len++] = task;
+    heap_up(h, task->slot);
+}
+
+// Take a task off the queue; a job it had waiting is dropped
+void evsched_cancel(evsched_task_t *task) {
+    if (task->slot >= 0)
+        heap_remove(&scheds[task->core].heaps[task->prio], task->slot);
+    task->resume = 0;
+}
+
+bool evsched_queued(const evsched_task_t *task) {
+    return task->slot >= 0;
+}
+
+/*! \brief Run the next due task, or sleep until one is due
+    \return false if nothing is queued at all
+*/
+bool evsched_run_once(void) {
+    sched_t *s = here();
+    heap_t *heaps = s->heaps;
+    uint64_t now = time_us_64();
+    __atomic_store_n(&s->load.passes, s->load.passes + 1, __ATOMIC_RELAXED);
+    uint64_t wake = UINT64_MAX;
+    evsched_task_t *run = NULL;
+    // Next beat task that is not due yet
+    const heap_t *beat = &heaps[EVS_PRIO_BEAT];
+    uint64_t beat_at = beat->len && beat->task[0]->at_us > now ? beat->task[0]->at_us : UINT64_MAX;
+
+    for (int p = 0; p < EVS_PRIOS; p++) {
+        if (!heaps[p].len) continue;
+        evsched_task_t *top = heaps[p].task[0];
+        if (top->at_us <= now) {
+            // Would it still be running when the next beat is due?
+            if (p != EVS_PRIO_BEAT && now + top->cost_us > beat_at) {
+                top->held++;
+                wake = beat_at;
+                break;
+            }
+            run = top;
+            break;
+        }
+        if (top->at_us < wake)
+            wake = top->at_us;
+    }
+
+    if (!run) {
+        if (wake == UINT64_MAX) return false;
+        if (wake > now) {
+            best_effort_wfe_or_timeout(wake);
+            uint32_t slept = (uint32_t)(time_us_64() - now);
+            __atomic_store_n(&s->load.idle_us, s->load.idle_us + slept, __ATOMIC_RELAXED);
+        }
+        return true;
+    }
+
+    heap_remove(&heaps[run->prio], run->slot);
+    uint32_t late = (uint32_t)(now - run->at_us);
+    run->runs++;
+    run->late_sum_us += late;
+    if (late > run->late_max_us)
+        run->late_max_us = late;
+
+    // A new job starts at its due time; a waiting one keeps its own
+    if (!run->resume) {
+        run->release_us = run->at_us;
+        run->job_us = 0;
+    }
+
+    TRACE_BEGIN(run->trace_id, run->resume);
+    run->fn(run, now);
+    TRACE_END(run->trace_id, 0);
+
+    uint64_t end = time_us_64();
+    uint32_t took = (uint32_t)(end - now);
+    run->cost_us = took > run->cost_us ? took : run->cost_us - run->cost_us / 16;
+    run->job_us += took;
+    if (run->resume)
+        return true; // waiting, queued again by EVS_WAIT_UNTIL()
+
+    run->jobs++;
+    run->run_sum_us += run->job_us;
+    if (run->job_us > run->run_max_us)
+        run->run_max_us = run->job_us;
+    if (run->deadline_us && end > run->release_us + run->deadline_us) {
+        uint32_t over = (uint32_t)(end - run->release_us - run->deadline_us);
+        run->misses++;
+        __atomic_store_n(&s->load.misses, s->load.misses + 1, __ATOMIC_RELAXED);
+        if (over > run->over_max_us)
+            run->over_max_us = over;
+    }
+    // Periodic: next release on the grid, or now if it is already past
+    if (run->period_us && run->slot < 0) {
+        uint64_t next = run->release_us + run->period_us;
+        evsched_at(run, next > end ? next : end);
+    }
+    return true;
+}
+
+/*! \brief A core's load counters, from either core (perfmon.c)
+    \param core 0 or 1
+*/
+void evsched_get_load(uint32_t core, evsched_load_t *out) {
+    const evsched_load_t *l = &scheds[core].load;
+    out->passes = __atomic_load_n(&l->passes, __ATOMIC_RELAXED);
+    out->idle_us = __atomic_load_n(&l->idle_us, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&l->misses, __ATOMIC_RELAXED);
+}
+
+// This core's tasks
+void evsched_reset_stats(void) {
+    sched_t *s = here();
+    for (int i = 0; i < s->num_tasks; i++) {
+        evsched_task_t *t = s->tasks[i];
+        t->runs = 0;
+        t->late_sum_us = 0;
+        t->late_max_us = 0;
+        t->held = 0;
+        t->jobs = 0;
+        t->run_sum_us = 0;
+        t->run_max_us = 0;
+        t->misses = 0;
+        t->over_max_us = 0;
+    }
+}
+
+// This core's tasks: lateness, run time per job and deadline misses
+void evsched_print_stats(void) {
+    sched_t *s = here();
+    for (int i = 0; i < s->num_tasks; i++) {
+        evsched_task_t *t = s->tasks[i];
+        if (!t->runs) continue;
+        printf("evsched: %-8s %6u runs, late avg %u us max %u us, cost %u us, held %u",
+               t->name, (unsigned)t->runs, (unsigned)(t->late_sum_us / t->runs),
+               (unsigned)t->late_max_us, (unsigned)t->cost_us, (unsigned)t->held);
+        if (t->jobs)
+            printf(", run avg %u us max %u us", (unsigned)(t->run_sum_us / t->jobs),
+                   (unsigned)t->run_max_us);
+        if (t->deadline_us)
+            printf(", %u/%u past %u us deadline (worst +%u us)", (unsigned)t->misses,
+                   (unsigned)t->jobs, (unsigned)t->deadline_us, (unsigned)t->over_max_us);
+        printf("\n");
+    }
+}
@@ -0,0 +1,271 @@
+/* Round flow: boot -> play -> results -> countdown -> play ..., and
+    attract once results time out. One LED-priority task drives the states.
+    Between rounds it also runs the keypad poll and LED writes (the game's
+    input task only runs during a round), and a key press moves attract or
+    results on to a countdown; holding a key there for FLOW_CALIB_HOLD_MS
+    starts latency calibration (calib.c) instead, and pressing the first
+    and last key together shows or hides the stats overlay (perfmon.c)
+    without starting anything. A round that beats the
+    stored high score, and new calibration offsets, are staged in the
+    settings store and written to flash between rounds, once core0 has
+    halted the song DMA.
+
+    Starting a round only rewinds things that already exist: core0 refills
+    its two DMA buffers from the top of the track and restarts the song
+    clock (audio_play()), and game_start() resets the chart cursors, judge
+    and tasks. No LCD, Seesaw or DMA setup is repeated, so a restart is a
+    few milliseconds of work instead of a reboot.
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "evsched.h"
+#include "audio.h"
+#include "minigame.h"
+#include "calib.h"
+#include "kvstore.h"
+#include "trace.h"
+#include "dlog.h"
+#include "perfmon.h"
+#include "gameflow.h"
+
+static flow_state_t state = FLOW_ATTRACT;
+static flow_hook_t hook = NULL;
+static evsched_task_t t_flow;
+static volatile bool key_pressed = false;
+static volatile bool calib_req = false;
+static uint64_t key_down_us = 0;
+static uint64_t keys_down = 0;
+static bool chord = false;              // the overlay chord was pressed; keys not yet all up
+static uint64_t state_since_us = 0;
+static uint32_t step = 0;
+static uint32_t countdown_ms = 0;     // none for the round started at boot
+static bool commit_due = false;
+static flow_stats_t stats;
+
+// A tap moves on when the key is let go; a long hold calibrates instead
+static void idle_key(keyEvent evt) {
+    if (state == FLOW_CALIBRATE) {
+        calib_key(evt);
+        return;
+    }
+    uint64_t bit = 1ull << evt.NUM;
+    uint64_t both = 1ull | 1ull << (neotrellis_num_keys() - 1);
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING) {
+        keys_down |= bit;
+        if ((keys_down & both) == both && !chord) {
+            perfmon_overlay_toggle();
+            chord = true;
+        }
+    } else if (evt.EDGE == SEESAW_KEYPAD_EDGE_FALLING) {
+        keys_down &= ~bit;
+    }
+    if (chord) {
+        // Nothing else until every key is up again
+        key_down_us = 0;
+        chord = keys_down != 0;
+        return;
+    }
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING) {
+        key_down_us = time_us_64();
+    } else if (evt.EDGE == SEESAW_KEYPAD_EDGE_FALLING && key_down_us) {
+        if (time_us_64() - key_down_us >= FLOW_CALIB_HOLD_MS * 1000ull)
+            calib_req = true;
+        else
+            key_pressed = true;
+        key_down_us = 0;
+    }
+}
+
+static void fill(uint64_t keys, uint8_t r, uint8_t g, uint8_t b) {
+    for (int k = 0; k < neotrellis_num_keys(); k++) {
+        if (keys & (1ull << k))
+            set_pixel_color(k, r, g, b);
+        else
+            set_pixel_color(k, 0, 0, 0);
+    }
+    show_pixels();
+}
+
+// First n keys, row major
+static uint64_t first_keys(uint32_t n) {
+    return n >= 64 ? ~0ull : (1ull << n) - 1;
+}
+
+static void enter(flow_state_t s, uint64_t now_us) {
+    TRACE_INSTANT(TRACE_FLOW, s);
+    state = s;
+    state_since_us = now_us;
+    step = 0;
+    key_pressed = false;
+    calib_req = false;
+    commit_due = s == FLOW_ATTRACT || s == FLOW_RESULTS;
+    // The game has the keys until the round is over: their edges go unseen
+    if (s == FLOW_PLAY) {
+        keys_down = 0;
+        chord = false;
+    }
+    if (hook)
+        hook(s);
+}
+
+// Staged settings go to flash once per idle state, when the song has
+// stopped; a failed write is retried after the next round
+static void commit_settings(void) {
+    if (!commit_due || !kv_pending() || !audio_idle())
+        return;
+    commit_due = false;
+    kv_err_t err = kv_commit();
+    if (err != KV_OK)
+        printf("ERROR: Settings not saved: %s\n", kv_strerror(err));
+}
+
+// Stage the round as the high score if it beats the stored one for this chart
+static bool new_best(uint32_t accuracy, uint32_t max_combo) {
+    kv_hiscore_t best;
+    uint32_t crc = game_chart()->hdr->crc32;
+    if (kv_get(KV_KEY_HISCORE, &best, sizeof(best)) == sizeof(best) && best.chart_crc == crc &&
+        (best.accuracy > accuracy || (best.accuracy == accuracy && best.max_combo >= max_combo)))
+        return false;
+    best = (kv_hiscore_t){ crc, accuracy, max_combo };
+    return kv_set(KV_KEY_HISCORE, &best, sizeof(best)) == KV_OK;
+}
+
+static void start_round(uint64_t now_us) {
+    uint64_t t0 = time_us_64();
+    audio_play();
+    while (!audio_playing() && time_us_64() - t0 < FLOW_AUDIO_WAIT_US)
+        tight_loop_contents();
+    if (!audio_playing())
+        printf("WARNING: Song did not start\n");
+    game_start();
+    uint32_t took = (uint32_t)(time_us_64() - t0);
+    stats.rounds++;
+    stats.start_last_us = took;
+    if (took > stats.start_max_us)
+        stats.start_max_us = took;
+    // The song is playing: no stdio until the drain task gets to it
+    DLOG("Round %u started in %u us\n", stats.rounds, took);
+    enter(FLOW_PLAY, time_us_64());
+}
+
+static void flow_task(evsched_task_t *t, uint64_t now_us) {
+    uint32_t in_state_ms = (uint32_t)((now_us - state_since_us) / 1000);
+    uint32_t keys = neotrellis_num_keys();
+
+    switch (state) {
+    case FLOW_ATTRACT:
+        i2c_sched_tick();
+        commit_settings();
+        if (calib_req) {
+            enter(FLOW_CALIBRATE, now_us);
+            calib_start();
+            evsched_at(t, time_us_64() + 100000);
+            return;
+        }
+        if (key_pressed) {
+            enter(FLOW_COUNTDOWN, now_us);
+            evsched_at(t, now_us);
+            return;
+        }
+        if (in_state_ms / FLOW_ATTRACT_STEP_MS >= step) {
+            // One key chasing round the field
+            fill(1ull << (step % keys), 0, 40, 60);
+            step++;
+        }
+        break;
+    case FLOW_COUNTDOWN:
+        i2c_sched_tick();
+        if (in_state_ms >= countdown_ms) {
+            fill(0, 0, 0, 0);
+            i2c_sched_flush();
+            countdown_ms = FLOW_COUNTDOWN_STEPS * FLOW_COUNTDOWN_STEP_MS;
+            start_round(now_us);
+            evsched_at(t, time_us_64() + 100000);
+            return;
+        }
+        if (in_state_ms / FLOW_COUNTDOWN_STEP_MS >= step) {
+            // 3, 2, 1: fewer keys lit each step
+            uint32_t left = FLOW_COUNTDOWN_STEPS - step;
+            fill(first_keys(keys * left / FLOW_COUNTDOWN_STEPS), 255, 255, 255);
+            step++;
+        }
+        break;
+    case FLOW_PLAY:
+        // The game's own tasks run the round
+        if (game_finished()) {
+            audio_stop();
+            enter(FLOW_RESULTS, now_us);
+            judge_stats_t st;
+            judge_get_stats(&st);
+            uint32_t acc = judge_accuracy_permille(&st);
+            bool best = new_best(acc, st.max_combo);
+            // Accuracy as a bar of green keys, gold for a new high score
+            if (best)
+                fill(first_keys((keys * acc + 999) / 1000), 200, 150, 0);
+            else
+                fill(first_keys((keys * acc + 999) / 1000), 0, 200, 0);
+            printf("Results: combo %d, max combo %u, accuracy %u.%u%%%s\n", game_get_combo(),
+                   (unsigned)st.max_combo, (unsigned)(acc / 10), (unsigned)(acc % 10),
+                   best ? ", new high score" : "");
+            break;
+        }
+        evsched_at(t, now_us + 100000);
+        return;
+    case FLOW_RESULTS:
+        i2c_sched_tick();
+        commit_settings();
+        if (calib_req) {
+            enter(FLOW_CALIBRATE, now_us);
+            calib_start();
+            evsched_at(t, time_us_64() + 100000);
+            return;
+        }
+        if (key_pressed) {
+            // Straight into the next round
+            enter(FLOW_COUNTDOWN, now_us);
+            evsched_at(t, now_us);
+            return;
+        }
+        if (in_state_ms >= FLOW_RESULTS_MS) {
+            enter(FLOW_ATTRACT, now_us);
+            evsched_at(t, now_us);
+            return;
+        }
+        break;
+    case FLOW_CALIBRATE:
+        // calib.c polls the keys and drives the click track
+        if (calib_phase() == CALIB_DONE || calib_phase() == CALIB_FAILED) {
+            enter(FLOW_ATTRACT, now_us);
+            evsched_at(t, now_us);
+            return;
+        }
+        evsched_at(t, now_us + 100000);
+        return;
+    }
+    evsched_at(t, time_us_64() + FLOW_IDLE_TICK_MS * 1000);
+}
+
+/*! \brief Take over the keys between rounds and start the first round,
+    without a countdown, as soon as the scheduler runs; call after
+    evsched_init() and game_setup()
+    \param h called on every state change (replay saving, stress), may be NULL
+*/
+void flow_init(flow_hook_t h) {
+    hook = h;
+    game_set_idle_keys(idle_key);
+    evsched_task(&t_flow, "flow", EVS_PRIO_LED, flow_task, NULL);
+    countdown_ms = 0;
+    enter(FLOW_COUNTDOWN, time_us_64());
+    evsched_at(&t_flow, time_us_64());
+}
+
+flow_state_t flow_state(void) {
+    return state;
+}
+
+void flow_get_stats(flow_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,401 @@
+/* I2C bus scheduler for the NeoTrellis
+    Keypad reads and NeoPixel writes share i2c0. Every tick the keypad FIFO is
+    polled first, then pending LED updates are sent until the LED budget for
+    that tick is spent. Whatever does not fit waits for the next tick, so a
+    burst of LED updates never pushes the next keypad poll back by more than
+    one budget.
+
+    Pixel colours are kept in a shadow of the Seesaw pixel buffer with a dirty
+    mask. Runs of neighbouring dirty pixels go out as one BUF write and a
+    pixel updated twice before it is sent costs one write. A SHOW goes out
+    once every pixel that was dirty when it was requested has reached the
+    Seesaw; runs are picked round robin so a sustained repaint lowers the LED
+    frame rate instead of starving the SHOW.
+
+    With tiled boards the shadow holds every board back to back. The SHOWs for
+    all boards that changed go out together, so the whole field updates as
+    one frame.
+
+    Beat SHOWs: the game writes the next target into the pixel buffer ahead
+    of time and arms a SHOW on a core0 hardware alarm at the song time the
+    target should light. While it is armed ordinary SHOWs are held (they are
+    folded into the beat SHOW), keypad polls that could still be in flight at
+    the deadline are not started, and LED runs that would straddle it wait.
+    If the alarm still lands inside a transaction, the SHOW goes out the
+    moment that transaction ends.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "trace.h"
+#include "hotpath.h"
+
+// Pixel p is local pixel p % 16 on board p / 16
+#define PIXEL_OF(board, local) ((board) * NEO_TRELLIS_KEYS_PER_BOARD + (local))
+#define BIT(p) (1ull << (p))
+
+static uint8_t shadow[NEO_TRELLIS_MAX_KEYS * 3]; // GRB, same layout as the Seesaw
+static uint64_t dirty = 0;
+static uint64_t show_mask = 0;   // pixels the pending SHOW is waiting for
+static uint8_t show_boards = 0;  // boards written since their last SHOW
+static bool show_pending = false;
+static bool show_again = false;  // another SHOW was asked for meanwhile
+static uint8_t cursor = 0;       // where the next run search starts
+
+static uint32_t led_budget_us = I2C_SCHED_LED_BUDGET_US;
+static uint32_t last_poll_us = 0;
+static bool polled_once = false;
+
+static i2c_sched_stats_t stats;
+static i2c_sched_show_hook_t show_hook = NULL;
+
+// Beat SHOW on an alarm
+static alarm_pool_t *beat_pool = NULL;
+static alarm_id_t beat_alarm = 0;
+static volatile bool beat_armed = false;
+static volatile bool beat_due = false;   // alarm fired while the bus was busy
+static volatile bool bus_busy = false;
+static uint64_t beat_at_us = 0;
+
+/*! \brief Send the next run of dirty pixels as one BUF write
+    \param max_us bus time left in this slot (0 = no limit)
+    \return bus time used, 0 if the run did not fit
+*/
+static uint32_t HOT_FUNC(send_run)(uint32_t max_us) {
+    // Pixels the pending SHOW waits for go first
+    uint64_t want = show_mask ? show_mask : dirty;
+    int first = cursor;
+    while (!(want & BIT(first)))
+        first = (first + 1) % NEO_TRELLIS_MAX_KEYS;
+    int board = first / NEO_TRELLIS_KEYS_PER_BOARD;
+    int local = first % NEO_TRELLIS_KEYS_PER_BOARD;
+
+    // Runs stop at the board edge
+    int n = 1;
+    while (local + n < NEO_TRELLIS_KEYS_PER_BOARD && n < I2C_SCHED_MAX_RUN &&
+           (dirty & BIT(first + n)))
+        n++;
+
+    uint32_t cost = i2c_sched_xfer_us(5 + n * 3);
+    if (max_us && cost > max_us) {
+        // Shrink the run to what still fits
+        while (n > 1 && cost > max_us)
+            cost = i2c_sched_xfer_us(5 + --n * 3);
+        if (cost > max_us) return 0;
+    }
+
+    uint8_t buf[2 + I2C_SCHED_MAX_RUN * 3];
+    uint16_t offset = local * 3;
+    buf[0] = (offset >> 8) & 0xFF;
+    buf[1] = offset & 0xFF;
+    // Copied by hand: memcpy() is in flash
+    for (int i = 0; i < n * 3; i++)
+        buf[2 + i] = shadow[first * 3 + i];
+    seesaw_write_raw(board, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF, buf, 2 + n * 3);
+
+    uint64_t run = (BIT(n) - 1) << first;
+    dirty &= ~run;
+    show_mask &= ~run;
+    show_boards |= 1 << board;
+    cursor = (first + n) % NEO_TRELLIS_MAX_KEYS;
+    stats.led_writes++;
+    return cost;
+}
+
+/*! \brief SHOW on every board that changed, back to back
+    \return bus time used
+*/
+static uint32_t HOT_FUNC(send_show)(void) {
+    uint32_t cost = 0;
+    for (int b = 0; b < NEO_TRELLIS_MAX_BOARDS; b++) {
+        if (show_boards & (1 << b)) {
+            seesaw_write_raw(b, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SHOW, NULL, 0);
+            cost += i2c_sched_xfer_us(3);
+        }
+    }
+    if (cost)
+        TRACE_INSTANT(TRACE_LED_SHOW, show_boards);
+    show_boards = 0;
+    if (show_hook && cost)
+        show_hook(dirty);
+    // A request that came in meanwhile waits for what is dirty now
+    show_pending = show_again;
+    show_mask = show_again ? dirty : 0;
+    show_again = false;
+    if (cost)
+        stats.led_shows++;
+    return cost;
+}
+
+/*! \brief The armed beat SHOW: every board, whatever is in its buffer
+*/
+static void HOT_FUNC(send_beat_show)(void) {
+    TRACE_BEGIN(TRACE_BEAT_SHOW, 0);
+    beat_due = false;
+    beat_armed = false;
+    // May run from the alarm IRQ, so the regular SHOW bookkeeping is left
+    // alone; a held SHOW just goes out once more after this one
+    for (int b = 0; b < neotrellis_num_boards(); b++)
+        seesaw_write_raw(b, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SHOW, NULL, 0);
+    if (show_hook)
+        show_hook(dirty);
+
+    uint32_t jitter = (uint32_t)(hot_time_us_64() - beat_at_us);
+    stats.beat_shows++;
+    stats.beat_jitter_sum_us += jitter;
+    if (jitter > stats.beat_jitter_max_us)
+        stats.beat_jitter_max_us = jitter;
+    TRACE_END(TRACE_BEAT_SHOW, MIN(jitter, UINT16_MAX));
+}
+
+static int64_t HOT_FUNC(beat_alarm_cb)(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    // Never cut into a transaction or a read turnaround
+    if (bus_busy || neo_read_busy())
+        beat_due = true;
+    else
+        send_beat_show();
+    return 0;
+}
+
+/*! \brief Time until the armed beat SHOW, or UINT32_MAX if none is armed
+*/
+static uint32_t beat_slack_us(void) {
+    if (!beat_armed) return UINT32_MAX;
+    int64_t left = (int64_t)(beat_at_us - time_us_64());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/*! \brief Bus time a SHOW would take right now
+*/
+static uint32_t show_cost(void) {
+    return __builtin_popcount(show_boards) * i2c_sched_xfer_us(3);
+}
+
+/*! \brief Set up the scheduler
+    \param budget_us bus time LED writes may use per tick (0 = default)
+*/
+void i2c_sched_init(uint32_t budget_us) {
+    led_budget_us = budget_us ? budget_us : I2C_SCHED_LED_BUDGET_US;
+    dirty = 0;
+    show_mask = 0;
+    show_boards = 0;
+    show_pending = false;
+    show_again = false;
+    cursor = 0;
+    polled_once = false;
+    i2c_sched_cancel_beat();
+    i2c_sched_reset_stats();
+
+    // Alarm callbacks run on the core that created the pool; the beat SHOW
+    // has to fire on the core that owns the bus
+    if (!beat_pool)
+        beat_pool = alarm_pool_create_with_unused_hardware_alarm(4);
+}
+
+/*! \brief Update one pixel in the shadow buffer
+    \param board board the pixel is on
+    \param local pixel index on that board
+    \param g green
+    \param r red
+    \param b blue
+*/
+void i2c_sched_set_pixel(uint8_t board, uint8_t local, uint8_t g, uint8_t r, uint8_t b) {
+    int pixel = PIXEL_OF(board, local);
+    uint8_t *p = &shadow[pixel * 3];
+    if (dirty & BIT(pixel))
+        stats.led_coalesced++;
+    p[0] = g;
+    p[1] = r;
+    p[2] = b;
+    dirty |= BIT(pixel);
+}
+
+/*! \brief Request a SHOW once the pending pixel writes are out
+*/
+void i2c_sched_show(void) {
+    if (show_pending) {
+        stats.led_coalesced++;
+        show_again = true;
+        return;
+    }
+    show_mask = dirty;
+    show_pending = true;
+}
+
+/*! \brief The driver is about to start a transaction
+*/
+void HOT_FUNC(i2c_sched_bus_begin)(void) {
+    TRACE_BEGIN(TRACE_I2C, 0);
+    bus_busy = true;
+}
+
+/*! \brief The driver finished a transaction; record its bus time
+    \param wire_bytes bytes on the wire including the address byte
+*/
+void HOT_FUNC(i2c_sched_bus_end)(uint32_t wire_bytes) {
+    stats.bus_us += i2c_sched_xfer_us(wire_bytes);
+    bus_busy = false;
+    TRACE_END(TRACE_I2C, wire_bytes);
+    if (beat_due && !neo_read_busy())
+        send_beat_show();
+}
+
+/*! \brief The driver has no transaction or read in flight
+*/
+void i2c_sched_bus_idle(void) {
+    if (beat_due && !bus_busy)
+        send_beat_show();
+}
+
+/*! \brief Arm a SHOW at a song position
+    Pixels set so far are written to the Seesaw now, in the slack before the
+    beat, so only the SHOW is left for the deadline.
+    \param song_us song position at which the LEDs should change
+    \return 0 if armed, -1 if the alarm could not be set
+*/
+int i2c_sched_stage_show(uint64_t song_us) {
+    i2c_sched_cancel_beat();
+    if (neo_read_busy())
+        neo_read_finish();
+    while (dirty)
+        send_run(0);
+
+    // Sent early by the LED latency, so it is seen on the beat
+    absolute_time_t at = song_clock_visual_to_abs(song_us);
+    beat_at_us = to_us_since_boot(at);
+    beat_armed = true;
+    beat_alarm = alarm_pool_add_alarm_at(beat_pool, at, beat_alarm_cb, NULL, true);
+    if (beat_alarm < 0) {
+        beat_armed = false;
+        return -1;
+    }
+    stats.beat_staged++;
+    return 0;
+}
+
+/*! \brief Drop an armed beat SHOW that has not fired yet
+*/
+void i2c_sched_cancel_beat(void) {
+    if (beat_armed && beat_alarm > 0)
+        alarm_pool_cancel_alarm(beat_pool, beat_alarm);
+    beat_armed = false;
+    beat_due = false;
+    beat_alarm = 0;
+}
+
+/*! \brief Start the keypad poll of the next slot early
+    Only the register address phases go out; the Seesaw turnaround then runs
+    while the caller does other work (e.g. a frame blit), and the next
+    i2c_sched_tick() completes the read.
+*/
+void i2c_sched_poll_begin(void) {
+    if (neo_read_busy())
+        return;
+    // Keep the bus clear for an armed beat SHOW
+    if (beat_slack_us() < I2C_SCHED_BEAT_GUARD_US) {
+        stats.polls_held++;
+        return;
+    }
+    uint32_t now = time_us_32();
+    if (polled_once) {
+        uint32_t gap = now - last_poll_us;
+        stats.input_delay_last_us = gap;
+        if (gap > stats.input_delay_max_us)
+            stats.input_delay_max_us = gap;
+        stats.window_us += gap;
+    }
+    polled_once = true;
+    last_poll_us = now;
+    neo_read_begin();
+}
+
+/*! \brief One scheduler slot: poll the keypad, then spend the LED budget
+*/
+void i2c_sched_tick(void) {
+    TRACE_BEGIN(TRACE_I2C_TICK, 0);
+    // Input first, every tick
+    i2c_sched_poll_begin();
+    neo_read_finish();
+
+    // LED writes fill the rest of the slot; a SHOW goes out as soon as
+    // the pixels it waits for are written
+    uint32_t left = led_budget_us;
+    for (;;) {
+        uint32_t slack = beat_slack_us();
+        if (show_pending && !show_mask && slack == UINT32_MAX) {
+            if (show_cost() > left) break;
+            left -= send_show();
+            continue;
+        }
+        if (!dirty || !left || !slack) break;
+        uint32_t used = send_run(MIN(left, slack));
+        if (!used) break;
+        left -= used;
+    }
+
+    if (dirty || show_pending)
+        stats.led_deferred++;
+    stats.ticks++;
+    TRACE_END(TRACE_I2C_TICK, led_budget_us - left);
+}
+
+/*! \brief Send every pending LED update, ignoring the budget
+*/
+void i2c_sched_flush(void) {
+    // Writes would move the register pointer of a board mid-read
+    if (neo_read_busy())
+        neo_read_finish();
+    while (dirty)
+        send_run(0);
+    while (show_pending)
+        send_show();
+}
+
+/*! \brief Check if every LED update has been sent
+*/
+bool i2c_sched_idle(void) {
+    return !dirty && !show_pending;
+}
+
+/*! \brief Be told when a SHOW has gone out (latency measurement)
+    \param hook gets the pixels still waiting to be written, so not shown;
+    may run from the beat alarm IRQ. NULL to stop.
+    \return the hook it replaces, for the new one to call on and put back
+*/
+i2c_sched_show_hook_t i2c_sched_set_show_hook(i2c_sched_show_hook_t hook) {
+    i2c_sched_show_hook_t was = show_hook;
+    show_hook = hook;
+    return was;
+}
+
+void i2c_sched_get_stats(i2c_sched_stats_t *out) {
+    *out = stats;
+}
+
+void i2c_sched_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*! \brief Print bus utilization and worst-case input delay
+*/
+void i2c_sched_print_stats(void) {
+    uint32_t util_pm = stats.window_us ? (uint32_t)(stats.bus_us * 1000 / stats.window_us) : 0;
+    printf("i2c: %u ticks, bus %u.%u%%, input delay max %u us (last %u us)\n",
+           (unsigned)stats.ticks, (unsigned)(util_pm / 10), (unsigned)(util_pm % 10),
+           (unsigned)stats.input_delay_max_us, (unsigned)stats.input_delay_last_us);
+    printf("i2c: pixel writes %u, shows %u, coalesced %u, deferred ticks %u\n",
+           (unsigned)stats.led_writes, (unsigned)stats.led_shows,
+           (unsigned)stats.led_coalesced, (unsigned)stats.led_deferred);
+    if (stats.beat_shows) {
+        printf("i2c: beat SHOWs %u/%u, jitter avg %u us max %u us, polls held %u\n",
+               (unsigned)stats.beat_shows, (unsigned)stats.beat_staged,
+               (unsigned)(stats.beat_jitter_sum_us / stats.beat_shows),
+               (unsigned)stats.beat_jitter_max_us, (unsigned)stats.polls_held);
+    }
+}
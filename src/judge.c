@@ -0,0 +1,257 @@
+/* Timing-window judgement
+    A note joins the queue of each of its lanes when the song reaches the
+    start of its good window, and leaves it when pressed or when the window
+    closes (a miss). A press only looks at the two oldest notes of its lane
+    and takes the nearer one, so matching is O(1) however long the chart is.
+
+    Every lane of a chord is judged on its own. A hold is judged on the press
+    like a tap and again on release: letting go before the end of the hold
+    (less the good window) drops it.
+
+    Times are song samples, the same as the chart.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "judge.h"
+#include "trace.h"
+
+typedef struct {
+    uint32_t note[JUDGE_LANE_DEPTH];
+    uint8_t head;
+    uint8_t len;
+} lane_queue_t;
+
+static const chart_t *chart = NULL;
+static judge_callback_t callback = NULL;
+static uint32_t win[JUDGE_GRADES - 1];  // perfect, great, good in samples
+
+static chart_cursor_t open_cur;         // time - good: note can be pressed
+static chart_cursor_t close_cur;        // time + good: unpressed lanes miss
+static lane_queue_t queues[CHART_MAX_LANES];
+static uint64_t hit[JUDGE_WINDOW];      // lanes pressed, by note % JUDGE_WINDOW
+static uint32_t hold_end[CHART_MAX_LANES];
+static uint32_t hold_note[CHART_MAX_LANES];
+static uint64_t holding = 0;
+
+static judge_stats_t stats;
+
+static void emit(judge_ev_kind_t kind, judge_grade_t grade, uint32_t note, uint8_t lane,
+                 int32_t offset) {
+    TRACE_INSTANT(TRACE_JUDGE, grade << 8 | lane);
+    if (callback) {
+        judge_event_t ev = { kind, grade, note, lane, offset };
+        callback(&ev);
+    }
+}
+
+static void miss(uint32_t note, uint8_t lane) {
+    stats.count[JUDGE_MISS]++;
+    stats.combo = 0;
+    emit(JUDGE_EV_MISS, JUDGE_MISS, note, lane, 0);
+}
+
+static void queue_pop(lane_queue_t *q) {
+    q->head = (q->head + 1) % JUDGE_LANE_DEPTH;
+    q->len--;
+}
+
+static uint32_t queue_at(const lane_queue_t *q, int i) {
+    return q->note[(q->head + i) % JUDGE_LANE_DEPTH];
+}
+
+/*! \brief Start judging a chart
+    \param c chart, must stay valid while judging
+    \param windows window half-widths, NULL for JUDGE_WINDOWS_DEFAULT
+    \param cb called for every judgement, may be NULL
+*/
+void judge_init(const chart_t *c, const judge_windows_t *windows, judge_callback_t cb) {
+    static const judge_windows_t defaults = JUDGE_WINDOWS_DEFAULT;
+    if (!windows) windows = &defaults;
+    chart = c;
+    callback = cb;
+    win[JUDGE_PERFECT] = chart_ms_to_samples(c, windows->perfect_ms);
+    win[JUDGE_GREAT] = chart_ms_to_samples(c, windows->great_ms);
+    win[JUDGE_GOOD] = chart_ms_to_samples(c, windows->good_ms);
+    chart_cursor_init(&open_cur, c, -(int32_t)win[JUDGE_GOOD]);
+    chart_cursor_init(&close_cur, c, (int32_t)win[JUDGE_GOOD] + 1);
+    memset(queues, 0, sizeof(queues));
+    memset(hit, 0, sizeof(hit));
+    holding = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*! \brief Skip to a song position; notes before it are not judged
+    \param now song position in samples
+*/
+void judge_seek(uint64_t now) {
+    chart_cursor_seek(&close_cur, now);
+    chart_cursor_seek(&open_cur, now);
+    memset(queues, 0, sizeof(queues));
+    holding = 0;
+}
+
+/*! \brief Open and close judgement windows up to a song position
+    \param now song position in samples
+*/
+void judge_update(uint64_t now) {
+    int32_t idx;
+    // Close first, so a note never sits in a queue past its window
+    while ((idx = chart_cursor_take(&close_cur, now)) >= 0) {
+        uint64_t lanes = chart->notes[idx].lanes;
+        if ((uint32_t)idx >= open_cur.next) {
+            // Never opened (window full): every lane is a miss
+            open_cur.next = idx + 1;
+            while (lanes) {
+                uint8_t lane = __builtin_ctzll(lanes);
+                lanes &= lanes - 1;
+                miss(idx, lane);
+            }
+            continue;
+        }
+        while (lanes) {
+            uint8_t lane = __builtin_ctzll(lanes);
+            lanes &= lanes - 1;
+            lane_queue_t *q = &queues[lane];
+            if (q->len && queue_at(q, 0) == (uint32_t)idx) {
+                queue_pop(q);
+                miss(idx, lane);
+            }
+        }
+    }
+    while (open_cur.next - close_cur.next < JUDGE_WINDOW &&
+           (idx = chart_cursor_take(&open_cur, now)) >= 0) {
+        hit[idx % JUDGE_WINDOW] = 0;
+        uint64_t lanes = chart->notes[idx].lanes;
+        while (lanes) {
+            uint8_t lane = __builtin_ctzll(lanes);
+            lanes &= lanes - 1;
+            lane_queue_t *q = &queues[lane];
+            if (q->len == JUDGE_LANE_DEPTH) {
+                // Denser than the queue: the oldest note gives way
+                miss(queue_at(q, 0), lane);
+                queue_pop(q);
+            }
+            q->note[(q->head + q->len) % JUDGE_LANE_DEPTH] = idx;
+            q->len++;
+        }
+    }
+    // Holds are kept once the press reaches the end of the hold
+    uint64_t lanes = holding;
+    while (lanes) {
+        uint8_t lane = __builtin_ctzll(lanes);
+        lanes &= lanes - 1;
+        if (now >= hold_end[lane]) {
+            holding &= ~(1ull << lane);
+            stats.holds_ok++;
+            emit(JUDGE_EV_HOLD_OK, JUDGE_PERFECT, hold_note[lane], lane, 0);
+        }
+    }
+}
+
+/*! \brief Judge a key press
+    \param lane key index
+    \param at song position of the press in samples
+*/
+void judge_press(uint8_t lane, uint64_t at) {
+    if (!chart || lane >= CHART_MAX_LANES) return;
+    judge_update(at);
+    lane_queue_t *q = &queues[lane];
+    if (!q->len) {
+        stats.strays++;
+        emit(JUDGE_EV_STRAY, JUDGE_MISS, 0, lane, 0);
+        return;
+    }
+
+    // The nearer of the two oldest notes; anything older is left to miss
+    int pick = 0;
+    int64_t off = (int64_t)at - chart->notes[queue_at(q, 0)].time;
+    if (q->len > 1) {
+        int64_t off2 = (int64_t)at - chart->notes[queue_at(q, 1)].time;
+        if ((off2 < 0 ? -off2 : off2) < (off < 0 ? -off : off)) {
+            pick = 1;
+            off = off2;
+        }
+    }
+    uint32_t note = queue_at(q, pick);
+    if (pick) {
+        q->note[(q->head + 1) % JUDGE_LANE_DEPTH] = queue_at(q, 0);
+    }
+    queue_pop(q);
+
+    uint64_t mag = off < 0 ? -off : off;
+    judge_grade_t grade = mag <= win[JUDGE_PERFECT] ? JUDGE_PERFECT :
+                          mag <= win[JUDGE_GREAT] ? JUDGE_GREAT : JUDGE_GOOD;
+    hit[note % JUDGE_WINDOW] |= 1ull << lane;
+    stats.count[grade]++;
+    stats.offset_sum += off;
+    stats.abs_offset_sum += mag;
+    if (++stats.combo > stats.max_combo)
+        stats.max_combo = stats.combo;
+
+    const chart_note_t *n = &chart->notes[note];
+    if (n->hold) {
+        holding |= 1ull << lane;
+        hold_end[lane] = n->time + n->hold;
+        hold_note[lane] = note;
+    }
+    emit(JUDGE_EV_HIT, grade, note, lane, (int32_t)off);
+}
+
+/*! \brief Judge a key release, only matters for holds
+    \param lane key index
+    \param at song position of the release in samples
+*/
+void judge_release(uint8_t lane, uint64_t at) {
+    if (lane >= CHART_MAX_LANES || !(holding & (1ull << lane))) return;
+    holding &= ~(1ull << lane);
+    if (at + win[JUDGE_GOOD] >= hold_end[lane]) {
+        stats.holds_ok++;
+        emit(JUDGE_EV_HOLD_OK, JUDGE_PERFECT, hold_note[lane], lane, 0);
+    } else {
+        stats.holds_dropped++;
+        stats.combo = 0;
+        emit(JUDGE_EV_HOLD_DROP, JUDGE_MISS, hold_note[lane], lane,
+             (int32_t)((int64_t)at - hold_end[lane]));
+    }
+}
+
+/*! \brief Lanes of a note pressed so far
+    \param note note index inside the current window
+*/
+uint64_t judge_hit_lanes(uint32_t note) {
+    return hit[note % JUDGE_WINDOW];
+}
+
+void judge_get_stats(judge_stats_t *out) {
+    *out = stats;
+}
+
+/*! \brief Weighted accuracy: perfect 100%, great 70%, good 40%, miss 0
+    \return accuracy in 1/1000
+*/
+uint32_t judge_accuracy_permille(const judge_stats_t *st) {
+    uint32_t n = st->count[JUDGE_PERFECT] + st->count[JUDGE_GREAT] +
+                 st->count[JUDGE_GOOD] + st->count[JUDGE_MISS];
+    if (!n) return 0;
+    return (st->count[JUDGE_PERFECT] * 1000 + st->count[JUDGE_GREAT] * 700 +
+            st->count[JUDGE_GOOD] * 400) / n;
+}
+
+void judge_print_stats(void) {
+    uint32_t hits = stats.count[JUDGE_PERFECT] + stats.count[JUDGE_GREAT] + stats.count[JUDGE_GOOD];
+    uint32_t acc = judge_accuracy_permille(&stats);
+    uint32_t rate = chart ? chart->rate : 1;
+    printf("judge: perfect %u, great %u, good %u, miss %u, stray %u, max combo %u, "
+           "accuracy %u.%u%%\n",
+           (unsigned)stats.count[JUDGE_PERFECT], (unsigned)stats.count[JUDGE_GREAT],
+           (unsigned)stats.count[JUDGE_GOOD], (unsigned)stats.count[JUDGE_MISS],
+           (unsigned)stats.strays, (unsigned)stats.max_combo, (unsigned)(acc / 10),
+           (unsigned)(acc % 10));
+    if (hits) {
+        printf("judge: offset avg %+d us, abs avg %u us, holds %u kept %u dropped\n",
+               (int)(stats.offset_sum * 1000000 / hits / rate),
+               (unsigned)(stats.abs_offset_sum * 1000000 / hits / rate),
+               (unsigned)stats.holds_ok, (unsigned)stats.holds_dropped);
+    }
+}
@@ -0,0 +1,394 @@
+/* Settings store: a log of key/value records in the last KV_SECTORS
+    sectors of flash
+    The active sector is the committed one with the highest sequence
+    number. A record is appended by programming only the page(s) it lands
+    on (NOR programming just clears bits, so the rest of the page is left
+    as it is) and is read back before it counts. When the active sector is
+    full, the latest value of every key is copied into the least worn other
+    sector, which gets a higher sequence number and, last of all, its
+    committed word. The old sector is left alone until it is picked as a
+    target again, so power lost at any point leaves either the old or the
+    new sector complete: an unfinished copy is never committed, and a torn
+    append fails its CRC and is skipped.
+
+    Erasing a sector takes tens of milliseconds with XIP off, during which
+    nothing may read flash. kv_commit() runs the flash work on the calling
+    core (core0, the game's) through flash_safe_execute(), which parks
+    core1 in RAM. Parking core1 does not stop the frame blit, a DMA stream
+    out of flash, so the renderer is held between two frames first
+    (render_hold()). kv_commit() refuses while audio plays: with
+    interrupts off the DMA would run out of buffers. kv_set() only stages
+    values, so it is safe from any game task.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "audio.h"
+#include "chart.h"
+#include "kvstore.h"
+#include "render.h"
+#include "trace.h"
+
+#define KV_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - KV_SECTORS * FLASH_SECTOR_SIZE)
+// Records start after the sector header
+#define KV_DATA_START ((sizeof(kv_sector_hdr_t) + 3) & ~3u)
+// Longest wait for core1 to park
+#define KV_LOCKOUT_MS 100
+// Longest wait for the frame blit to end
+#define KV_RENDER_WAIT_US 100000
+
+typedef struct {
+    uint16_t key;
+    uint16_t off;               ///< record offset in the active sector
+} kv_index_t;
+
+typedef struct {
+    uint16_t key;
+    uint16_t len;
+    uint8_t value[KV_VALUE_MAX];
+} kv_pending_t;
+
+typedef struct {
+    uint32_t offs;
+    const uint8_t *data;        ///< NULL: erase
+    uint32_t len;
+} kv_flash_op_t;
+
+static int32_t active = -1;
+static uint32_t seq = 0;
+static uint32_t used = 0;
+static uint32_t erases[KV_SECTORS];
+static kv_index_t index_tab[KV_MAX_KEYS];
+static uint32_t num_keys = 0;
+static kv_pending_t pending[KV_MAX_KEYS];
+static uint32_t num_pending = 0;
+static kv_stats_t stats;
+// A sector being built, or the page(s) of one append
+static uint8_t image[FLASH_SECTOR_SIZE];
+
+static const uint8_t *sector_ptr(int32_t s) {
+    return (const uint8_t *)(XIP_BASE + KV_FLASH_OFFSET + s * FLASH_SECTOR_SIZE);
+}
+
+static uint32_t sector_offs(int32_t s) {
+    return KV_FLASH_OFFSET + s * FLASH_SECTOR_SIZE;
+}
+
+static uint32_t rec_size(uint32_t len) {
+    return sizeof(kv_rec_t) + ((len + 3) & ~3u);
+}
+
+static uint32_t rec_crc(uint16_t key, uint16_t len, const uint8_t *value) {
+    uint8_t buf[4 + KV_VALUE_MAX];
+    memcpy(buf, &key, 2);
+    memcpy(buf + 2, &len, 2);
+    memcpy(buf + 4, value, len);
+    return chart_crc32(buf, 4 + len);
+}
+
+// Runs with XIP off: nothing here may come from flash
+static void __no_inline_not_in_flash_func(flash_op)(void *param) {
+    const kv_flash_op_t *op = param;
+    if (op->data)
+        flash_range_program(op->offs, op->data, op->len);
+    else
+        flash_range_erase(op->offs, op->len);
+}
+
+static bool run_op(uint32_t offs, const uint8_t *data, uint32_t len) {
+    kv_flash_op_t op = { offs, data, len };
+    TRACE_BEGIN(TRACE_FLASH, len / 1024);
+    bool ok = flash_safe_execute(flash_op, &op, KV_LOCKOUT_MS) == PICO_OK;
+    TRACE_END(TRACE_FLASH, ok);
+    return ok;
+}
+
+static bool sector_valid(int32_t s) {
+    const kv_sector_hdr_t *hdr = (const kv_sector_hdr_t *)sector_ptr(s);
+    return hdr->magic == KV_SECTOR_MAGIC && hdr->committed == KV_COMMITTED &&
+           hdr->crc32 == chart_crc32(hdr, offsetof(kv_sector_hdr_t, crc32));
+}
+
+static bool sector_blank(int32_t s) {
+    const uint32_t *p = (const uint32_t *)sector_ptr(s);
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / 4; i++)
+        if (p[i] != 0xFFFFFFFFu) return false;
+    return true;
+}
+
+static kv_index_t *index_find(uint16_t key) {
+    for (uint32_t i = 0; i < num_keys; i++)
+        if (index_tab[i].key == key) return &index_tab[i];
+    return NULL;
+}
+
+static void index_put(uint16_t key, uint32_t off) {
+    kv_index_t *e = index_find(key);
+    if (!e) {
+        if (num_keys == KV_MAX_KEYS) return;
+        e = &index_tab[num_keys++];
+        e->key = key;
+    }
+    e->off = (uint16_t)off;
+}
+
+static kv_pending_t *pending_find(uint16_t key) {
+    for (uint32_t i = 0; i < num_pending; i++)
+        if (pending[i].key == key) return &pending[i];
+    return NULL;
+}
+
+// Lay a record out at buf
+static void put_record(uint8_t *buf, uint16_t key, uint16_t len, const uint8_t *value) {
+    kv_rec_t r = { key, len, rec_crc(key, len, value) };
+    memcpy(buf, &r, sizeof(r));
+    memcpy(buf + sizeof(r), value, len);
+}
+
+/*! \brief Find the active sector and index its records; call at boot,
+    before kv_get(). Staged values are dropped.
+*/
+void kv_init(void) {
+    active = -1;
+    seq = 0;
+    used = 0;
+    num_keys = 0;
+    num_pending = 0;
+    memset(erases, 0, sizeof(erases));
+    memset(&stats, 0, sizeof(stats));
+    for (int32_t s = 0; s < KV_SECTORS; s++) {
+        const kv_sector_hdr_t *hdr = (const kv_sector_hdr_t *)sector_ptr(s);
+        if (sector_valid(s) && (active < 0 || hdr->seq > seq)) {
+            active = s;
+            seq = hdr->seq;
+        }
+    }
+    if (active < 0)
+        return;
+    memcpy(erases, ((const kv_sector_hdr_t *)sector_ptr(active))->erases, sizeof(erases));
+
+    const uint8_t *base = sector_ptr(active);
+    uint32_t pos = KV_DATA_START;
+    while (pos + sizeof(kv_rec_t) <= FLASH_SECTOR_SIZE) {
+        kv_rec_t r;
+        memcpy(&r, base + pos, sizeof(r));
+        if (r.key == 0xFFFF && r.len == 0xFFFF && r.crc32 == 0xFFFFFFFFu)
+            break;                                      // free space
+        if (r.len > KV_VALUE_MAX || pos + rec_size(r.len) > FLASH_SECTOR_SIZE) {
+            // Torn header: nothing after it can be found, compact on the next write
+            stats.torn++;
+            pos = FLASH_SECTOR_SIZE;
+            break;
+        }
+        if (r.key != 0xFFFF && rec_crc(r.key, r.len, base + pos + sizeof(r)) == r.crc32)
+            index_put(r.key, pos);
+        else
+            stats.torn++;
+        pos += rec_size(r.len);
+    }
+    used = pos;
+}
+
+/*! \brief Read a value, staged or stored
+    \param key
+    \param buf filled with up to len bytes of the value
+    \param len size of buf
+    \return length of the value (may be more than len), or KV_ERR_NOT_FOUND
+*/
+int32_t kv_get(uint16_t key, void *buf, uint32_t len) {
+    const uint8_t *value;
+    uint32_t n;
+    kv_pending_t *p = pending_find(key);
+    kv_index_t *e = index_find(key);
+    if (p) {
+        value = p->value;
+        n = p->len;
+    } else if (e) {
+        kv_rec_t r;
+        memcpy(&r, sector_ptr(active) + e->off, sizeof(r));
+        value = sector_ptr(active) + e->off + sizeof(r);
+        n = r.len;
+    } else {
+        return KV_ERR_NOT_FOUND;
+    }
+    memcpy(buf, value, n < len ? n : len);
+    return (int32_t)n;
+}
+
+/*! \brief Stage a value for the next kv_commit(); a value equal to the
+    stored one is not written again
+    \param key any but 0xFFFF
+    \param value
+    \param len at most KV_VALUE_MAX bytes
+    \return KV_OK, KV_ERR_SIZE, or KV_ERR_FULL if KV_MAX_KEYS are in use
+*/
+kv_err_t kv_set(uint16_t key, const void *value, uint32_t len) {
+    if (key == 0xFFFF || len > KV_VALUE_MAX)
+        return KV_ERR_SIZE;
+    kv_pending_t *p = pending_find(key);
+    kv_index_t *e = index_find(key);
+    if (e) {
+        kv_rec_t r;
+        memcpy(&r, sector_ptr(active) + e->off, sizeof(r));
+        if (r.len == len && !memcmp(sector_ptr(active) + e->off + sizeof(r), value, len)) {
+            // Back to the stored value: nothing to write
+            if (p)
+                *p = pending[--num_pending];
+            return KV_OK;
+        }
+    }
+    if (!p) {
+        if (!e && num_keys + num_pending >= KV_MAX_KEYS)
+            return KV_ERR_FULL;
+        p = &pending[num_pending++];
+        p->key = key;
+    }
+    p->len = (uint16_t)len;
+    memcpy(p->value, value, len);
+    return KV_OK;
+}
+
+bool kv_pending(void) {
+    return num_pending != 0;
+}
+
+// Append one staged value to the active sector
+static kv_err_t append(const kv_pending_t *p) {
+    uint32_t size = rec_size(p->len);
+    uint32_t at = sector_offs(active) + used;
+    uint32_t page = at & ~(FLASH_PAGE_SIZE - 1);
+    uint32_t pages = (at + size - page + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+    memset(image, 0xFF, pages * FLASH_PAGE_SIZE);
+    put_record(image + (at - page), p->key, p->len, p->value);
+    // The space is spent even if the write does not read back
+    uint32_t off = used;
+    used += size;
+    if (!run_op(page, image, pages * FLASH_PAGE_SIZE) ||
+        memcmp(sector_ptr(active) + off, image + (at - page), size) != 0)
+        return KV_ERR_IO;
+    index_put(p->key, off);
+    stats.appends++;
+    return KV_OK;
+}
+
+// Copy the latest value of every key, staged ones included, into the least
+// worn sector other than the active one, then make that one active
+static kv_err_t compact(void) {
+    // Ties go to the next sector round the ring, so all of them take turns
+    int32_t target = -1;
+    for (int32_t i = 1; i < KV_SECTORS; i++) {
+        int32_t s = (active + i + KV_SECTORS) % KV_SECTORS;
+        if (target < 0 || erases[s] < erases[target])
+            target = s;
+    }
+
+    memset(image, 0xFF, sizeof(image));
+    kv_index_t new_index[KV_MAX_KEYS];
+    uint32_t new_keys = 0;
+    uint32_t pos = KV_DATA_START;
+    for (uint32_t i = 0; i < num_pending; i++) {
+        const kv_pending_t *p = &pending[i];
+        put_record(image + pos, p->key, p->len, p->value);
+        new_index[new_keys++] = (kv_index_t){ p->key, (uint16_t)pos };
+        pos += rec_size(p->len);
+    }
+    for (uint32_t i = 0; i < num_keys; i++) {
+        if (pending_find(index_tab[i].key))
+            continue;
+        kv_rec_t r;
+        memcpy(&r, sector_ptr(active) + index_tab[i].off, sizeof(r));
+        if (pos + rec_size(r.len) > FLASH_SECTOR_SIZE)
+            return KV_ERR_FULL;
+        memcpy(image + pos, sector_ptr(active) + index_tab[i].off, sizeof(r) + r.len);
+        new_index[new_keys++] = (kv_index_t){ r.key, (uint16_t)pos };
+        pos += rec_size(r.len);
+    }
+
+    if (!sector_blank(target)) {
+        if (!run_op(sector_offs(target), NULL, FLASH_SECTOR_SIZE))
+            return KV_ERR_IO;
+        erases[target]++;
+    }
+    kv_sector_hdr_t hdr = {
+        .magic = KV_SECTOR_MAGIC,
+        .seq = seq + 1,
+        .committed = 0xFFFFFFFFu,
+    };
+    memcpy(hdr.erases, erases, sizeof(erases));
+    hdr.crc32 = chart_crc32(&hdr, offsetof(kv_sector_hdr_t, crc32));
+    memcpy(image, &hdr, sizeof(hdr));
+    uint32_t len = (pos + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+    if (!run_op(sector_offs(target), image, len) || memcmp(sector_ptr(target), image, pos) != 0)
+        return KV_ERR_IO;
+
+    // The copy is complete: commit it
+    uint32_t committed = KV_COMMITTED;
+    memset(image, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(image + offsetof(kv_sector_hdr_t, committed), &committed, sizeof(committed));
+    if (!run_op(sector_offs(target), image, FLASH_PAGE_SIZE) || !sector_valid(target))
+        return KV_ERR_IO;
+
+    active = target;
+    seq++;
+    used = pos;
+    memcpy(index_tab, new_index, sizeof(new_index));
+    num_keys = new_keys;
+    num_pending = 0;
+    stats.compactions++;
+    return KV_OK;
+}
+
+/*! \brief Write the staged values to flash; core0, between rounds. Blocks
+    for about a millisecond per value, or a sector erase (tens of ms) when
+    the active sector is full.
+    \return KV_OK, KV_ERR_BUSY while audio plays or a frame blit does not
+    end (nothing written), or the first error; values not written stay
+    staged
+*/
+kv_err_t kv_commit(void) {
+    if (!num_pending)
+        return KV_OK;
+    if (!audio_idle() || !render_hold(KV_RENDER_WAIT_US))
+        return KV_ERR_BUSY;
+    kv_err_t err = KV_OK;
+    while (num_pending) {
+        const kv_pending_t *p = &pending[num_pending - 1];
+        if (active >= 0 && used + rec_size(p->len) <= FLASH_SECTOR_SIZE) {
+            if (append(p) == KV_OK) {
+                num_pending--;
+                continue;
+            }
+            // Did not read back (a torn record left behind): start afresh
+        }
+        err = compact();
+        break;
+    }
+    render_release();
+    return err;
+}
+
+void kv_get_stats(kv_stats_t *out) {
+    *out = stats;
+    out->active = active;
+    out->seq = seq;
+    out->used = used;
+    out->keys = num_keys;
+    out->pending = num_pending;
+    memcpy(out->erases, erases, sizeof(erases));
+}
+
+const char *kv_strerror(kv_err_t err) {
+    switch (err) {
+    case KV_OK: return "ok";
+    case KV_ERR_NOT_FOUND: return "no such key";
+    case KV_ERR_SIZE: return "bad key or value too long";
+    case KV_ERR_FULL: return "store is full";
+    case KV_ERR_BUSY: return "audio is playing or a frame is being drawn";
+    case KV_ERR_IO: return "flash write failed";
+    }
+    return "unknown error";
+}
@@ -5,9 +5,12 @@
 
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 #include <stdio.h>
 #include <stdint.h>
 #include "lcd.h"
+#include "trace.h"
+#include "hotpath.h"
 
 void nano_wait(int t);
 
@@ -100,9 +103,9 @@ static void tft_reg_select(int val)
 void LCD_Reset(void)
 {
     lcddev.reset(1);      // Assert reset
-    sleep_ms(100); // Wait
+    sleep_ms(LCD_RESET_MS); // Wait
     lcddev.reset(0);      // De-assert reset
-    sleep_ms(50);  // Wait
+    sleep_ms(LCD_RESET_WAIT_MS);  // Wait
 }
 
 
@@ -139,12 +142,22 @@ void LCD_WriteData16_Prepare()
     // SPI->CR2 |= SPI_CR2_DS;
 }
 
-// Write 16-bit data
-void LCD_WriteData16(u16 data)
+// Write 16-bit data: spi_write16_blocking() for one pixel, on the
+// registers, so the blit loops stay in SRAM (hotpath.h)
+void HOT_FUNC(LCD_WriteData16)(u16 data)
 {
-    uint16_t buf[1];
-    buf[0] = data;
-    spi_write16_blocking(SPI, buf, 1);
+    spi_hw_t *hw = (spi_hw_t *)SPI;
+    while (!(hw->sr & SPI_SSPSR_TNF_BITS))
+        ;
+    hw->dr = data;
+    // Drop what came in, wait for the pixel to go, then drop the rest
+    while (hw->sr & SPI_SSPSR_RNE_BITS)
+        (void)hw->dr;
+    while (hw->sr & SPI_SSPSR_BSY_BITS)
+        ;
+    while (hw->sr & SPI_SSPSR_RNE_BITS)
+        (void)hw->dr;
+    hw->icr = SPI_SSPICR_RORIC_BITS;
 }
 
 // Finish writing 16-bit data
@@ -197,8 +210,7 @@ void LCD_direction(u8 direction)
     }
 }
 
-// Do the initialization sequence for the display.
-void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
+static void LCD_Bind(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
 {
     lcddev.reset = tft_reset;
     lcddev.select = tft_select;
@@ -209,8 +221,12 @@ void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
         lcddev.select = select;
     if (reg_select)
         lcddev.reg_select = reg_select;
-    lcddev.select(1);
-    LCD_Reset();
+}
+
+// Register setup after reset, up to leaving sleep; the display wants
+// LCD_SLEEP_OUT_MS before it is switched on
+static void LCD_InitRegs(void)
+{
     // Initialization sequence for 2.2inch ILI9341
     LCD_WR_REG(0xCF);
     LCD_WR_DATA(0x00);
@@ -303,13 +319,27 @@ void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
     LCD_WR_DATA(0x00);
     LCD_WR_DATA(0xef);
     LCD_WR_REG(0x11);     // Exit Sleep
-    sleep_ms(120); // Wait 120 ms
+}
+
+static void LCD_DisplayOn(void)
+{
     LCD_WR_REG(0x29);     // Display on
 
     LCD_direction(USE_HORIZONTAL);
     lcddev.select(0);
 }
 
+// Do the initialization sequence for the display.
+void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
+{
+    LCD_Bind(reset, select, reg_select);
+    lcddev.select(1);
+    LCD_Reset();
+    LCD_InitRegs();
+    sleep_ms(LCD_SLEEP_OUT_MS); // Wait 120 ms
+    LCD_DisplayOn();
+}
+
 void LCD_Setup() {
     tft_select(0);
     tft_reset(0);
@@ -317,6 +347,37 @@ void LCD_Setup() {
     LCD_Init(tft_reset, tft_select, tft_reg_select);
 }
 
+//===========================================================================
+// LCD_Setup() in stages for boot: each call does the next part and returns
+// when (us since boot) to call again, or 0 once the display is on. The
+// reset and sleep-out waits are deadlines, so the core is free meanwhile.
+//===========================================================================
+uint64_t LCD_SetupStep(void)
+{
+    static int stage = 0;
+    uint64_t now = time_us_64();
+    switch (stage++) {
+    case 0:
+        tft_select(0);
+        tft_reset(0);
+        tft_reg_select(0);
+        LCD_Bind(tft_reset, tft_select, tft_reg_select);
+        lcddev.select(1);
+        lcddev.reset(1);      // Assert reset
+        return now + LCD_RESET_MS * 1000;
+    case 1:
+        lcddev.reset(0);      // De-assert reset
+        return now + LCD_RESET_WAIT_MS * 1000;
+    case 2:
+        LCD_InitRegs();
+        return now + LCD_SLEEP_OUT_MS * 1000;
+    default:
+        LCD_DisplayOn();
+        stage = 0;
+        return 0;
+    }
+}
+
 //===========================================================================
 // Select a subset of the display to work on, and issue the "Write RAM"
 // command to prepare to send pixel data to it.
@@ -438,7 +499,7 @@ void LCD_DrawRectangle(u16 x1, u16 y1, u16 x2, u16 y2, u16 c)
 //===========================================================================
 // Fill a rectangle with color c from (x1,y1) to (x2,y2).
 //===========================================================================
-static void _LCD_Fill(u16 sx,u16 sy,u16 ex,u16 ey,u16 color)
+static void HOT_FUNC(_LCD_Fill)(u16 sx,u16 sy,u16 ex,u16 ey,u16 color)
 {
     u16 i,j;
     u16 width=ex-sx+1;
@@ -626,8 +687,8 @@ void LCD_DrawFillTriangle(u16 x0,u16 y0, u16 x1,u16 y1, u16 x2,u16 y2, u16 c)
     lcddev.select(0);
 }
 
-// A 12x6 font
-const unsigned char asc2_1206[95][12]={
+// A 12x6 font, in SRAM: the overlay looks it up for every character
+const unsigned char HOT_DATA asc2_1206[95][12]={
 {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},/*" ",0*/
 {0x00,0x00,0x04,0x04,0x04,0x04,0x04,0x04,0x00,0x04,0x00,0x00},/*"!",1*/
 {0x00,0x14,0x0A,0x0A,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},/*""",2*/
@@ -1211,7 +1272,7 @@ const unsigned char asc2_3216[95][64]={
 // size is the height of the character (either 12 or 16)
 // When mode is set, the background will be transparent.
 //===========================================================================
-void _LCD_DrawChar(u16 x,u16 y,u16 fc, u16 bc, char num, u8 size, u8 mode)
+void HOT_FUNC(_LCD_DrawChar)(u16 x,u16 y,u16 fc, u16 bc, char num, u8 size, u8 mode)
 {
     u8 temp;
     u8 pos,t;
@@ -1286,7 +1347,7 @@ void LCD_DrawString(u16 x,u16 y, u16 fc, u16 bg, const char *p, u8 size, u8 mode
 //===========================================================================
 // Draw a picture with upper left corner at (x0,y0).
 //===========================================================================
-void LCD_DrawPicture(u16 x0, u16 y0, const Picture *pic)
+void HOT_FUNC(LCD_DrawPicture)(u16 x0, u16 y0, const Picture *pic)
 {
     lcddev.select(1);
     u16 x1 = x0 + pic->width - 1;
@@ -1308,4 +1369,52 @@ void LCD_DrawPicture(u16 x0, u16 y0, const Picture *pic)
 
     LCD_WriteData16_End();
     lcddev.select(0);
-}
\ No newline at end of file
+}
+// Picture blit in the background: the SPI TX FIFO is fed by DMA while the
+// core does other work. The window and the 16-bit format stay set up and
+// CS stays low until LCD_DrawPictureBusy() sees the last pixel out, so no
+// other drawing may start before then.
+static int blit_dma = -1;
+static bool blit_active = false;
+
+void LCD_DrawPictureStart(u16 x0, u16 y0, const Picture *pic)
+{
+    if (blit_dma < 0)
+        blit_dma = dma_claim_unused_channel(true);
+    lcddev.select(1);
+    LCD_SetWindow(x0, y0, x0 + pic->width - 1, y0 + pic->height - 1);
+    LCD_WriteData16_Prepare();
+
+    dma_channel_config c = dma_channel_get_default_config(blit_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_dreq(&c, spi_get_dreq(SPI, true));
+    dma_channel_configure(blit_dma, &c, &spi_get_hw(SPI)->dr, pic->pixel_data,
+                          pic->width * pic->height, true);
+    blit_active = true;
+    TRACE_ASYNC_BEGIN(TRACE_BLIT, 0);
+}
+
+// Still sending? The first call to see it done ends the transfer.
+bool LCD_DrawPictureBusy(void)
+{
+    if (!blit_active)
+        return false;
+    if (dma_channel_is_busy(blit_dma) || spi_is_busy(SPI))
+        return true;
+    // Nothing read the RX side: drop what came in and the overrun
+    while (spi_is_readable(SPI))
+        (void)spi_get_hw(SPI)->dr;
+    spi_get_hw(SPI)->icr = SPI_SSPICR_RORIC_BITS;
+    LCD_WriteData16_End();
+    lcddev.select(0);
+    blit_active = false;
+    TRACE_ASYNC_END(TRACE_BLIT, 0);
+    return false;
+}
+
+// Wire time of a picture at the current SPI clock
+uint32_t LCD_DrawPictureUs(const Picture *pic)
+{
+    uint64_t bits = (uint64_t)pic->width * pic->height * 16;
+    return (uint32_t)(bits * 1000000 / spi_get_baudrate(SPI));
+}
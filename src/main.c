@@ -1,5 +1,6 @@
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "pico/flash.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -12,11 +13,28 @@
 #include "hardware/dma.h"
 #include "hardware/i2c.h"
 #include "hardware/adc.h"
+#include "hardware/sync.h"
 #include "hardware/structs/dma.h"
 #include "hardware/structs/pwm.h"
 
 #include "neotrellis.h"
+#include "i2c_sched.h"
 #include "minigame.h"
+#include "songclock.h"
+#include "evsched.h"
+#include "replay.h"
+#include "stress.h"
+#include "audio.h"
+#include "gameflow.h"
+#include "boot.h"
+#include "calib.h"
+#include "kvstore.h"
+#include "render.h"
+#include "trace.h"
+#include "dlog.h"
+#include "perfmon.h"
+#include "memmon.h"
+#include "xipmon.h"
 #include "pico/time.h"
 
 #include "lcd.h"
@@ -24,8 +42,6 @@
 #include "combo.h"
 #include "ievan_polkka_cut.h"
 
-#define BUFFER_SIZE 1024
-#define AUDIO_GPIO 27
 bool input = false;
 
 /****************************************** */
@@ -50,151 +66,355 @@ static void _init_play(){
 
 // lcd display functions
 void init_spi_lcd();
-Picture* load_image(const uint8_t* image_data);
-void free_image(Picture* pic);
 
 // song playing functions
 void init_pwm_dma();
-void fill_pwm_buffer();
 
 // volume control functions
 void init_adc();
-float get_multiplier();
 
-extern uint16_t pwm_buffer[2][1024];
-extern int current_buffer;
-extern bool buffer_ready[2];
-extern bool playback_active;
-extern int dma_chan;
-
-void core1_main() {
-    // initialize lcd screen
-    init_spi_lcd();
-    // Initialize I2C
-    init_i2c();
-    sleep_ms(500);
-
-    LCD_Setup();
-    LCD_Clear(0xC71D); // Clear the screen to black
-
-    Picture* frame_pic = NULL;
-    int frame_index = 0;
-    bool combo_disp; // check if combo text is displayed
-    int combo = 0;
-    bool chg = false;
-    int ten = combo/10;
-    int one = combo%10;
-
-    // Initialize NeoPixels
-    if (init_neopixels() < 0) {
-        printf("ERROR: Failed to initialize NeoPixels.\n");
+// LCD animation: core1 does nothing else. The game runs on core0 and
+// is seen only through its snapshot; each frame is reported back to core0
+// (render.c). core1 has a scheduler of its own with two tasks: the frame
+// blits the next animation frame by DMA and waits for it with the core
+// free, and the HUD redraws the combo whenever the snapshot moved, in
+// between two blits. A third task draws the stats overlay (perfmon.c).
+
+// Frame budget (60 fps); a frame or HUD update later than this is a miss
+#define RENDER_FRAME_BUDGET_US 16667
+// Snapshot reads for the HUD
+#define RENDER_HUD_PERIOD_US 10000
+// Looking again for the end of a blit: the frame, which expects it; the
+// HUD, which the frame also wakes when the blit is out
+#define RENDER_POLL_US 100
+#define RENDER_HUD_POLL_US 1000
+// Small gap between frames to control animation speed
+#define RENDER_GAP_US 40
+
+// Stats overlay: PERFMON_LINES of text along the bottom of the screen,
+// over the combo, a character redrawn only where the text changed. With
+// the overlay off a latched warning shows as a red mark in the corner.
+#define OVERLAY_PERIOD_US 50000
+#define OVERLAY_FONT 12
+#define OVERLAY_Y (LCD_H - PERFMON_LINES * OVERLAY_FONT)
+#define OVERLAY_MARK 6
+#define SCREEN_BG 0xC71D
+
+static evsched_task_t t_frame;
+static evsched_task_t t_hud;
+static const Picture* frame_pic = NULL;
+static int frame_index = 0;
+static uint64_t frame_start;
+static xipmon_mark_t frame_xip; // XIP counters at the start of the frame
+static bool hud_drawn = false; // the HUD drew a new state since the last frame
+static bool combo_disp; // check if combo text is displayed
+static int ten = 0;
+static int one = 0;
+static game_snapshot_t hud_snap;
+static uint32_t drawn_version = 0; // game snapshot the combo on screen is from
+static int drawn_combo = 0;
+static uint32_t was_running = 0;
+static evsched_task_t t_overlay;
+static perfmon_view_t ov_view;
+static char ov_text[PERFMON_LINES][PERFMON_COLS + 1];
+static char ov_shown[PERFMON_LINES][PERFMON_COLS + 1]; // on screen, 0 = not known
+static uint32_t ov_version = 0;
+static bool ov_on = false;
+static bool ov_mark = false;
+static u16 ov_warn_fc = GREEN;
+
+static void frame_task(evsched_task_t *t, uint64_t now_us) {
+    EVS_BEGIN(t);
+    // No blit while core0 writes flash: the DMA would read it (render.c)
+    EVS_WAIT_UNTIL(t, !render_held(), RENDER_POLL_US);
+    frame_start = time_us_64();
+    xipmon_begin(&frame_xip);
+    TRACE_ASYNC_BEGIN(TRACE_FRAME, frame_index);
+    // The next frame's descriptor, made at compile time (images.h)
+    frame_pic = &mystery_frames[frame_index];
+
+    // Draw the frame to the top-left corner of the screen; most of it is
+    // wire time, which the HUD can have
+    LCD_DrawPictureStart(0, 0, frame_pic);
+    EVS_YIELD_UNTIL(t, frame_start + LCD_DrawPictureUs(frame_pic));
+    EVS_WAIT_UNTIL(t, !LCD_DrawPictureBusy(), RENDER_POLL_US);
+
+    // A HUD update waiting on the LCD goes before the next blit
+    if (t_hud.resume)
+        evsched_at(&t_hud, time_us_64());
+
+    // Move to the next frame, looping back to the start
+    frame_index++;
+    if (frame_index >= mystery_frame_count) {
+        frame_index = 0;
     }
 
-    // Initialize the game (sets up keypad callback, timers, first target)
-    game_init();
-
-    printf("Game initialized. Entering game loop...\n");
-    
-    #ifdef PLAY
-        _init_play();
-    #endif
+    TRACE_ASYNC_END(TRACE_FRAME, hud_drawn);
+    xipmon_end(XIPMON_RENDER, &frame_xip);
+    render_report(frame_start, time_us_64(), hud_drawn);
+    hud_drawn = false;
+    evsched_at(t, time_us_64() + RENDER_GAP_US);
+    EVS_END(t);
+}
 
-    while (1) { // Loop forever
-        // Get the next frame from the array
-        game_step();
-        combo = game_get_combo();
+static void hud_task(evsched_task_t *t, uint64_t now_us) {
+    EVS_BEGIN(t);
+    // One consistent copy; nothing the game does meanwhile is lost
+    game_snapshot(&hud_snap);
+    // Round over: what each of this core's tasks cost during it
+    if (was_running && !hud_snap.running)
+        evsched_print_stats();
+    else if (!was_running && hud_snap.running)
+        evsched_reset_stats();
+    was_running = hud_snap.running;
+
+    if (hud_snap.version != drawn_version) {
+        // The LCD is the frame's until its blit is out
+        EVS_WAIT_UNTIL(t, !LCD_DrawPictureBusy(), RENDER_HUD_POLL_US);
+        TRACE_BEGIN(TRACE_HUD, hud_snap.combo);
+        // A reset between two updates: clear the old digits first
+        if (hud_snap.combo && hud_snap.combo < drawn_combo)
+            _disp_combo_help(0, &ten, &one, &combo_disp);
+        _disp_combo_help(hud_snap.combo, &ten, &one, &combo_disp);
+        TRACE_END(TRACE_HUD, hud_snap.combo);
+        drawn_version = hud_snap.version;
+        drawn_combo = hud_snap.combo;
+        hud_drawn = true;
+        // The combo may have drawn over the overlay
+        memset(ov_shown, 0, sizeof(ov_shown));
+    }
+    EVS_END(t);
+}
 
-        chg = get_chg();
-        frame_pic = load_image(mystery_frames[frame_index]);
-    
-        if (frame_pic) {
-            // Draw the frame to the top-left corner of the screen
-            LCD_DrawPicture(0, 0, frame_pic);
-            
-            // Free the Picture struct (not the pixel data)
-            free_image(frame_pic);
+static void overlay_draw(void) {
+    if (!ov_view.overlay && ov_on) {
+        // Closed: give the rows back to the combo, which draws it all again
+        LCD_DrawFillRectangle(0, OVERLAY_Y, LCD_W - 1, LCD_H - 1, SCREEN_BG);
+        _disp_combo_help(0, &ten, &one, &combo_disp);
+        drawn_version = 0;
+        drawn_combo = 0;
+        ov_on = false;
+        ov_mark = false;
+    } else if (ov_view.overlay && !ov_on) {
+        LCD_DrawFillRectangle(0, OVERLAY_Y, LCD_W - 1, LCD_H - 1, BLACK);
+        memset(ov_shown, ' ', sizeof(ov_shown));
+        ov_on = true;
+    }
+    if (!ov_on) {
+        if ((ov_view.warn != 0) != ov_mark) {
+            ov_mark = ov_view.warn != 0;
+            LCD_DrawFillRectangle(0, LCD_H - OVERLAY_MARK, OVERLAY_MARK - 1, LCD_H - 1,
+                                  ov_mark ? RED : SCREEN_BG);
         }
-    
-        // Move to the next frame, looping back to the start
-        frame_index++;
-        if (frame_index >= mystery_frame_count) {
-            frame_index = 0;
+        return;
+    }
+    perfmon_format(&ov_view, ov_text);
+    // The warning line is red while anything is latched: all of it again
+    // when that changes
+    u16 warn_fc = ov_view.warn ? RED : GREEN;
+    if (warn_fc != ov_warn_fc)
+        memset(ov_shown[PERFMON_LINES - 1], 0, PERFMON_COLS);
+    ov_warn_fc = warn_fc;
+    for (int l = 0; l < PERFMON_LINES; l++) {
+        u16 fc = l == PERFMON_LINES - 1 ? warn_fc : WHITE;
+        for (int c = 0; c < PERFMON_COLS; c++) {
+            if (ov_text[l][c] == ov_shown[l][c])
+                continue;
+            LCD_DrawChar(c * OVERLAY_FONT / 2, OVERLAY_Y + l * OVERLAY_FONT, fc, BLACK,
+                         ov_text[l][c], OVERLAY_FONT, 0);
+            ov_shown[l][c] = ov_text[l][c];
         }
+    }
+}
 
-        if(chg){
-            _disp_combo_help(combo, &ten, &one, &combo_disp);
-        }
-        // Add a small delay to control animation speed
-        sleep_us(40); // Adjust delay as needed
+static void overlay_task(evsched_task_t *t, uint64_t now_us) {
+    EVS_BEGIN(t);
+    perfmon_read(&ov_view);
+    bool stale = ov_on && !ov_shown[0][0];
+    if (ov_view.version != ov_version || (bool)ov_view.overlay != ov_on || stale) {
+        EVS_WAIT_UNTIL(t, !LCD_DrawPictureBusy(), RENDER_HUD_POLL_US);
+        // The latest view, whichever the wait let through
+        perfmon_read(&ov_view);
+        overlay_draw();
+        ov_version = ov_view.version;
     }
+    EVS_END(t);
 }
 
-// mini game variables
+#if defined(TRACE) || defined(XIP_BENCH)
+// Keys over USB: 't' prints the trace rings (sim trace json makes Chrome
+// trace JSON of them), 'x' runs the placement benchmark (xipmon.c). Both
+// hold core0 while they run: send them between rounds.
+static void console(void) {
+    int c = getchar_timeout_us(0);
+#ifdef TRACE
+    if (c == 't')
+        trace_dump();
+#endif
+#ifdef XIP_BENCH
+    if (c == 'x' && audio_idle())
+        xipmon_bench(ievan_polkka_cut_wav + 44, (ievan_polkka_cut_wav_len - 44) / 2);
+#endif
+}
+#endif
 
-int main() {
-    stdio_init_all();
-    multicore_launch_core1(core1_main);
+// Per-round extras around the round flow
+static void flow_changed(flow_state_t state) {
+    if (state == FLOW_PLAY) {
+        render_reset_stats();
+        xipmon_reset_stats();
+#ifdef GAME_STRESS
+        stress_start(GAME_STRESS, 1, NULL);
+#endif
+    } else if (state == FLOW_RESULTS) {
+        // Frame rate core1 kept up during the round, and the XIP cache
+        // around its blits and the refills
+        render_print_stats();
+        xipmon_print_stats();
+#ifdef GAME_STRESS
+        stress_stop();
+        stress_print_stats();
+#endif
+#ifdef REPLAY_SD
+        // Keep the round's key events for replay (sim replay <file>)
+        replay_err_t err = replay_save_file("replay.rpl");
+        if (err != REPLAY_OK)
+            printf("ERROR: Replay not saved: %s\n", replay_strerror(err));
+#endif
+    }
+}
+
+// Boot steps, picked in table order by whichever core may run them
+enum { STEP_AUDIO, STEP_I2C, STEP_SEESAW, STEP_LCD_SPI, STEP_LCD, STEP_GAME, STEP_COUNT };
 
-    // initialize pwm and dma
+// The DMA IRQ handler is installed on the core that sets it up: core0
+static uint64_t boot_audio(void) {
     init_adc();
     init_pwm_dma();
-    sleep_ms(500);
-
-    const uint8_t* wav_ptr = ievan_polkka_cut_wav + 44;
-    int total_samples = (ievan_polkka_cut_wav_len - 44) / 2;
-    int samples_played = 0;
+    audio_init(ievan_polkka_cut_wav + 44, (ievan_polkka_cut_wav_len - 44) / 2);
+    return 0;
+}
 
-    for (int i = 0; i < 2; i++) {
-        int count = total_samples - samples_played;
-        if (count > BUFFER_SIZE) {
-            count = BUFFER_SIZE;
-        }
+static uint64_t boot_i2c(void) {
+    init_i2c();
+    return 0;
+}
 
-        if (count <= 0) {
-            break;
-        }
-        float multiplier = get_multiplier();
-        fill_pwm_buffer(pwm_buffer[i], wav_ptr + samples_played * 2, count, multiplier);
-        buffer_ready[i] = false;
-        samples_played += count;
+// NeoPixel and keypad setup: queued once, then sent as each board settles
+static uint64_t boot_seesaw(void) {
+    static bool queued = false;
+    if (!queued) {
+        neotrellis_config_defer(true);
+        init_neopixels();
+        game_setup();
+        neotrellis_config_defer(false);
+        queued = true;
     }
+    uint64_t at = neotrellis_config_step();
+    if (!at && neotrellis_config_failed())
+        printf("ERROR: Failed to initialize NeoPixels.\n");
+    return at;
+}
 
-    dma_channel_set_read_addr(dma_chan, pwm_buffer[0], true);
-    dma_channel_start(dma_chan);
-
-    // plays the song
-    while (samples_played < total_samples) {
-        for (int i = 0; i < 2; i++) {
-            if (buffer_ready[i]) {
-                int count = total_samples - samples_played;
-                if (count > BUFFER_SIZE) count = BUFFER_SIZE;
-                if (count <= 0) {
-                    playback_active = false;
-                    continue;
-                }
-                
-                float multiplier = get_multiplier();
-                fill_pwm_buffer(pwm_buffer[i], wav_ptr + samples_played * 2, count, multiplier);
-                buffer_ready[i] = false;
-                samples_played += count;
-            }
-        }
-        tight_loop_contents();
-    }
+static uint64_t boot_lcd_spi(void) {
+    init_spi_lcd();
+    return 0;
+}
+
+static uint64_t boot_lcd(void) {
+    uint64_t at = LCD_SetupStep();
+    if (!at)
+        LCD_Clear(0xC71D); // Clear the screen to black
+    return at;
+}
 
-    while (dma_channel_is_busy(dma_chan)) {
-        tight_loop_contents();
+// Game and round flow run as timed tasks on core0, next to the audio
+static uint64_t boot_game(void) {
+    evsched_init();
+    // Deferred log lines go out from a low priority task (sim dlog decode)
+    dlog_start();
+    // Stats windows for the overlay; first and last key together show it
+    perfmon_start();
+#ifdef GAME_STRESS
+    // Synthetic input through neo_inject(), latency printed after each round
+    game_set_observer(stress_on_judge);
+#endif
+    // Settings: master volume and the offsets from the last calibration
+    kv_init();
+    uint16_t volume;
+    if (kv_get(KV_KEY_VOLUME, &volume, sizeof(volume)) == sizeof(volume))
+        audio_set_volume(volume);
+    if (calib_load()) {
+        int32_t audio_us, visual_us;
+        song_clock_get_offsets(&audio_us, &visual_us);
+        printf("Calibration: audio %+d us, visual %+d us\n", (int)audio_us, (int)visual_us);
     }
+    flow_init(flow_changed);
+    return 0;
+}
 
-    dma_channel_set_irq0_enabled(dma_chan, false);
-    irq_set_enabled(DMA_IRQ_0, false);
-    dma_channel_abort(dma_chan);
-    dma_channel_unclaim(dma_chan);
+static const boot_step_t boot_steps[STEP_COUNT] = {
+    [STEP_AUDIO] = { "audio", boot_audio, BOOT_CORE0, 0 },
+    [STEP_I2C] = { "i2c", boot_i2c, BOOT_ANY, 0 },
+    // i2c_sched_init() (in game_setup) makes the beat alarm pool: core0
+    [STEP_SEESAW] = { "seesaw", boot_seesaw, BOOT_CORE0, BOOT_DEP(STEP_I2C) },
+    // The LCD belongs to core1, which only renders
+    [STEP_LCD_SPI] = { "lcd_spi", boot_lcd_spi, BOOT_CORE1, 0 },
+    [STEP_LCD] = { "lcd", boot_lcd, BOOT_CORE1, BOOT_DEP(STEP_LCD_SPI) },
+    [STEP_GAME] = { "game", boot_game, BOOT_CORE0,
+                    BOOT_DEP(STEP_AUDIO) | BOOT_DEP(STEP_SEESAW) },
+};
 
-    uint slice = pwm_gpio_to_slice_num(AUDIO_GPIO);
-    pwm_set_chan_level(slice, pwm_gpio_to_channel(AUDIO_GPIO), 3905 / 2);
+void core1_main() {
+    // Lets core0 pause this core while it writes flash (settings store)
+    flash_safe_execute_core_init();
+    boot_run(BOOT_CORE1);
+
+    // Frames back to back, the HUD in their waits; the game is on core0
+    evsched_init();
+    evsched_task(&t_frame, "frame", EVS_PRIO_FRAME, frame_task, NULL);
+    evsched_task(&t_hud, "hud", EVS_PRIO_LED, hud_task, NULL);
+    evsched_task(&t_overlay, "overlay", EVS_PRIO_LED, overlay_task, NULL);
+    evsched_timing(&t_frame, 0, RENDER_FRAME_BUDGET_US);
+    evsched_timing(&t_hud, RENDER_HUD_PERIOD_US, RENDER_FRAME_BUDGET_US);
+    evsched_timing(&t_overlay, OVERLAY_PERIOD_US, 0);
+    render_attach();
+    uint64_t t0 = time_us_64();
+    evsched_at(&t_frame, t0);
+    evsched_at(&t_hud, t0);
+    evsched_at(&t_overlay, t0);
+    for (;;)
+        evsched_run_once();
+}
 
-    printf("Playback finished.\n");
+// mini game variables
 
-    for(;;);
-}
\ No newline at end of file
+int main() {
+    // Stacks painted before anything runs deep on them (perfmon shows them)
+    memmon_init();
+    xipmon_init();
+    stdio_init_all();
+    boot_init(boot_steps, STEP_COUNT);
+    multicore_launch_core1_with_stack(core1_main, memmon_core1_stack(),
+                                      MEMMON_CORE1_STACK_BYTES);
+    boot_run(BOOT_CORE0);
+    boot_print();
+
+    printf("Game initialized. Entering game loop...\n");
+
+    #ifdef PLAY
+        _init_play();
+    #endif
+
+    // Audio first on every pass: buffers refilled and requests handled,
+    // then the next due game task. Sleeps (WFE) until a task is due or the
+    // DMA IRQ wakes it for a refill.
+    for (;;) {
+        audio_service();
+        render_service();
+#if defined(TRACE) || defined(XIP_BENCH)
+        console();
+#endif
+        evsched_run_once();
+    }
+}
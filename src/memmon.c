@@ -0,0 +1,115 @@
+/* Stack painting and the counting allocator
+    core0's stack is the linker's [__StackBottom, __StackTop); memmon_init()
+    paints it from the bottom up to just below its own frame, first thing
+    in main(). core1's stack is an array here, painted whole and handed to
+    multicore_launch_core1_with_stack(). A scan runs from the bottom up to
+    the first word that is not the paint, so it reads every word of
+    headroom left; perfmon does one per core per window.
+
+    Each block from mem_alloc() has its size in a header just before it,
+    so mem_free() knows what it gives back. The counters are atomics: both
+    cores allocate, and the peak is raised with a compare and swap.
+*/
+
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "memmon.h"
+
+// 8 bytes keep the caller's block aligned as malloc() gave it
+#define MEMMON_HEADER 8
+
+static uint32_t core1_stack[MEMMON_CORE1_STACK_BYTES / 4] __attribute__((aligned(8)));
+static uint32_t *stack_lo[2];
+static uint32_t stack_words[2];
+
+static uint32_t in_use = 0;
+static uint32_t peak = 0;
+static uint32_t allocs[2] = { 0, 0 };
+static uint32_t frees = 0;
+static uint32_t failed = 0;
+
+#ifndef SIM_HOST
+static void paint(uint32_t *from, uint32_t *to) {
+    for (volatile uint32_t *w = from; w < to; w++)
+        *w = MEMMON_PAINT;
+}
+#endif
+
+/*! \brief Paint both stacks; core0, first thing in main(), before core1
+    is launched
+*/
+void memmon_init(void) {
+#ifndef SIM_HOST
+    extern uint32_t __StackBottom[], __StackTop[];
+    uint32_t here;
+    uint32_t *end = &here - MEMMON_PAINT_MARGIN / 4;
+    paint(__StackBottom, end);
+    stack_lo[0] = __StackBottom;
+    stack_words[0] = (uint32_t)(__StackTop - __StackBottom);
+    paint(core1_stack, core1_stack + MEMMON_CORE1_STACK_BYTES / 4);
+    stack_lo[1] = core1_stack;
+    stack_words[1] = MEMMON_CORE1_STACK_BYTES / 4;
+#endif
+}
+
+/*! \brief core1's stack, lowest word first (MEMMON_CORE1_STACK_BYTES)
+*/
+uint32_t *memmon_core1_stack(void) {
+    return core1_stack;
+}
+
+/*! \brief How deep a core's stack has been, from either core
+    \param core 0 or 1
+    \param out size 0 on the host, or before memmon_init()
+*/
+void memmon_stack(uint32_t core, memmon_stack_t *out) {
+    *out = (memmon_stack_t){ 0 };
+    if (core > 1 || !stack_words[core])
+        return;
+    const volatile uint32_t *w = stack_lo[core];
+    uint32_t left = 0;
+    while (left < stack_words[core] && w[left] == MEMMON_PAINT)
+        left++;
+    out->size = stack_words[core] * 4;
+    out->used_max = (stack_words[core] - left) * 4;
+}
+
+/*! \brief malloc(), counted
+    \return NULL when the heap is out, counted as a failure
+*/
+void *mem_alloc(size_t n) {
+    uint8_t *p = malloc(n + MEMMON_HEADER);
+    if (!p) {
+        __atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    *(uint32_t *)p = (uint32_t)n;
+    __atomic_fetch_add(&allocs[get_core_num()], 1, __ATOMIC_RELAXED);
+    uint32_t now = __atomic_add_fetch(&in_use, (uint32_t)n, __ATOMIC_RELAXED);
+    uint32_t was = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+    while (now > was &&
+           !__atomic_compare_exchange_n(&peak, &was, now, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+        ;
+    return p + MEMMON_HEADER;
+}
+
+/*! \brief free() for mem_alloc() blocks; NULL is fine
+*/
+void mem_free(void *p) {
+    if (!p)
+        return;
+    uint8_t *base = (uint8_t *)p - MEMMON_HEADER;
+    __atomic_fetch_sub(&in_use, *(uint32_t *)base, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&frees, 1, __ATOMIC_RELAXED);
+    free(base);
+}
+
+void memmon_heap(memmon_heap_t *out) {
+    out->in_use = __atomic_load_n(&in_use, __ATOMIC_RELAXED);
+    out->peak = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+    for (int c = 0; c < 2; c++)
+        out->allocs[c] = __atomic_load_n(&allocs[c], __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&frees, __ATOMIC_RELAXED);
+    out->failed = __atomic_load_n(&failed, __ATOMIC_RELAXED);
+}
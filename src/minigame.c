@@ -4,174 +4,445 @@
 #include "pico/stdlib.h"
 #include "pico/time.h"
 #include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "chart.h"
+#include "chart_default.h"
+#include "judge.h"
+#include "evsched.h"
+#include "replay.h"
+#include "boot.h"
+#include "seqlock.h"
+#include "trace.h"
+#include "dlog.h"
+#include "perfmon.h"
 #include "minigame.h"
 
-static int score = 0; // Combo count
-static bool chg = false; // If combo changed
-static uint8_t current_target = 255;   // 0–15 = valid, 255 = no target
-static uint8_t prev_target = 255;
+// The next target is written to the Seesaw this long before it lights,
+// so only the SHOW is left for the beat itself
+#define BEAT_STAGE_LEAD_MS 40
+
+// Notes light this long before their beat
+#define LIGHT_LEAD_MS 100
+
+// Notes that can be lit at once (open, not yet closed)
+#define GAME_WINDOW 8
 
-// Condition control variables for gameplay reaction time
-static bool cur_check = false;
-static bool nxt_check = false;
-static uint8_t keyHit = 0;
+// Keypad poll and LED writes
+#define GAME_INPUT_PERIOD_US 1000
+
+// Deadlines in the scheduler stats: a note task done this long after its
+// due time is a late light or judgement; a stage must be done well
+// before the beat it stages for
+#define GAME_BEAT_DEADLINE_US 2000
+#define GAME_STAGE_DEADLINE_US (BEAT_STAGE_LEAD_MS * 1000 / 2)
+// A tick that brings key events waits out the COUNT + FIFO turnaround,
+// which the beat guard is sized for; one held past that is a miss
+#define GAME_INPUT_DEADLINE_US I2C_SCHED_BEAT_GUARD_US
+
+static int score = 0; // Combo count
 
-// BPM control
-static int bpm = 120;                  // change this for speed
-static uint32_t beat_interval_ms = 0;
-static uint32_t last_beat_ms = 0;
-static uint32_t nxt_beat_ms = 0;
+// What the renderer (or anything off the game tasks) sees of the round:
+// written whole every input tick and after any other task that judged,
+// read with game_snapshot()
+SEQLOCK_DEFINE(snap, game_snapshot_t)
+static uint32_t snap_version = 0;
+static bool snap_dirty = false; // score or counts changed since the last write
+
+// Timing windows (half widths): +- 100ms for reaction time at most
+static const judge_windows_t windows = JUDGE_WINDOWS_DEFAULT;
+
+// Chart and the cursors that walk it for display: a note lights at open,
+// turns to the warning colour on its beat and goes dark at close. The
+// judgement itself is in judge.c.
+static chart_t chart;
+static const uint8_t *chart_image = chart_default;
+static uint32_t chart_image_len = sizeof(chart_default);
+static chart_cursor_t open_cur;
+static chart_cursor_t beat_cur;
+static chart_cursor_t close_cur;
+static bool staged = false; // next note already in the Seesaw buffer
+static bool finished = true; // no round running
+static judge_callback_t observer = NULL;
+static void (*idle_keys)(keyEvent evt) = NULL;
+
+// Rounds are recorded unless a replay is set; while one plays, live keys
+// are ignored and its events come in through the keypad callback
+static replay_t *replay = NULL;
+static bool injecting = false;
+static uint64_t inject_at = 0;  // song position of the event being fed in
+static uint32_t game_seed = 0;
+
+// Lanes of hit hold notes stay lit until the judge ends the hold
+static uint64_t held = 0;
 
 // Game duration (30 seconds)
 static uint32_t game_duration_ms = 33000;  // 33 s
 static uint32_t game_start_ms = 0;
 
-static uint8_t beats[70] = {0}; 
-static uint8_t cur_idx = 0;
-
-bool valid_hit = false;
-bool miss = false;
-
-static void advance_beat(bool clear, bool update, uint8_t* target) {
-    printf("Advancing beat...\n");
-
-    // If target is valid or a valid hit was registered
-    if(((*target) != 255 || valid_hit) && clear){
-         if (!valid_hit) {
-            miss = true;
-            chg = true;
-            if(prev_target!= current_target)
-                set_pixel_color(*target, 0, 0 ,0);
-            *target = 255;
-         }
-         else{
-            valid_hit = false;
-            if(prev_target!= current_target)
-                set_pixel_color(keyHit, 0, 0 ,0);
-            chg = false;
-         }
+// Work runs as timed tasks (evsched.c) instead of a polling loop: each
+// cursor task sleeps until its next note is due
+static evsched_task_t t_input;
+static evsched_task_t t_open;
+static evsched_task_t t_beat;
+static evsched_task_t t_close;
+static evsched_task_t t_stage;
+static evsched_task_t t_end;
+static evsched_task_t t_replay;
+
+static void set_lanes(uint64_t lanes, uint8_t r, uint8_t g, uint8_t b) {
+    while (lanes) {
+        int key = __builtin_ctzll(lanes);
+        lanes &= lanes - 1;
+        set_pixel_color(key, r, g, b);
     }
+}
 
-    if(update){
-        chg = false;
-        *target = beats[cur_idx++];
-        printf("New target key index: %u\n", *target);
-        // Hatsune Miku blue
-        set_pixel_color(*target, 0, 220, 255);
+// Song position in chart samples. Derived from song_clock_us() like the
+// task times below, so a task that is due always finds its note reached.
+static uint64_t song_pos(void) {
+    return song_clock_us() * chart.rate / 1000000;
+}
 
-        printf("Target %u lit in Hatsune Miku blue.\n", *target);
-    }
+// Song time of a song position, rounded up so song_pos() has reached it
+static uint64_t pos_song_us(uint64_t at) {
+    return (at * 1000000 + chart.rate - 1) / chart.rate;
+}
 
-    show_pixels();
+// Song time at which a cursor reaches its next note
+static uint64_t cursor_due_us(const chart_cursor_t *cur) {
+    int64_t at = (int64_t)chart.notes[cur->next].time + cur->offset;
+    return at > 0 ? pos_song_us((uint64_t)at) : 0;
 }
 
-//when user presses a key
-static TrellisCallback printKey(keyEvent evt) {
+// Queue a cursor task for its next note
+static void schedule_cursor(evsched_task_t *task, const chart_cursor_t *cur) {
+    if (chart_cursor_done(cur))
+        return;
+    evsched_at(task, to_us_since_boot(song_clock_to_abs(cursor_due_us(cur))));
+}
 
-    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING) {
+/*! \brief Upload the next note and arm its SHOW for the song time it lights
+    \param idx note index
+*/
+static void stage_next_target(uint32_t idx) {
+    // Hatsune Miku blue
+    set_lanes(chart.notes[idx].lanes, 0, 220, 255);
+    staged = i2c_sched_stage_show(cursor_due_us(&open_cur)) == 0;
+}
 
-        if (evt.NUM == current_target || evt.NUM == prev_target) {
-            score++;
-            chg = true;
-            printf("Correct key! New score = %d\n", score);
-
-            // Clear LEDs and wait for next beat
-            if (current_target!= prev_target)
-                set_pixel_color(evt.NUM == prev_target?  prev_target: current_target, 152, 251, 152);
-            valid_hit = true;
-            show_pixels();
-
-            if (evt.NUM == prev_target){
-                keyHit = prev_target;
-                prev_target = 255;
-            }
-            else{
-                keyHit = current_target;
-                current_target = 255; 
-            }
-        } else {
-            printf("Wrong key pressed.\n");
-        }
+static void open_note(uint32_t idx) {
+    // Per-note logs are deferred: stdio would block right at the beat
+    DLOG("Note %u open, lanes %llx\n", idx, DLOG_U64(chart.notes[idx].lanes));
+    if (staged) {
+        // Colour is already in the Seesaw; the beat alarm sends the SHOW
+        staged = false;
+        return;
     }
-
-    return 0;
+    set_lanes(chart.notes[idx].lanes, 0, 220, 255);
+    show_pixels();
 }
 
-// Initialize game
-void game_init(void) {
-    printf("Initializing game logic...\n");
-    init_keypad(printKey);
+static void beat_note(uint32_t idx) {
+    uint64_t left = chart.notes[idx].lanes & ~judge_hit_lanes(idx);
+    if (!left) return;
+    //warning color
+    set_lanes(left, 100, 0, 0);
+    show_pixels();
+}
 
-    srand(250);
-    // Set up beat timing
-    beat_interval_ms = 60000 / bpm;
-    last_beat_ms = to_ms_since_boot(get_absolute_time());
-    game_start_ms = last_beat_ms;
-    clear_all_pixels();
+static void close_note(uint32_t idx) {
+    set_lanes(chart.notes[idx].lanes & ~held, 0, 0, 0);
+    show_pixels();
+}
 
-    // Avoid overlapping keys (really hard to catch when playing)
-    for(int i = 0; i<70; i++){
-        beats[i] = rand() % NEO_TRELLIS_NUM_KEYS;
-        if(i>0 && beats[i] == beats[i-1])
-            beats[i] = (beats[i] + 1) % NEO_TRELLIS_NUM_KEYS;
+// Feedback colour per grade
+static const uint8_t grade_color[JUDGE_GRADES][3] = {
+    [JUDGE_PERFECT] = {152, 251, 152},
+    [JUDGE_GREAT] = {255, 215, 0},
+    [JUDGE_GOOD] = {255, 140, 0},
+    [JUDGE_MISS] = {0, 0, 0},
+};
+
+static void on_judge(const judge_event_t *ev) {
+    switch (ev->kind) {
+    case JUDGE_EV_HIT:
+        score++;
+        DLOG("Note %u lane %u grade %d offset %d\n", ev->note, ev->lane, ev->grade, ev->offset);
+        set_pixel_color(ev->lane, grade_color[ev->grade][0], grade_color[ev->grade][1],
+                        grade_color[ev->grade][2]);
+        show_pixels();
+        perfmon_led_wait(ev->lane, neo_read_began_us());
+        if (chart.notes[ev->note].hold)
+            held |= 1ull << ev->lane;
+        break;
+    case JUDGE_EV_MISS:
+        score = 0;
+        DLOG("Note %u lane %u missed\n", ev->note, ev->lane);
+        break;
+    case JUDGE_EV_HOLD_DROP:
+        score = 0;
+        // fall through
+    case JUDGE_EV_HOLD_OK:
+        held &= ~(1ull << ev->lane);
+        set_pixel_color(ev->lane, 0, 0, 0);
+        show_pixels();
+        break;
+    case JUDGE_EV_STRAY:
+        DLOG("Wrong key %u pressed.\n", ev->lane);
+        break;
     }
+    // Strays change nothing on screen
+    if (ev->kind != JUDGE_EV_STRAY)
+        snap_dirty = true;
+    if (observer)
+        observer(ev);
+}
 
-    printf("BPM = %d → beat_interval_ms = %u ms\n", bpm, beat_interval_ms);
-    printf("Game duration = %u ms (~33 s)\n", game_duration_ms);
+/*! \brief Write the snapshot: the song position every time, the judgement
+    (and a new version) only when it changed
+    \param now song position
+*/
+static void publish(uint64_t now) {
+    game_snapshot_t s;
+    static game_snapshot_t last;
+    if (snap_dirty) {
+        judge_stats_t st;
+        judge_get_stats(&st);
+        last.version = ++snap_version;
+        last.combo = score;
+        last.max_combo = st.max_combo;
+        last.accuracy = judge_accuracy_permille(&st);
+        for (int g = 0; g < JUDGE_GRADES; g++)
+            last.count[g] = st.count[g];
+        snap_dirty = false;
+        TRACE_INSTANT(TRACE_SNAPSHOT, snap_version);
+    }
+    s = last;
+    s.song_pos = now;
+    s.running = !finished;
+    snap_write(&s);
 }
 
-//One "step" of the game
-void game_step(void) {
-    uint32_t now = to_ms_since_boot(get_absolute_time());
-    if (miss){
-        score = 0;
-        miss = false;
+//when user presses a key
+static TrellisCallback printKey(keyEvent evt) {
+    if (finished) {
+        // Between rounds (attract, results)
+        if (idle_keys) idle_keys(evt);
+        return 0;
+    }
+    uint64_t now = song_pos();
+    if (replay) {
+        if (!injecting) return 0;
+        now = inject_at;
+    }
+    if (evt.EDGE == SEESAW_KEYPAD_EDGE_RISING) {
+        replay_record(evt.NUM, true, now);
+        judge_press(evt.NUM, now);
+    } else if (evt.EDGE == SEESAW_KEYPAD_EDGE_FALLING) {
+        replay_record(evt.NUM, false, now);
+        judge_release(evt.NUM, now);
     }
+    return 0;
+}
 
-    // 1) Time's up?
-    if (now - game_start_ms >= game_duration_ms) {
-        printf("Time's up! Final score = %d\n", score);
-        clear_all_pixels();
+// Keypad events first, then queued LED writes. The tick waits out the
+// keypad turnaround, so the period counts from its end to leave the lower
+// priorities room. Windows are closed up to where the tick started: key
+// events it hands over are no earlier, and a replayed event due meanwhile
+// must still find its note open.
+static void input_task(evsched_task_t *t, uint64_t now_us) {
+    uint64_t now = song_pos();
+    i2c_sched_tick();
+    judge_update(now);
+    publish(now);
+    // Start the next read now: its turnaround runs while the core sleeps
+    // (the frame blit it used to overlap is on core1)
+    i2c_sched_poll_begin();
+    evsched_at(t, time_us_64() + GAME_INPUT_PERIOD_US);
+}
 
-        // park here - or you could add restart logic, etc.
-        while (1) {
-            sleep_ms(1000);
-        }
+static void open_task(evsched_task_t *t, uint64_t now_us) {
+    uint64_t now = song_pos();
+    int32_t idx;
+    // Window full: later notes wait (and light late) rather than overwrite
+    while (open_cur.next - close_cur.next < GAME_WINDOW &&
+           (idx = chart_cursor_take(&open_cur, now)) >= 0)
+        open_note(idx);
+    if (open_cur.next - close_cur.next >= GAME_WINDOW) {
+        // t_close queues this again once a note has closed
+        return;
     }
+    schedule_cursor(t, &open_cur);
+    // Stage the next note in the slack before it lights
+    if (!chart_cursor_done(&open_cur)) {
+        uint64_t lead = (uint64_t)BEAT_STAGE_LEAD_MS * 1000;
+        uint64_t due = cursor_due_us(&open_cur);
+        evsched_at(&t_stage, to_us_since_boot(song_clock_visual_to_abs(due > lead ? due - lead : 0)));
+    }
+}
 
-    // Always process keypad events
-    neo_read();
+static void stage_task(evsched_task_t *t, uint64_t now_us) {
+    if (!staged && !chart_cursor_done(&open_cur) &&
+        open_cur.next - close_cur.next < GAME_WINDOW &&
+        to_us_since_boot(song_clock_visual_to_abs(cursor_due_us(&open_cur))) > time_us_64())
+        stage_next_target(open_cur.next);
+}
 
-    // Pad timing by +- 100ms for reaction time
-    if (now - last_beat_ms + 100 >= beat_interval_ms && !cur_check) {
-        cur_check = true;
-        nxt_check = false;
-        prev_target = current_target;
+static void beat_task(evsched_task_t *t, uint64_t now_us) {
+    int32_t idx;
+    while ((idx = chart_cursor_take(&beat_cur, song_pos())) >= 0)
+        beat_note(idx);
+    boot_first_beat();
+    schedule_cursor(t, &beat_cur);
+}
 
-        //only update the beat, don't clear the pixel
-        advance_beat(false, true, &current_target);
+static void close_task(evsched_task_t *t, uint64_t now_us) {
+    uint64_t now = song_pos();
+    judge_update(now);
+    int32_t idx;
+    bool closed = false;
+    while ((idx = chart_cursor_take(&close_cur, now)) >= 0) {
+        close_note(idx);
+        closed = true;
     }
+    schedule_cursor(t, &close_cur);
+    // Misses found here reach the renderer without waiting for the tick
+    if (snap_dirty)
+        publish(now);
+    if (closed && !evsched_queued(&t_open))
+        evsched_at(&t_open, now_us);
+}
 
-    if (now - last_beat_ms >= beat_interval_ms && !nxt_check){
-        //update next beat time
-        nxt_beat_ms = now;
-        nxt_check = true;
+// Feed the replay events that are due through the keypad callback, each
+// at its recorded song position
+static void replay_task(evsched_task_t *t, uint64_t now_us) {
+    uint64_t now = song_pos();
+    replay_event_t ev;
+    injecting = true;
+    while (replay_peek(replay, &ev) && ev.at <= now) {
+        replay_next(replay, &ev);
+        inject_at = ev.at;
+        keyEvent evt = { ev.press ? SEESAW_KEYPAD_EDGE_RISING : SEESAW_KEYPAD_EDGE_FALLING, ev.key };
+        neo_dispatch(evt);
+    }
+    injecting = false;
+    if (snap_dirty)
+        publish(now);
+    if (replay_peek(replay, &ev))
+        evsched_at(t, to_us_since_boot(song_clock_to_abs(pos_song_us(ev.at))));
+}
 
-        //warning color
-        set_pixel_color(prev_target, 100, 0, 0);
-        show_pixels();
+static void end_task(evsched_task_t *t, uint64_t now_us) {
+    printf("Time's up! Final score = %d\n", score);
+    evsched_cancel(&t_replay);
+    evsched_cancel(&t_input);
+    evsched_cancel(&t_open);
+    evsched_cancel(&t_beat);
+    evsched_cancel(&t_close);
+    evsched_cancel(&t_stage);
+    i2c_sched_cancel_beat();
+    clear_all_pixels();
+    judge_print_stats();
+    i2c_sched_print_stats();
+    evsched_print_stats();
+    if (replay_recording()) {
+        judge_stats_t st;
+        judge_get_stats(&st);
+        if (!replay_record_finish(score, st.max_combo, judge_accuracy_permille(&st), NULL))
+            printf("WARNING: Replay log full, events dropped\n");
     }
+    finished = true;
+    publish(song_pos());
+}
+
+/*! \brief One-time setup: keypad edges and callbacks, I2C scheduler
+    (about 32 Seesaw writes, so not repeated for every round)
+*/
+void game_setup(void) {
+    printf("Initializing game logic...\n");
+    init_keypad(printKey);
+    i2c_sched_init(I2C_SCHED_LED_BUDGET_US);
+}
+
+// Initialize game: setup and a round against the running song clock
+void game_init(void) {
+    game_setup();
+    game_start();
+}
 
-    if (now - last_beat_ms - 100 >= beat_interval_ms){
-        cur_check = false;
+/*! \brief Start a round against the song clock, which must be running:
+    chart cursors, judge and tasks reset, no peripheral set up again
+*/
+void game_start(void) {
+    chart_err_t err = chart_open(&chart, chart_image, chart_image_len);
+    if (err != CHART_OK)
+        printf("ERROR: Chart rejected: %s\n", chart_strerror(err));
+    else if (chart.rate != CHART_SAMPLE_RATE)
+        printf("WARNING: Chart written for %u Hz, playback is %u Hz\n",
+               (unsigned)chart.rate, (unsigned)CHART_SAMPLE_RATE);
+
+    // Notes follow the song, not the time since boot
+    game_start_ms = song_clock_ms();
+    chart_cursor_init(&open_cur, &chart, -(int32_t)chart_ms_to_samples(&chart, LIGHT_LEAD_MS));
+    chart_cursor_init(&beat_cur, &chart, 0);
+    chart_cursor_init(&close_cur, &chart,
+                      (int32_t)chart_ms_to_samples(&chart, windows.good_ms) + 1);
+    uint64_t now = song_pos();
+    chart_cursor_seek(&open_cur, now);
+    chart_cursor_seek(&beat_cur, now);
+    chart_cursor_seek(&close_cur, now);
+    judge_init(&chart, &windows, on_judge);
+    judge_seek(now);
+    score = 0;
+    finished = false;
+    staged = false;
+    held = 0;
+    snap_dirty = true;
+    publish(now);
+    clear_all_pixels();
 
-        //update reference interval time, clear previous pixel
-        advance_beat(true, false, &prev_target);
-        last_beat_ms = nxt_beat_ms;
+    evsched_task(&t_input, "input", EVS_PRIO_INPUT, input_task, NULL);
+    evsched_task(&t_open, "open", EVS_PRIO_BEAT, open_task, NULL);
+    evsched_task(&t_beat, "beat", EVS_PRIO_BEAT, beat_task, NULL);
+    evsched_task(&t_close, "close", EVS_PRIO_BEAT, close_task, NULL);
+    evsched_task(&t_stage, "stage", EVS_PRIO_LED, stage_task, NULL);
+    evsched_task(&t_end, "end", EVS_PRIO_BEAT, end_task, NULL);
+    evsched_task(&t_replay, "replay", EVS_PRIO_BEAT, replay_task, NULL);
+    // A tick must be done before the next one is due
+    evsched_timing(&t_input, 0, GAME_INPUT_DEADLINE_US);
+    evsched_timing(&t_open, 0, GAME_BEAT_DEADLINE_US);
+    evsched_timing(&t_beat, 0, GAME_BEAT_DEADLINE_US);
+    evsched_timing(&t_close, 0, GAME_BEAT_DEADLINE_US);
+    evsched_timing(&t_stage, 0, GAME_STAGE_DEADLINE_US);
+    uint64_t t0 = time_us_64();
+    evsched_at(&t_input, t0);
+    evsched_at(&t_open, t0);
+    schedule_cursor(&t_beat, &beat_cur);
+    schedule_cursor(&t_close, &close_cur);
+    evsched_at(&t_end, to_us_since_boot(song_clock_to_abs(
+                           (uint64_t)(game_start_ms + game_duration_ms) * 1000)));
+    if (replay) {
+        replay_event_t ev;
+        replay_rewind(replay);
+        if (replay->hdr->chart_crc != (chart.hdr ? chart.hdr->crc32 : 0))
+            printf("WARNING: Replay was recorded on another chart\n");
+        if (replay_peek(replay, &ev))
+            evsched_at(&t_replay, to_us_since_boot(song_clock_to_abs(pos_song_us(ev.at))));
+    } else {
+        replay_record_start(chart.hdr ? chart.hdr->crc32 : 0, chart.rate, game_seed);
     }
+    evsched_reset_stats();
 
-    // tiny sleep so we don't busy-loop too hard
-    sleep_ms(1);
+    printf("Chart: %u notes, %u lanes\n", (unsigned)chart.count, (unsigned)chart.lanes);
+    printf("Game duration = %u ms (~33 s)\n", game_duration_ms);
+}
+
+/*! \brief Run the next due game (or frame) task, sleeping until one is due
+*/
+void game_step(void) {
+    if (finished) return;
+    evsched_run_once();
 }
 
 // Return combo
@@ -179,7 +450,57 @@ int game_get_combo(void) {
     return score;
 }
 
-// If combo changed since last update
-bool get_chg(void){
-    return chg;
-}
\ No newline at end of file
+/*! \brief Consistent copy of the round's state, safe from any task or core
+    \param out filled in; out->version changes when the score, combo or
+    judgement counts do, so a renderer can skip frames where it did not
+*/
+void game_snapshot(game_snapshot_t *out) {
+    snap_read(out);
+}
+
+// Round over (or none started); game_step() does nothing until the next game_start()
+bool game_finished(void) {
+    return finished;
+}
+
+/*! \brief Chart the next game_start() plays
+    \param image chart image (flash array or loaded file), must stay valid
+    \param len image size, or NULL image for the built-in chart
+*/
+void game_set_chart(const uint8_t *image, uint32_t len) {
+    chart_image = image ? image : chart_default;
+    chart_image_len = image ? len : sizeof(chart_default);
+}
+
+// Chart opened by the last game_start()
+const chart_t *game_chart(void) {
+    return &chart;
+}
+
+/*! \brief Also pass every judgement to cb (trace, replay, tests)
+    \param cb called after the game has handled the judgement, NULL to stop
+*/
+void game_set_observer(judge_callback_t cb) {
+    observer = cb;
+}
+
+/*! \brief Play back a recorded round instead of live keys
+    \param r opened replay, must stay valid; NULL to play (and record) live
+*/
+void game_set_replay(replay_t *r) {
+    replay = r;
+}
+
+/*! \brief Seed stored with the replay of the next round
+    \param seed scripted player or shuffle seed, 0 if none
+*/
+void game_set_seed(uint32_t seed) {
+    game_seed = seed;
+}
+
+/*! \brief Where keys go while no round is running (attract, results)
+    \param cb key handler, NULL to drop them
+*/
+void game_set_idle_keys(void (*cb)(keyEvent evt)) {
+    idle_keys = cb;
+}
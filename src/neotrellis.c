@@ -6,7 +6,17 @@
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
 #include "neotrellis.h"
+#include "i2c_sched.h"
+#include "trace.h"
+#include "hotpath.h"
 #include <stdlib.h>
+#include <string.h>
+
+TrellisCallback (*_callbacks[NEO_TRELLIS_MAX_KEYS])(keyEvent);
+
+// Board layout, boards are numbered row major across the play field
+static uint8_t num_boards = NEO_TRELLIS_NUM_BOARDS;
+static uint8_t board_cols = NEO_TRELLIS_BOARD_COLS;
 
 /*! \brief Initialize I2C, corresponding SDA, SCK pins
 */
@@ -16,6 +26,7 @@ void init_i2c(){
     gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SDA_PIN);
     gpio_pull_up(I2C_SCL_PIN);
+    neotrellis_config_reset();
 }
 
 /*! \brief Find corresponding trellis key number on the keypad given key index
@@ -24,29 +35,285 @@ uint8_t neotrellis_key_finder(uint8_t key_num) {
     return ((key_num/8) * 4 + (key_num%8));
 }
 
+/*! \brief Set how many boards are tiled and how many sit side by side
+    \param boards number of boards, at NEOTRELLIS_ADDR onwards
+    \param cols boards per row of the play field
+    \return 0 if the layout is valid
+*/
+int neotrellis_set_layout(uint8_t boards, uint8_t cols) {
+    if (boards == 0 || boards > NEO_TRELLIS_MAX_BOARDS || cols == 0 || boards % cols)
+        return -1;
+    num_boards = boards;
+    board_cols = cols;
+    return 0;
+}
+
+uint8_t HOT_FUNC(neotrellis_num_boards)(void) {
+    return num_boards;
+}
+
+uint8_t neotrellis_num_keys(void) {
+    return num_boards * NEO_TRELLIS_KEYS_PER_BOARD;
+}
+
+/*! \brief Global key index (row major over the whole play field)
+    \param board board number
+    \param local key index 0-15 on that board
+*/
+uint8_t neotrellis_key_index(uint8_t board, uint8_t local) {
+    uint8_t width = board_cols * 4;
+    uint8_t x = (board % board_cols) * 4 + local % 4;
+    uint8_t y = (board / board_cols) * 4 + local / 4;
+    return y * width + x;
+}
+
+/*! \brief Board a global key index lives on
+*/
+uint8_t neotrellis_key_board(uint8_t key) {
+    uint8_t width = board_cols * 4;
+    return ((key / width) / 4) * board_cols + (key % width) / 4;
+}
+
+/*! \brief Key index 0-15 on its own board for a global key index
+*/
+uint8_t neotrellis_key_local(uint8_t key) {
+    uint8_t width = board_cols * 4;
+    return ((key / width) % 4) * 4 + (key % width) % 4;
+}
+
+// Configuration writes waiting for their board's settle time
+typedef struct {
+    uint8_t reg_high;
+    uint8_t reg_low;
+    uint8_t len;
+    uint8_t data[NEO_CONFIG_DATA_MAX];
+} config_write_t;
+
+static config_write_t config_q[NEO_TRELLIS_MAX_BOARDS][NEO_CONFIG_DEPTH];
+static uint8_t config_head[NEO_TRELLIS_MAX_BOARDS];
+static uint8_t config_len[NEO_TRELLIS_MAX_BOARDS];
+static uint64_t config_ready_at[NEO_TRELLIS_MAX_BOARDS];
+static bool config_deferred = false;
+static uint32_t config_failed = 0;
+
+// When the board takes its next write: after the Seesaw has started up,
+// and after the settle time of its last configuration write
+static uint64_t HOT_FUNC(ready_at)(uint8_t board) {
+    uint64_t at = config_ready_at[board];
+    return at > NEO_TRELLIS_BOOT_MS * 1000ull ? at : NEO_TRELLIS_BOOT_MS * 1000ull;
+}
+
+// Wait out what is left of that; in SRAM for the raw writes, and only a
+// board still settling calls into flash (sleep_us())
+static void HOT_FUNC(settle)(uint8_t board) {
+    uint64_t now = hot_time_us_64();
+    if (now < ready_at(board))
+        sleep_us(ready_at(board) - now);
+}
+
+// Send a board's oldest queued configuration write
+static int config_send(uint8_t board) {
+    config_write_t *w = &config_q[board][config_head[board]];
+    uint8_t buf[2 + NEO_CONFIG_DATA_MAX];
+    buf[0] = w->reg_high;
+    buf[1] = w->reg_low;
+    memcpy(&buf[2], w->data, w->len);
+    config_head[board] = (config_head[board] + 1) % NEO_CONFIG_DEPTH;
+    config_len[board]--;
+
+    i2c_sched_bus_begin();
+    int result = i2c_write_blocking(I2C_PORT, NEOTRELLIS_ADDR + board, buf, w->len + 2, false);
+    i2c_sched_bus_end(w->len + 3);
+    // The next write to this board waits until then, others do not
+    config_ready_at[board] = time_us_64() + NEO_CONFIG_SETTLE_US;
+    if (result <= 0) {
+        config_failed++;
+        return -1;
+    }
+    return 0;
+}
+
+// Drop queued configuration writes and settle deadlines (new bus)
+void neotrellis_config_reset(void) {
+    memset(config_head, 0, sizeof(config_head));
+    memset(config_len, 0, sizeof(config_len));
+    memset(config_ready_at, 0, sizeof(config_ready_at));
+    config_deferred = false;
+    config_failed = 0;
+}
+
+/*! \brief Send every configuration write whose board has settled
+    \return 0 once nothing is queued, else the time (us since boot) the
+    next write is due; call again then
+*/
+uint64_t neotrellis_config_step(void) {
+    uint64_t next = 0;
+    for (int b = 0; b < NEO_TRELLIS_MAX_BOARDS; b++) {
+        if (config_len[b] && ready_at(b) <= time_us_64())
+            config_send(b);
+        if (config_len[b] && (next == 0 || ready_at(b) < next))
+            next = ready_at(b);
+    }
+    return next;
+}
+
+/*! \brief Send all queued configuration writes, sleeping until each is due
+    \return 0 if all of them were acknowledged
+*/
+int neotrellis_config_flush(void) {
+    uint32_t failed = config_failed;
+    uint64_t at;
+    while ((at = neotrellis_config_step()) != 0) {
+        uint64_t now = time_us_64();
+        if (at > now)
+            sleep_us(at - now);
+    }
+    // Boards settled before returning, as callers expect
+    for (int b = 0; b < NEO_TRELLIS_MAX_BOARDS; b++)
+        settle(b);
+    return config_failed == failed ? 0 : -1;
+}
+
+/*! \brief Queue configuration writes instead of sending them
+    While deferred, init_neopixels() and init_keypad() return as soon as
+    their writes are queued, and the caller drains the queue with
+    neotrellis_config_step() between other work (boot).
+*/
+void neotrellis_config_defer(bool defer) {
+    config_deferred = defer;
+}
+
+// Configuration writes not acknowledged since boot
+uint32_t neotrellis_config_failed(void) {
+    return config_failed;
+}
+
 /*! \brief Write data to Seesaw register
+    The Seesaw needs NEO_CONFIG_SETTLE_US after a configuration write before
+    the next one to the same board. That is a deadline kept per board, so
+    writes to other boards, or other work, can fill the wait.
+    \param board board to write to
+    \param regHigh higher precedence register address for data source 
+    \param regLow lower precedence register address for data source
+    \param data data to write to the register
+    \param len length of data in bytes (at most NEO_CONFIG_DATA_MAX)
+    \return 0 if data is written successfully (or queued, while deferred)
+*/
+static int seesaw_write(uint8_t board, uint8_t regHigh, uint8_t regLow, uint8_t *data, uint8_t len) {
+    if (config_len[board] == NEO_CONFIG_DEPTH)
+        neotrellis_config_flush();
+    config_write_t *w = &config_q[board][(config_head[board] + config_len[board]) % NEO_CONFIG_DEPTH];
+    w->reg_high = regHigh;
+    w->reg_low = regLow;
+    w->len = len > NEO_CONFIG_DATA_MAX ? NEO_CONFIG_DATA_MAX : len;
+    memcpy(w->data, data, w->len);
+    config_len[board]++;
+    if (config_deferred)
+        return 0;
+    return neotrellis_config_flush();
+}
+
+/*! \brief Write data to Seesaw register without the settle delay
+    Used by the bus scheduler for NeoPixel traffic, which the Seesaw accepts
+    back to back. Configuration writes still go through seesaw_write().
+    \param board board to write to
     \param regHigh higher precedence register address for data source 
     \param regLow lower precedence register address for data source
     \param data data to write to the register
     \param len length of data in bytes
     \return 0 if data is written successfully
 */
-static int seesaw_write(uint8_t regHigh, uint8_t regLow, uint8_t *data, uint8_t len) {
+int HOT_FUNC(seesaw_write_raw)(uint8_t board, uint8_t regHigh, uint8_t regLow, const uint8_t *data, uint8_t len) {
     uint8_t buf[34];
     buf[0] = regHigh;
     buf[1] = regLow;
-    
+
     for (int i = 0; i < len; i++) {
         buf[2 + i] = data[i];
     }
-    
-    int result = i2c_write_blocking(I2C_PORT, NEOTRELLIS_ADDR, buf, len + 2, false);
-    sleep_ms(5); // Increased delay for more reliable communication
-    
+
+    settle(board);
+    i2c_sched_bus_begin();
+    int result = i2c_write_blocking(I2C_PORT, NEOTRELLIS_ADDR + board, buf, len + 2, false);
+    i2c_sched_bus_end(len + 3);
+
     return result > 0 ? 0 : -1;
 }
 
+/*! \brief Address phase of a Seesaw read
+    \param board board to read from
+    \param regHigh higher precedence register address for data source 
+    \param regLow lower precedence register address for data source
+    \return if the board acknowledged
+*/
+static bool HOT_FUNC(seesaw_read_prefix)(uint8_t board, uint8_t regHigh, uint8_t regLow) {
+    uint8_t prefix[2];
+    prefix[0] = (uint8_t)regHigh;
+    prefix[1] = (uint8_t)regLow;
+
+    settle(board);
+    i2c_sched_bus_begin();
+    int result = i2c_write_blocking(I2C_PORT, NEOTRELLIS_ADDR + board, prefix, 2, false);
+    i2c_sched_bus_end(3);
+    return result >= 0;
+}
+
+/*! \brief Data phase of a Seesaw read, once the turnaround delay has passed
+    \param board board to read from
+    \param buf address to write to
+    \param len length of data to read (at most 32)
+    \return if data is read successfully
+*/
+static bool HOT_FUNC(seesaw_read_data)(uint8_t board, uint8_t *buf, uint8_t len) {
+    i2c_sched_bus_begin();
+    int result = i2c_read_blocking(I2C_PORT, NEOTRELLIS_ADDR + board, buf, len, false);
+    i2c_sched_bus_end(len + 1);
+    return result >= 0;
+}
+
+/*! \brief Start a split-phase read: send the register address and return
+    The Seesaw needs \p delay us before the data can be read. The caller can
+    do other work meanwhile and complete the read with seesaw_read_finish().
+    Nothing else may be sent to the same board until then, since any write
+    moves the Seesaw's register pointer.
+    \param rd handle to fill in
+    \param board board to read from
+    \param regHigh higher precedence register address for data source 
+    \param regLow lower precedence register address for data source
+    \param delay turnaround time the Seesaw needs, in us
+    \return if the board acknowledged
+*/
+bool seesaw_read_begin(seesaw_read_t *rd, uint8_t board, uint8_t regHigh, uint8_t regLow, uint16_t delay) {
+    rd->board = board;
+    rd->ok = seesaw_read_prefix(board, regHigh, regLow);
+    rd->ready_us = time_us_32() + delay;
+    return rd->ok;
+}
+
+/*! \brief Check if the turnaround of a split-phase read has passed
+*/
+bool seesaw_read_ready(const seesaw_read_t *rd) {
+    return (int32_t)(time_us_32() - rd->ready_us) >= 0;
+}
+
+/*! \brief Complete a split-phase read, waiting out what is left of the turnaround
+    \param rd handle from seesaw_read_begin()
+    \param buf address to write to
+    \param len length of data to read (at most 32)
+    \return if data is read successfully
+*/
+bool seesaw_read_finish(seesaw_read_t *rd, uint8_t *buf, uint8_t len) {
+    if (!rd->ok)
+        return false;
+    int32_t wait = (int32_t)(rd->ready_us - time_us_32());
+    if (wait > 0)
+        sleep_us(wait);
+    rd->ok = false;
+    return seesaw_read_data(rd->board, buf, len);
+}
+
 /*! \brief Read data from Seesaw
+    \param board board to read from
     \param regHigh higher precedence register address for data source 
     \param regLow lower precedence register address for data source
     \param buf address to write to
@@ -54,18 +321,15 @@ static int seesaw_write(uint8_t regHigh, uint8_t regLow, uint8_t *data, uint8_t
     \param delay time to wait between reading and writing from I2C 
     \return if data is read successfully
 */
-static bool seesaw_read(uint8_t regHigh, uint8_t regLow, uint8_t *buf, uint8_t len, uint16_t delay) {
+static bool seesaw_read(uint8_t board, uint8_t regHigh, uint8_t regLow, uint8_t *buf, uint8_t len, uint16_t delay) {
     uint8_t pos = 0;
-    uint8_t prefix[2];
-    prefix[0] = (uint8_t)regHigh;
-    prefix[1] = (uint8_t)regLow;
+    seesaw_read_t rd;
 
     while (pos<len) {
         uint8_t read_now = MIN(32,len-pos);
-        if(i2c_write_blocking(I2C_PORT, NEOTRELLIS_ADDR, prefix, 2, false) < 0)
+        if(!seesaw_read_begin(&rd, board, regHigh, regLow, delay))
             return false;
-        sleep_us(delay);
-        if(i2c_read_blocking(I2C_PORT, NEOTRELLIS_ADDR, buf + pos, read_now, false) < 0)
+        if(!seesaw_read_finish(&rd, buf + pos, read_now))
             return false;
             
         pos+=read_now;
@@ -73,125 +337,272 @@ static bool seesaw_read(uint8_t regHigh, uint8_t regLow, uint8_t *buf, uint8_t l
     return true;
 }
 
-/*! \brief Get event count from Seesaw count 
-    \return Number of events occurred from last poll
+/*! \brief Read from keypad fifo register
+    \param board board to read from
+    \param buf bufferr to write the data read to
+    \param count value from count register
+    \return if fifo is successfully read
+*/
+bool readKeypad(uint8_t board, keyEvent *buf, uint8_t count) {
+    return seesaw_read(board, SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_FIFO, (uint8_t*)buf, count, 1000);
+}
+
+/* Keypad poll pipeline. COUNT is read from every board through one shared
+   turnaround; boards with events then get their FIFO read the same way.
+   neo_read_begin() only sends the COUNT address phases, so the turnaround
+   can overlap rendering; neo_read_poll() moves the pipeline on without
+   blocking and neo_read_finish() waits for whatever is left. */
+enum {
+    NEO_READ_IDLE = 0,
+    NEO_READ_COUNT,
+    NEO_READ_FIFO,
+};
+
+static uint8_t read_state = NEO_READ_IDLE;
+static uint64_t read_began_us = 0;
+static seesaw_read_t pending[NEO_TRELLIS_MAX_BOARDS];
+static uint8_t fifo_count[NEO_TRELLIS_MAX_BOARDS];
+
+// Synthetic events (stress mode) queued per board in FIFO format. A poll
+// takes them after the board's own events, within the same per-poll cap.
+static keyEvent inject_q[NEO_TRELLIS_MAX_BOARDS][NEO_INJECT_DEPTH];
+static uint8_t inject_len[NEO_TRELLIS_MAX_BOARDS];
+static uint8_t inject_take[NEO_TRELLIS_MAX_BOARDS];
+static uint32_t inject_dropped = 0;
+
+/*! \brief Hand the events of one board to their callbacks
 */
-static uint8_t getCount(void) {
-    uint8_t count = 0;
+static void dispatch(uint8_t board, keyEvent *e, uint8_t count) {
+    for (int i = 0; i<count; i++) {
 
-    // From Arduino src code 
-    seesaw_read(SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_COUNT, &count, 1, 1000);
+        // Convert weird keypad number to key index
+        uint8_t local = neotrellis_key_finder(e[i].NUM);
+        if (local >= NEO_TRELLIS_KEYS_PER_BOARD)
+            continue;
+        uint8_t key = neotrellis_key_index(board, local);
 
-    return count;
+        keyEvent evt = {e[i].EDGE, key};
+        neo_dispatch(evt);
+    }
 }
 
-/*! \brief Read from keypad fifo register
-    \param buf bufferr to write the data read to
-    \param count value from count register
-    \return if fifo is successfully read
+/*! \brief Hand one key event to its callback, as a keypad poll does
+    (replay and synthetic input come in here)
+    \param evt edge and key index
 */
-bool readKeypad(keyEvent *buf, uint8_t count) {
-    return seesaw_read(SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_FIFO, (uint8_t*)buf, count, 1000);
-    
-    // printf("\nbuffer %d, %d", buf[count].NUM, buf[count].EDGE);
+void neo_dispatch(keyEvent evt){
+    // If valid key, and corresponding fxn exists, run it
+    if(evt.NUM < NEO_TRELLIS_MAX_KEYS && _callbacks[evt.NUM] != NULL){
+        _callbacks[evt.NUM](evt);
+    }
 }
 
-/*! \brief continuously poll keypad for events, call associated function when event detected
+/*! \brief Queue a synthetic key event for the next keypad poll
+    \param key key index
+    \param edge SEESAW_KEYPAD_EDGE_RISING or _FALLING
+    \return false if the board's queue is full (event dropped)
 */
-void neo_read(){
-    // Get event count from count register
-    uint8_t count = getCount();
-    sleep_us(500);
+bool neo_inject(uint8_t key, uint8_t edge){
+    uint8_t b = neotrellis_key_board(key);
+    if (b >= num_boards)
+        return false;
+    if (inject_len[b] == NEO_INJECT_DEPTH) {
+        inject_dropped++;
+        return false;
+    }
+    keyEvent e = {edge, button_num[neotrellis_key_local(key)]};
+    inject_q[b][inject_len[b]++] = e;
+    return true;
+}
 
-    if (count > 0){
-        count += 2; //because no interrupt pin
+// Synthetic events dropped because a queue was full
+uint32_t neo_inject_dropped(){
+    return inject_dropped;
+}
 
-        // Creates keyEvent array with "count" number of events 
-        keyEvent e[count];
+/*! \brief Hand the synthetic events a poll took to their callbacks
+*/
+static void dispatch_injected(){
+    for (int b = 0; b < num_boards; b++) {
+        uint8_t n = inject_take[b];
+        if (!n)
+            continue;
+        inject_take[b] = 0;
+        keyEvent e[NEO_INJECT_DEPTH];
+        memcpy(e, inject_q[b], n * sizeof(keyEvent));
+        // Keep the rest for the next poll
+        inject_len[b] -= n;
+        memmove(inject_q[b], inject_q[b] + n, inject_len[b] * sizeof(keyEvent));
+        dispatch(b, e, n);
+    }
+}
 
-        // Read the corresponding events from the FIFO register
-        readKeypad(e, count);
-        for (int i = 0; i<count; i++) {
+/*! \brief Start a keypad poll: send COUNT address phases to every board
+*/
+void neo_read_begin(){
+    if (read_state != NEO_READ_IDLE)
+        return;
+    for (int b = 0; b < num_boards; b++)
+        seesaw_read_begin(&pending[b], b, SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_COUNT, 1000);
+    read_state = NEO_READ_COUNT;
+    read_began_us = time_us_64();
+    TRACE_ASYNC_BEGIN(TRACE_KEY_POLL, 0);
+}
 
-            // Convert weird keypad number to key index
-            e[i].NUM = neotrellis_key_finder(e[i].NUM);
+/*! \brief Advance the keypad poll as far as possible without waiting
+    \param block wait out turnarounds instead of returning
+    \return true once the poll is complete
+*/
+static bool neo_read_step(bool block) {
+    static keyEvent e[NEO_TRELLIS_MAX_BOARDS][NEO_TRELLIS_FIFO_MAX + 2];
+    bool started = read_state != NEO_READ_IDLE;
+
+    if (read_state == NEO_READ_COUNT) {
+        // Boards share one turnaround, the last one to be addressed is the latest
+        if (!block && !seesaw_read_ready(&pending[num_boards - 1]))
+            return false;
 
-            // If valid key, and corresponding fxn exists, run it
-            if(e[i].NUM < NEO_TRELLIS_NUM_KEYS && _callbacks[e[i].NUM] != NULL){
-                keyEvent evt = {e[i].EDGE, e[i].NUM};
-                _callbacks[e[i].NUM](evt);
+        bool any = false;
+        for (int b = 0; b < num_boards; b++) {
+            uint8_t count = 0;
+            if (!seesaw_read_finish(&pending[b], &count, 1) || count == 0xFF)
+                count = 0;
+            if (count > NEO_TRELLIS_FIFO_MAX)
+                count = NEO_TRELLIS_FIFO_MAX;
+            // Synthetic events fill what the board's own leave of the cap
+            uint8_t room = NEO_TRELLIS_FIFO_MAX - count;
+            inject_take[b] = inject_len[b] < room ? inject_len[b] : room;
+            if (count > 0)
+                count += 2; //because no interrupt pin
+            fifo_count[b] = count;
+        }
+
+        // Pipeline straight into the FIFO reads of the boards that have events
+        for (int b = 0; b < num_boards; b++) {
+            if (fifo_count[b]) {
+                seesaw_read_begin(&pending[b], b, SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_FIFO, 1000);
+                any = true;
             }
         }
+        read_state = any ? NEO_READ_FIFO : NEO_READ_IDLE;
     }
+
+    if (read_state == NEO_READ_FIFO) {
+        for (int b = 0; b < num_boards; b++) {
+            if (!fifo_count[b])
+                continue;
+            if (!block && !seesaw_read_ready(&pending[b]))
+                return false;
+            if (seesaw_read_finish(&pending[b], (uint8_t*)e[b], fifo_count[b]))
+                dispatch(b, e[b], fifo_count[b]);
+            fifo_count[b] = 0;
+        }
+        read_state = NEO_READ_IDLE;
+    }
+    if (started)
+        TRACE_ASYNC_END(TRACE_KEY_POLL, 0);
+    dispatch_injected();
+    // A beat SHOW may have been held back for this read
+    i2c_sched_bus_idle();
+    return true;
+}
+
+/*! \brief Move a started keypad poll on without blocking
+    \return true once the poll is complete (callbacks have run)
+*/
+bool neo_read_poll(){
+    return neo_read_step(false);
+}
+
+/*! \brief Complete a started keypad poll, waiting where needed
+*/
+void neo_read_finish(){
+    neo_read_step(true);
+}
+
+/*! \brief Check if a keypad poll is in flight
+*/
+bool HOT_FUNC(neo_read_busy)(){
+    return read_state != NEO_READ_IDLE;
+}
+
+/*! \brief Start of the latest keypad poll: an event it hands out was on
+    the board by then (one poll period after the press at most)
+*/
+uint64_t neo_read_began_us(){
+    return read_began_us;
+}
+
+/*! \brief continuously poll keypad for events, call associated function when event detected
+    Boards are polled interleaved: the COUNT address phase goes to every board,
+    then one turnaround delay covers all of them before the counts are read.
+    The FIFO reads work the same way, so adding boards adds bus time but not
+    more 1 ms waits.
+*/
+void neo_read(){
+    neo_read_begin();
+    neo_read_finish();
 }
 
 
 // Initialize NeoPixels on the NeoTrellis
 int init_neopixels() {
     uint8_t pin = 3; // NeoPixel pin on Seesaw
-    
-    // Set NeoPixel pin
-    if (seesaw_write(SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_PIN, &pin, 1) < 0) {
-        printf("Failed to set NeoPixel pin\n");
-        return -1;
-    }
-    
-    // Set NeoPixel speed (800 KHz)
     uint8_t speed = 1;
-    if (seesaw_write(SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SPEED, &speed, 1) < 0) {
-        printf("Failed to set NeoPixel speed\n");
-        return -1;
-    }
     uint8_t buf = 0x01;
-    seesaw_write(SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_INTENSET, &buf, 1);
 
     // Set buffer length (16 pixels * 3 bytes per pixel = 48 bytes)
-    uint16_t buf_len = NEO_TRELLIS_NUM_KEYS * 3;  
+    uint16_t buf_len = NEO_TRELLIS_KEYS_PER_BOARD * 3;  
     uint8_t len_data[2] = {(buf_len >> 8) & 0xFF, buf_len & 0xFF};
-    if (seesaw_write(SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF_LENGTH, len_data, 2) < 0) {
-        printf("Failed to set buffer length\n");
+
+    // Queued together so the boards settle in parallel
+    bool defer = config_deferred;
+    config_deferred = true;
+    for (int b = 0; b < num_boards; b++) {
+        // Set NeoPixel pin
+        seesaw_write(b, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_PIN, &pin, 1);
+        // Set NeoPixel speed (800 KHz)
+        seesaw_write(b, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SPEED, &speed, 1);
+        seesaw_write(b, SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_INTENSET, &buf, 1);
+        seesaw_write(b, SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF_LENGTH, len_data, 2);
+    }
+    config_deferred = defer;
+    if (!defer && neotrellis_config_flush() < 0) {
+        printf("Failed to set up NeoPixels on %d board(s)\n", num_boards);
         return -1;
     }
-    printf("Set NeoPixel buffer length to %d bytes\n", buf_len);
+    printf("Set NeoPixel buffer length to %d bytes on %d board(s)\n", buf_len, num_boards);
     
     return 0;
 }
 
 int set_pixel_color(uint8_t pixel, uint8_t r, uint8_t g, uint8_t b) { 
-    if (pixel >= NEO_TRELLIS_NUM_KEYS) return -1;
-
-    uint8_t buf[5];
-    uint16_t offset = pixel * 3;
-
-    buf[0] = (offset >> 8) & 0xFF;
-    buf[1] = offset & 0xFF;
+    if (pixel >= neotrellis_num_keys()) return -1;
 
     // Seesaw NeoPixels use GRB order
-    buf[2] = g;
-    buf[3] = r;
-    buf[4] = b;
+    // Queued; the bus scheduler sends it after the next keypad poll
+    i2c_sched_set_pixel(neotrellis_key_board(pixel), neotrellis_key_local(pixel), g, r, b);
 
-    int result = seesaw_write(SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF, buf, 5);
-    sleep_ms(2);
-
-    return result;
+    return 0;
 }
 
 
 // Show the pixels (update display)
 int show_pixels() {
-    uint8_t dummy = 0;
-    return seesaw_write(SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SHOW, &dummy, 0);
+    i2c_sched_show();
+    return 0;
 }
 
 // Clear all pixels
 int clear_all_pixels() {
-    for (int i = 0; i < NEO_TRELLIS_NUM_KEYS; i++) {
+    for (int i = 0; i < neotrellis_num_keys(); i++) {
         if (set_pixel_color(i, 0, 0, 0) < 0) {
             return -1;
         }
     }
-    return show_pixels();
+    int result = show_pixels();
+    i2c_sched_flush();
+    return result;
 }
 
 //function for fading the led in and out
@@ -214,6 +625,7 @@ void fade_pixel_miku(uint8_t pixel, uint32_t duration_ms) {
 
         set_pixel_color(pixel, r, g, b);
         show_pixels();
+        i2c_sched_flush();
         sleep_ms(step_delay);
     }
 
@@ -225,12 +637,14 @@ void fade_pixel_miku(uint8_t pixel, uint32_t duration_ms) {
 
         set_pixel_color(pixel, r, g, b);
         show_pixels();
+        i2c_sched_flush();
         sleep_ms(step_delay);
     }
 
     // End fully off
     set_pixel_color(pixel, 0, 0, 0);
     show_pixels();
+    i2c_sched_flush();
 }
 
 /*! \brief Makeshift "interrupt" function to test keypad input
@@ -251,16 +665,17 @@ void fade_pixel_miku(uint8_t pixel, uint32_t duration_ms) {
 // }
 
 /*! \brief Enable/disable key event
+    \param board board the key is on
     \param key the corresponding key number
     \param edge the edge event to enable
     \param en enable or disable
 */
-void setKeypadEv(uint8_t key, uint8_t edge, bool en){
+void setKeypadEv(uint8_t board, uint8_t key, uint8_t edge, bool en){
     union keyState ks;
     ks.bit.STATE = en;
     ks.bit.ACTIVE = (1<<edge);
     uint8_t cmd[] = {key, ks.reg};
-    seesaw_write(SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_EVENT, cmd, 2);
+    seesaw_write(board, SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_EVENT, cmd, 2);
 }
 
 /*! \brief Set corresponding key function
@@ -275,9 +690,20 @@ void regCallback(uint8_t key, TrellisCallback(*cb)(keyEvent)){
     \param cb the "interrupt" function to set
 */
 void init_keypad(TrellisCallback(*cb)(keyEvent)){
-    for(int i = 0; i < NEO_TRELLIS_NUM_KEYS; i++){
-        setKeypadEv(button_num[i], SEESAW_KEYPAD_EDGE_FALLING, true);
-        setKeypadEv(button_num[i], SEESAW_KEYPAD_EDGE_RISING, true);
-        regCallback(i, cb);
+    // A poll left half done by a previous round is abandoned
+    read_state = NEO_READ_IDLE;
+    for (int b = 0; b < NEO_TRELLIS_MAX_BOARDS; b++)
+        inject_len[b] = inject_take[b] = 0;
+    bool defer = config_deferred;
+    config_deferred = true;
+    for(int b = 0; b < num_boards; b++){
+        for(int i = 0; i < NEO_TRELLIS_KEYS_PER_BOARD; i++){
+            setKeypadEv(b, button_num[i], SEESAW_KEYPAD_EDGE_FALLING, true);
+            setKeypadEv(b, button_num[i], SEESAW_KEYPAD_EDGE_RISING, true);
+            regCallback(neotrellis_key_index(b, i), cb);
+        }
     }
+    config_deferred = defer;
+    if (!defer && neotrellis_config_flush() < 0)
+        printf("Failed to enable keypad events on %d board(s)\n", num_boards);
 }
\ No newline at end of file
@@ -0,0 +1,367 @@
+/* Performance monitor: windows of live stats and latched warnings
+    Everything here runs on core0. Frames come from render_service() (the
+    reports core1 sends back), refills from audio_service(), hit LEDs from
+    the game and the SHOW hook; the bus time and both cores' scheduler
+    counters are read when a window closes. A window is PERFMON_WINDOW_US
+    of a low priority task, so closing one never gets near a beat.
+
+    Audio slack is how long the DMA could still have played when a refill
+    was done: the buffer just filled has to be ready before the other one
+    runs out, one buffer's time after the IRQ that freed it. The LED
+    latency of a hit runs from the start of the keypad poll that brought
+    the press to the SHOW that lit its colour, so it leaves out up to one
+    poll period before that. Stacks are scanned for their paint and the
+    heap counters read as the window closes (memmon.c).
+
+    The view goes to core1 through a seqlock; core1 formats it with
+    perfmon_format() and draws only the characters that changed.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "evsched.h"
+#include "seqlock.h"
+#include "dlog.h"
+#include "memmon.h"
+#include "perfmon.h"
+#include "hotpath.h"
+
+#ifdef SIM_HOST
+// One thread: no IRQ to keep out
+#define irq_save() 0u
+#define irq_restore(s) ((void)(s))
+#else
+#include "hardware/sync.h"
+#define irq_save() save_and_disable_interrupts()
+#define irq_restore(s) restore_interrupts(s)
+#endif
+
+SEQLOCK_DEFINE(view, perfmon_view_t)
+
+static const char *const warn_names[PERFMON_WARNS] = {
+    [PERFMON_WARN_FRAME] = "FRM",
+    [PERFMON_WARN_AUDIO] = "AUD",
+    [PERFMON_WARN_I2C] = "I2C",
+    [PERFMON_WARN_LED] = "LED",
+    [PERFMON_WARN_IDLE0] = "ID0",
+    [PERFMON_WARN_IDLE1] = "ID1",
+    [PERFMON_WARN_DEADLINE0] = "DL0",
+    [PERFMON_WARN_DEADLINE1] = "DL1",
+    [PERFMON_WARN_STACK0] = "ST0",
+    [PERFMON_WARN_STACK1] = "ST1",
+};
+
+static evsched_task_t t_mon;
+static i2c_sched_show_hook_t next_hook = NULL;
+static perfmon_view_t last;             // the view as last published
+static uint64_t window_start = 0;
+static bool frames_seen = false;        // core1 has drawn since the start
+
+// The open window
+static uint32_t frames = 0;
+static uint32_t frame_worst = 0;
+static int32_t slack_min = 0;
+static uint32_t refills = 0;
+static uint64_t bus_before = 0;
+static evsched_load_t load_before[EVS_CORES];
+static uint32_t allocs_before[2];
+
+// Hit LEDs, shared with the SHOW hook (beat alarm IRQ)
+static uint64_t led_since[NEO_TRELLIS_MAX_KEYS]; // by pixel
+static volatile uint64_t led_waiting = 0;
+static uint32_t led_samples = 0;
+static uint64_t led_sum = 0;
+static uint32_t led_max = 0;
+
+/*! \brief A frame core1 finished (core0, as its report comes in)
+*/
+void perfmon_frame(uint32_t took_us) {
+    frames++;
+    frames_seen = true;
+    if (took_us > frame_worst)
+        frame_worst = took_us;
+}
+
+/*! \brief A buffer refilled (core0)
+    \param slack_us time the DMA still had on the other buffer; < 0 = it ran dry
+*/
+void perfmon_audio(int32_t slack_us) {
+    if (!refills || slack_us < slack_min)
+        slack_min = slack_us;
+    refills++;
+}
+
+/*! \brief A hit's colour is waiting for a SHOW (core0 task)
+    \param pixel key index
+    \param since_us when the press was read (neo_read_began_us())
+*/
+void perfmon_led_wait(uint8_t pixel, uint64_t since_us) {
+    if (pixel >= NEO_TRELLIS_MAX_KEYS)
+        return;
+    uint32_t s = irq_save();
+    // A second hit before the first was shown counts from the first
+    if (!(led_waiting & (1ull << pixel))) {
+        led_since[pixel] = since_us;
+        led_waiting |= 1ull << pixel;
+    }
+    irq_restore(s);
+}
+
+// Pixels whose hit colour went out with this SHOW (task or beat alarm;
+// SRAM, hotpath.h)
+static void HOT_FUNC(on_show)(uint64_t unshown) {
+    if (next_hook)
+        next_hook(unshown);
+    uint64_t done = led_waiting & ~unshown;
+    if (!done)
+        return;
+    led_waiting &= ~done;
+    uint64_t now = hot_time_us_64();
+    while (done) {
+        uint8_t p = __builtin_ctzll(done);
+        done &= done - 1;
+        uint32_t lat = (uint32_t)(now - led_since[p]);
+        led_samples++;
+        led_sum += lat;
+        if (lat > led_max)
+            led_max = lat;
+    }
+}
+
+static void publish(void) {
+    view_write(&last);
+}
+
+static uint32_t per_mille(uint64_t part, uint32_t whole) {
+    uint64_t pm = part * 1000 / whole;
+    return pm > 1000 ? 1000 : (uint32_t)pm;
+}
+
+/*! \brief Close the window: work out its figures, latch warnings, publish
+    (the perfmon task; sim benches call it directly)
+*/
+void perfmon_window(void) {
+    uint64_t now = time_us_64();
+    uint32_t us = (uint32_t)(now - window_start);
+    if (!us)
+        return;
+    perfmon_view_t v = last;
+    v.version++;
+    v.window_us = us;
+    v.frames = frames;
+    v.fps_x10 = (uint32_t)((uint64_t)frames * 10000000 / us);
+    v.frame_worst_us = frame_worst;
+    v.refills = refills;
+    v.audio_slack_us = refills ? slack_min : 0;
+
+    // The bus counters start over with i2c_sched_reset_stats()
+    i2c_sched_stats_t bus;
+    i2c_sched_get_stats(&bus);
+    if (bus.bus_us < bus_before)
+        bus_before = 0;
+    v.i2c_permille = per_mille(bus.bus_us - bus_before, us);
+    bus_before = bus.bus_us;
+
+    uint32_t s = irq_save();
+    v.led_samples = led_samples;
+    v.led_avg_us = led_samples ? (uint32_t)(led_sum / led_samples) : 0;
+    v.led_max_us = led_max;
+    led_samples = 0;
+    led_sum = 0;
+    led_max = 0;
+    irq_restore(s);
+
+    v.sched_on = 0;
+    for (uint32_t c = 0; c < EVS_CORES; c++) {
+        evsched_load_t l;
+        evsched_get_load(c, &l);
+        if (l.passes != load_before[c].passes)
+            v.sched_on |= 1u << c;
+        v.idle_permille[c] = per_mille(l.idle_us - load_before[c].idle_us, us);
+        v.misses[c] = l.misses - load_before[c].misses;
+        load_before[c] = l;
+    }
+
+    memmon_heap_t heap;
+    memmon_heap(&heap);
+    v.heap_in_use = heap.in_use;
+    v.heap_peak = heap.peak;
+    for (uint32_t c = 0; c < 2; c++) {
+        memmon_stack_t st;
+        memmon_stack(c, &st);
+        v.stack_used[c] = st.used_max;
+        v.stack_size[c] = st.size;
+        v.allocs[c] = heap.allocs[c] - allocs_before[c];
+        allocs_before[c] = heap.allocs[c];
+    }
+
+    uint32_t w = 0;
+    if (frame_worst > PERFMON_FRAME_WARN_US ||
+        (frames_seen && v.fps_x10 < PERFMON_FPS_WARN_X10))
+        w |= 1u << PERFMON_WARN_FRAME;
+    if (refills && slack_min < PERFMON_AUDIO_WARN_US)
+        w |= 1u << PERFMON_WARN_AUDIO;
+    if (v.i2c_permille > PERFMON_I2C_WARN_PERMILLE)
+        w |= 1u << PERFMON_WARN_I2C;
+    if (v.led_max_us > PERFMON_LED_WARN_US)
+        w |= 1u << PERFMON_WARN_LED;
+    for (uint32_t c = 0; c < EVS_CORES; c++) {
+        if ((v.sched_on & (1u << c)) && v.idle_permille[c] < PERFMON_IDLE_WARN_PERMILLE)
+            w |= 1u << (PERFMON_WARN_IDLE0 + c);
+        if (v.misses[c])
+            w |= 1u << (PERFMON_WARN_DEADLINE0 + c);
+    }
+    for (uint32_t c = 0; c < 2; c++)
+        if (v.stack_size[c] && per_mille(v.stack_used[c], v.stack_size[c]) >=
+                                   PERFMON_STACK_WARN_PERMILLE)
+            w |= 1u << (PERFMON_WARN_STACK0 + c);
+    v.warn_now = w;
+    for (uint32_t fresh = w & ~v.warn; fresh; fresh &= fresh - 1)
+        DLOG("perfmon: %s warning latched\n", DLOG_STR(warn_names[__builtin_ctz(fresh)]));
+    v.warn |= w;
+
+    last = v;
+    publish();
+    frames = 0;
+    frame_worst = 0;
+    refills = 0;
+    window_start = now;
+}
+
+static void mon_task(evsched_task_t *t, uint64_t now_us) {
+    perfmon_window();
+}
+
+/*! \brief Start the windows and watch the SHOWs; core0, after
+    evsched_init(). The overlay starts off, with nothing latched.
+*/
+void perfmon_start(void) {
+    last = (perfmon_view_t){ 0 };
+    frames = 0;
+    frame_worst = 0;
+    refills = 0;
+    frames_seen = false;
+    i2c_sched_stats_t bus;
+    i2c_sched_get_stats(&bus);
+    bus_before = bus.bus_us;
+    for (uint32_t c = 0; c < EVS_CORES; c++)
+        evsched_get_load(c, &load_before[c]);
+    memmon_heap_t heap;
+    memmon_heap(&heap);
+    for (uint32_t c = 0; c < 2; c++)
+        allocs_before[c] = heap.allocs[c];
+    uint32_t s = irq_save();
+    led_waiting = 0;
+    led_samples = 0;
+    led_sum = 0;
+    led_max = 0;
+    irq_restore(s);
+    i2c_sched_show_hook_t was = i2c_sched_set_show_hook(on_show);
+    if (was != on_show)
+        next_hook = was;
+    publish();
+
+    window_start = time_us_64();
+    evsched_task(&t_mon, "perfmon", EVS_PRIO_FRAME, mon_task, NULL);
+    evsched_timing(&t_mon, PERFMON_WINDOW_US, 0);
+    evsched_at(&t_mon, window_start + PERFMON_WINDOW_US);
+}
+
+/*! \brief Latest view, from either core
+    \return its seqlock sequence
+*/
+uint32_t perfmon_read(perfmon_view_t *out) {
+    return view_read(out);
+}
+
+/*! \brief Show or hide the overlay (core0); closing it clears the warnings,
+    so the next ones to latch are new
+*/
+void perfmon_overlay_toggle(void) {
+    last.overlay = !last.overlay;
+    if (!last.overlay)
+        last.warn = 0;
+    publish();
+}
+
+void perfmon_clear_warnings(void) {
+    last.warn = 0;
+    publish();
+}
+
+const char *perfmon_warn_name(perfmon_warn_t w) {
+    return w < PERFMON_WARNS ? warn_names[w] : "?";
+}
+
+// "12.3ms" from microseconds, "-0.4ms" if below zero
+static int put_ms(char *p, size_t n, int32_t us) {
+    uint32_t a = us < 0 ? (uint32_t)-us : (uint32_t)us;
+    return snprintf(p, n, "%s%u.%ums", us < 0 ? "-" : "", (unsigned)(a / 1000),
+                    (unsigned)(a % 1000 / 100));
+}
+
+static int put_pct(char *p, size_t n, const perfmon_view_t *v, uint32_t core) {
+    if (!(v->sched_on & (1u << core)))
+        return snprintf(p, n, "--");
+    return snprintf(p, n, "%u%%", (unsigned)(v->idle_permille[core] / 10));
+}
+
+static int put_stack(char *p, size_t n, const perfmon_view_t *v, uint32_t core) {
+    if (!v->stack_size[core])
+        return snprintf(p, n, "--");
+    return snprintf(p, n, "%u", (unsigned)v->stack_used[core]);
+}
+
+/*! \brief The overlay's text, each line padded with spaces to PERFMON_COLS
+    (core1, or the sim)
+*/
+void perfmon_format(const perfmon_view_t *v, char line[PERFMON_LINES][PERFMON_COLS + 1]) {
+    char slack[16], led[24], idle[2][12], stack[2][12];
+    if (v->refills)
+        put_ms(slack, sizeof(slack), v->audio_slack_us);
+    else
+        snprintf(slack, sizeof(slack), "--");
+    if (v->led_samples) {
+        // "avg/max", one unit for both
+        int n = put_ms(led, sizeof(led), v->led_avg_us) - 2;
+        led[n++] = '/';
+        put_ms(led + n, sizeof(led) - n, v->led_max_us);
+    } else {
+        snprintf(led, sizeof(led), "--");
+    }
+    for (uint32_t c = 0; c < 2; c++) {
+        put_pct(idle[c], sizeof(idle[c]), v, c);
+        put_stack(stack[c], sizeof(stack[c]), v, c);
+    }
+    uint32_t per_s[2];
+    for (uint32_t c = 0; c < 2; c++)
+        per_s[c] = v->window_us ? (uint32_t)((uint64_t)v->allocs[c] * 1000000 / v->window_us) : 0;
+
+    char text[PERFMON_LINES][80];
+    snprintf(text[0], sizeof(text[0]), "FPS %u.%u FRAME %u.%ums AUDIO %s",
+             (unsigned)(v->fps_x10 / 10), (unsigned)(v->fps_x10 % 10),
+             (unsigned)(v->frame_worst_us / 1000), (unsigned)(v->frame_worst_us % 1000 / 100),
+             slack);
+    snprintf(text[1], sizeof(text[1]), "I2C %u%% LED %s IDLE %s/%s",
+             (unsigned)(v->i2c_permille / 10), led, idle[0], idle[1]);
+    // Stack bytes used, heap bytes in use/peak, allocations a second
+    snprintf(text[2], sizeof(text[2]), "STK %s/%s HEAP %u/%u A/s %u/%u", stack[0], stack[1],
+             (unsigned)v->heap_in_use, (unsigned)v->heap_peak, (unsigned)per_s[0],
+             (unsigned)per_s[1]);
+    int n = snprintf(text[3], sizeof(text[3]), v->warn ? "WARN" : "OK");
+    for (uint32_t w = 0; w < PERFMON_WARNS; w++)
+        if (v->warn & (1u << w))
+            n += snprintf(text[3] + n, sizeof(text[3]) - n, " %s", warn_names[w]);
+
+    for (int l = 0; l < PERFMON_LINES; l++) {
+        size_t len = strlen(text[l]);
+        if (len > PERFMON_COLS)
+            len = PERFMON_COLS;
+        memcpy(line[l], text[l], len);
+        memset(line[l] + len, ' ', PERFMON_COLS - len);
+        line[l][PERFMON_COLS] = 0;
+    }
+}
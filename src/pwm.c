@@ -3,35 +3,57 @@
 #include "hardware/dma.h"
 #include "hardware/structs/dma.h"
 #include "hardware/structs/pwm.h"
+#include "hardware/structs/timer.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "songclock.h"
+#include "chan.h"
+#include "audio.h"
+#include "trace.h"
+#include "perfmon.h"
+#include "hotpath.h"
+#include "xipmon.h"
 #include <stdint.h>
 #include <stdbool.h>
 
 #define AUDIO_GPIO 27
 #define PWM_TOP 3905
 #define BUFFER_SIZE 1024
+#define PWM_CLKDIV 1.22f
 
-uint16_t pwm_buffer[2][BUFFER_SIZE];
-int current_buffer = 0;
-bool buffer_ready[2] = {false, false};
-bool playback_active = true;
+// Shared with the DMA IRQ (core0 as well)
+static uint16_t pwm_buffer[2][BUFFER_SIZE];
+static volatile int current_buffer = 0;
+static volatile bool buffer_ready[2] = {false, false};
+static volatile bool playback_active = true;
+// When the DMA let go of each buffer; the refill has one buffer's time
+static volatile uint32_t freed_us[2];
+static uint32_t buffer_us = 0;
 
-int dma_chan;
+static int dma_chan;
 
-void dma_handler() {
+// In SRAM, registers written directly (hotpath.h)
+void HOT_FUNC(dma_handler)() {
     dma_hw->ints0 = 1u << dma_chan;
+    TRACE_INSTANT(TRACE_AUDIO_IRQ, current_buffer);
 
     if (playback_active) {
+        song_clock_buffer_done(BUFFER_SIZE);
+        freed_us[current_buffer] = timer_hw->timerawl;
         buffer_ready[current_buffer] = true;
         current_buffer ^= 1;
-        dma_channel_set_read_addr(dma_chan, pwm_buffer[current_buffer], true);
+        // dma_channel_set_read_addr(), triggering
+        dma_hw->ch[dma_chan].al3_read_addr_trig = (uintptr_t)pwm_buffer[current_buffer];
     }
+    // Wake the core0 loop even if the IRQ came just before its WFE
+    __sev();
 }
 
 void init_pwm_dma() {
     gpio_set_function(AUDIO_GPIO, GPIO_FUNC_PWM);
     uint slice = pwm_gpio_to_slice_num(AUDIO_GPIO);
     pwm_set_wrap(slice, PWM_TOP);
-    pwm_set_clkdiv(slice, 1.22f);
+    pwm_set_clkdiv(slice, PWM_CLKDIV);
     pwm_set_chan_level(slice, pwm_gpio_to_channel(AUDIO_GPIO), PWM_TOP / 2);
     pwm_set_enabled(slice, true);
 
@@ -57,11 +79,273 @@ void init_pwm_dma() {
     irq_set_enabled(DMA_IRQ_0, true);
 }
 
-void fill_pwm_buffer(uint16_t* dest, const uint8_t* src, int count, float multiplier) {
+// One sample per PWM wrap
+uint32_t pwm_sample_rate() {
+    return (uint32_t)(clock_get_hz(clk_sys) / (PWM_CLKDIV * (PWM_TOP + 1)));
+}
+
+// The refill's loop, forced inline: the SRAM copy and the flash one each
+// have all of it
+static inline __attribute__((always_inline)) void fill_samples(uint16_t *dest, const uint8_t *src,
+                                                              int count, float multiplier) {
     for (int i = 0; i < count; i++) {
         int16_t sample = src[0] | (src[1] << 8);
         src += 2;
         sample = sample * multiplier;
         dest[i] = ((int32_t)sample + 32768) * PWM_TOP / 65535;
     }
-}
\ No newline at end of file
+}
+
+void HOT_FUNC(fill_pwm_buffer)(uint16_t* dest, const uint8_t* src, int count, float multiplier) {
+    fill_samples(dest, src, count, multiplier);
+}
+
+#ifdef XIP_BENCH
+// The same loop left in flash, for xipmon_bench()
+void __attribute__((noinline)) fill_pwm_buffer_flash(uint16_t *dest, const uint8_t *src,
+                                                     int count, float multiplier) {
+    fill_samples(dest, src, count, multiplier);
+}
+#endif
+
+float get_multiplier();
+
+// Requests from the game, round flow and calibration (core0 tasks) to the
+// audio engine (core0 loop)
+typedef enum {
+    AUDIO_CMD_PLAY,
+    AUDIO_CMD_CLICK,
+    AUDIO_CMD_STOP,
+    AUDIO_CMD_VOLUME,
+} audio_cmd_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t audible;            ///< CLICK
+    uint16_t volume;            ///< VOLUME, permille
+    uint32_t period;            ///< CLICK, samples
+} audio_cmd_t;
+
+#define AUDIO_CMD_DEPTH 8
+CHAN_DEFINE(audio_cmds, audio_cmd_t, AUDIO_CMD_DEPTH, CHAN_DOORBELL)
+
+// Requester side: commands sent; core0 side: commands handled, and if the
+// DMA is streaming once they are
+static uint32_t cmds_sent = 0;
+static uint32_t cmds_done = 0;
+static uint32_t playing = 0;
+
+// Track and where the refill is (core0)
+static const uint8_t *track = NULL;
+static uint32_t track_samples = 0;
+static uint32_t samples_played = 0;
+static uint32_t click_period = 0;       // samples between clicks, 0 = the track
+static bool click_audible = true;
+static uint16_t volume = 1000;          // permille, on top of the pot
+
+/*! \brief Set the track (16-bit little endian mono PCM); call on core0
+    after init_pwm_dma()
+    \param pcm first sample
+    \param samples number of samples
+*/
+void audio_init(const uint8_t *pcm, uint32_t samples) {
+    track = pcm;
+    track_samples = samples;
+}
+
+// Metronome click: a decaying square wave, higher on every fourth beat
+#define CLICK_MS 25
+#define CLICK_HZ 1000
+#define CLICK_ACCENT_HZ 2000
+#define CLICK_LEVEL 12000
+
+/*! \brief Synthesize the click track into a buffer (no asset needed)
+    \param dest PWM buffer
+    \param from stream position of the first sample
+    \param count samples
+    \param multiplier volume
+*/
+static void fill_click_buffer(uint16_t *dest, uint32_t from, int count, float multiplier) {
+    uint32_t rate = pwm_sample_rate();
+    uint32_t len = rate * CLICK_MS / 1000;
+    int32_t level = click_audible ? (int32_t)(CLICK_LEVEL * multiplier) : 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t pos = from + i;
+        uint32_t phase = pos % click_period;
+        int32_t sample = 0;
+        if (phase < len) {
+            uint32_t hz = (pos / click_period) % 4 == 0 ? CLICK_ACCENT_HZ : CLICK_HZ;
+            int32_t amp = level * (int32_t)(len - phase) / (int32_t)len;
+            sample = ((uint64_t)phase * hz * 2 / rate) & 1 ? -amp : amp;
+        }
+        dest[i] = (sample + 32768) * PWM_TOP / 65535;
+    }
+}
+
+// Fill one buffer with the next part of the track (or the click track,
+// which does not end); false once it is all out
+static bool refill(int i) {
+    if (click_period) {
+        float multiplier = get_multiplier() * volume / 1000;
+        fill_click_buffer(pwm_buffer[i], samples_played, BUFFER_SIZE, multiplier);
+        buffer_ready[i] = false;
+        samples_played += BUFFER_SIZE;
+        return true;
+    }
+    int count = track_samples - samples_played;
+    if (count > BUFFER_SIZE) count = BUFFER_SIZE;
+    if (count <= 0)
+        return false;
+    float multiplier = get_multiplier() * volume / 1000;
+    fill_pwm_buffer(pwm_buffer[i], track + samples_played * 2, count, multiplier);
+    buffer_ready[i] = false;
+    samples_played += count;
+    return true;
+}
+
+static void halt(void) {
+    playback_active = false;
+    dma_channel_abort(dma_chan);
+    uint slice = pwm_gpio_to_slice_num(AUDIO_GPIO);
+    pwm_set_chan_level(slice, pwm_gpio_to_channel(AUDIO_GPIO), PWM_TOP / 2);
+    song_clock_stop();
+    __atomic_store_n(&playing, 0, __ATOMIC_RELAXED);
+}
+
+/*! \brief Rewind and start the track: prefill both buffers, start the DMA
+    and the song clock (core0, from audio_service())
+*/
+static void start(void) {
+    // A round still playing is cut off
+    halt();
+    samples_played = 0;
+    current_buffer = 0;
+    buffer_us = (uint32_t)((uint64_t)BUFFER_SIZE * 1000000 / pwm_sample_rate());
+    for (int i = 0; i < 2; i++)
+        refill(i);
+    playback_active = true;
+    // Clock first: its IRQ-side updates start with the first buffer
+    song_clock_start(pwm_sample_rate());
+    dma_channel_set_read_addr(dma_chan, pwm_buffer[0], true);
+    __atomic_store_n(&playing, 1, __ATOMIC_RELAXED);
+}
+
+static void handle(const audio_cmd_t *cmd) {
+    TRACE_INSTANT(TRACE_AUDIO_CMD, cmd->op);
+    switch (cmd->op) {
+    case AUDIO_CMD_PLAY:
+        click_period = 0;
+        start();
+        break;
+    case AUDIO_CMD_CLICK:
+        click_period = cmd->period;
+        click_audible = cmd->audible;
+        start();
+        break;
+    case AUDIO_CMD_STOP:
+        if (__atomic_load_n(&playing, __ATOMIC_RELAXED))
+            halt();
+        break;
+    case AUDIO_CMD_VOLUME:
+        volume = cmd->volume;
+        break;
+    }
+}
+
+/*! \brief Handle requests and refill finished buffers; core0 loop
+*/
+void audio_service(void) {
+    audio_cmd_t cmd;
+    while (audio_cmds_pop(&cmd)) {
+        handle(&cmd);
+        // Release: playing is up to date for whoever sees the count
+        __atomic_store_n(&cmds_done, cmds_done + 1, __ATOMIC_RELEASE);
+    }
+    song_clock_service();
+    if (!__atomic_load_n(&playing, __ATOMIC_RELAXED))
+        return;
+    for (int i = 0; i < 2; i++) {
+        if (!buffer_ready[i])
+            continue;
+        TRACE_BEGIN(TRACE_AUDIO_REFILL, i);
+        xipmon_mark_t xip;
+        xipmon_begin(&xip);
+        bool more = refill(i);
+        xipmon_end(XIPMON_REFILL, &xip);
+        if (!more) {
+            // Track is out: the buffer still playing is the last one
+            playback_active = false;
+        } else {
+            // Time left before the other buffer runs out
+            perfmon_audio((int32_t)(freed_us[i] + buffer_us - time_us_32()));
+        }
+        TRACE_END(TRACE_AUDIO_REFILL, i);
+    }
+    if (!playback_active && !dma_channel_is_busy(dma_chan))
+        halt();
+}
+
+// Queue a request for the audio engine. The callers run on core0 between
+// passes of its loop, so the request is handled right here rather than on
+// the next pass: audio_play() is playing when it returns.
+static void send(const audio_cmd_t *cmd) {
+    while (!audio_cmds_push(cmd))
+        audio_service();
+    cmds_sent++;
+    audio_service();
+}
+
+// Rewind and play from the start; audio_playing() turns true once it runs
+void audio_play(void) {
+    audio_cmd_t cmd = { .op = AUDIO_CMD_PLAY };
+    send(&cmd);
+}
+
+/*! \brief Play a metronome instead of the track until audio_stop(); the
+    song clock starts with it, click k at sample k * period
+    \param period_ms time between clicks
+    \param audible false for silence with the same clock (visual calibration)
+    \return the period in samples
+*/
+uint32_t audio_click(uint32_t period_ms, bool audible) {
+    uint32_t period = (uint32_t)((uint64_t)pwm_sample_rate() * period_ms / 1000);
+    audio_cmd_t cmd = {
+        .op = AUDIO_CMD_CLICK,
+        .audible = audible,
+        .period = period ? period : 1,
+    };
+    send(&cmd);
+    return cmd.period;
+}
+
+// Halt the DMA; audio_idle() turns true once it has
+void audio_stop(void) {
+    audio_cmd_t cmd = { .op = AUDIO_CMD_STOP };
+    send(&cmd);
+}
+
+/*! \brief Master volume, scaling whatever the pot is set to; the default
+    comes from the settings store at boot
+    \param permille 1000 = full pot range
+*/
+void audio_set_volume(uint16_t permille) {
+    audio_cmd_t cmd = { .op = AUDIO_CMD_VOLUME, .volume = permille > 1000 ? 1000 : permille };
+    send(&cmd);
+}
+
+// Sample rate of the song clock, in Hz
+uint32_t audio_sample_rate(void) {
+    return pwm_sample_rate();
+}
+
+// Every request handled, and the DMA streaming
+bool audio_playing(void) {
+    return __atomic_load_n(&cmds_done, __ATOMIC_ACQUIRE) == cmds_sent &&
+           __atomic_load_n(&playing, __ATOMIC_RELAXED);
+}
+
+// Every request handled, and the DMA halted: safe to stall core0 (flash)
+bool audio_idle(void) {
+    return __atomic_load_n(&cmds_done, __ATOMIC_ACQUIRE) == cmds_sent &&
+           !__atomic_load_n(&playing, __ATOMIC_RELAXED);
+}
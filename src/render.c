@@ -0,0 +1,142 @@
+/* Renderer link: frame reports from core1 to core0
+    core1 does nothing but draw, so nothing it does can hold up a keypad
+    poll or a beat; the price is that its timing is out of sight of the
+    game. After every frame core1 pushes a report (start, length, whether
+    it drew a new game state) into a lossy channel, and core0 folds the
+    reports into the round's stats from its loop. A full channel drops the
+    report rather than stall the renderer; the drop is counted.
+
+    The frame blit is a DMA stream out of flash, which parking core1 for a
+    flash write does not stop. core0 holds the renderer first: it bumps
+    the hold sequence and waits for core1 to answer it from between two
+    frames, where no blit runs and none starts until the hold is released.
+    The sequence, not a flag, so a stale answer to an earlier hold never
+    passes for this one.
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "chan.h"
+#include "perfmon.h"
+#include "render.h"
+
+CHAN_DEFINE(reports, render_report_t, RENDER_REPORT_DEPTH, 0)
+
+// core0 side
+static render_stats_t stats;
+static uint32_t lost_seen = 0;          // reports.dropped at the last reset
+
+// Hold: core0 writes asked and held, core1 writes answered
+static uint32_t hold_asked = 0;
+static uint32_t hold_answered = 0;
+static bool hold_on = false;
+static bool attached = false;           // core1 renders frames
+
+/*! \brief Report a finished frame (core1, after each frame)
+    \param start_us time_us_64() when it began
+    \param end_us time_us_64() when it was on screen
+    \param redrawn it drew a game state the last frame had not
+*/
+void render_report(uint64_t start_us, uint64_t end_us, bool redrawn) {
+    render_report_t r = {
+        .start_us = (uint32_t)start_us,
+        .took_us = (uint32_t)(end_us - start_us),
+        .redrawn = redrawn,
+    };
+    reports_push(&r);
+}
+
+/*! \brief Take the waiting frame reports into the stats (core0 loop)
+*/
+void render_service(void) {
+    render_report_t r;
+    while (reports_pop(&r)) {
+        if (!stats.frames)
+            stats.first_us = r.start_us;
+        stats.frames++;
+        stats.redraws += r.redrawn;
+        stats.busy_us += r.took_us;
+        stats.last_us = r.start_us + r.took_us;
+        if (r.took_us > stats.worst_us)
+            stats.worst_us = r.took_us;
+        perfmon_frame(r.took_us);
+    }
+    // Written by core1 only; a snapshot is enough for the stats
+    stats.lost = __atomic_load_n(&reports.dropped, __ATOMIC_RELAXED) - lost_seen;
+}
+
+// core1, before its first frame: from now on a hold waits for its answer
+void render_attach(void) {
+    __atomic_store_n(&attached, true, __ATOMIC_RELEASE);
+}
+
+/*! \brief Keep core1 from starting a frame blit, and wait for the one
+    running to end (core0, before writing flash)
+    \param timeout_us longest wait; a frame is about 11 ms
+    \return true once no blit runs; false on timeout, and nothing is held
+*/
+bool render_hold(uint32_t timeout_us) {
+    if (!__atomic_load_n(&attached, __ATOMIC_ACQUIRE))
+        return true;
+    uint32_t seq = hold_asked + 1;
+    __atomic_store_n(&hold_on, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&hold_asked, seq, __ATOMIC_RELEASE);
+    uint64_t t0 = time_us_64();
+    while (__atomic_load_n(&hold_answered, __ATOMIC_ACQUIRE) != seq) {
+        if (time_us_64() - t0 > timeout_us) {
+            render_release();
+            return false;
+        }
+        tight_loop_contents();
+    }
+    return true;
+}
+
+// core0: frames may start again
+void render_release(void) {
+    __atomic_store_n(&hold_on, false, __ATOMIC_RELEASE);
+}
+
+/*! \brief Held by core0? core1, between frames; answers the hold, and no
+    blit may start while it returns true
+*/
+bool render_held(void) {
+    if (!__atomic_load_n(&hold_on, __ATOMIC_ACQUIRE))
+        return false;
+    __atomic_store_n(&hold_answered, __atomic_load_n(&hold_asked, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+    return true;
+}
+
+void render_get_stats(render_stats_t *out) {
+    render_service();
+    *out = stats;
+}
+
+// Frames per second, times 10, over the frames counted
+uint32_t render_fps_x10(const render_stats_t *st) {
+    uint32_t span = st->last_us - st->first_us;
+    if (st->frames < 2 || !span)
+        return 0;
+    return (uint32_t)((uint64_t)st->frames * 10000000 / span);
+}
+
+// Start counting again (a new round); reports still waiting are dropped
+void render_reset_stats(void) {
+    render_report_t r;
+    while (reports_pop(&r))
+        ;
+    stats = (render_stats_t){ 0 };
+    lost_seen = __atomic_load_n(&reports.dropped, __ATOMIC_RELAXED);
+}
+
+void render_print_stats(void) {
+    render_stats_t st;
+    render_get_stats(&st);
+    uint32_t fps = render_fps_x10(&st);
+    printf("render: %u frames, %u.%u fps, worst frame %u us, avg %u us, %u redrawn, "
+           "%u reports lost\n",
+           (unsigned)st.frames, (unsigned)(fps / 10), (unsigned)(fps % 10), (unsigned)st.worst_us,
+           (unsigned)(st.frames ? st.busy_us / st.frames : 0), (unsigned)st.redraws,
+           (unsigned)st.lost);
+}
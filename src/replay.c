@@ -0,0 +1,269 @@
+/* Input replay: record and play back the key event stream of a round
+    While recording, every key event the game handles is appended to a RAM
+    log as a delta-coded varint (no stdio, no allocation, a few hundred ns
+    per event). After the round the header is filled in with the chart,
+    seed and result, and the log can be written to the SD card.
+
+    Playback walks a log image in place, like a chart; the game feeds the
+    events back through the keypad callbacks at their song positions.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chart.h"
+#include "replay.h"
+#include "memmon.h"
+
+#ifdef SIM_HOST
+#define REPLAY_FILE_STDIO
+#elif defined(REPLAY_SD)
+#include "ff.h"
+#endif
+
+// Header first, so the finished log is one contiguous image
+static union {
+    replay_header_t hdr;
+    uint8_t bytes[REPLAY_LOG_BYTES];
+} log_buf;
+static uint32_t log_len = 0;
+static uint64_t log_at = 0;
+static bool recording = false;
+static bool overflow = false;
+
+/*! \brief Start a new log, dropping any previous one
+    \param chart_crc crc32 field of the chart header being played
+    \param sample_rate song sample rate
+    \param seed player / shuffle seed, 0 if none
+*/
+void replay_record_start(uint32_t chart_crc, uint32_t sample_rate, uint32_t seed) {
+    memset(&log_buf.hdr, 0, sizeof(log_buf.hdr));
+    log_buf.hdr.magic = REPLAY_MAGIC;
+    log_buf.hdr.version = REPLAY_VERSION;
+    log_buf.hdr.chart_crc = chart_crc;
+    log_buf.hdr.sample_rate = sample_rate;
+    log_buf.hdr.seed = seed;
+    log_len = sizeof(replay_header_t);
+    log_at = 0;
+    overflow = false;
+    recording = true;
+}
+
+/*! \brief Append one key event
+    \param key key index
+    \param press rising edge, else released
+    \param at song position of the event in samples, not before the last one
+*/
+void replay_record(uint8_t key, bool press, uint64_t at) {
+    if (!recording || overflow) return;
+    uint64_t delta = at > log_at ? at - log_at : 0;
+    uint64_t v = (delta << 7) | ((uint64_t)press << 6) | (key & 0x3F);
+    uint8_t enc[10];
+    uint32_t n = 0;
+    do {
+        enc[n] = v & 0x7F;
+        v >>= 7;
+        if (v) enc[n] |= 0x80;
+        n++;
+    } while (v);
+    if (log_len + n > REPLAY_LOG_BYTES) {
+        overflow = true;
+        return;
+    }
+    memcpy(&log_buf.bytes[log_len], enc, n);
+    log_len += n;
+    log_at = at;
+    log_buf.hdr.events++;
+}
+
+bool replay_recording(void) {
+    return recording;
+}
+
+/*! \brief Stop recording and fill in the header
+    \param score final combo
+    \param max_combo best combo of the round
+    \param accuracy judge_accuracy_permille() of the round
+    \param len image size in bytes, may be NULL
+    \return log image, or NULL if the log ran out of room
+*/
+const uint8_t *replay_record_finish(int32_t score, uint32_t max_combo, uint32_t accuracy,
+                                    uint32_t *len) {
+    recording = false;
+    replay_header_t *hdr = &log_buf.hdr;
+    hdr->bytes = log_len - sizeof(replay_header_t);
+    hdr->crc32 = chart_crc32(&log_buf.bytes[sizeof(replay_header_t)], hdr->bytes);
+    hdr->score = score;
+    hdr->max_combo = max_combo;
+    hdr->accuracy = accuracy;
+    if (len) *len = log_len;
+    return overflow ? NULL : log_buf.bytes;
+}
+
+/*! \brief Last finished log
+    \param len image size in bytes
+    \return log image, or NULL if none was finished or events were dropped
+*/
+const uint8_t *replay_log(uint32_t *len) {
+    if (recording || overflow || log_len < sizeof(replay_header_t)) return NULL;
+    *len = log_len;
+    return log_buf.bytes;
+}
+
+/*! \brief Write the finished log to a file
+    \param path file on the SD card (FatFs, built with -DREPLAY_SD)
+    \return REPLAY_OK, REPLAY_ERR_FULL if events were dropped, or REPLAY_ERR_IO
+*/
+replay_err_t replay_save_file(const char *path) {
+    if (overflow) return REPLAY_ERR_FULL;
+    if (recording || log_len < sizeof(replay_header_t)) return REPLAY_ERR_SIZE;
+#if defined(REPLAY_FILE_STDIO)
+    FILE *f = fopen(path, "wb");
+    if (!f) return REPLAY_ERR_IO;
+    size_t put = fwrite(log_buf.bytes, 1, log_len, f);
+    if (fclose(f) != 0 || put != log_len) return REPLAY_ERR_IO;
+    return REPLAY_OK;
+#elif defined(REPLAY_SD)
+    FIL f;
+    UINT put = 0;
+    if (f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return REPLAY_ERR_IO;
+    FRESULT fr = f_write(&f, log_buf.bytes, log_len, &put);
+    if (f_close(&f) != FR_OK || fr != FR_OK || put != log_len) return REPLAY_ERR_IO;
+    return REPLAY_OK;
+#else
+    (void)path;
+    return REPLAY_ERR_IO;
+#endif
+}
+
+/*! \brief Check a log image and point a replay at its first event
+    \param r replay to fill in
+    \param image header followed by the encoded events, 4-byte aligned
+    \param len image size in bytes
+    \return REPLAY_OK or the first problem found
+*/
+replay_err_t replay_open(replay_t *r, const void *image, uint32_t len) {
+    memset(r, 0, sizeof(*r));
+    if (len < sizeof(replay_header_t)) return REPLAY_ERR_SIZE;
+    const replay_header_t *hdr = image;
+    if (hdr->magic != REPLAY_MAGIC) return REPLAY_ERR_MAGIC;
+    if (hdr->version != REPLAY_VERSION) return REPLAY_ERR_VERSION;
+    if (hdr->bytes != len - sizeof(replay_header_t)) return REPLAY_ERR_SIZE;
+    const uint8_t *data = (const uint8_t *)image + sizeof(replay_header_t);
+    if (chart_crc32(data, hdr->bytes) != hdr->crc32) return REPLAY_ERR_CRC;
+    r->hdr = hdr;
+    r->data = data;
+    replay_rewind(r);
+    return REPLAY_OK;
+}
+
+/*! \brief Load a log file into the heap and open it
+    \param r replay to fill in, release with replay_close()
+    \param path file on the SD card (FatFs, built with -DREPLAY_SD)
+    \return REPLAY_OK, REPLAY_ERR_IO, or a replay_open() error
+*/
+replay_err_t replay_load_file(replay_t *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    uint8_t *buf = NULL;
+    uint32_t len = 0;
+#if defined(REPLAY_FILE_STDIO)
+    FILE *f = fopen(path, "rb");
+    if (!f) return REPLAY_ERR_IO;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long n = ftell(f);
+        if (n > 0 && fseek(f, 0, SEEK_SET) == 0 && (buf = mem_alloc(n)) != NULL) {
+            len = (uint32_t)n;
+            if (fread(buf, 1, len, f) != len) {
+                mem_free(buf);
+                buf = NULL;
+            }
+        }
+    }
+    fclose(f);
+#elif defined(REPLAY_SD)
+    FIL f;
+    UINT got = 0;
+    if (f_open(&f, path, FA_READ) != FR_OK) return REPLAY_ERR_IO;
+    len = (uint32_t)f_size(&f);
+    if (len && (buf = mem_alloc(len)) != NULL) {
+        if (f_read(&f, buf, len, &got) != FR_OK || got != len) {
+            mem_free(buf);
+            buf = NULL;
+        }
+    }
+    f_close(&f);
+#else
+    (void)path;
+#endif
+    if (!buf) return REPLAY_ERR_IO;
+
+    replay_err_t err = replay_open(r, buf, len);
+    if (err != REPLAY_OK) {
+        mem_free(buf);
+        return err;
+    }
+    r->owned = buf;
+    return REPLAY_OK;
+}
+
+void replay_close(replay_t *r) {
+    mem_free(r->owned);
+    memset(r, 0, sizeof(*r));
+}
+
+// Back to the first event
+void replay_rewind(replay_t *r) {
+    r->pos = 0;
+    r->at = 0;
+    r->left = r->hdr ? r->hdr->events : 0;
+}
+
+// Decode the event at r->pos without taking it; returns bytes used, 0 if none
+static uint32_t decode(const replay_t *r, replay_event_t *ev) {
+    if (!r->left) return 0;
+    uint64_t v = 0;
+    uint32_t n = 0;
+    for (;;) {
+        if (r->pos + n >= r->hdr->bytes || n >= 10) return 0;
+        uint8_t b = r->data[r->pos + n];
+        v |= (uint64_t)(b & 0x7F) << (7 * n);
+        n++;
+        if (!(b & 0x80)) break;
+    }
+    ev->at = r->at + (v >> 7);
+    ev->press = (v >> 6) & 1;
+    ev->key = v & 0x3F;
+    return n;
+}
+
+/*! \brief Look at the next event without taking it
+    \return false once every event has been taken
+*/
+bool replay_peek(const replay_t *r, replay_event_t *ev) {
+    return decode(r, ev) != 0;
+}
+
+/*! \brief Take the next event
+    \return false once every event has been taken
+*/
+bool replay_next(replay_t *r, replay_event_t *ev) {
+    uint32_t n = decode(r, ev);
+    if (!n) return false;
+    r->pos += n;
+    r->at = ev->at;
+    r->left--;
+    return true;
+}
+
+const char *replay_strerror(replay_err_t err) {
+    switch (err) {
+    case REPLAY_OK: return "ok";
+    case REPLAY_ERR_SIZE: return "size does not match the header";
+    case REPLAY_ERR_MAGIC: return "not a replay";
+    case REPLAY_ERR_VERSION: return "unsupported version";
+    case REPLAY_ERR_CRC: return "event CRC mismatch";
+    case REPLAY_ERR_FULL: return "log ran out of room, events dropped";
+    case REPLAY_ERR_IO: return "cannot read or write file";
+    }
+    return "unknown error";
+}
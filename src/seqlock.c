@@ -0,0 +1,60 @@
+/* Sequence lock: one writer, lock-free readers
+    The writer stores an odd sequence, then the block, then the next even
+    sequence with release. A reader loads the sequence with acquire, copies
+    the block and loads the sequence again after an acquire fence; if the
+    first was odd or the two differ, the copy may mix two writes and it goes
+    again. The block words are relaxed atomics, so neither side is a data
+    race and the compiler cannot split or merge the word accesses.
+
+    The writer must not be interrupted by a reader on its own core that
+    spins on the same block (it would never finish); the game writes from a
+    task and reads from other tasks, so that cannot happen here.
+*/
+
+#include "seqlock.h"
+
+/*! \brief Set up a block; call before either side uses it
+    \param s lock
+    \param storage size bytes, word aligned, shared by both cores
+    \param size bytes, a multiple of 4
+*/
+void seqlock_init(seqlock_t *s, void *storage, uint32_t size) {
+    s->data = storage;
+    s->words = size / 4;
+    s->retries = 0;
+    __atomic_store_n(&s->seq, 0, __ATOMIC_RELEASE);
+}
+
+/*! \brief Replace the block (the one writer)
+    \param src size bytes given to seqlock_init()
+*/
+void seqlock_write(seqlock_t *s, const void *src) {
+    const uint32_t *w = src;
+    uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    // Release fence: the odd sequence is visible before any word changes
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < s->words; i++)
+        __atomic_store_n(&s->data[i], w[i], __ATOMIC_RELAXED);
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*! \brief Copy the block out whole (any reader)
+    \param dst size bytes given to seqlock_init()
+    \return sequence of the copy: even, and changes with every write
+*/
+uint32_t seqlock_read(seqlock_t *s, void *dst) {
+    uint32_t *w = dst;
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            for (uint32_t i = 0; i < s->words; i++)
+                w[i] = __atomic_load_n(&s->data[i], __ATOMIC_RELAXED);
+            // Acquire fence: the words are read before the sequence below
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+                return seq;
+        }
+        __atomic_fetch_add(&s->retries, 1, __ATOMIC_RELAXED);
+    }
+}
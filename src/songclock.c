@@ -0,0 +1,193 @@
+/* Song clock
+    Game timing follows the music instead of the time since boot. The anchor
+    (sample count, timer value) moves forward from the DMA IRQ on every
+    finished buffer, so the clock cannot drift away from what is playing.
+
+    core0 (DMA IRQ and audio_service()) produces the clock, the game reads
+    it. Each change goes over a channel as the whole clock state, and the
+    reading side applies everything waiting before it answers, so it owns
+    its copy and never sees a half-moved anchor. A state that finds the
+    channel full is held and sent with the next one or by
+    song_clock_service(); as every message is complete, only the latest
+    one matters. Thread-side sends run with interrupts off, so they never
+    interleave with the IRQ's.
+
+    The position the game sees is the one the player hears: the DMA
+    position less the calibrated audio offset (speaker, ears and fingers).
+    LED changes are sent ahead of it by the visual offset, so they are
+    seen on the beat the player hears.
+*/
+
+#include "pico/stdlib.h"
+#include "chan.h"
+#include "songclock.h"
+#include "hotpath.h"
+
+#ifdef SIM_HOST
+// One thread: no IRQ to keep out
+#define irq_save() 0u
+#define irq_restore(s) ((void)(s))
+#else
+#include "hardware/sync.h"
+#define irq_save() save_and_disable_interrupts()
+#define irq_restore(s) restore_interrupts(s)
+#endif
+
+typedef struct {
+    uint64_t samples;           ///< played when the anchor was taken
+    uint64_t us;                ///< timer value of the anchor
+    uint32_t rate;
+    uint32_t running;
+} clock_msg_t;
+
+// A second of buffers; the game reads the clock far more often
+#define SONG_CLOCK_CHAN_DEPTH 32
+CHAN_DEFINE(clock_chan, clock_msg_t, SONG_CLOCK_CHAN_DEPTH, 0)
+
+// Producer (core0)
+static clock_msg_t sent;
+static clock_msg_t held;
+static volatile bool holding = false;
+
+// Reader: applied from the channel
+static bool running = false;
+static uint32_t rate = 1;
+static uint64_t anchor_samples = 0;
+static uint64_t anchor_us = 0;
+static int32_t audio_offset_us = 0;
+static int32_t visual_offset_us = 0;
+
+// Send the producer's state, or hold it if the channel is full
+static void HOT_FUNC(send)(void) {
+    if (clock_chan_push(&sent)) {
+        holding = false;
+        return;
+    }
+    held = sent;
+    holding = true;
+}
+
+/*! \brief Retry a held state; core0 loop, from audio_service()
+*/
+void song_clock_service(void) {
+    if (!holding) return;
+    uint32_t irq = irq_save();
+    if (holding && clock_chan_push(&held))
+        holding = false;
+    irq_restore(irq);
+}
+
+/*! \brief Start the clock at song position 0 (core0, thread)
+    \param sample_rate audio sample rate in Hz
+*/
+void song_clock_start(uint32_t sample_rate) {
+    uint32_t irq = irq_save();
+    sent.rate = sample_rate ? sample_rate : 1;
+    sent.samples = 0;
+    sent.us = time_us_64();
+    sent.running = 1;
+    send();
+    irq_restore(irq);
+}
+
+// core0, thread
+void song_clock_stop(void) {
+    uint32_t irq = irq_save();
+    sent.running = 0;
+    send();
+    irq_restore(irq);
+}
+
+/*! \brief Move the anchor forward by one finished buffer (DMA IRQ; SRAM)
+    \param samples samples in the buffer that just finished
+*/
+void HOT_FUNC(song_clock_buffer_done)(uint32_t samples) {
+    if (!sent.running) return;
+    sent.samples += samples;
+    sent.us = hot_time_us_64();
+    send();
+}
+
+// Apply every state waiting; the reading side only
+static void sync(void) {
+    clock_msg_t m;
+    bool got = false;
+    while (clock_chan_pop(&m))
+        got = true;
+    if (!got) return;
+    running = m.running;
+    rate = m.rate;
+    anchor_samples = m.samples;
+    anchor_us = m.us;
+}
+
+bool song_clock_running(void) {
+    sync();
+    return running;
+}
+
+/*! \brief Samples played so far by the DMA (no offsets)
+*/
+uint64_t song_clock_samples(void) {
+    sync();
+    if (!running) return 0;
+    return anchor_samples + (time_us_64() - anchor_us) * rate / 1000000;
+}
+
+// DMA position in microseconds, no offsets; after sync()
+static uint64_t raw_us(void) {
+    return anchor_samples * 1000000 / rate + (time_us_64() - anchor_us);
+}
+
+/*! \brief Song position in microseconds, as heard (audio offset applied);
+    0 until the start of the song has been heard
+*/
+uint64_t song_clock_us(void) {
+    sync();
+    if (!running) return 0;
+    int64_t us = (int64_t)raw_us() - audio_offset_us;
+    return us > 0 ? (uint64_t)us : 0;
+}
+
+/*! \brief Position of the DMA in the song, without the offsets (calibration)
+*/
+uint64_t song_clock_raw_us(void) {
+    sync();
+    return running ? raw_us() : 0;
+}
+
+uint32_t song_clock_ms(void) {
+    return (uint32_t)(song_clock_us() / 1000);
+}
+
+/*! \brief Timer value at which the song reaches a position
+    \param song_us song position in microseconds, as heard
+    \return absolute time, usable with the SDK alarm functions
+*/
+absolute_time_t song_clock_to_abs(uint64_t song_us) {
+    int64_t ahead = (int64_t)song_us + audio_offset_us - (int64_t)song_clock_raw_us();
+    return delayed_by_us(get_absolute_time(), ahead > 0 ? (uint64_t)ahead : 0);
+}
+
+/*! \brief Timer value at which to send an LED change that should be seen
+    at a song position: the visual offset earlier
+    \param song_us song position in microseconds, as heard
+*/
+absolute_time_t song_clock_visual_to_abs(uint64_t song_us) {
+    int64_t at = (int64_t)song_us - visual_offset_us;
+    return song_clock_to_abs(at > 0 ? (uint64_t)at : 0);
+}
+
+/*! \brief Set the latency offsets (from calibration)
+    \param audio_us taps land this long after a sound leaves the DMA
+    \param visual_us taps land this long after an LED change is sent
+*/
+void song_clock_set_offsets(int32_t audio_us, int32_t visual_us) {
+    audio_offset_us = audio_us;
+    visual_offset_us = visual_us;
+}
+
+void song_clock_get_offsets(int32_t *audio_us, int32_t *visual_us) {
+    *audio_us = audio_offset_us;
+    *visual_us = visual_offset_us;
+}
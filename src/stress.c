@@ -0,0 +1,325 @@
+/* Input stress: synthetic key events and input latency percentiles
+    Autoplay presses every lane of every note at its song time, and keeps
+    holds to their end. Storms throw bursts of random edges, up to the most
+    one poll takes from a FIFO, at random intervals, off autoplay's keys
+    and the lanes of the notes it is about to press. Both run as timed
+    tasks next to the game and hand their edges to a sink: neo_inject() on
+    the device (the driver boundary: they come out of the next poll with
+    the board's own events) or the simulated Seesaw FIFO on the host.
+
+    Each press is timestamped when injected. The game's judgement of that
+    press (observer callback) closes the event-to-judgement sample, and the
+    SHOW that puts its hit colour on the LEDs closes the event-to-LED one.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "neotrellis.h"
+#include "i2c_sched.h"
+#include "songclock.h"
+#include "evsched.h"
+#include "minigame.h"
+#include "stress.h"
+
+#ifdef SIM_HOST
+// One thread: no IRQ to keep out
+#define irq_save() 0u
+#define irq_restore(s) ((void)(s))
+#else
+#include "hardware/sync.h"
+#define irq_save() save_and_disable_interrupts()
+#define irq_restore(s) restore_interrupts(s)
+#endif
+
+typedef struct {
+    uint64_t at_us[STRESS_KEY_DEPTH];
+    uint8_t head;
+    uint8_t len;
+} press_queue_t;
+
+static uint8_t stress_mode = 0;
+static stress_sink_t sink = NULL;
+static uint32_t rng = 1;
+static evsched_task_t t_auto;
+static evsched_task_t t_storm;
+
+// Autoplay
+static const chart_t *chart = NULL;
+static chart_cursor_t cur;
+static uint64_t down = 0;                   // keys held by autoplay
+static uint64_t release_at[NEO_TRELLIS_MAX_KEYS];
+static uint64_t storm_down = 0;             // keys held by a storm
+
+// Latency
+static press_queue_t presses[NEO_TRELLIS_MAX_KEYS];
+static uint64_t led_since[NEO_TRELLIS_MAX_KEYS];  // by pixel
+static volatile uint64_t led_waiting = 0;
+static i2c_sched_show_hook_t next_hook = NULL;
+static uint32_t judge_lat[STRESS_MAX_SAMPLES];
+static uint32_t led_lat[STRESS_MAX_SAMPLES];
+static uint32_t judge_max = 0;
+static uint32_t led_max = 0;
+static uint32_t sample_rng = 1;     // own stream, so the storm pattern does not depend on it
+static stress_stats_t stats;
+
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/*! \brief Keep a latency sample: the first STRESS_MAX_SAMPLES as they come,
+    then each later one replaces a random kept one with the odds that keep
+    the set a uniform sample of everything seen (reservoir sampling)
+    \param v sample storage
+    \param seen samples seen before this one
+    \param lat latency in us
+*/
+static void keep_sample(uint32_t *v, uint32_t seen, uint32_t lat) {
+    if (seen < STRESS_MAX_SAMPLES) {
+        v[seen] = lat;
+        return;
+    }
+    sample_rng ^= sample_rng << 13;
+    sample_rng ^= sample_rng >> 17;
+    sample_rng ^= sample_rng << 5;
+    uint32_t i = sample_rng % (seen + 1);
+    if (i < STRESS_MAX_SAMPLES)
+        v[i] = lat;
+}
+
+static void sink_inject(uint8_t key, bool press) {
+    neo_inject(key, press ? SEESAW_KEYPAD_EDGE_RISING : SEESAW_KEYPAD_EDGE_FALLING);
+}
+
+static uint8_t pixel_of(uint8_t key) {
+    return neotrellis_key_board(key) * NEO_TRELLIS_KEYS_PER_BOARD + neotrellis_key_local(key);
+}
+
+static void emit(uint8_t key, bool press) {
+    if (press) {
+        press_queue_t *q = &presses[key];
+        if (q->len == STRESS_KEY_DEPTH) {
+            q->head = (q->head + 1) % STRESS_KEY_DEPTH;
+            q->len--;
+        }
+        q->at_us[(q->head + q->len) % STRESS_KEY_DEPTH] = time_us_64();
+        q->len++;
+        stats.presses++;
+    }
+    stats.injected++;
+    sink(key, press);
+}
+
+static uint64_t song_pos(void) {
+    return song_clock_us() * chart->rate / 1000000;
+}
+
+// Absolute time of a song position, rounded up
+static uint64_t pos_abs_us(uint64_t at) {
+    return to_us_since_boot(song_clock_to_abs((at * 1000000 + chart->rate - 1) / chart->rate));
+}
+
+static void auto_task(evsched_task_t *t, uint64_t now_us) {
+    uint64_t now = song_pos();
+    uint64_t keys = down;
+    while (keys) {
+        uint8_t key = __builtin_ctzll(keys);
+        keys &= keys - 1;
+        if (release_at[key] <= now) {
+            down &= ~(1ull << key);
+            emit(key, false);
+        }
+    }
+    int32_t idx;
+    while ((idx = chart_cursor_take(&cur, now)) >= 0) {
+        const chart_note_t *n = &chart->notes[idx];
+        uint32_t hold = n->hold ? n->hold : chart_ms_to_samples(chart, STRESS_TAP_MS);
+        uint64_t lanes = n->lanes;
+        while (lanes) {
+            uint8_t key = __builtin_ctzll(lanes);
+            lanes &= lanes - 1;
+            if (key >= neotrellis_num_keys()) continue;
+            if ((down | storm_down) & (1ull << key))
+                emit(key, false);
+            storm_down &= ~(1ull << key);
+            emit(key, true);
+            down |= 1ull << key;
+            release_at[key] = (uint64_t)n->time + hold;
+        }
+    }
+
+    // Next note or release, whichever is first
+    uint64_t next = UINT64_MAX;
+    if (!chart_cursor_done(&cur))
+        next = chart->notes[cur.next].time;
+    keys = down;
+    while (keys) {
+        uint8_t key = __builtin_ctzll(keys);
+        keys &= keys - 1;
+        if (release_at[key] < next)
+            next = release_at[key];
+    }
+    if (next != UINT64_MAX)
+        evsched_at(t, pos_abs_us(next));
+}
+
+// Lanes of the notes autoplay has still to press that are due within
+// STRESS_STORM_GUARD_MS; without autoplay, none
+static uint64_t guarded_lanes(void) {
+    if (!(stress_mode & STRESS_AUTOPLAY))
+        return 0;
+    uint64_t until = song_pos() + chart_ms_to_samples(chart, STRESS_STORM_GUARD_MS);
+    uint64_t lanes = 0;
+    for (uint32_t i = cur.next; i < chart->count && chart->notes[i].time <= until; i++)
+        lanes |= chart->notes[i].lanes;
+    return lanes;
+}
+
+static void storm_task(evsched_task_t *t, uint64_t now_us) {
+    uint32_t n = 1 + rng_next() % NEO_TRELLIS_FIFO_MAX;
+    // Autoplay's keys, and the lanes of its next notes, are left alone so
+    // its presses stay on time and are the only ones judged as hits
+    uint64_t skip = down | guarded_lanes();
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t key = rng_next() % neotrellis_num_keys();
+        if (skip & (1ull << key)) continue;
+        bool press = !(storm_down & (1ull << key));
+        storm_down ^= 1ull << key;
+        emit(key, press);
+    }
+    stats.bursts++;
+    if (n > stats.burst_max)
+        stats.burst_max = n;
+    evsched_at(t, time_us_64() + 2000 + rng_next() % ((STRESS_STORM_GAP_MS - 2) * 1000));
+}
+
+// Pixels whose hit colour went out with this SHOW
+static void on_show(uint64_t unshown) {
+    if (next_hook)
+        next_hook(unshown);
+    uint64_t done = led_waiting & ~unshown;
+    if (!done) return;
+    led_waiting &= ~done;
+    uint64_t now = time_us_64();
+    while (done) {
+        uint8_t p = __builtin_ctzll(done);
+        done &= done - 1;
+        uint32_t lat = (uint32_t)(now - led_since[p]);
+        keep_sample(led_lat, stats.shown++, lat);
+        if (lat > led_max)
+            led_max = lat;
+    }
+}
+
+/*! \brief Start injecting; call after game_start()
+    \param mode STRESS_AUTOPLAY and/or STRESS_STORM
+    \param seed storm pattern
+    \param s where edges go, NULL for neo_inject()
+*/
+void stress_start(uint8_t mode, uint32_t seed, stress_sink_t s) {
+    stress_mode = mode;
+    sink = s ? s : sink_inject;
+    rng = seed ? seed : 1;
+    chart = game_chart();
+    chart_cursor_init(&cur, chart, 0);
+    chart_cursor_seek(&cur, song_pos());
+    down = storm_down = 0;
+    led_waiting = 0;
+    memset(presses, 0, sizeof(presses));
+    memset(&stats, 0, sizeof(stats));
+    judge_max = led_max = 0;
+    sample_rng = 1;
+    // In front of whoever watches the SHOWs already (perfmon.c)
+    i2c_sched_show_hook_t was = i2c_sched_set_show_hook(on_show);
+    if (was != on_show)
+        next_hook = was;
+
+    evsched_task(&t_auto, "autoplay", EVS_PRIO_BEAT, auto_task, NULL);
+    evsched_task(&t_storm, "storm", EVS_PRIO_INPUT, storm_task, NULL);
+    if ((stress_mode & STRESS_AUTOPLAY) && !chart_cursor_done(&cur))
+        evsched_at(&t_auto, pos_abs_us(chart->notes[cur.next].time));
+    if (stress_mode & STRESS_STORM)
+        evsched_at(&t_storm, time_us_64());
+}
+
+void stress_stop(void) {
+    evsched_cancel(&t_auto);
+    evsched_cancel(&t_storm);
+    i2c_sched_set_show_hook(next_hook);
+    next_hook = NULL;
+}
+
+/*! \brief Game observer: match judgements to the presses that caused them
+*/
+void stress_on_judge(const judge_event_t *ev) {
+    if (ev->kind != JUDGE_EV_HIT && ev->kind != JUDGE_EV_STRAY)
+        return;
+    press_queue_t *q = &presses[ev->lane];
+    if (!q->len) {
+        stats.unmatched++;
+        return;
+    }
+    uint64_t at = q->at_us[q->head];
+    q->head = (q->head + 1) % STRESS_KEY_DEPTH;
+    q->len--;
+    uint32_t lat = (uint32_t)(time_us_64() - at);
+    keep_sample(judge_lat, stats.judged++, lat);
+    if (lat > judge_max)
+        judge_max = lat;
+    if (ev->kind == JUDGE_EV_HIT) {
+        // The game has queued the hit colour; the next SHOW without it
+        // still dirty puts it on the LEDs
+        // on_show() takes bits off from the beat alarm IRQ (i2c_sched.c)
+        uint8_t p = pixel_of(ev->lane);
+        uint32_t irq = irq_save();
+        led_since[p] = at;
+        led_waiting |= 1ull << p;
+        irq_restore(irq);
+    }
+}
+
+void stress_get_stats(stress_stats_t *out) {
+    *out = stats;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*! \brief Latency percentile (sorts the samples; call once injection stopped)
+    \param led event-to-LED, else event-to-judgement
+    \param permille 500 = median; 1000 = max, exact even past STRESS_MAX_SAMPLES
+    \return microseconds, 0 without samples
+*/
+uint32_t stress_percentile(bool led, uint32_t permille) {
+    if (permille >= 1000)
+        return led ? led_max : judge_max;
+    uint32_t *v = led ? led_lat : judge_lat;
+    uint32_t n = led ? stats.shown : stats.judged;
+    if (n > STRESS_MAX_SAMPLES) n = STRESS_MAX_SAMPLES;
+    if (!n) return 0;
+    qsort(v, n, sizeof(*v), cmp_u32);
+    uint32_t i = (uint32_t)(((uint64_t)n * permille + 999) / 1000);
+    return v[i ? i - 1 : 0];
+}
+
+void stress_print_stats(void) {
+    printf("stress: %u edges (%u presses), %u bursts of up to %u, %u injects dropped, "
+           "%u judgements unmatched\n",
+           (unsigned)stats.injected, (unsigned)stats.presses, (unsigned)stats.bursts,
+           (unsigned)stats.burst_max, (unsigned)neo_inject_dropped(), (unsigned)stats.unmatched);
+    static const uint32_t pct[] = { 500, 900, 990, 999, 1000 };
+    for (int led = 0; led < 2; led++) {
+        printf("stress: event to %-9s %5u samples, p50/p90/p99/p99.9/max",
+               led ? "LED" : "judgement", (unsigned)(led ? stats.shown : stats.judged));
+        for (int i = 0; i < 5; i++)
+            printf("%s%u", i ? "/" : " ", (unsigned)stress_percentile(led, pct[i]));
+        printf(" us\n");
+    }
+}
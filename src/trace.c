@@ -0,0 +1,92 @@
+/* Event trace rings, one per core (built with -DTRACE)
+    Each core only writes its own ring, tasks and IRQs alike, so recording
+    is an atomic add for the slot and four stores; there is no lock and no
+    check for a reader. The ring wraps: the oldest events are overwritten.
+
+    The dump is text over stdio, one event per line behind a "trace:"
+    prefix, so it can be cut out of a serial log with the rest of the
+    output around it. Recording is paused while it prints; an event core1
+    was in the middle of may come out half written. The dump holds the
+    calling core for as long as the USB takes, so ask between rounds.
+*/
+
+#ifdef TRACE
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "trace.h"
+
+trace_ring_t trace_rings[TRACE_CORES];
+// On from boot, so the boot steps are in the first dump
+uint32_t trace_on = 1;
+
+static const char *names[TRACE_MAX_NAMES] = {
+    [TRACE_AUDIO_IRQ] = "audio_irq",
+    [TRACE_AUDIO_REFILL] = "audio_refill",
+    [TRACE_AUDIO_CMD] = "audio_cmd",
+    [TRACE_I2C] = "i2c",
+    [TRACE_KEY_POLL] = "key_poll",
+    [TRACE_I2C_TICK] = "i2c_tick",
+    [TRACE_LED_SHOW] = "led_show",
+    [TRACE_BEAT_SHOW] = "beat_show",
+    [TRACE_JUDGE] = "judge",
+    [TRACE_SNAPSHOT] = "snapshot",
+    [TRACE_FLOW] = "flow",
+    [TRACE_FLASH] = "flash",
+    [TRACE_BOOT] = "boot",
+    [TRACE_FRAME] = "frame",
+    [TRACE_BLIT] = "blit",
+    [TRACE_HUD] = "hud",
+    [TRACE_TASK] = "task",
+};
+static uint32_t num_names = TRACE_IDS;
+
+// Empty the rings and record from now on
+void trace_init(void) {
+    __atomic_store_n(&trace_on, 0, __ATOMIC_RELAXED);
+    memset(trace_rings, 0, sizeof(trace_rings));
+    __atomic_store_n(&trace_on, 1, __ATOMIC_RELAXED);
+}
+
+/*! \brief Event id for a name of its own (a scheduler task)
+    \param name must stay valid; the same name gets the same id
+    \return id for TRACE_BEGIN() etc., TRACE_TASK once the table is full
+*/
+uint8_t trace_name(const char *name) {
+    uint32_t n = __atomic_load_n(&num_names, __ATOMIC_ACQUIRE);
+    for (uint32_t i = TRACE_IDS; i < n && i < TRACE_MAX_NAMES; i++)
+        if (names[i] && strcmp(names[i], name) == 0)
+            return (uint8_t)i;
+    // Both cores register at boot; a name taken twice gets two ids
+    uint32_t i = __atomic_fetch_add(&num_names, 1, __ATOMIC_ACQ_REL);
+    if (i >= TRACE_MAX_NAMES)
+        return TRACE_TASK;
+    names[i] = name;
+    return (uint8_t)i;
+}
+
+/*! \brief Print the names, then every core's events oldest first
+*/
+void trace_dump(void) {
+    uint32_t was = __atomic_exchange_n(&trace_on, 0, __ATOMIC_ACQ_REL);
+    uint32_t n = MIN(__atomic_load_n(&num_names, __ATOMIC_ACQUIRE), TRACE_MAX_NAMES);
+    printf("trace: begin %u\n", (unsigned)time_us_32());
+    for (uint32_t i = 0; i < n; i++)
+        if (names[i])
+            printf("trace: name %u %s\n", (unsigned)i, names[i]);
+    uint32_t lost = 0;
+    for (int c = 0; c < TRACE_CORES; c++) {
+        const trace_ring_t *r = &trace_rings[c];
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint32_t from = head > TRACE_DEPTH ? head - TRACE_DEPTH : 0;
+        lost += from;
+        for (uint32_t i = from; i < head; i++) {
+            const trace_event_t *e = &r->ev[i & (TRACE_DEPTH - 1)];
+            printf("trace: ev %d %u %c %u %u\n", c, (unsigned)e->t_us, e->ph, (unsigned)e->id,
+                   (unsigned)e->arg);
+        }
+    }
+    printf("trace: end %u overwritten\n", (unsigned)lost);
+    __atomic_store_n(&trace_on, was, __ATOMIC_RELEASE);
+}
+#endif
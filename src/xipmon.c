@@ -0,0 +1,167 @@
+/* XIP cache counters around the render and the refill
+    The cache counts hits and accesses in two 32-bit registers that stop
+    at their maximum and clear when written. Every reading here takes
+    them, clears them and adds them to 64-bit totals under a hardware
+    spin lock, as both cores read them: a span is the totals' difference
+    between its two ends. Accesses made between the read and the clear
+    are lost, a handful at most.
+
+    The render span is written by core1 alone and the refill by core0, so
+    each span's stats have a single writer; core0 resets and prints them
+    between rounds.
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "xipmon.h"
+#ifdef XIP_BENCH
+#include "hardware/xip_cache.h"
+#endif
+
+static const char *const span_names[XIPMON_SPANS] = {
+    [XIPMON_RENDER] = "render",
+    [XIPMON_REFILL] = "refill",
+};
+
+static spin_lock_t *lock = NULL;
+static uint64_t total_accesses = 0;
+static uint64_t total_hits = 0;
+static xipmon_stats_t stats[XIPMON_SPANS];
+
+/*! \brief Claim the spin lock and start the counters from zero; core0,
+    before core1 is launched
+*/
+void xipmon_init(void) {
+    lock = spin_lock_init(spin_lock_claim_unused(true));
+    xip_ctrl_hw->ctr_hit = 0;
+    xip_ctrl_hw->ctr_acc = 0;
+}
+
+/*! \brief Mark the start of a span (or its end, for xipmon_end())
+*/
+void xipmon_begin(xipmon_mark_t *m) {
+    uint32_t s = spin_lock_blocking(lock);
+    // Hits before accesses: an access between the two reads is counted
+    // now, its hit maybe only next time (misses() allows for that)
+    uint32_t hits = xip_ctrl_hw->ctr_hit;
+    uint32_t accesses = xip_ctrl_hw->ctr_acc;
+    xip_ctrl_hw->ctr_hit = 0;
+    xip_ctrl_hw->ctr_acc = 0;
+    total_hits += hits;
+    total_accesses += accesses;
+    m->hits = total_hits;
+    m->accesses = total_accesses;
+    spin_unlock(lock, s);
+    m->us = time_us_32();
+}
+
+// Misses between two marks; a hit whose access went in the mark before
+// would make it less than none
+static uint64_t misses(const xipmon_mark_t *from, const xipmon_mark_t *to) {
+    uint64_t accesses = to->accesses - from->accesses;
+    uint64_t hits = to->hits - from->hits;
+    return hits < accesses ? accesses - hits : 0;
+}
+
+/*! \brief Close a span and add it to its stats
+    \param span XIPMON_RENDER on core1, XIPMON_REFILL on core0
+    \param m from xipmon_begin() at the start
+*/
+void xipmon_end(xipmon_span_t span, const xipmon_mark_t *m) {
+    xipmon_mark_t now;
+    xipmon_begin(&now);
+    xipmon_stats_t *st = &stats[span];
+    uint32_t us = now.us - m->us;
+    uint32_t missed = (uint32_t)misses(m, &now);
+    st->spans++;
+    st->accesses += now.accesses - m->accesses;
+    st->hits += now.accesses - m->accesses - missed;
+    st->us += us;
+    if (us > st->worst_us)
+        st->worst_us = us;
+    if (missed > st->worst_misses)
+        st->worst_misses = missed;
+}
+
+void xipmon_get_stats(xipmon_span_t span, xipmon_stats_t *out) {
+    *out = stats[span];
+}
+
+// Start counting again (a new round)
+void xipmon_reset_stats(void) {
+    for (int s = 0; s < XIPMON_SPANS; s++)
+        stats[s] = (xipmon_stats_t){ 0 };
+}
+
+void xipmon_print_stats(void) {
+    for (int s = 0; s < XIPMON_SPANS; s++) {
+        const xipmon_stats_t *st = &stats[s];
+        if (!st->spans)
+            continue;
+        uint64_t missed = st->accesses - st->hits;
+        uint32_t hit_pm = st->accesses ? (uint32_t)(st->hits * 1000 / st->accesses) : 1000;
+        printf("xip: %s %u spans, avg %u us (worst %u), hit %u.%u%%, misses avg %u max %u\n",
+               span_names[s], (unsigned)st->spans, (unsigned)(st->us / st->spans),
+               (unsigned)st->worst_us, (unsigned)(hit_pm / 10), (unsigned)(hit_pm % 10),
+               (unsigned)(missed / st->spans), (unsigned)st->worst_misses);
+    }
+}
+
+#ifdef XIP_BENCH
+// pwm.c: the refill's loop in SRAM (hotpath.h), and the same left in flash
+void fill_pwm_buffer(uint16_t *dest, const uint8_t *src, int count, float multiplier);
+void fill_pwm_buffer_flash(uint16_t *dest, const uint8_t *src, int count, float multiplier);
+typedef void (*fill_fn_t)(uint16_t *dest, const uint8_t *src, int count, float multiplier);
+
+// One PWM buffer per loop
+#define XIPMON_BENCH_SAMPLES 1024
+
+static uint16_t bench_buf[XIPMON_BENCH_SAMPLES];
+
+static void bench_case(const char *where, fill_fn_t fill, bool cold, const uint8_t *pcm,
+                       uint32_t samples) {
+    uint64_t us = 0, accesses = 0, missed = 0;
+    uint32_t worst = 0;
+    uint32_t at = 0;
+    for (int r = 0; r < XIPMON_BENCH_RUNS; r++) {
+        // The song moves on as in a round: its data is never in the cache
+        if (at + XIPMON_BENCH_SAMPLES > samples)
+            at = 0;
+        if (cold)
+            xip_cache_invalidate_all();
+        xipmon_mark_t start, end;
+        xipmon_begin(&start);
+        fill(bench_buf, pcm + at * 2, XIPMON_BENCH_SAMPLES, 0.5f);
+        xipmon_begin(&end);
+        uint32_t took = end.us - start.us;
+        us += took;
+        if (took > worst)
+            worst = took;
+        accesses += end.accesses - start.accesses;
+        missed += misses(&start, &end);
+        at += XIPMON_BENCH_SAMPLES;
+    }
+    printf("xip bench: %-5s %-4s %5u us avg, %5u max, %6u accesses, %5u misses a loop\n", where,
+           cold ? "cold" : "warm", (unsigned)(us / XIPMON_BENCH_RUNS), (unsigned)worst,
+           (unsigned)(accesses / XIPMON_BENCH_RUNS), (unsigned)(missed / XIPMON_BENCH_RUNS));
+}
+
+/*! \brief Refill loop from flash vs. SRAM, warm and cold cache; core0,
+    audio idle (it holds the core). core1 keeps rendering meanwhile, so
+    the counts have its blits in them as they would in a round.
+    \param pcm the song, 16-bit mono
+    \param samples in the song
+*/
+void xipmon_bench(const uint8_t *pcm, uint32_t samples) {
+    if (samples < XIPMON_BENCH_SAMPLES)
+        return;
+    printf("xip bench: %u loops of %u samples each\n", (unsigned)XIPMON_BENCH_RUNS,
+           (unsigned)XIPMON_BENCH_SAMPLES);
+    bench_case("flash", fill_pwm_buffer_flash, false, pcm, samples);
+    bench_case("flash", fill_pwm_buffer_flash, true, pcm, samples);
+    bench_case("sram", fill_pwm_buffer, false, pcm, samples);
+    bench_case("sram", fill_pwm_buffer, true, pcm, samples);
+}
+#endif